@@ -0,0 +1,59 @@
+#include "counter_report.h"
+
+#include <cstdio>
+
+std::string format_counter_report(live_counters_snapshot const &snapshot, live_counters_snapshot const *previous, std::chrono::steady_clock::duration elapsed)
+{
+	std::string report;
+	char line[128];
+
+	std::snprintf(line, sizeof(line), "process %u, %u threads publishing", snapshot.process_id, snapshot.slots_in_use);
+	report.append(line);
+	if (snapshot.slots_exhausted != 0)
+	{
+		std::snprintf(line, sizeof(line), ", %u threads without a slot", snapshot.slots_exhausted);
+		report.append(line);
+	}
+	report.push_back('\n');
+
+	const auto seconds = std::chrono::duration<double>(elapsed).count();
+	for (size_t i = 0; i < live_counter_count; ++i)
+	{
+		const auto counter = static_cast<live_counter>(i);
+		const auto name = live_counter_names[i];
+		if (get_live_counter_kind(counter) == live_counter_kind::gauge)
+		{
+			std::snprintf(line, sizeof(line), "  %-28.*s %16lld\n", static_cast<int>(name.size()), name.data(), static_cast<long long>(snapshot.get_gauge(counter)));
+		}
+		else if (previous && seconds > 0.0)
+		{
+			const auto delta = snapshot.get_total(counter) - previous->get_total(counter);
+			std::snprintf(line, sizeof(line), "  %-28.*s %16llu %12.1f/s\n", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(snapshot.get_total(counter)), delta / seconds);
+		}
+		else
+		{
+			std::snprintf(line, sizeof(line), "  %-28.*s %16llu\n", static_cast<int>(name.size()), name.data(), static_cast<unsigned long long>(snapshot.get_total(counter)));
+		}
+		report.append(line);
+	}
+
+	return report;
+}
+
+std::string_view get_read_result_name(live_counters_read_result result)
+{
+	switch (result)
+	{
+	case live_counters_read_result::ok:
+		return "ok";
+	case live_counters_read_result::too_small:
+		return "the region is too small";
+	case live_counters_read_result::bad_magic:
+		return "the region isn't a counters region";
+	case live_counters_read_result::unsupported_version:
+		return "the region is from an unsupported version";
+	case live_counters_read_result::bad_layout:
+		return "the region layout isn't valid";
+	}
+	return "unknown";
+}
\ No newline at end of file
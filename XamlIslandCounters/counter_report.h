@@ -0,0 +1,12 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "live_counters.h"
+
+//Formats a snapshot as one line per counter.
+//If there is an earlier snapshot then totals also show their rate per second since it was taken.
+std::string format_counter_report(live_counters_snapshot const &, live_counters_snapshot const *previous, std::chrono::steady_clock::duration elapsed);
+
+std::string_view get_read_result_name(live_counters_read_result);
\ No newline at end of file
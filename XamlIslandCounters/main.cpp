@@ -0,0 +1,92 @@
+#define _WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "counter_report.h"
+
+#include <climits>
+#include <cwchar>
+#include <iostream>
+#include <string>
+
+//Prints the live counters of a running XamlIslandTest3.
+//Usage: XamlIslandCounters <process id> [interval in milliseconds] [samples]
+//With an interval the counters are sampled until the count runs out or the process exits.
+//The region is mapped read only, so this can't disturb the process being watched.
+
+int wmain(int argc, wchar_t *argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: XamlIslandCounters <process id> [interval in milliseconds] [samples]\n";
+		return 2;
+	}
+
+	const auto process_id = static_cast<DWORD>(std::wcstoul(argv[1], nullptr, 10));
+	const auto interval = argc > 2 ? std::chrono::milliseconds(std::wcstoul(argv[2], nullptr, 10)) : std::chrono::milliseconds(0);
+	auto samples = argc > 3 ? std::wcstoul(argv[3], nullptr, 10) : (interval.count() == 0 ? 1ul : ULONG_MAX);
+
+	const auto name = std::wstring(live_counters_name_prefix) + std::to_wstring(process_id);
+	HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, name.c_str());
+	if (!mapping)
+	{
+		std::cerr << "XamlIslandCounters: error: no counters for process " << process_id << ", error " << GetLastError() << "\n";
+		return 1;
+	}
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		std::cerr << "XamlIslandCounters: error: unable to map the counters, error " << GetLastError() << "\n";
+		CloseHandle(mapping);
+		return 1;
+	}
+
+	//A newer application may have a bigger region, so the size comes from the mapping.
+	MEMORY_BASIC_INFORMATION information{};
+	VirtualQuery(view, &information, sizeof(information));
+
+	//Used to stop sampling when the process exits, the region outlives it while it is mapped here.
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, process_id);
+
+	int result = 0;
+	live_counters_snapshot previous{};
+	bool have_previous = false;
+	auto previous_time = std::chrono::steady_clock::now();
+	for (; samples != 0; --samples)
+	{
+		live_counters_snapshot snapshot{};
+		const auto read_result = read_live_counters(view, information.RegionSize, snapshot);
+		const auto now = std::chrono::steady_clock::now();
+		if (read_result != live_counters_read_result::ok)
+		{
+			std::cerr << "XamlIslandCounters: error: " << get_read_result_name(read_result) << "\n";
+			result = 1;
+			break;
+		}
+
+		std::cout << format_counter_report(snapshot, have_previous ? &previous : nullptr, now - previous_time) << std::flush;
+		previous = snapshot;
+		previous_time = now;
+		have_previous = true;
+
+		if (samples > 1)
+		{
+			if (process && WaitForSingleObject(process, static_cast<DWORD>(interval.count())) == WAIT_OBJECT_0)
+			{
+				std::cout << "process " << process_id << " has exited\n";
+				break;
+			}
+			if (!process)
+			{
+				Sleep(static_cast<DWORD>(interval.count()));
+			}
+		}
+	}
+
+	if (process)
+	{
+		CloseHandle(process);
+	}
+	UnmapViewOfFile(view);
+	CloseHandle(mapping);
+	return result;
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "IslandApplication.h"
 #include "IslandApplication.g.cpp"
+#include "live_counters_region.h"
 
 namespace wf = winrt::Windows::Foundation;
 namespace wfc = winrt::Windows::Foundation::Collections;
@@ -46,6 +47,7 @@ namespace winrt::XamlIslandTest3::implementation
 			muxm::IXamlMetadataProvider provider{};
 			winrt::check_hresult(out->QueryInterface(winrt::guid_of<muxm::IXamlMetadataProvider>(), winrt::put_abi(provider)));
 			m_providers.Append(provider);
+			m_application_provider = provider;
 		}
 
 		//Initialise the manager.
@@ -68,52 +70,102 @@ namespace winrt::XamlIslandTest3::implementation
 		m_isclosed = true;
 
 		m_xamlmanager.Close();
+		m_known_types.fill(nullptr);
+		m_factory_providers.fill(nullptr);
+		m_application_provider = nullptr;
+		m_xmlns_definitions.clear();
 		m_providers.Clear();
 		m_xamlmanager = nullptr;
 		Exit();
 	}
 
 	//Implements the metadata provider interface.
-	//This just passes any requests through to the contained metadata provider collection.
+	//Requests are passed through to the contained metadata provider collection.
 	muxm::IXamlType IslandApplication::GetXamlType(wuxi::TypeName const &type)
 	{
+		return resolve_xaml_type(type.Name, type);
+	}
+	muxm::IXamlType IslandApplication::GetXamlType(winrt::hstring const &fullname)
+	{
+		return resolve_xaml_type(fullname, fullname);
+	}
+	//Types that the project's own markup and IDL use are in the generated table, found with a
+	//single probe. The table says which provider creates each of them, so even the first lookup
+	//only asks that one, and the result is cached per slot. Anything else goes to the providers
+	//every time.
+	template <typename Key>
+	muxm::IXamlType IslandApplication::resolve_xaml_type(std::wstring_view name, Key const &key)
+	{
+		const auto slot = find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, name);
+		if (slot != xaml_type_not_found)
+		{
+			if (!m_known_types[slot])
+			{
+				if (const auto provider = get_factory_provider(xaml_type_table[slot].factory))
+				{
+					m_known_types[slot] = provider.GetXamlType(key);
+				}
+			}
+			if (m_known_types[slot])
+			{
+				publish_counters({ { live_counter::xaml_type_lookups, 1 }, { live_counter::xaml_type_table_hits, 1 } });
+				return m_known_types[slot];
+			}
+		}
+		publish_counter(live_counter::xaml_type_lookups);
+
+		//The factory's provider didn't have it, or the type isn't in the table.
+
 		for (const auto &provider : m_providers)
 		{
-			const auto result = provider.GetXamlType(type);
+			const auto result = provider.GetXamlType(key);
 			if (result)
 			{
+				if (slot != xaml_type_not_found)
+				{
+					m_known_types[slot] = result;
+				}
 				return result;
 			}
 		}
 
 		return nullptr;
 	}
-	muxm::IXamlType IslandApplication::GetXamlType(winrt::hstring const &fullname)
+	//The controls provider is recognised by its class name, the application's provider is the
+	//one that came from the outer object.
+	muxm::IXamlMetadataProvider IslandApplication::get_factory_provider(xaml_type_factory factory)
 	{
-		for (const auto &provider : m_providers)
+		if (m_factory_provider_count != m_providers.Size())
 		{
-			const auto result = provider.GetXamlType(fullname);
-			if (result)
+			m_factory_providers.fill(nullptr);
+			m_factory_providers[static_cast<size_t>(xaml_type_factory::application_provider)] = m_application_provider;
+			for (const auto &provider : m_providers)
 			{
-				return result;
+				if (winrt::get_class_name(provider) == L"Microsoft.UI.Xaml.XamlTypeInfo.XamlControlsXamlMetaDataProvider")
+				{
+					m_factory_providers[static_cast<size_t>(xaml_type_factory::controls_provider)] = provider;
+				}
 			}
+			m_factory_provider_count = m_providers.Size();
 		}
 
-		return nullptr;
+		return m_factory_providers[static_cast<size_t>(factory)];
 	}
+	//The providers' definitions don't change, so they are only asked once rather than building
+	//the list again for every call.
 	winrt::com_array<muxm::XmlnsDefinition> IslandApplication::GetXmlnsDefinitions()
 	{
-		std::vector<muxm::XmlnsDefinition> definitions;
-
-		for (const auto &provider : m_providers)
+		if (m_xmlns_provider_count != m_providers.Size() || m_xmlns_definitions.empty())
 		{
-			auto defs = provider.GetXmlnsDefinitions();
-			for (const auto &def : defs)
+			m_xmlns_definitions.clear();
+			for (const auto &provider : m_providers)
 			{
-				definitions.push_back(def);
+				auto defs = provider.GetXmlnsDefinitions();
+				m_xmlns_definitions.insert(m_xmlns_definitions.end(), defs.begin(), defs.end());
 			}
+			m_xmlns_provider_count = m_providers.Size();
 		}
 
-		return winrt::com_array<muxm::XmlnsDefinition>(definitions.begin(), definitions.end());
+		return winrt::com_array<muxm::XmlnsDefinition>(m_xmlns_definitions.begin(), m_xmlns_definitions.end());
 	}
 }
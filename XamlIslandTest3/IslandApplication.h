@@ -1,5 +1,6 @@
 #pragma once
 #include "IslandApplication.g.h"
+#include "xaml_type_table.g.h"
 
 namespace winrt::XamlIslandTest3::implementation
 {
@@ -23,10 +24,25 @@ namespace winrt::XamlIslandTest3::implementation
 		winrt::com_array<winrt::Microsoft::UI::Xaml::Markup::XmlnsDefinition> GetXmlnsDefinitions();
 
 	private:
+		template <typename Key>
+		winrt::Microsoft::UI::Xaml::Markup::IXamlType resolve_xaml_type(std::wstring_view, Key const &);
+		winrt::Microsoft::UI::Xaml::Markup::IXamlMetadataProvider get_factory_provider(xaml_type_factory);
 
 		bool m_isclosed = false;
 		winrt::Microsoft::UI::Xaml::Hosting::WindowsXamlManager m_xamlmanager = nullptr;
 		winrt::Windows::Foundation::Collections::IVector<winrt::Microsoft::UI::Xaml::Markup::IXamlMetadataProvider> m_providers = winrt::single_threaded_vector<winrt::Microsoft::UI::Xaml::Markup::IXamlMetadataProvider>();
+		//One entry per slot in the generated type table.
+		//The first time a known type is resolved, the result is kept here so that later lookups
+		//for it never reach the providers.
+		std::array<winrt::Microsoft::UI::Xaml::Markup::IXamlType, xaml_type_table.size()> m_known_types{};
+		//The provider for each factory in the generated type table, found again if providers are added.
+		std::array<winrt::Microsoft::UI::Xaml::Markup::IXamlMetadataProvider, static_cast<size_t>(xaml_type_factory::factory_count)> m_factory_providers{};
+		winrt::Microsoft::UI::Xaml::Markup::IXamlMetadataProvider m_application_provider = nullptr;
+		uint32_t m_factory_provider_count = 0;
+		//The definitions from every provider, gathered the first time they are asked for.
+		//They are gathered again if providers are added.
+		std::vector<winrt::Microsoft::UI::Xaml::Markup::XmlnsDefinition> m_xmlns_definitions;
+		uint32_t m_xmlns_provider_count = 0;
 	};
 }
 namespace winrt::XamlIslandTest3::factory_implementation
@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "background_executor.h"
+
+#include <algorithm>
+
+//The executor and worker that the calling thread belongs to, if it is a worker.
+struct executor_thread_state
+{
+	background_executor const *executor = nullptr;
+	size_t worker_index = 0;
+};
+
+executor_thread_state &get_executor_thread_state()
+{
+	thread_local executor_thread_state state;
+	return state;
+}
+
+//Spreads the affinity keys over the workers, keys are often small sequential numbers or pointers.
+uint64_t mix_affinity_key(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xBF58476D1CE4E5B9ull;
+	key ^= key >> 27;
+	key *= 0x94D049BB133111EBull;
+	key ^= key >> 31;
+	return key;
+}
+
+//xorshift, used to pick which worker to steal from first.
+uint64_t next_steal_random(uint64_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+background_executor::background_executor(size_t worker_count, wake_function wake) : m_wake(std::move(wake))
+{
+	if (worker_count == 0)
+	{
+		const size_t hardware_threads = std::thread::hardware_concurrency();
+		worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	//Every worker has to exist before any of them starts, since they steal from each other.
+	m_workers.reserve(worker_count);
+	for (size_t i = 0; i < worker_count; ++i)
+	{
+		m_workers.push_back(std::make_unique<worker>());
+	}
+
+	try
+	{
+		for (size_t i = 0; i < worker_count; ++i)
+		{
+			m_workers[i]->thread = std::thread([this, i]() { run_worker(i); });
+		}
+	}
+	catch (...)
+	{
+		shutdown();
+		throw;
+	}
+}
+
+background_executor::~background_executor()
+{
+	shutdown();
+}
+
+void background_executor::submit(task function, executor_affinity affinity)
+{
+	if (m_stopping.load())
+	{
+		m_tasks_cancelled.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	m_tasks_submitted.fetch_add(1, std::memory_order_relaxed);
+
+	size_t worker_index = 0;
+	auto &state = get_executor_thread_state();
+	if (affinity.key != executor_affinity::none)
+	{
+		worker_index = static_cast<size_t>(mix_affinity_key(affinity.key) % m_workers.size());
+	}
+	else if (state.executor == this)
+	{
+		worker_index = state.worker_index;
+	}
+	else
+	{
+		worker_index = m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+	}
+
+	push(worker_index, std::move(function));
+}
+
+void background_executor::push(size_t worker_index, task function)
+{
+	//This is counted before the task is visible, so a worker that finds the task has always
+	//seen it counted. A worker that sees the count first just looks again.
+	m_queued.fetch_add(1);
+
+	auto &target = *m_workers[worker_index];
+	{
+		std::scoped_lock lock(target.mutex);
+		target.tasks.push_back(std::move(function));
+		const auto depth = target.tasks.size();
+		target.queue_depth.store(depth, std::memory_order_relaxed);
+		if (depth > target.max_queue_depth.load(std::memory_order_relaxed))
+		{
+			target.max_queue_depth.store(depth, std::memory_order_relaxed);
+		}
+	}
+
+	//A worker increments m_sleeping before it checks m_queued, so either it sees the task
+	//or this sees it sleeping.
+	if (m_sleeping.load() != 0)
+	{
+		std::scoped_lock lock(m_sleep_mutex);
+		m_sleep_condition.notify_one();
+	}
+}
+
+bool background_executor::pop(size_t worker_index, task &function)
+{
+	auto &self = *m_workers[worker_index];
+	std::scoped_lock lock(self.mutex);
+	if (self.tasks.empty())
+	{
+		return false;
+	}
+
+	//The newest task is the one most likely to still be in this worker's caches.
+	function = std::move(self.tasks.back());
+	self.tasks.pop_back();
+	self.queue_depth.store(self.tasks.size(), std::memory_order_relaxed);
+	m_queued.fetch_sub(1);
+	return true;
+}
+
+bool background_executor::steal(size_t thief_index, size_t victim_index, task &function)
+{
+	auto &thief = *m_workers[thief_index];
+	auto &victim = *m_workers[victim_index];
+
+	//Don't take the victim's lock just to find out that there is nothing there.
+	if (victim.queue_depth.load(std::memory_order_relaxed) == 0)
+	{
+		thief.failed_steals.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	std::vector<task> taken;
+	{
+		std::scoped_lock lock(victim.mutex);
+		if (victim.tasks.empty())
+		{
+			thief.failed_steals.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		//The oldest tasks are taken, they are the ones the victim is furthest from running.
+		const auto count = std::min((victim.tasks.size() + 1) / 2, max_steal_batch);
+		function = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		taken.reserve(count - 1);
+		for (size_t i = 1; i < count; ++i)
+		{
+			taken.push_back(std::move(victim.tasks.front()));
+			victim.tasks.pop_front();
+		}
+		victim.queue_depth.store(victim.tasks.size(), std::memory_order_relaxed);
+	}
+	m_queued.fetch_sub(1);
+
+	if (!taken.empty())
+	{
+		std::scoped_lock lock(thief.mutex);
+		for (auto &stolen : taken)
+		{
+			thief.tasks.push_back(std::move(stolen));
+		}
+		const auto depth = thief.tasks.size();
+		thief.queue_depth.store(depth, std::memory_order_relaxed);
+		if (depth > thief.max_queue_depth.load(std::memory_order_relaxed))
+		{
+			thief.max_queue_depth.store(depth, std::memory_order_relaxed);
+		}
+	}
+
+	thief.steals.fetch_add(1, std::memory_order_relaxed);
+	thief.tasks_stolen.fetch_add(taken.size() + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool background_executor::find_task(size_t worker_index, uint64_t &random_state, task &function)
+{
+	if (pop(worker_index, function))
+	{
+		return true;
+	}
+
+	const auto count = m_workers.size();
+	for (uint32_t round = 0; round < steal_rounds && count > 1; ++round)
+	{
+		//Each pass starts at a different worker so that the thieves don't all pile onto the same one.
+		const auto first = static_cast<size_t>(next_steal_random(random_state) % count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto victim_index = (first + i) % count;
+			if (victim_index != worker_index && steal(worker_index, victim_index, function))
+			{
+				return true;
+			}
+		}
+
+		if (m_queued.load() == 0 || m_stopping.load(std::memory_order_relaxed))
+		{
+			break;
+		}
+		std::this_thread::yield();
+	}
+
+	//A task may have been pushed to this worker while it was looking elsewhere.
+	return pop(worker_index, function);
+}
+
+void background_executor::run_worker(size_t worker_index)
+{
+	get_executor_thread_state() = { this, worker_index };
+	auto &self = *m_workers[worker_index];
+	uint64_t random_state = 0x9E3779B97F4A7C15ull * (worker_index + 1);
+
+	task function;
+	while (!m_stopping.load(std::memory_order_relaxed))
+	{
+		if (find_task(worker_index, random_state, function))
+		{
+			try
+			{
+				function();
+			}
+			catch (...)
+			{
+				m_tasks_failed.fetch_add(1, std::memory_order_relaxed);
+			}
+			//Whatever the task captured is released now, not when the next task replaces it.
+			function = nullptr;
+			self.tasks_run.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		std::unique_lock lock(m_sleep_mutex);
+		m_sleeping.fetch_add(1);
+		if (m_queued.load() == 0 && !m_stopping.load())
+		{
+			self.sleeps.fetch_add(1, std::memory_order_relaxed);
+			m_sleep_condition.wait(lock, [this]() { return m_queued.load() != 0 || m_stopping.load(); });
+		}
+		m_sleeping.fetch_sub(1);
+	}
+}
+
+void background_executor::post_completion(completion function)
+{
+	bool first_in_batch = false;
+	{
+		std::scoped_lock lock(m_completion_mutex);
+		first_in_batch = m_completions.empty();
+		m_completions.push_back(std::move(function));
+		++m_completions_posted;
+		if (first_in_batch)
+		{
+			++m_completion_batches;
+		}
+	}
+
+	//The owner is already going to run the batch if there was something in it.
+	if (first_in_batch && m_wake)
+	{
+		m_wake();
+	}
+}
+
+size_t background_executor::run_completions()
+{
+	std::vector<completion> batch;
+	{
+		std::scoped_lock lock(m_completion_mutex);
+		batch.swap(m_completions);
+	}
+	if (batch.empty())
+	{
+		return 0;
+	}
+
+	for (auto &function : batch)
+	{
+		function();
+	}
+
+	std::scoped_lock lock(m_completion_mutex);
+	m_completions_run += batch.size();
+	m_max_completion_batch = std::max(m_max_completion_batch, batch.size());
+	return batch.size();
+}
+
+bool background_executor::has_completions() const
+{
+	std::scoped_lock lock(m_completion_mutex);
+	return !m_completions.empty();
+}
+
+void background_executor::shutdown()
+{
+	{
+		std::scoped_lock lock(m_sleep_mutex);
+		m_stopping.store(true);
+	}
+	m_sleep_condition.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		if (worker->thread.joinable())
+		{
+			worker->thread.join();
+		}
+	}
+
+	for (auto &worker : m_workers)
+	{
+		std::scoped_lock lock(worker->mutex);
+		m_tasks_cancelled.fetch_add(worker->tasks.size(), std::memory_order_relaxed);
+		worker->tasks.clear();
+		worker->queue_depth.store(0, std::memory_order_relaxed);
+	}
+	m_queued.store(0);
+
+	std::scoped_lock lock(m_completion_mutex);
+	m_completions.clear();
+}
+
+size_t background_executor::get_worker_count() const
+{
+	return m_workers.size();
+}
+
+size_t background_executor::get_queued_task_count() const
+{
+	return m_queued.load(std::memory_order_relaxed);
+}
+
+executor_statistics background_executor::get_statistics() const
+{
+	executor_statistics statistics{};
+	statistics.tasks_submitted = m_tasks_submitted.load(std::memory_order_relaxed);
+	statistics.tasks_failed = m_tasks_failed.load(std::memory_order_relaxed);
+	statistics.tasks_cancelled = m_tasks_cancelled.load(std::memory_order_relaxed);
+	statistics.queued = m_queued.load(std::memory_order_relaxed);
+
+	statistics.workers.reserve(m_workers.size());
+	for (auto &worker : m_workers)
+	{
+		executor_worker_statistics worker_statistics{};
+		worker_statistics.tasks_run = worker->tasks_run.load(std::memory_order_relaxed);
+		worker_statistics.tasks_stolen = worker->tasks_stolen.load(std::memory_order_relaxed);
+		worker_statistics.steals = worker->steals.load(std::memory_order_relaxed);
+		worker_statistics.failed_steals = worker->failed_steals.load(std::memory_order_relaxed);
+		worker_statistics.sleeps = worker->sleeps.load(std::memory_order_relaxed);
+		worker_statistics.queue_depth = worker->queue_depth.load(std::memory_order_relaxed);
+		worker_statistics.max_queue_depth = worker->max_queue_depth.load(std::memory_order_relaxed);
+
+		statistics.tasks_run += worker_statistics.tasks_run;
+		statistics.tasks_stolen += worker_statistics.tasks_stolen;
+		statistics.steals += worker_statistics.steals;
+		statistics.workers.push_back(worker_statistics);
+	}
+
+	std::scoped_lock lock(m_completion_mutex);
+	statistics.completions_posted = m_completions_posted;
+	statistics.completions_run = m_completions_run;
+	statistics.completion_batches = m_completion_batches;
+	statistics.max_completion_batch = m_max_completion_batch;
+	return statistics;
+}
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _MEMORY_
+#include <memory>
+#endif
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//A pool of worker threads for CPU heavy preparation, such as decoding, layout or shaping data,
+//so that it stays off the UI thread.
+//Each worker has a deque of its own. A worker takes its newest task first, and when it runs out
+//it steals the oldest tasks from another worker, so workers mostly only touch their own deque.
+//Results come back through completions, which are queued for the owning thread and run there in
+//a batch. The owner is only woken for the first completion of a batch.
+//This only uses the standard library, waking the owning thread is supplied by the caller.
+
+//Where a task would like to run.
+//Tasks with the same key go to the same worker, so related work shares that worker's caches.
+//This is only a hint, an idle worker still steals the task.
+struct executor_affinity
+{
+	static constexpr uint64_t none = UINT64_MAX;
+
+	uint64_t key = none;
+};
+
+struct executor_worker_statistics
+{
+	uint64_t tasks_run = 0;
+	//Tasks this worker took from other workers.
+	uint64_t tasks_stolen = 0;
+	//Times this worker took tasks from another worker, a steal can take several tasks.
+	uint64_t steals = 0;
+	//Times this worker looked at another worker's deque and found it empty.
+	uint64_t failed_steals = 0;
+	uint64_t sleeps = 0;
+	size_t queue_depth = 0;
+	size_t max_queue_depth = 0;
+};
+
+struct executor_statistics
+{
+	uint64_t tasks_submitted = 0;
+	uint64_t tasks_run = 0;
+	//Tasks that threw, the exception is dropped.
+	uint64_t tasks_failed = 0;
+	//Tasks that were still queued at shutdown.
+	uint64_t tasks_cancelled = 0;
+	uint64_t tasks_stolen = 0;
+	uint64_t steals = 0;
+	uint64_t completions_posted = 0;
+	uint64_t completions_run = 0;
+	//The number of times the owner was woken, one for each batch of completions.
+	uint64_t completion_batches = 0;
+	size_t max_completion_batch = 0;
+	//Tasks waiting in the deques.
+	size_t queued = 0;
+	std::vector<executor_worker_statistics> workers;
+};
+
+class background_executor
+{
+public:
+	using task = std::function<void()>;
+	using completion = std::function<void()>;
+	//Called from a worker when a completion is queued and none were waiting, so the owner
+	//knows to call run_completions.
+	using wake_function = std::function<void()>;
+
+	//0 workers uses one less than the number of hardware threads, leaving one for the owner.
+	explicit background_executor(size_t worker_count = 0, wake_function = {});
+	//Stops the workers, see shutdown.
+	~background_executor();
+	background_executor(const background_executor &) = delete;
+	background_executor(background_executor &&) = delete;
+	background_executor &operator=(const background_executor &) = delete;
+	background_executor &operator=(background_executor &&) = delete;
+
+	//Queues a task. This can be called from any thread, including from a task.
+	//Without a key, a task submitted by a worker goes to that worker's deque, otherwise the tasks
+	//are spread over the workers in turn.
+	void submit(task, executor_affinity = {});
+	//Runs the work on a worker, then runs the completion on the owning thread with the result.
+	//If the work throws, the completion isn't run and the failure is counted.
+	//The work, the completion and the result are held in std::function, so they must be copyable.
+	template <typename Work, typename Completion>
+	void submit_with_completion(Work work, Completion completion, executor_affinity affinity = {})
+	{
+		submit([this, work = std::move(work), completion = std::move(completion)]() mutable
+			{
+				if constexpr (std::is_void_v<std::invoke_result_t<Work &>>)
+				{
+					work();
+					post_completion(std::move(completion));
+				}
+				else
+				{
+					post_completion([completion = std::move(completion), result = work()]() mutable { completion(std::move(result)); });
+				}
+			}, affinity);
+	}
+	//Queues a function to run on the owning thread. This can be called from any thread.
+	void post_completion(completion);
+	//Runs every completion that was queued before the call, in the order they were posted.
+	//This must only be called on the owning thread. Returns the number run.
+	size_t run_completions();
+	bool has_completions() const;
+
+	//Stops the workers once they finish the task they are running. Tasks that are still queued,
+	//and completions that haven't run, are thrown away.
+	//This must not be called from a task.
+	void shutdown();
+
+	size_t get_worker_count() const;
+	//The number of tasks waiting in the deques.
+	size_t get_queued_task_count() const;
+	executor_statistics get_statistics() const;
+
+private:
+	//The most tasks taken in one steal. A steal takes half of the victim's deque up to this.
+	static constexpr size_t max_steal_batch = 32;
+	//The number of passes over the other deques before a worker goes to sleep.
+	static constexpr uint32_t steal_rounds = 4;
+
+	//The worker's counters are only written by the worker, but they are read by get_statistics.
+	struct alignas(64) worker
+	{
+		std::mutex mutex;
+		std::deque<task> tasks;
+		std::atomic<size_t> queue_depth{ 0 };
+		std::atomic<size_t> max_queue_depth{ 0 };
+		std::atomic<uint64_t> tasks_run{ 0 };
+		std::atomic<uint64_t> tasks_stolen{ 0 };
+		std::atomic<uint64_t> steals{ 0 };
+		std::atomic<uint64_t> failed_steals{ 0 };
+		std::atomic<uint64_t> sleeps{ 0 };
+		std::thread thread;
+	};
+
+	void push(size_t worker_index, task);
+	bool pop(size_t worker_index, task &);
+	//Takes up to half of the victim's tasks, returns the first and queues the rest on the thief.
+	bool steal(size_t thief_index, size_t victim_index, task &);
+	bool find_task(size_t worker_index, uint64_t &random_state, task &);
+	void run_worker(size_t worker_index);
+
+	wake_function m_wake;
+	std::vector<std::unique_ptr<worker>> m_workers;
+	std::atomic<size_t> m_next_worker{ 0 };
+
+	//Tasks that are queued but not yet taken, the workers sleep while this is 0.
+	std::atomic<size_t> m_queued{ 0 };
+	std::atomic<size_t> m_sleeping{ 0 };
+	std::atomic<bool> m_stopping{ false };
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_sleep_condition;
+
+	std::atomic<uint64_t> m_tasks_submitted{ 0 };
+	std::atomic<uint64_t> m_tasks_failed{ 0 };
+	std::atomic<uint64_t> m_tasks_cancelled{ 0 };
+
+	mutable std::mutex m_completion_mutex;
+	std::vector<completion> m_completions;
+	uint64_t m_completions_posted = 0;
+	uint64_t m_completions_run = 0;
+	uint64_t m_completion_batches = 0;
+	size_t m_max_completion_batch = 0;
+};
\ No newline at end of file
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "island_batch.h"
+
+//Keeps native child controls that are no longer needed, so that the next control of the same
+//kind can be handed out without going through the window manager to create one.
+//A released control is hidden and moved under a parking window, handing it out again moves it
+//back under its new parent. Controls are only interchangeable if they have the same class and
+//styles, so there is a pool for each combination.
+//
+//The window manager is a template parameter so that this can be run against anything that
+//provides the following:
+//  Handle create_control(child_control_class const &, Handle parent, island_rect const &, uint32_t id, wchar_t const *text);
+//  void reuse_control(Handle, Handle parent, island_rect const &, uint32_t id, wchar_t const *text);
+//  void park_control(Handle);
+//  void destroy_control(Handle);
+//create_control returns a null handle if it fails. Both create_control and reuse_control leave
+//the control visible, park_control hides it.
+//This is not thread safe, controls belong to the thread that created them.
+
+//Identifies controls that can stand in for each other.
+//Visibility isn't part of the style, controls are shown when they are handed out.
+struct child_control_class
+{
+	std::wstring_view class_name;
+	uint32_t style = 0;
+	uint32_t extended_style = 0;
+};
+
+struct child_recycler_options
+{
+	//The most released controls kept for each class, any more are destroyed.
+	size_t max_pooled_per_class = 64;
+};
+
+struct child_recycler_statistics
+{
+	uint64_t created = 0;
+	uint64_t reused = 0;
+	uint64_t released = 0;
+	//Controls destroyed because their pool was full, or by trim.
+	uint64_t destroyed = 0;
+	uint64_t failed = 0;
+	size_t pooled = 0;
+	size_t max_pooled = 0;
+};
+
+template <typename WindowManager, typename Handle>
+class child_control_recycler
+{
+public:
+	explicit child_control_recycler(WindowManager &window_manager, child_recycler_options const &options = {}) : m_window_manager(window_manager), m_options(options)
+	{
+	}
+	~child_control_recycler()
+	{
+		clear();
+	}
+	child_control_recycler(const child_control_recycler &) = delete;
+	child_control_recycler(child_control_recycler &&) = delete;
+	child_control_recycler &operator=(const child_control_recycler &) = delete;
+	child_control_recycler &operator=(child_control_recycler &&) = delete;
+
+	//Gets a visible control under the parent, reusing a released one if there is one.
+	//Returns a null handle if a control had to be created and that failed.
+	Handle acquire(child_control_class const &control_class, Handle parent, island_rect const &rect, uint32_t id = 0, wchar_t const *text = nullptr)
+	{
+		auto &pool = get_pool(control_class);
+		if (!pool.handles.empty())
+		{
+			auto handle = pool.handles.back();
+			pool.handles.pop_back();
+			--m_statistics.pooled;
+			m_window_manager.reuse_control(handle, parent, rect, id, text);
+			++m_statistics.reused;
+			return handle;
+		}
+
+		auto handle = m_window_manager.create_control(control_class, parent, rect, id, text);
+		if (handle == Handle{})
+		{
+			++m_statistics.failed;
+		}
+		else
+		{
+			++m_statistics.created;
+		}
+		return handle;
+	}
+
+	//Hides the control and keeps it for reuse, or destroys it if its pool is full.
+	//The class must be the one that the control was acquired with.
+	void release(child_control_class const &control_class, Handle handle)
+	{
+		if (handle == Handle{})
+		{
+			return;
+		}
+
+		++m_statistics.released;
+		auto &pool = get_pool(control_class);
+		if (pool.handles.size() >= m_options.max_pooled_per_class)
+		{
+			m_window_manager.destroy_control(handle);
+			++m_statistics.destroyed;
+			return;
+		}
+
+		m_window_manager.park_control(handle);
+		pool.handles.push_back(handle);
+		++m_statistics.pooled;
+		if (m_statistics.pooled > m_statistics.max_pooled)
+		{
+			m_statistics.max_pooled = m_statistics.pooled;
+		}
+	}
+
+	//Destroys pooled controls until no more than max_pooled are left in total.
+	//The largest pools lose controls first, and each pool loses the controls released longest ago.
+	void trim(size_t max_pooled)
+	{
+		while (m_statistics.pooled > max_pooled)
+		{
+			auto *largest = &m_pools.front();
+			for (auto &pool : m_pools)
+			{
+				if (pool.handles.size() > largest->handles.size())
+				{
+					largest = &pool;
+				}
+			}
+
+			const auto excess = m_statistics.pooled - max_pooled;
+			const auto count = largest->handles.size() < excess ? largest->handles.size() : excess;
+			for (size_t i = 0; i < count; ++i)
+			{
+				m_window_manager.destroy_control(largest->handles[i]);
+			}
+			largest->handles.erase(largest->handles.begin(), largest->handles.begin() + static_cast<std::ptrdiff_t>(count));
+			m_statistics.pooled -= count;
+			m_statistics.destroyed += count;
+		}
+	}
+	void clear()
+	{
+		trim(0);
+	}
+
+	size_t get_pooled_count() const
+	{
+		return m_statistics.pooled;
+	}
+	child_recycler_statistics const &get_statistics() const
+	{
+		return m_statistics;
+	}
+
+private:
+	struct control_pool
+	{
+		std::wstring class_name;
+		uint32_t style = 0;
+		uint32_t extended_style = 0;
+		//The most recently released control is at the back, it is handed out first.
+		std::vector<Handle> handles;
+	};
+
+	//There are only ever a few classes, so a linear search is quicker than hashing the name.
+	control_pool &get_pool(child_control_class const &control_class)
+	{
+		for (auto &pool : m_pools)
+		{
+			if (pool.style == control_class.style && pool.extended_style == control_class.extended_style && pool.class_name == control_class.class_name)
+			{
+				return pool;
+			}
+		}
+		return m_pools.emplace_back(control_pool{ std::wstring(control_class.class_name), control_class.style, control_class.extended_style, {} });
+	}
+
+	WindowManager &m_window_manager;
+	child_recycler_options m_options;
+	std::vector<control_pool> m_pools;
+	child_recycler_statistics m_statistics{};
+};
\ No newline at end of file
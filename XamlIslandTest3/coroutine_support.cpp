@@ -0,0 +1,254 @@
+#include "pch.h"
+#include "coroutine_support.h"
+
+#include <new>
+#include <vector>
+
+coroutine_frame_pool *coroutine_frame_pool::create()
+{
+	return new coroutine_frame_pool();
+}
+
+coroutine_frame_pool::~coroutine_frame_pool()
+{
+	trim();
+}
+
+void coroutine_frame_pool::add_ref()
+{
+	m_references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void coroutine_frame_pool::release()
+{
+	if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete this;
+	}
+}
+
+void *coroutine_frame_pool::allocate(size_t size)
+{
+	const auto size_class = size_class_for(size);
+	if (size_class == size_class_count)
+	{
+		std::lock_guard lock(m_mutex);
+		++m_statistics.allocations;
+		++m_statistics.oversized_allocations;
+		++m_statistics.live_frames;
+	}
+	else
+	{
+		std::unique_lock lock(m_mutex);
+		++m_statistics.allocations;
+		++m_statistics.live_frames;
+		if (auto frame = m_free_lists[size_class])
+		{
+			m_free_lists[size_class] = frame->next;
+			--m_free_counts[size_class];
+			++m_statistics.pool_hits;
+			lock.unlock();
+
+			//The free list link overwrote the header, so it is written again.
+			auto header = reinterpret_cast<frame_header *>(frame);
+			header->pool = this;
+			header->size_class = size_class;
+			add_ref();
+			return header + 1;
+		}
+	}
+
+	//Pooled frames are allocated with the full size of their class so they can be reused
+	//by any frame in that class.
+	const auto frame_size = size_class == size_class_count ? size : (size_class + 1) * size_class_granularity;
+	auto header = static_cast<frame_header *>(::operator new(sizeof(frame_header) + frame_size));
+	header->pool = this;
+	header->size_class = size_class;
+	add_ref();
+	return header + 1;
+}
+
+void *coroutine_frame_pool::allocate_unpooled(size_t size)
+{
+	auto header = static_cast<frame_header *>(::operator new(sizeof(frame_header) + size));
+	header->pool = nullptr;
+	header->size_class = size_class_count;
+	return header + 1;
+}
+
+void coroutine_frame_pool::deallocate(void *frame)
+{
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	auto header = static_cast<frame_header *>(frame) - 1;
+	auto pool = header->pool;
+	if (pool == nullptr)
+	{
+		::operator delete(header);
+		return;
+	}
+
+	pool->return_frame(header);
+	//Every frame holds a reference to the pool, this may be the last one.
+	pool->release();
+}
+
+coroutine_frame_pool_statistics coroutine_frame_pool::get_statistics() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_statistics;
+}
+
+size_t coroutine_frame_pool::trim()
+{
+	std::array<free_frame *, size_class_count> free_lists{};
+	{
+		std::lock_guard lock(m_mutex);
+		free_lists = m_free_lists;
+		m_free_lists.fill(nullptr);
+		m_free_counts.fill(0);
+	}
+
+	size_t released = 0;
+	for (size_t size_class = 0; size_class < size_class_count; ++size_class)
+	{
+		auto frame = free_lists[size_class];
+		while (frame != nullptr)
+		{
+			auto next = frame->next;
+			::operator delete(frame);
+			released += sizeof(frame_header) + (size_class + 1) * size_class_granularity;
+			frame = next;
+		}
+	}
+
+	return released;
+}
+
+size_t coroutine_frame_pool::size_class_for(size_t size)
+{
+	if (size == 0 || size > max_pooled_size)
+	{
+		return size_class_count;
+	}
+	return (size - 1) / size_class_granularity;
+}
+
+void coroutine_frame_pool::return_frame(frame_header *header)
+{
+	const auto size_class = header->size_class;
+
+	std::unique_lock lock(m_mutex);
+	--m_statistics.live_frames;
+	if (size_class == size_class_count || m_free_counts[size_class] >= max_free_frames)
+	{
+		lock.unlock();
+		::operator delete(header);
+		return;
+	}
+
+	//The free list link overwrites the start of the header, the pool and size class
+	//are written again when the frame is reused.
+	auto frame = reinterpret_cast<free_frame *>(header);
+	frame->next = m_free_lists[size_class];
+	m_free_lists[size_class] = frame;
+	++m_free_counts[size_class];
+}
+
+coroutine_context::coroutine_context(std::thread::id owner, post_function post, post_after_function post_after)
+	: m_owner(owner), m_post(std::move(post)), m_post_after(std::move(post_after)), m_frame_pool(coroutine_frame_pool::create())
+{
+}
+
+coroutine_context::~coroutine_context()
+{
+	m_frame_pool->release();
+}
+
+std::thread::id coroutine_context::get_owner() const
+{
+	return m_owner;
+}
+
+bool coroutine_context::is_cancelled() const
+{
+	return m_cancelled.load(std::memory_order_acquire);
+}
+
+coroutine_frame_pool &coroutine_context::get_frame_pool()
+{
+	return *m_frame_pool;
+}
+
+bool coroutine_context::schedule(std::coroutine_handle<> handle, std::chrono::nanoseconds delay)
+{
+	resumption_id id = invalid_resumption_id;
+	{
+		std::lock_guard lock(m_mutex);
+		if (is_cancelled())
+		{
+			return false;
+		}
+		id = m_next_id++;
+		m_pending.emplace(id, handle);
+	}
+
+	const bool posted = delay.count() > 0 ? m_post_after(id, delay) : m_post(id);
+	if (!posted)
+	{
+		//Take the handle back. If it is already gone then cancel has resumed it,
+		//so the caller must not resume it again.
+		std::lock_guard lock(m_mutex);
+		return m_pending.erase(id) == 0;
+	}
+
+	return true;
+}
+
+bool coroutine_context::resume(resumption_id id)
+{
+	std::coroutine_handle<> handle{};
+	{
+		std::lock_guard lock(m_mutex);
+		auto it = m_pending.find(id);
+		if (it == m_pending.end())
+		{
+			return false;
+		}
+		handle = it->second;
+		m_pending.erase(it);
+	}
+
+	handle.resume();
+	return true;
+}
+
+void coroutine_context::cancel()
+{
+	std::vector<std::coroutine_handle<>> handles;
+	{
+		std::lock_guard lock(m_mutex);
+		m_cancelled.store(true, std::memory_order_release);
+		handles.reserve(m_pending.size());
+		for (auto &pending : m_pending)
+		{
+			handles.push_back(pending.second);
+		}
+		m_pending.clear();
+	}
+
+	//Each of these throws operation_cancelled out of its await and unwinds.
+	for (auto &handle : handles)
+	{
+		handle.resume();
+	}
+}
+
+size_t coroutine_context::pending_count() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_pending.size();
+}
\ No newline at end of file
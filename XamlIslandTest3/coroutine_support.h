@@ -0,0 +1,264 @@
+#pragma once
+
+#ifndef _COROUTINE_
+#include <coroutine>
+#endif
+#ifndef _MEMORY_
+#include <memory>
+#endif
+#ifndef _MUTEX_
+#include <mutex>
+#endif
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#ifndef _THREAD_
+#include <thread>
+#endif
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <unordered_map>
+
+//Thrown out of an await when the context that the coroutine belongs to has been cancelled.
+//window_task swallows this, so a cancelled coroutine just unwinds.
+class operation_cancelled : public std::exception
+{
+public:
+	const char *what() const noexcept override
+	{
+		return "operation cancelled";
+	}
+};
+
+//Allocation counts for a coroutine_frame_pool.
+struct coroutine_frame_pool_statistics
+{
+	uint64_t allocations = 0;
+	uint64_t pool_hits = 0;
+	uint64_t oversized_allocations = 0;
+	uint64_t live_frames = 0;
+};
+
+//A pool of coroutine frames.
+//Frames are grouped into size classes and kept on free lists when they are released.
+//Frames can be released on any thread, and can outlive the owner of the pool, so the
+//pool is reference counted and every live frame holds a reference.
+class coroutine_frame_pool
+{
+public:
+	static constexpr size_t size_class_granularity = 64;
+	static constexpr size_t size_class_count = 16;
+	//Frames larger than this aren't pooled.
+	static constexpr size_t max_pooled_size = size_class_granularity * size_class_count;
+	//The number of frames that each size class keeps.
+	static constexpr size_t max_free_frames = 32;
+
+	//Creates a pool with a single reference.
+	static coroutine_frame_pool *create();
+
+	void add_ref();
+	void release();
+
+	//Allocates a frame from the pool.
+	void *allocate(size_t);
+	//Allocates a frame that doesn't belong to any pool.
+	static void *allocate_unpooled(size_t);
+	//Returns a frame to the pool it came from, or frees it.
+	static void deallocate(void *);
+
+	coroutine_frame_pool_statistics get_statistics() const;
+	//Frees all of the cached frames.
+	//Returns the number of bytes released.
+	size_t trim();
+
+private:
+	//Placed in front of every frame. This is padded to the default new alignment
+	//so the frame itself stays correctly aligned.
+	struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_header
+	{
+		coroutine_frame_pool *pool;
+		size_t size_class;
+	};
+	struct free_frame
+	{
+		free_frame *next;
+	};
+
+	coroutine_frame_pool() = default;
+	~coroutine_frame_pool();
+
+	static size_t size_class_for(size_t);
+	void return_frame(frame_header *);
+
+	std::atomic<uint32_t> m_references{ 1 };
+	mutable std::mutex m_mutex;
+	std::array<free_frame *, size_class_count> m_free_lists{};
+	std::array<size_t, size_class_count> m_free_counts{};
+	coroutine_frame_pool_statistics m_statistics{};
+};
+
+//Identifies a suspended coroutine that is waiting to be resumed by its context.
+using resumption_id = uint64_t;
+constexpr resumption_id invalid_resumption_id = 0;
+
+//The scheduler neutral part of running coroutines on a single owning thread.
+//The owner provides the functions that get a resumption back onto its thread,
+//either straight away or after a delay. The owning thread then calls resume with
+//the id it was given.
+//Cancelling the context resumes every suspended coroutine with operation_cancelled,
+//and any later attempt to suspend on the context fails the same way.
+class coroutine_context
+{
+public:
+	using post_function = std::function<bool(resumption_id)>;
+	using post_after_function = std::function<bool(resumption_id, std::chrono::nanoseconds)>;
+
+	coroutine_context(std::thread::id owner, post_function post, post_after_function post_after);
+	~coroutine_context();
+	coroutine_context(const coroutine_context &) = delete;
+	coroutine_context &operator=(const coroutine_context &) = delete;
+
+	std::thread::id get_owner() const;
+	bool is_cancelled() const;
+	coroutine_frame_pool &get_frame_pool();
+
+	//Stores the handle and asks the owner to resume it.
+	//Returns true if the caller should suspend. Returns false if the handle couldn't
+	//be scheduled, in which case the caller still owns the handle.
+	bool schedule(std::coroutine_handle<>, std::chrono::nanoseconds delay);
+	//Resumes a coroutine scheduled earlier.
+	//Returns false if it was already resumed or cancelled.
+	bool resume(resumption_id);
+	//Cancels the context.
+	//This must be called on the owning thread.
+	void cancel();
+
+	//The number of coroutines currently waiting for the owner.
+	size_t pending_count() const;
+
+private:
+	std::thread::id m_owner;
+	post_function m_post;
+	post_after_function m_post_after;
+	coroutine_frame_pool *m_frame_pool = nullptr;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<resumption_id, std::coroutine_handle<>> m_pending;
+	resumption_id m_next_id = 1;
+	std::atomic<bool> m_cancelled{ false };
+};
+
+//Anything that can give a coroutine_context.
+//Coroutines whose first parameter, or implicit object parameter, is one of these have
+//their frames allocated from the context's pool.
+template <typename T>
+concept coroutine_context_owner = requires(T &owner)
+{
+	{ owner.get_coroutine_context() } -> std::convertible_to<std::shared_ptr<coroutine_context>>;
+};
+
+//Awaitable that continues the coroutine on the context's owning thread, optionally after a delay.
+//If the coroutine is already on the owning thread and there is no delay, it just continues.
+class context_awaitable
+{
+public:
+	context_awaitable(std::shared_ptr<coroutine_context> context, std::chrono::nanoseconds delay = {}) : m_context(std::move(context)), m_delay(delay)
+	{
+	}
+
+	bool await_ready() const
+	{
+		if (m_context->is_cancelled())
+		{
+			return true;
+		}
+		return m_delay.count() <= 0 && std::this_thread::get_id() == m_context->get_owner();
+	}
+	bool await_suspend(std::coroutine_handle<> handle)
+	{
+		//Once scheduled, the coroutine may be resumed on another thread before this returns,
+		//which destroys this awaitable. Only locals are used after scheduling.
+		auto context = m_context;
+		if (!context->schedule(handle, m_delay))
+		{
+			//The owner couldn't take the coroutine, so it carries on here.
+			//Since it isn't on the owning thread, it has to be treated as cancelled.
+			m_not_scheduled = true;
+			return false;
+		}
+		return true;
+	}
+	void await_resume() const
+	{
+		if (m_not_scheduled || m_context->is_cancelled())
+		{
+			throw operation_cancelled();
+		}
+	}
+
+private:
+	std::shared_ptr<coroutine_context> m_context;
+	std::chrono::nanoseconds m_delay{};
+	bool m_not_scheduled = false;
+};
+
+//Lightweight fire and forget coroutine type.
+//The coroutine starts straight away and its frame destroys itself on completion.
+//operation_cancelled ends the coroutine quietly, any other exception terminates
+//the process, the same as winrt::fire_and_forget.
+struct window_task
+{
+	struct promise_type
+	{
+		window_task get_return_object() const noexcept
+		{
+			return {};
+		}
+		std::suspend_never initial_suspend() const noexcept
+		{
+			return {};
+		}
+		std::suspend_never final_suspend() const noexcept
+		{
+			return {};
+		}
+		void return_void() const noexcept
+		{
+		}
+		void unhandled_exception() const noexcept
+		{
+			try
+			{
+				throw;
+			}
+			catch (operation_cancelled const &)
+			{
+			}
+			catch (...)
+			{
+				std::terminate();
+			}
+		}
+
+		//Frames for coroutines that belong to a context owner come from the owner's pool.
+		template <coroutine_context_owner Owner, typename... Args>
+		static void *operator new(size_t size, Owner &owner, Args &&...)
+		{
+			return owner.get_coroutine_context()->get_frame_pool().allocate(size);
+		}
+		static void *operator new(size_t size)
+		{
+			return coroutine_frame_pool::allocate_unpooled(size);
+		}
+		static void operator delete(void *frame)
+		{
+			coroutine_frame_pool::deallocate(frame);
+		}
+	};
+};
\ No newline at end of file
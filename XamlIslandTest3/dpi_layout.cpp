@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "dpi_layout.h"
+
+#include <algorithm>
+
+int scale_to_dpi(int value, uint32_t dpi)
+{
+	return scale_between_dpi(value, default_dpi, dpi);
+}
+
+//Rounds half away from zero, so negative positions scale the same way as positive ones.
+int scale_between_dpi(int value, uint32_t from_dpi, uint32_t to_dpi)
+{
+	if (from_dpi == 0 || from_dpi == to_dpi)
+	{
+		return value;
+	}
+
+	const auto product = static_cast<int64_t>(value) * to_dpi;
+	const auto half = static_cast<int64_t>(from_dpi / 2);
+	const auto result = product >= 0 ? (product + half) / from_dpi : -((-product + half) / static_cast<int64_t>(from_dpi));
+	return static_cast<int>(result);
+}
+
+island_rect scale_rect_to_dpi(island_rect const &rect, uint32_t dpi)
+{
+	island_rect scaled{};
+	scaled.x = scale_to_dpi(rect.x, dpi);
+	scaled.y = scale_to_dpi(rect.y, dpi);
+	scaled.width = scale_to_dpi(rect.width, dpi);
+	scaled.height = scale_to_dpi(rect.height, dpi);
+	return scaled;
+}
+
+float get_dpi_scale(uint32_t dpi)
+{
+	return dpi / static_cast<float>(default_dpi);
+}
+
+dpi_layout_cache::dpi_layout_cache(size_t max_entries) : m_max_entries(max_entries == 0 ? 1 : max_entries)
+{
+	m_entries.reserve(m_max_entries);
+}
+
+void dpi_layout_cache::set_logical_layout(std::span<const island_rect> layout)
+{
+	const bool same = std::equal(layout.begin(), layout.end(), m_logical_layout.begin(), m_logical_layout.end(), [](island_rect const &a, island_rect const &b)
+		{
+			return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+		});
+	if (same)
+	{
+		return;
+	}
+
+	m_logical_layout.assign(layout.begin(), layout.end());
+	if (!m_entries.empty())
+	{
+		++m_counters.invalidations;
+		m_entries.clear();
+	}
+}
+
+std::span<const island_rect> dpi_layout_cache::get_logical_layout() const
+{
+	return m_logical_layout;
+}
+
+std::span<const island_rect> dpi_layout_cache::get_layout(uint32_t dpi)
+{
+	++m_use_counter;
+	for (auto &cached : m_entries)
+	{
+		if (cached.dpi == dpi)
+		{
+			++m_counters.hits;
+			cached.last_used = m_use_counter;
+			return cached.rects;
+		}
+	}
+
+	++m_counters.misses;
+	entry *target = nullptr;
+	if (m_entries.size() < m_max_entries)
+	{
+		target = &m_entries.emplace_back();
+	}
+	else
+	{
+		++m_counters.evictions;
+		target = &*std::min_element(m_entries.begin(), m_entries.end(), [](entry const &a, entry const &b) { return a.last_used < b.last_used; });
+	}
+
+	target->dpi = dpi;
+	target->last_used = m_use_counter;
+	target->rects.clear();
+	for (auto &rect : m_logical_layout)
+	{
+		target->rects.push_back(scale_rect_to_dpi(rect, dpi));
+	}
+	return target->rects;
+}
+
+void dpi_layout_cache::clear()
+{
+	m_entries.clear();
+}
+
+size_t dpi_layout_cache::size() const
+{
+	return m_entries.size();
+}
+
+dpi_layout_counters const &dpi_layout_cache::get_counters() const
+{
+	return m_counters;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "island_batch.h"
+
+//Scaling between virtual pixels and physical pixels, and a cache of scaled layouts.
+//This only uses the standard library, so it has no idea what a window is.
+
+//The DPI where one virtual pixel is one physical pixel.
+constexpr uint32_t default_dpi = 96;
+
+//Scales a value in virtual pixels to physical pixels at the DPI.
+//This rounds to the nearest pixel in the same way as MulDiv.
+int scale_to_dpi(int value, uint32_t dpi);
+//Scales a value in physical pixels at one DPI to physical pixels at another.
+int scale_between_dpi(int value, uint32_t from_dpi, uint32_t to_dpi);
+//The position and size are scaled separately, so controls that are the same size in virtual pixels
+//stay the same size as each other at every DPI.
+island_rect scale_rect_to_dpi(island_rect const &, uint32_t dpi);
+float get_dpi_scale(uint32_t dpi);
+
+struct dpi_layout_counters
+{
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	//The number of times the layout changed and the cache was thrown away.
+	size_t invalidations = 0;
+};
+
+//Holds a layout in virtual pixels and the same layout scaled for each DPI it has been asked for.
+//A window that moves between monitors only scales its layout the first time it sees each DPI,
+//moving back to a monitor it has been on before uses the cached rectangles.
+class dpi_layout_cache
+{
+public:
+	//At most this many DPI values are cached, the least recently used is dropped to make room.
+	explicit dpi_layout_cache(size_t max_entries = 8);
+
+	//Sets the layout in virtual pixels.
+	//If this is different to the current layout then every cached layout is thrown away.
+	void set_logical_layout(std::span<const island_rect>);
+	std::span<const island_rect> get_logical_layout() const;
+	//Gets the layout in physical pixels for the DPI.
+	//The span is valid until the next call to set_logical_layout, clear or get_layout.
+	std::span<const island_rect> get_layout(uint32_t dpi);
+	void clear();
+
+	size_t size() const;
+	dpi_layout_counters const &get_counters() const;
+
+private:
+	struct entry
+	{
+		uint32_t dpi = 0;
+		uint64_t last_used = 0;
+		std::vector<island_rect> rects;
+	};
+
+	size_t m_max_entries;
+	std::vector<island_rect> m_logical_layout;
+	//There are only ever a handful of DPI values, so this is searched in order.
+	std::vector<entry> m_entries;
+	uint64_t m_use_counter = 0;
+	dpi_layout_counters m_counters{};
+};
\ No newline at end of file
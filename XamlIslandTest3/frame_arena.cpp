@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "frame_arena.h"
+
+#include <algorithm>
+
+frame_arena::frame_arena(size_t initial_size)
+{
+	if (initial_size != 0)
+	{
+		add_chunk(initial_size);
+	}
+}
+
+frame_arena::~frame_arena() = default;
+
+void *frame_arena::allocate(size_t size, size_t alignment)
+{
+	const auto padding = [this, alignment]()
+		{
+			return (alignment - reinterpret_cast<uintptr_t>(m_current) % alignment) % alignment;
+		};
+
+	if (m_chunks.empty())
+	{
+		add_chunk(std::max(size + alignment, default_chunk_size));
+	}
+	else if (static_cast<size_t>(m_end - m_current) < padding() + size)
+	{
+		add_chunk(size + alignment);
+	}
+
+	auto *allocation = m_current + padding();
+	m_current = allocation + size;
+	m_last_allocation = allocation;
+
+	++m_statistics.allocations;
+	m_statistics.bytes_allocated += size;
+	m_statistics.high_water = std::max(m_statistics.high_water, get_used());
+	return allocation;
+}
+
+void frame_arena::deallocate(void *pointer, size_t size)
+{
+	auto *allocation = static_cast<std::byte *>(pointer);
+	if (allocation != nullptr && allocation == m_last_allocation && allocation + size == m_current)
+	{
+		m_current = allocation;
+		m_last_allocation = nullptr;
+		++m_statistics.frees_reclaimed;
+	}
+}
+
+void frame_arena::reset()
+{
+	++m_statistics.resets;
+	m_last_allocation = nullptr;
+	m_used_in_full_chunks = 0;
+	if (m_chunks.empty())
+	{
+		return;
+	}
+
+	//The frame didn't fit in one chunk, so the next frame gets one chunk that holds it all.
+	if (m_chunks.size() > 1)
+	{
+		size_t total = 0;
+		for (auto &chunk : m_chunks)
+		{
+			total += chunk.size;
+		}
+		m_chunks.clear();
+		m_statistics.capacity = 0;
+		add_chunk(total);
+	}
+
+	auto &chunk = m_chunks.back();
+	m_current = chunk.memory.get();
+	m_end = m_current + chunk.size;
+}
+
+void frame_arena::release()
+{
+	m_chunks.clear();
+	m_current = nullptr;
+	m_end = nullptr;
+	m_used_in_full_chunks = 0;
+	m_last_allocation = nullptr;
+	m_statistics.capacity = 0;
+}
+
+size_t frame_arena::get_used() const
+{
+	return m_chunks.empty() ? 0 : m_used_in_full_chunks + static_cast<size_t>(m_current - m_chunks.back().memory.get());
+}
+
+frame_arena_statistics const &frame_arena::get_statistics() const
+{
+	return m_statistics;
+}
+
+//Each chunk is at least twice the size of the one before it, so a frame that keeps growing
+//only needs a few of them.
+void frame_arena::add_chunk(size_t minimum_size)
+{
+	size_t size = minimum_size;
+	if (!m_chunks.empty())
+	{
+		auto &last = m_chunks.back();
+		m_used_in_full_chunks += static_cast<size_t>(m_current - last.memory.get());
+		size = std::max(size, last.size * 2);
+	}
+
+	chunk new_chunk{ std::make_unique_for_overwrite<std::byte[]>(size), size };
+	m_current = new_chunk.memory.get();
+	m_end = m_current + size;
+	m_chunks.push_back(std::move(new_chunk));
+
+	++m_statistics.chunk_allocations;
+	m_statistics.capacity += size;
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifndef _MEMORY_
+#include <memory>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Memory for things that only live until the end of a pump iteration, such as the lists built
+//while routing a message.
+//Allocating is bumping a pointer, freeing does nothing unless it is the most recent allocation.
+//Everything is thrown away at once by reset.
+//If a frame needs more than the current chunk, another chunk is added. At the next reset, the
+//chunks are replaced by one chunk big enough for the whole frame, so after the first few
+//frames a steady state frame doesn't touch the heap at all.
+//This is not thread safe, an arena belongs to one thread.
+//This only uses the standard library.
+
+struct frame_arena_statistics
+{
+	uint64_t allocations = 0;
+	uint64_t bytes_allocated = 0;
+	//Frees that gave the memory back, because they were the most recent allocation.
+	uint64_t frees_reclaimed = 0;
+	uint64_t resets = 0;
+	//Chunks taken from the heap, this should stop going up once the arena has warmed up.
+	uint64_t chunk_allocations = 0;
+	//The most used by any single frame.
+	size_t high_water = 0;
+	//The size of the chunks currently held.
+	size_t capacity = 0;
+};
+
+class frame_arena
+{
+public:
+	static constexpr size_t default_chunk_size = 16 * 1024;
+
+	explicit frame_arena(size_t initial_size = default_chunk_size);
+	~frame_arena();
+	frame_arena(const frame_arena &) = delete;
+	frame_arena(frame_arena &&) = delete;
+	frame_arena &operator=(const frame_arena &) = delete;
+	frame_arena &operator=(frame_arena &&) = delete;
+
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	//Only gives the memory back if it is the most recent allocation.
+	void deallocate(void *, size_t size);
+	//Frees everything allocated since the last reset.
+	//Nothing allocated from the arena may be used after this.
+	void reset();
+	//Gives the chunks back to the heap, the next allocation starts a new chunk.
+	//This must only be called straight after reset.
+	void release();
+
+	//The bytes used since the last reset.
+	size_t get_used() const;
+	frame_arena_statistics const &get_statistics() const;
+
+private:
+	struct chunk
+	{
+		std::unique_ptr<std::byte[]> memory;
+		size_t size = 0;
+	};
+
+	void add_chunk(size_t minimum_size);
+
+	std::vector<chunk> m_chunks;
+	//The position in the last chunk.
+	std::byte *m_current = nullptr;
+	std::byte *m_end = nullptr;
+	//Everything in the chunks before the last one.
+	size_t m_used_in_full_chunks = 0;
+	//Where the most recent allocation started, so that it can be freed or grown.
+	std::byte *m_last_allocation = nullptr;
+	frame_arena_statistics m_statistics{};
+};
+
+//A standard allocator that allocates from a frame arena.
+template <typename T>
+class frame_allocator
+{
+public:
+	using value_type = T;
+
+	explicit frame_allocator(frame_arena &arena) noexcept : m_arena(&arena)
+	{
+	}
+	template <typename U>
+	frame_allocator(frame_allocator<U> const &other) noexcept : m_arena(other.get_arena())
+	{
+	}
+
+	T *allocate(size_t count)
+	{
+		return static_cast<T *>(m_arena->allocate(count * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *pointer, size_t count) noexcept
+	{
+		m_arena->deallocate(pointer, count * sizeof(T));
+	}
+
+	frame_arena *get_arena() const noexcept
+	{
+		return m_arena;
+	}
+
+	template <typename U>
+	bool operator==(frame_allocator<U> const &other) const noexcept
+	{
+		return m_arena == other.get_arena();
+	}
+
+private:
+	frame_arena *m_arena;
+};
+
+//Containers for the current frame. They must not outlive the next reset of their arena.
+template <typename T>
+using frame_vector = std::vector<T, frame_allocator<T>>;
+using frame_wstring = std::basic_string<wchar_t, std::char_traits<wchar_t>, frame_allocator<wchar_t>>;
+
+template <typename T>
+frame_vector<T> make_frame_vector(frame_arena &arena, size_t reserve = 0)
+{
+	frame_vector<T> vector{ frame_allocator<T>(arena) };
+	vector.reserve(reserve);
+	return vector;
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "pch.h"
+#include "hang_watchdog.h"
+
+#include <algorithm>
+
+std::wstring_view get_pump_stage_name(pump_stage stage)
+{
+	switch (stage)
+	{
+	case pump_stage::waiting:
+		return L"waiting";
+	case pump_stage::peek:
+		return L"peek";
+	case pump_stage::filter:
+		return L"filter";
+	case pump_stage::navigate:
+		return L"navigate";
+	case pump_stage::dispatch:
+		return L"dispatch";
+	case pump_stage::completions:
+		return L"completions";
+	case pump_stage::property_flush:
+		return L"property_flush";
+	case pump_stage::timers:
+		return L"timers";
+	case pump_stage::idle_tasks:
+		return L"idle_tasks";
+	case pump_stage::housekeeping:
+		return L"housekeeping";
+	case pump_stage::stage_count:
+		break;
+	}
+	return L"unknown";
+}
+
+std::wstring_view get_stall_severity_name(stall_severity severity)
+{
+	switch (severity)
+	{
+	case stall_severity::none:
+		return L"none";
+	case stall_severity::slow:
+		return L"slow";
+	case stall_severity::hung:
+		return L"hung";
+	}
+	return L"unknown";
+}
+
+void pump_heartbeat::enter_modal_loop()
+{
+	if (m_modal_depth++ == 0)
+	{
+		m_before_modal = sample();
+		beat(pump_stage::waiting);
+	}
+}
+
+void pump_heartbeat::exit_modal_loop()
+{
+	if (m_modal_depth != 0 && --m_modal_depth == 0)
+	{
+		beat(m_before_modal.stage, m_before_modal.message, m_before_modal.window, m_before_modal.island);
+	}
+}
+
+heartbeat_sample pump_heartbeat::sample() const
+{
+	heartbeat_sample sample{};
+	for (;;)
+	{
+		const auto sequence = m_sequence.load(std::memory_order_acquire);
+		sample.stage = m_stage.load(std::memory_order_relaxed);
+		sample.message = m_message.load(std::memory_order_relaxed);
+		sample.window = m_window.load(std::memory_order_relaxed);
+		sample.island = m_island.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		//An odd sequence is a beat in progress, a changed one means a beat happened while reading.
+		if ((sequence & 1) == 0 && m_sequence.load(std::memory_order_relaxed) == sequence)
+		{
+			sample.sequence = sequence;
+			return sample;
+		}
+		std::this_thread::yield();
+	}
+}
+
+stall_classifier::stall_classifier(hang_watchdog_options const &options) : m_options(options)
+{
+}
+
+std::optional<stall_report> stall_classifier::observe(heartbeat_sample const &sample, time_point now)
+{
+	++m_statistics.samples;
+	if (!m_started || sample.sequence != m_last.sequence)
+	{
+		auto report = m_started ? finish_stall(now) : std::nullopt;
+		m_started = true;
+		m_last = sample;
+		m_first_seen = now;
+		m_stalled = false;
+		m_reported = stall_severity::none;
+		return report;
+	}
+
+	//The pump is allowed to wait for as long as it likes.
+	if (sample.stage == pump_stage::waiting)
+	{
+		return std::nullopt;
+	}
+
+	m_stalled = true;
+	const auto elapsed = now - m_first_seen;
+	auto severity = stall_severity::none;
+	if (elapsed >= m_options.hang_threshold)
+	{
+		severity = stall_severity::hung;
+	}
+	else if (elapsed >= m_options.slow_threshold)
+	{
+		severity = stall_severity::slow;
+	}
+	if (severity <= m_reported)
+	{
+		return std::nullopt;
+	}
+
+	//A stall that passes both thresholds between samples is only reported once, as hung.
+	m_reported = severity;
+	if (severity == stall_severity::hung)
+	{
+		++m_statistics.hung;
+	}
+	else
+	{
+		++m_statistics.slow;
+	}
+	return stall_report{ m_last, severity, elapsed, false };
+}
+
+stall_statistics stall_classifier::get_statistics() const
+{
+	auto statistics = m_statistics;
+	statistics.durations.count = m_durations.get_count();
+	statistics.durations.p50 = m_durations.get_percentile(0.5);
+	statistics.durations.p90 = m_durations.get_percentile(0.9);
+	statistics.durations.p99 = m_durations.get_percentile(0.99);
+	statistics.durations.max = m_durations.get_max();
+	return statistics;
+}
+
+//The stall ended somewhere between the last sample and this one, so now is as close as the
+//watchdog can get.
+std::optional<stall_report> stall_classifier::finish_stall(time_point now)
+{
+	if (!m_stalled)
+	{
+		return std::nullopt;
+	}
+
+	const auto elapsed = now - m_first_seen;
+	++m_statistics.stalls;
+	m_durations.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+	if (elapsed > m_statistics.longest)
+	{
+		m_statistics.longest = elapsed;
+		m_statistics.longest_stage = m_last.stage;
+	}
+
+	if (m_reported == stall_severity::none)
+	{
+		return std::nullopt;
+	}
+	return stall_report{ m_last, m_reported, elapsed, true };
+}
+
+hang_watchdog::hang_watchdog(pump_heartbeat const &heartbeat, hang_watchdog_options const &options, report_function report)
+	: m_heartbeat(heartbeat), m_options(options), m_report(std::move(report)), m_classifier(options)
+{
+	m_thread = std::thread([this]() { run(); });
+}
+
+hang_watchdog::~hang_watchdog()
+{
+	stop();
+}
+
+void hang_watchdog::stop()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_stop_requested.notify_all();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+stall_statistics hang_watchdog::get_statistics() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_classifier.get_statistics();
+}
+
+void hang_watchdog::run()
+{
+	std::unique_lock lock(m_mutex);
+	while (!m_stop_requested.wait_for(lock, m_options.poll_interval, [this]() { return m_stopping; }))
+	{
+		const auto report = m_classifier.observe(m_heartbeat.sample(), stall_classifier::clock::now());
+		if (report && m_report)
+		{
+			//The report can take a while, such as when it samples the stalled thread.
+			lock.unlock();
+			m_report(*report);
+			lock.lock();
+		}
+	}
+}
\ No newline at end of file
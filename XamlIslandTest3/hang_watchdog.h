@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <condition_variable>
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _MUTEX_
+#include <mutex>
+#endif
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#include "latency_probe.h"
+
+//Notices when the UI thread stops pumping messages, and records what it was doing at the time.
+//The pump updates a heartbeat as it moves from stage to stage. This is only a few stores, the
+//pump doesn't read the clock for it. A watchdog thread samples the heartbeat on a fixed
+//interval. If the heartbeat hasn't moved on between samples, and the pump isn't just waiting
+//for messages, the pump is stalled in the stage that the heartbeat shows.
+//Stall times are measured by the watchdog, from the first sample that saw the heartbeat, so they
+//are short by up to one poll interval.
+//This only uses the standard library, what to do with a stall is up to the caller.
+
+//What the pump is doing.
+enum class pump_stage : uint8_t
+{
+	//Blocked waiting for messages, this is never a stall.
+	waiting,
+	//Getting the next message, messages sent from other threads are handled in here.
+	peek,
+	filter,
+	navigate,
+	dispatch,
+	completions,
+	property_flush,
+	timers,
+	idle_tasks,
+	//Anything else the pump does between messages.
+	housekeeping,
+	stage_count
+};
+
+std::wstring_view get_pump_stage_name(pump_stage);
+
+//A consistent copy of the heartbeat.
+struct heartbeat_sample
+{
+	uint64_t sequence = 0;
+	pump_stage stage = pump_stage::waiting;
+	uint32_t message = 0;
+	//The window the message was sent to, and the island or other child that contains it.
+	uint64_t window = 0;
+	uint64_t island = 0;
+};
+
+//Written by the pump's thread only, read by the watchdog.
+//The fields are guarded by a sequence number that is odd while they are being written, so the
+//reader can tell when it has read a mix of two beats and try again.
+class pump_heartbeat
+{
+public:
+	void beat(pump_stage stage, uint32_t message = 0, uint64_t window = 0, uint64_t island = 0)
+	{
+		//Only this thread writes the sequence, so it doesn't need a read-modify-write.
+		const auto sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_stage.store(stage, std::memory_order_relaxed);
+		m_message.store(message, std::memory_order_relaxed);
+		m_window.store(window, std::memory_order_relaxed);
+		m_island.store(island, std::memory_order_relaxed);
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	//While a window is moved or sized, or a menu is open, DefWindowProc runs a message loop of
+	//its own inside the dispatch. The pump is waiting for that loop, not stalled, so it beats
+	//waiting until the loop ends, and then the beat from before it again.
+	//Loops can nest, such as a menu opened from the system menu.
+	void enter_modal_loop();
+	void exit_modal_loop();
+
+	heartbeat_sample sample() const;
+
+private:
+	std::atomic<uint64_t> m_sequence{ 0 };
+	std::atomic<pump_stage> m_stage{ pump_stage::waiting };
+	std::atomic<uint32_t> m_message{ 0 };
+	std::atomic<uint64_t> m_window{ 0 };
+	std::atomic<uint64_t> m_island{ 0 };
+	//Only used by the pump's thread.
+	uint32_t m_modal_depth = 0;
+	heartbeat_sample m_before_modal{};
+};
+
+enum class stall_severity : uint8_t
+{
+	none,
+	slow,
+	hung
+};
+
+std::wstring_view get_stall_severity_name(stall_severity);
+
+struct hang_watchdog_options
+{
+	std::chrono::milliseconds poll_interval{ 50 };
+	//A stall is reported as it passes each threshold, and again when it ends.
+	std::chrono::milliseconds slow_threshold{ 250 };
+	std::chrono::milliseconds hang_threshold{ 2000 };
+};
+
+struct stall_report
+{
+	heartbeat_sample sample{};
+	stall_severity severity = stall_severity::none;
+	std::chrono::nanoseconds elapsed{};
+	//Set once the pump has moved on, elapsed is then the whole stall.
+	bool ended = false;
+};
+
+struct stall_statistics
+{
+	uint64_t samples = 0;
+	//Busy periods that outlasted a poll interval.
+	uint64_t stalls = 0;
+	uint64_t slow = 0;
+	uint64_t hung = 0;
+	std::chrono::nanoseconds longest{};
+	pump_stage longest_stage = pump_stage::waiting;
+	//How long each stall lasted.
+	latency_summary durations{};
+};
+
+//Turns a series of samples into stalls.
+//This holds no threads or clocks of its own, the samples and their times are passed in.
+class stall_classifier
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	explicit stall_classifier(hang_watchdog_options const & = {});
+
+	//Looks at a sample taken at the time.
+	//Returns a report if the stall has just passed a threshold, or a reported stall has ended.
+	std::optional<stall_report> observe(heartbeat_sample const &, time_point now);
+
+	stall_statistics get_statistics() const;
+
+private:
+	//Records the stall that the last sample belonged to, now that the heartbeat has moved on.
+	std::optional<stall_report> finish_stall(time_point now);
+
+	hang_watchdog_options m_options;
+	heartbeat_sample m_last{};
+	//When the last sample's beat was first seen.
+	time_point m_first_seen{};
+	bool m_started = false;
+	//The beat has been seen by more than one sample.
+	bool m_stalled = false;
+	stall_severity m_reported = stall_severity::none;
+	latency_histogram m_durations{};
+	stall_statistics m_statistics{};
+};
+
+//The thread that samples the heartbeat.
+//Reports are made on the watchdog's thread.
+class hang_watchdog
+{
+public:
+	using report_function = std::function<void(stall_report const &)>;
+
+	hang_watchdog(pump_heartbeat const &, hang_watchdog_options const &, report_function);
+	~hang_watchdog();
+	hang_watchdog(const hang_watchdog &) = delete;
+	hang_watchdog(hang_watchdog &&) = delete;
+	hang_watchdog &operator=(const hang_watchdog &) = delete;
+	hang_watchdog &operator=(hang_watchdog &&) = delete;
+
+	//Stops and joins the thread, this is also done by the destructor.
+	void stop();
+	stall_statistics get_statistics() const;
+
+private:
+	void run();
+
+	pump_heartbeat const &m_heartbeat;
+	hang_watchdog_options m_options;
+	report_function m_report;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_stop_requested;
+	bool m_stopping = false;
+	stall_classifier m_classifier;
+	std::thread m_thread;
+};
\ No newline at end of file
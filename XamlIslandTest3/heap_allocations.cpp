@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "heap_allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+//The global operator new and delete are replaced so that each allocation can be counted.
+//Every form is replaced, so that no allocation goes uncounted and every delete frees memory
+//the way its new allocated it.
+
+thread_local heap_allocation_counts thread_heap_allocations{};
+
+heap_allocation_counts get_thread_heap_allocations()
+{
+	return thread_heap_allocations;
+}
+
+namespace
+{
+	void *allocate_counted(size_t size, size_t alignment)
+	{
+		++thread_heap_allocations.allocations;
+		thread_heap_allocations.bytes += size;
+
+		//malloc(0) may return null, operator new may not.
+		if (size == 0)
+		{
+			size = 1;
+		}
+		while (true)
+		{
+			void *pointer = nullptr;
+			if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			{
+				pointer = std::malloc(size);
+			}
+			else
+			{
+#if defined(_MSC_VER)
+				pointer = _aligned_malloc(size, alignment);
+#else
+				//aligned_alloc wants the size to be a multiple of the alignment.
+				pointer = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+			}
+			if (pointer)
+			{
+				return pointer;
+			}
+			const auto handler = std::get_new_handler();
+			if (!handler)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	void *allocate_counted_nothrow(size_t size, size_t alignment) noexcept
+	{
+		try
+		{
+			return allocate_counted(size, alignment);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+	}
+
+	void free_counted(void *pointer, size_t alignment) noexcept
+	{
+#if defined(_MSC_VER)
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			_aligned_free(pointer);
+			return;
+		}
+#else
+		(void)alignment;
+#endif
+		std::free(pointer);
+	}
+}
+
+void *operator new(size_t size)
+{
+	return allocate_counted(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](size_t size)
+{
+	return allocate_counted(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept
+{
+	return allocate_counted_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept
+{
+	return allocate_counted_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return allocate_counted(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocate_counted(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+	return allocate_counted_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+	return allocate_counted_nothrow(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *pointer, std::nothrow_t const &) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void *pointer, std::nothrow_t const &) noexcept
+{
+	free_counted(pointer, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void *pointer, std::align_val_t alignment) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t alignment) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
+
+void operator delete[](void *pointer, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+	free_counted(pointer, static_cast<size_t>(alignment));
+}
\ No newline at end of file
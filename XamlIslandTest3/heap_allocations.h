@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+//Counts the allocations made through the global operator new on each thread, so that the pump
+//can check that a steady state message doesn't allocate.
+//Allocations that xaml and the Windows Runtime make for themselves don't go through operator new,
+//so this only sees what our code allocates.
+//This only uses the standard library.
+
+struct heap_allocation_counts
+{
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+};
+
+//The allocations made by the calling thread since it started.
+heap_allocation_counts get_thread_heap_allocations();
\ No newline at end of file
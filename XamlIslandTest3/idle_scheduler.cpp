@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "idle_scheduler.h"
+
+#include <algorithm>
+
+idle_scheduler::idle_scheduler(clock_function clock_fn) : m_clock(std::move(clock_fn))
+{
+}
+
+idle_task_id idle_scheduler::post(task_function function, idle_task_options options)
+{
+	task_entry entry{};
+	entry.id = m_next_id++;
+	entry.function = std::move(function);
+	entry.options = std::move(options);
+	entry.posted_time = m_clock();
+
+	m_tasks.push_back(std::move(entry));
+	++m_statistics.tasks_posted;
+
+	return m_tasks.back().id;
+}
+
+bool idle_scheduler::cancel(idle_task_id id)
+{
+	for (auto &task : m_tasks)
+	{
+		if (task.id == id && !task.cancelled)
+		{
+			//The entry is only marked here. Removing it could invalidate the
+			//entry of a task that is currently running.
+			task.cancelled = true;
+			++m_statistics.tasks_cancelled;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void idle_scheduler::cancel_all()
+{
+	for (auto &task : m_tasks)
+	{
+		if (!task.cancelled)
+		{
+			task.cancelled = true;
+			++m_statistics.tasks_cancelled;
+		}
+	}
+
+	if (m_running_task == invalid_idle_task_id)
+	{
+		remove_cancelled_tasks();
+	}
+}
+
+bool idle_scheduler::has_pending_tasks() const
+{
+	return pending_task_count() != 0;
+}
+
+size_t idle_scheduler::pending_task_count() const
+{
+	return static_cast<size_t>(std::count_if(m_tasks.begin(), m_tasks.end(), [](task_entry const &task) { return !task.cancelled; }));
+}
+
+idle_run_result idle_scheduler::run(std::chrono::nanoseconds budget, input_pending_function const &input_pending)
+{
+	idle_run_result result{};
+	const auto start = m_clock();
+	const auto budget_end = start + budget;
+
+	remove_cancelled_tasks();
+
+	for (;;)
+	{
+		if (m_tasks.empty())
+		{
+			result.reason = idle_run_stop_reason::no_tasks;
+			break;
+		}
+		//Input always takes precedence over idle work.
+		if (input_pending && input_pending())
+		{
+			result.reason = idle_run_stop_reason::input_pending;
+			++m_statistics.yields_for_input;
+			break;
+		}
+
+		const auto now = m_clock();
+		if (now >= budget_end)
+		{
+			result.reason = idle_run_stop_reason::budget_exhausted;
+			break;
+		}
+
+		const auto index = select_next_task(now);
+		if (index == m_tasks.size())
+		{
+			result.reason = idle_run_stop_reason::no_tasks;
+			break;
+		}
+
+		auto &selected = m_tasks[index];
+		if (!selected.has_run)
+		{
+			selected.has_run = true;
+			m_statistics.max_wait_time = std::max(m_statistics.max_wait_time, std::chrono::duration_cast<std::chrono::nanoseconds>(now - selected.posted_time));
+		}
+
+		//The function is moved out so the task can post or cancel tasks without
+		//invalidating what is running.
+		const auto id = selected.id;
+		auto function = std::move(selected.function);
+		const auto slice_end = std::min(now + m_slice_length, budget_end);
+
+		m_running_task = id;
+		const auto task_result = function(slice_end);
+		m_running_task = invalid_idle_task_id;
+
+		const auto after = m_clock();
+		m_statistics.total_run_time += after - now;
+		++m_statistics.slices_run;
+		++result.slices_run;
+
+		//Find the entry again, posting from inside the task may have moved it.
+		auto it = std::find_if(m_tasks.begin(), m_tasks.end(), [id](task_entry const &task) { return task.id == id; });
+		if (it != m_tasks.end())
+		{
+			if (task_result == idle_task_result::complete || it->cancelled)
+			{
+				if (!it->cancelled)
+				{
+					++m_statistics.tasks_completed;
+				}
+				m_tasks.erase(it);
+			}
+			else
+			{
+				it->function = std::move(function);
+				//Once the task has had a slice, it competes on its own priority again.
+				it->times_skipped = 0;
+				it->promotion = 0;
+			}
+		}
+
+		remove_cancelled_tasks();
+	}
+
+	result.time_used = m_clock() - start;
+	return result;
+}
+
+void idle_scheduler::set_slice_length(std::chrono::nanoseconds slice_length)
+{
+	m_slice_length = slice_length;
+}
+
+std::chrono::nanoseconds idle_scheduler::get_slice_length() const
+{
+	return m_slice_length;
+}
+
+idle_scheduler_statistics const &idle_scheduler::get_statistics() const
+{
+	return m_statistics;
+}
+
+//Overdue tasks come first, in deadline order.
+//After that it is the highest effective priority, then the oldest task.
+size_t idle_scheduler::select_next_task(time_point now)
+{
+	size_t best = m_tasks.size();
+
+	for (size_t i = 0; i < m_tasks.size(); ++i)
+	{
+		auto &task = m_tasks[i];
+		if (task.cancelled)
+		{
+			continue;
+		}
+
+		const bool overdue = task.options.deadline <= now;
+		if (overdue && !task.deadline_missed)
+		{
+			task.deadline_missed = true;
+			++m_statistics.deadlines_missed;
+		}
+
+		if (best == m_tasks.size())
+		{
+			best = i;
+			continue;
+		}
+
+		auto &current = m_tasks[best];
+		const bool current_overdue = current.options.deadline <= now;
+		bool better = false;
+		if (overdue != current_overdue)
+		{
+			better = overdue;
+		}
+		else if (overdue)
+		{
+			better = task.options.deadline < current.options.deadline;
+		}
+		else
+		{
+			const auto priority = effective_priority(task);
+			const auto current_priority = effective_priority(current);
+			better = priority > current_priority || (priority == current_priority && task.posted_time < current.posted_time);
+		}
+
+		if (better)
+		{
+			best = i;
+		}
+	}
+
+	//Everything that didn't get picked was passed over.
+	for (size_t i = 0; i < m_tasks.size(); ++i)
+	{
+		auto &task = m_tasks[i];
+		if (i == best || task.cancelled)
+		{
+			continue;
+		}
+
+		++task.times_skipped;
+		if (task.times_skipped >= starvation_threshold)
+		{
+			task.times_skipped = 0;
+			++task.promotion;
+			++m_statistics.starvation_promotions;
+		}
+	}
+
+	return best;
+}
+
+uint32_t idle_scheduler::effective_priority(task_entry const &task) const
+{
+	return static_cast<uint32_t>(task.options.priority) + task.promotion;
+}
+
+void idle_scheduler::remove_cancelled_tasks()
+{
+	std::erase_if(m_tasks, [](task_entry const &task) { return task.cancelled; });
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#ifndef _VECTOR_
+#include <vector>
+#endif
+#include <cstdint>
+
+//Relative priority of idle tasks.
+//Higher priority tasks run first, but tasks that are passed over often enough
+//are promoted so that low priority work isn't starved forever.
+enum class idle_priority : uint32_t
+{
+	low = 0,
+	normal = 1,
+	high = 2
+};
+
+//Returned by an idle task to say whether it needs to be called again.
+//Tasks are expected to do a small amount of work, check the slice deadline
+//and return more_work if they haven't finished.
+enum class idle_task_result
+{
+	complete,
+	more_work
+};
+
+//Why a call to idle_scheduler::run returned.
+enum class idle_run_stop_reason
+{
+	no_tasks,
+	budget_exhausted,
+	input_pending
+};
+
+using idle_task_id = uint64_t;
+constexpr idle_task_id invalid_idle_task_id = 0;
+
+//Options for posting an idle task.
+struct idle_task_options
+{
+	idle_priority priority = idle_priority::normal;
+	//If the task hasn't completed by this time, it runs ahead of everything else
+	//in the next idle period. The miss is recorded in the statistics.
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+	//Name used for diagnostics.
+	std::string name;
+};
+
+//Running totals for the scheduler.
+struct idle_scheduler_statistics
+{
+	uint64_t tasks_posted = 0;
+	uint64_t tasks_completed = 0;
+	uint64_t tasks_cancelled = 0;
+	uint64_t slices_run = 0;
+	uint64_t deadlines_missed = 0;
+	//Number of times a task was promoted because it had been passed over too often.
+	uint64_t starvation_promotions = 0;
+	uint64_t yields_for_input = 0;
+	//The longest any task waited between being posted and its first slice.
+	std::chrono::nanoseconds max_wait_time{};
+	std::chrono::nanoseconds total_run_time{};
+};
+
+//The result of a single call to idle_scheduler::run.
+struct idle_run_result
+{
+	idle_run_stop_reason reason = idle_run_stop_reason::no_tasks;
+	uint32_t slices_run = 0;
+	std::chrono::nanoseconds time_used{};
+};
+
+//Cooperative scheduler for low priority work that runs when the message queue is empty.
+//This doesn't depend on the Windows API. The clock is provided by the owner and whether
+//input has arrived is asked through a callback, so it can be driven by a message pump
+//or by a simulation.
+class idle_scheduler
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+	using clock_function = std::function<time_point()>;
+	//The task is given the time at which its slice ends.
+	using task_function = std::function<idle_task_result(time_point)>;
+	using input_pending_function = std::function<bool()>;
+
+	//The number of times a task can be passed over before it is promoted by one priority level.
+	static constexpr uint32_t starvation_threshold = 8;
+
+	explicit idle_scheduler(clock_function = &clock::now);
+
+	//Adds a task to the scheduler.
+	idle_task_id post(task_function, idle_task_options = {});
+	//Removes a task. This is safe to call from inside a running task, including the task itself.
+	//Returns false if the task doesn't exist or already completed.
+	bool cancel(idle_task_id);
+	//Removes every task.
+	void cancel_all();
+
+	bool has_pending_tasks() const;
+	size_t pending_task_count() const;
+
+	//Runs tasks until the budget is used up, input arrives or there is nothing left to do.
+	//Each task gets at most one slice at a time, which is also cut short by the budget.
+	idle_run_result run(std::chrono::nanoseconds budget, input_pending_function const &input_pending);
+
+	void set_slice_length(std::chrono::nanoseconds);
+	std::chrono::nanoseconds get_slice_length() const;
+
+	idle_scheduler_statistics const &get_statistics() const;
+
+private:
+	struct task_entry
+	{
+		idle_task_id id = invalid_idle_task_id;
+		task_function function;
+		idle_task_options options;
+		time_point posted_time{};
+		//How many times this task was passed over for another task.
+		uint32_t times_skipped = 0;
+		uint32_t promotion = 0;
+		bool has_run = false;
+		bool deadline_missed = false;
+		bool cancelled = false;
+	};
+
+	//Picks the task that should run next, returns the index or size() if there is none.
+	size_t select_next_task(time_point now);
+	uint32_t effective_priority(task_entry const &) const;
+	void remove_cancelled_tasks();
+
+	clock_function m_clock;
+	std::chrono::nanoseconds m_slice_length = std::chrono::milliseconds(2);
+	std::vector<task_entry> m_tasks;
+	idle_task_id m_next_id = 1;
+	idle_task_id m_running_task = invalid_idle_task_id;
+	idle_scheduler_statistics m_statistics{};
+};
\ No newline at end of file
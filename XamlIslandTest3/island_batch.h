@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+#include <span>
+
+//A rectangle in parent client coordinates.
+struct island_rect
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+//Where an island goes and what styles it needs.
+template <typename Handle>
+struct island_placement
+{
+	Handle handle{};
+	uint32_t extra_styles = 0;
+	island_rect rect{};
+	bool show = true;
+};
+
+//Counts and timings for a batch.
+//The create time is filled in by whoever creates the islands, the batch only does
+//the style and position phases.
+struct island_batch_statistics
+{
+	size_t style_reads = 0;
+	size_t style_writes = 0;
+	size_t positions_deferred = 0;
+	//Set if the deferred batch failed and each island had to be positioned on its own.
+	bool used_fallback = false;
+	std::chrono::nanoseconds create_time{};
+	std::chrono::nanoseconds style_time{};
+	std::chrono::nanoseconds position_time{};
+	std::chrono::nanoseconds total_time{};
+};
+
+//Applies styles and positions to a batch of islands in as few window manager round trips as possible.
+//All of the styles are applied first, skipping any that wouldn't change, and then everything is
+//moved and shown in a single deferred batch.
+//Nothing is invalidated here. Ending the deferred batch repaints only what moved or was uncovered,
+//so this is cheap enough to run on every step of a live resize or scroll.
+//
+//The window manager is a template parameter so that this can be run against anything that
+//provides the following:
+//  uint32_t get_style(Handle);
+//  void set_style(Handle, uint32_t);
+//  Deferral begin_deferred_positions(size_t count);
+//  bool defer_position(Deferral &, Handle, island_rect const &, bool show);
+//  bool end_deferred_positions(Deferral &);
+//  void set_position(Handle, island_rect const &, bool show);
+//defer_position returns false if the batch has failed, the deferral is then abandoned.
+template <typename WindowManager, typename Handle>
+island_batch_statistics apply_island_batch(WindowManager &window_manager, std::span<const island_placement<Handle>> placements)
+{
+	using clock = std::chrono::steady_clock;
+
+	island_batch_statistics statistics{};
+	if (placements.empty())
+	{
+		return statistics;
+	}
+
+	const auto start = clock::now();
+	{
+		for (auto &placement : placements)
+		{
+			if (placement.extra_styles == 0)
+			{
+				continue;
+			}
+
+			const auto current_style = window_manager.get_style(placement.handle);
+			++statistics.style_reads;
+			const auto new_style = current_style | placement.extra_styles;
+			if (new_style != current_style)
+			{
+				window_manager.set_style(placement.handle, new_style);
+				++statistics.style_writes;
+			}
+		}
+		const auto styled = clock::now();
+		statistics.style_time = styled - start;
+
+		auto deferral = window_manager.begin_deferred_positions(placements.size());
+		bool deferred = true;
+		for (auto &placement : placements)
+		{
+			if (!window_manager.defer_position(deferral, placement.handle, placement.rect, placement.show))
+			{
+				deferred = false;
+				break;
+			}
+			++statistics.positions_deferred;
+		}
+		if (deferred)
+		{
+			deferred = window_manager.end_deferred_positions(deferral);
+		}
+		if (!deferred)
+		{
+			//A failed deferral applies nothing, so go through them one by one.
+			statistics.used_fallback = true;
+			for (auto &placement : placements)
+			{
+				window_manager.set_position(placement.handle, placement.rect, placement.show);
+			}
+		}
+		statistics.position_time = clock::now() - styled;
+	}
+	statistics.total_time = clock::now() - start;
+
+	return statistics;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "island_consolidation.h"
+
+#include <algorithm>
+
+island_rect get_union(island_rect const &a, island_rect const &b)
+{
+	const int left = std::min(a.x, b.x);
+	const int top = std::min(a.y, b.y);
+	const int right = std::max(a.x + a.width, b.x + b.width);
+	const int bottom = std::max(a.y + a.height, b.y + b.height);
+	return { left, top, right - left, bottom - top };
+}
+
+//Touching edges don't count, neighbouring controls are allowed to share an edge.
+bool intersects(island_rect const &a, island_rect const &b)
+{
+	return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+//The larger of the horizontal and vertical distances between the rectangles, 0 if they touch
+//or overlap.
+int get_gap(island_rect const &a, island_rect const &b)
+{
+	const int horizontal = std::max({ a.x - (b.x + b.width), b.x - (a.x + a.width), 0 });
+	const int vertical = std::max({ a.y - (b.y + b.height), b.y - (a.y + a.height), 0 });
+	return std::max(horizontal, vertical);
+}
+
+//Checks whether the bounds cover any of the children outside of [first, last).
+bool covers_outside(std::span<const consolidation_child> children, island_rect const &bounds, size_t first, size_t last)
+{
+	for (size_t i = 0; i < children.size(); ++i)
+	{
+		if ((i < first || i >= last) && intersects(bounds, children[i].rect))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool covers_range(std::span<const consolidation_child> children, island_rect const &bounds, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; ++i)
+	{
+		if (intersects(bounds, children[i].rect))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+consolidation_plan plan_island_consolidation(std::span<const consolidation_child> children, consolidation_options const &options)
+{
+	consolidation_plan plan{};
+	plan.island_of_child.assign(children.size(), consolidation_plan::no_island);
+
+	size_t first = 0;
+	while (first < children.size())
+	{
+		if (children[first].kind == consolidation_child_kind::native)
+		{
+			++first;
+			continue;
+		}
+
+		//The run of xaml children that no native child interrupts.
+		size_t run_end = first + 1;
+		while (run_end < children.size() && children[run_end].kind == consolidation_child_kind::xaml)
+		{
+			++run_end;
+		}
+
+		//The island grows along the run. It may grow over elements further along the run,
+		//since they are likely to join it, but nothing outside the run.
+		auto bounds = children[first].rect;
+		size_t last = first + 1;
+		while (last < run_end && last - first < options.max_elements && get_gap(bounds, children[last].rect) <= options.max_gap)
+		{
+			const auto grown = get_union(bounds, children[last].rect);
+			if (covers_outside(children, grown, first, run_end))
+			{
+				break;
+			}
+			bounds = grown;
+			++last;
+		}
+
+		//If it stopped short of the end of the run, it mustn't cover the elements left for the
+		//next island, so elements are given back until it doesn't.
+		while (last - first > 1 && covers_range(children, bounds, last, run_end))
+		{
+			--last;
+			bounds = children[first].rect;
+			for (size_t i = first + 1; i < last; ++i)
+			{
+				bounds = get_union(bounds, children[i].rect);
+			}
+		}
+
+		consolidated_island island{ bounds, {} };
+		for (size_t i = first; i < last; ++i)
+		{
+			island.children.push_back(i);
+			plan.island_of_child[i] = plan.islands.size();
+		}
+		plan.islands.push_back(std::move(island));
+		first = last;
+	}
+
+	return plan;
+}
+
+island_rect get_rect_within(island_rect const &island, island_rect const &child)
+{
+	return { child.x - island.x, child.y - island.y, child.width, child.height };
+}
\ No newline at end of file
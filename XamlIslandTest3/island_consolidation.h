@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "island_batch.h"
+
+//Works out which xaml elements of a window can share one island.
+//Every island is a window of its own, it is given every message in PreTranslateMessage and
+//focus has to be bridged into and out of it. Elements that are next to each other in the tab
+//order can be hosted by one island, where xaml moves the focus between them itself, so an island
+//is only needed where native controls and xaml elements interleave.
+//This only uses the standard library, creating the islands is left to the caller.
+
+enum class consolidation_child_kind : uint8_t
+{
+	native,
+	xaml
+};
+
+//A child of the window. The children are given in tab order.
+struct consolidation_child
+{
+	consolidation_child_kind kind = consolidation_child_kind::xaml;
+	island_rect rect{};
+};
+
+struct consolidation_options
+{
+	//An element only joins an island if it is no further than this from what is already in it.
+	int max_gap = 32;
+	//The most elements that one island hosts.
+	size_t max_elements = 64;
+};
+
+//One island and the elements that it hosts.
+struct consolidated_island
+{
+	//The bounds of the elements.
+	island_rect rect{};
+	//Indexes into the children, in tab order.
+	std::vector<size_t> children;
+};
+
+struct consolidation_plan
+{
+	static constexpr size_t no_island = SIZE_MAX;
+
+	//In the tab order of their first element.
+	std::vector<consolidated_island> islands;
+	//The island that hosts each child, no_island for native children.
+	std::vector<size_t> island_of_child;
+};
+
+//Groups runs of xaml children that aren't broken up by a native child in the tab order.
+//A run is split where the next element is too far away, or where the island would grow over a
+//child that it doesn't host, since sibling windows mustn't cover each other's controls.
+consolidation_plan plan_island_consolidation(std::span<const consolidation_child>, consolidation_options const & = {});
+
+//Gets where the child is within the island.
+island_rect get_rect_within(island_rect const &island, island_rect const &child);
\ No newline at end of file
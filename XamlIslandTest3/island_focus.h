@@ -0,0 +1,156 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <utility>
+
+//Keyboard focus navigation and message filtering for a window that hosts xaml islands.
+//
+//This is written against a platform rather than the Windows API directly, so the logic can
+//be driven by something other than a live desktop session. The platform is a template parameter,
+//in the same way as the window manager for apply_island_batch, and must provide the following:
+//  using window_type, message_type, source_type, reason_type, request_id_type;
+//  window_type get_focus();
+//  void set_focus(window_type);
+//  window_type get_next_tab_item(window_type host, window_type from, bool previous);
+//  bool is_menu_modifier_down();
+//  bool is_dialog_message(window_type host, message_type &);
+//  std::optional<reason_type> get_navigation_reason(message_type const &);
+//  bool is_previous(reason_type);
+//  message_type make_navigation_message(window_type, reason_type);
+//  window_type get_source_window(source_type const &);
+//  bool source_has_focus(source_type const &);
+//  bool pre_translate_message(source_type const &, message_type const &);
+//  bool navigate_source(source_type const &, reason_type, window_type previous_focus, request_id_type &last_request_id);
+//  void restore_source(source_type const &, request_id_type &last_request_id);
+//navigate_source and restore_source must store the id of the request they create in
+//last_request_id before navigating. Navigating can raise TakeFocusRequested synchronously,
+//and that handler compares against the stored id.
+template <typename Platform>
+class island_focus_navigator
+{
+public:
+	using window_type = typename Platform::window_type;
+	using message_type = typename Platform::message_type;
+	using source_type = typename Platform::source_type;
+	using reason_type = typename Platform::reason_type;
+	using request_id_type = typename Platform::request_id_type;
+
+	explicit island_focus_navigator(Platform platform = {}) : m_platform(std::move(platform))
+	{
+	}
+
+	Platform &get_platform()
+	{
+		return m_platform;
+	}
+
+	//Gets the island that keyboard navigation from the message would move the focus to.
+	//The next control with the tab stop style is found the same way as for dialogs, if that
+	//control is one of the islands then that is the island returned.
+	source_type const *get_next_focused_island(window_type host, std::span<const source_type> sources, message_type const &msg)
+	{
+		const auto reason = m_platform.get_navigation_reason(msg);
+		if (!reason)
+		{
+			return nullptr;
+		}
+
+		const auto next_element = m_platform.get_next_tab_item(host, m_platform.get_focus(), m_platform.is_previous(*reason));
+		for (auto &source : sources)
+		{
+			if (m_platform.get_source_window(source) == next_element)
+			{
+				return &source;
+			}
+		}
+
+		return nullptr;
+	}
+
+	//Gets the island, if any, that has focus.
+	source_type const *get_focused_island(std::span<const source_type> sources)
+	{
+		for (auto &source : sources)
+		{
+			if (m_platform.source_has_focus(source))
+			{
+				return &source;
+			}
+		}
+
+		return nullptr;
+	}
+
+	//Moves focus between controls.
+	//If the next control is an island then the island is asked to take the focus. Otherwise,
+	//unless an island has the focus, the message goes through dialog navigation.
+	bool navigate_focus(window_type host, std::span<const source_type> sources, message_type &msg)
+	{
+		if (const auto next_focused_island = get_next_focused_island(host, sources, msg))
+		{
+			const auto reason = *m_platform.get_navigation_reason(msg);
+			const bool focus_moved = m_platform.navigate_source(*next_focused_island, reason, m_platform.get_focus(), m_last_request_id);
+			//NavigateFocus doesn't move the keyboard focus for the island's window, so that
+			//has to be done here. Without this the xaml content doesn't receive keyboard focus
+			//when pressing tab.
+			if (focus_moved)
+			{
+				m_platform.set_focus(m_platform.get_source_window(*next_focused_island));
+			}
+			return focus_moved;
+		}
+
+		//If an island has keyboard focus then the message is left to it, unless Alt is being
+		//held. This allows access to Windows API menu bars.
+		if (get_focused_island(sources) != nullptr && !m_platform.is_menu_modifier_down())
+		{
+			return false;
+		}
+
+		//The dialog keyboard navigation handles Tab, Shift+Tab and the cursor keys. It is
+		//documented to work on regular windows, not just dialog boxes.
+		return m_platform.is_dialog_message(host, msg);
+	}
+
+	//Handles an island asking to give up the focus, i.e. an island has focus and tab was pressed.
+	//If the request came from navigating into the island then the island keeps the focus.
+	void on_take_focus_requested(window_type host, std::span<const source_type> sources, source_type const &sender, reason_type reason, request_id_type const &request_id)
+	{
+		const auto sender_window = m_platform.get_source_window(sender);
+
+		if (request_id != m_last_request_id)
+		{
+			//Synthesise a key press in the requested direction to navigate.
+			auto msg = m_platform.make_navigation_message(sender_window, reason);
+			if (!navigate_focus(host, sources, msg))
+			{
+				//If that didn't move the focus, go to the next window with the tab stop style.
+				m_platform.set_focus(m_platform.get_next_tab_item(host, sender_window, m_platform.is_previous(reason)));
+			}
+		}
+		else
+		{
+			m_platform.restore_source(sender, m_last_request_id);
+			m_platform.set_focus(sender_window);
+		}
+	}
+
+	//Passes the message to each island in turn until one handles it.
+	bool pre_translate_message(std::span<const source_type> sources, message_type const &msg)
+	{
+		for (auto &source : sources)
+		{
+			if (m_platform.pre_translate_message(source, msg))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	Platform m_platform;
+	request_id_type m_last_request_id{};
+};
\ No newline at end of file
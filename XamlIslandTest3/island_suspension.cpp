@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "island_suspension.h"
+
+std::chrono::nanoseconds suspension_statistics::estimated_cpu_time_saved() const
+{
+	if (active_wall_time.count() <= 0)
+	{
+		return {};
+	}
+
+	//Scale the suspended wall time by the CPU usage ratio observed while active.
+	const double active_ratio = static_cast<double>(active_cpu_time.count()) / static_cast<double>(active_wall_time.count());
+	const auto would_have_used = std::chrono::nanoseconds(static_cast<int64_t>(suspended_wall_time.count() * active_ratio));
+	const auto saved = would_have_used - suspended_cpu_time;
+
+	return saved.count() > 0 ? saved : std::chrono::nanoseconds{};
+}
+
+island_suspension::island_suspension(suspension_policy const &policy) : m_policy(policy)
+{
+}
+
+suspension_transition island_suspension::process_event(suspension_event event, time_point now, std::chrono::nanoseconds cpu_time)
+{
+	//The time since the last event belongs to the state we were in before this event.
+	account_time(now, cpu_time);
+
+	const bool was_suspended = is_suspended();
+
+	switch (event)
+	{
+	case suspension_event::minimized:
+	{
+		set_reason(suspension_reason::minimized, m_policy.suspend_when_minimized);
+		break;
+	}
+	case suspension_event::restored:
+	{
+		//A window can't be occluded while it is being restored, the window manager
+		//brings it to the front.
+		set_reason(suspension_reason::minimized, false);
+		set_reason(suspension_reason::occluded, false);
+		break;
+	}
+	case suspension_event::occluded:
+	{
+		set_reason(suspension_reason::occluded, m_policy.suspend_when_occluded);
+		break;
+	}
+	case suspension_event::unoccluded:
+	{
+		set_reason(suspension_reason::occluded, false);
+		break;
+	}
+	case suspension_event::activated:
+	{
+		m_foreground = true;
+		set_reason(suspension_reason::idle, false);
+		//An active window is on top, so it can't be occluded either.
+		set_reason(suspension_reason::occluded, false);
+		break;
+	}
+	case suspension_event::deactivated:
+	{
+		if (m_foreground)
+		{
+			m_foreground = false;
+			m_background_since = now;
+		}
+		break;
+	}
+	case suspension_event::tick:
+	{
+		if (now >= idle_deadline())
+		{
+			set_reason(suspension_reason::idle, true);
+		}
+		break;
+	}
+	}
+
+	const bool suspended = is_suspended();
+	if (suspended == was_suspended)
+	{
+		return suspension_transition::none;
+	}
+
+	if (suspended)
+	{
+		++m_statistics.suspend_count;
+		return suspension_transition::suspend;
+	}
+
+	++m_statistics.resume_count;
+	return suspension_transition::resume;
+}
+
+bool island_suspension::is_suspended() const
+{
+	return m_reasons != 0;
+}
+
+bool island_suspension::is_hidden() const
+{
+	return (m_reasons & (static_cast<uint32_t>(suspension_reason::minimized) | static_cast<uint32_t>(suspension_reason::occluded))) != 0;
+}
+
+bool island_suspension::is_foreground() const
+{
+	return m_foreground;
+}
+
+uint32_t island_suspension::reasons() const
+{
+	return m_reasons;
+}
+
+island_suspension::time_point island_suspension::idle_deadline() const
+{
+	if (m_foreground || m_policy.background_idle_timeout.count() <= 0)
+	{
+		return time_point::max();
+	}
+
+	return m_background_since + m_policy.background_idle_timeout;
+}
+
+suspension_policy const &island_suspension::get_policy() const
+{
+	return m_policy;
+}
+
+void island_suspension::set_policy(suspension_policy const &policy)
+{
+	m_policy = policy;
+
+	//Drop any reason that the new policy no longer allows.
+	//Reasons that the new policy enables will be picked up with the next event.
+	if (!m_policy.suspend_when_minimized)
+	{
+		set_reason(suspension_reason::minimized, false);
+	}
+	if (!m_policy.suspend_when_occluded)
+	{
+		set_reason(suspension_reason::occluded, false);
+	}
+	if (m_policy.background_idle_timeout.count() <= 0)
+	{
+		set_reason(suspension_reason::idle, false);
+	}
+}
+
+void island_suspension::note_skipped_filter()
+{
+	++m_statistics.skipped_filter_calls;
+}
+
+suspension_statistics island_suspension::get_statistics(time_point now, std::chrono::nanoseconds cpu_time) const
+{
+	auto statistics = m_statistics;
+
+	//Include the interval that is still open.
+	if (m_started && now >= m_last_event_time)
+	{
+		add_interval(statistics, is_suspended(), now - m_last_event_time, cpu_time - m_last_cpu_time);
+	}
+
+	return statistics;
+}
+
+void island_suspension::set_reason(suspension_reason reason, bool set)
+{
+	if (set)
+	{
+		m_reasons |= static_cast<uint32_t>(reason);
+	}
+	else
+	{
+		m_reasons &= ~static_cast<uint32_t>(reason);
+	}
+}
+
+void island_suspension::account_time(time_point now, std::chrono::nanoseconds cpu_time)
+{
+	if (!m_started)
+	{
+		//The first event just establishes the baseline.
+		m_started = true;
+		m_background_since = now;
+	}
+	else if (now >= m_last_event_time)
+	{
+		add_interval(m_statistics, is_suspended(), now - m_last_event_time, cpu_time - m_last_cpu_time);
+	}
+
+	m_last_event_time = now;
+	m_last_cpu_time = cpu_time;
+}
+
+void island_suspension::add_interval(suspension_statistics &statistics, bool suspended, std::chrono::nanoseconds wall, std::chrono::nanoseconds cpu)
+{
+	//Clock granularity can make the CPU time go slightly backwards relative to the wall time.
+	if (cpu.count() < 0)
+	{
+		cpu = {};
+	}
+
+	if (suspended)
+	{
+		statistics.suspended_wall_time += wall;
+		statistics.suspended_cpu_time += cpu;
+	}
+	else
+	{
+		statistics.active_wall_time += wall;
+		statistics.active_cpu_time += cpu;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+
+//Events that drive the island suspension state machine.
+//window_base synthesises these from window messages, but the state machine itself
+//doesn't use the Windows API, so any stream of events can be fed into it.
+enum class suspension_event
+{
+	minimized,
+	restored,
+	occluded,
+	unoccluded,
+	activated,
+	deactivated,
+	//Periodic tick, used to detect that a background window has been idle for too long.
+	tick
+};
+
+//The reasons why islands are suspended.
+//These are bit flags, more than one reason can apply at any one time.
+enum class suspension_reason : uint32_t
+{
+	none = 0,
+	minimized = 1,
+	occluded = 2,
+	idle = 4
+};
+
+//What the owner of the state machine has to do as a result of an event.
+enum class suspension_transition
+{
+	none,
+	suspend,
+	resume
+};
+
+//Controls when islands get suspended.
+struct suspension_policy
+{
+	bool suspend_when_minimized = true;
+	bool suspend_when_occluded = true;
+	//How long a window has to be in the background before its islands are suspended.
+	//A zero timeout disables idle suspension, which is the default. An idle window is still on
+	//screen, so it is only paused and keeps its content, see island_suspension::is_hidden.
+	std::chrono::milliseconds background_idle_timeout{ 0 };
+};
+
+//Time accounting for the state machine.
+//The CPU times are whatever the owner passes in, normally the thread's CPU time.
+struct suspension_statistics
+{
+	uint64_t suspend_count = 0;
+	uint64_t resume_count = 0;
+	uint64_t skipped_filter_calls = 0;
+	std::chrono::nanoseconds active_wall_time{};
+	std::chrono::nanoseconds active_cpu_time{};
+	std::chrono::nanoseconds suspended_wall_time{};
+	std::chrono::nanoseconds suspended_cpu_time{};
+
+	//Estimates the CPU time saved by suspending.
+	//This assumes that, had the islands not been suspended, the thread would have used CPU
+	//at the same rate as it does while active.
+	std::chrono::nanoseconds estimated_cpu_time_saved() const;
+};
+
+//The state machine that decides when the xaml islands in a window are suspended.
+class island_suspension
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	explicit island_suspension(suspension_policy const & = {});
+
+	//Feeds an event into the state machine.
+	//now is the time that the event happened and cpu_time is the total CPU time used
+	//by the thread so far.
+	suspension_transition process_event(suspension_event, time_point now, std::chrono::nanoseconds cpu_time);
+
+	bool is_suspended() const;
+	//Returns true if the window can't be seen, so its islands can be hidden as well as paused.
+	//A window that is only idle isn't hidden.
+	bool is_hidden() const;
+	bool is_foreground() const;
+	uint32_t reasons() const;
+	//The time at which a background window will be considered idle.
+	//Returns time_point::max() if the idle timeout doesn't apply.
+	time_point idle_deadline() const;
+
+	suspension_policy const &get_policy() const;
+	void set_policy(suspension_policy const &);
+
+	//Records a PreTranslateMessage call that was skipped because the islands are suspended.
+	void note_skipped_filter();
+	//Gets the statistics, including the time since the last event.
+	suspension_statistics get_statistics(time_point now, std::chrono::nanoseconds cpu_time) const;
+
+private:
+	void set_reason(suspension_reason, bool);
+	void account_time(time_point now, std::chrono::nanoseconds cpu_time);
+	static void add_interval(suspension_statistics &, bool suspended, std::chrono::nanoseconds wall, std::chrono::nanoseconds cpu);
+
+	suspension_policy m_policy{};
+	uint32_t m_reasons = 0;
+	bool m_foreground = true;
+	bool m_started = false;
+	time_point m_background_since{};
+	time_point m_last_event_time{};
+	std::chrono::nanoseconds m_last_cpu_time{};
+	suspension_statistics m_statistics{};
+};
\ No newline at end of file
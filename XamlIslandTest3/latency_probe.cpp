@@ -0,0 +1,318 @@
+#include "pch.h"
+#include "latency_probe.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+std::string_view get_input_kind_name(input_kind kind)
+{
+	switch (kind)
+	{
+	case input_kind::key:
+		return "key";
+	case input_kind::character:
+		return "character";
+	case input_kind::mouse_button:
+		return "mouse_button";
+	case input_kind::mouse_wheel:
+		return "mouse_wheel";
+	case input_kind::pointer:
+		return "pointer";
+	case input_kind::kind_count:
+		break;
+	}
+	return "unknown";
+}
+
+std::string_view get_latency_stage_name(latency_stage stage)
+{
+	switch (stage)
+	{
+	case latency_stage::dequeued:
+		return "dequeued";
+	case latency_stage::filtered:
+		return "filtered";
+	case latency_stage::navigated:
+		return "navigated";
+	case latency_stage::take_focus:
+		return "take_focus";
+	case latency_stage::handled:
+		return "handled";
+	case latency_stage::stage_count:
+		break;
+	}
+	return "unknown";
+}
+
+//The names are ASCII, so they widen a character at a time.
+void append_name(std::wstring &text, std::string_view name)
+{
+	text.append(name.begin(), name.end());
+}
+
+std::wstring format_latency_span(latency_span const &span)
+{
+	std::wstring text;
+	append_name(text, get_input_kind_name(span.kind));
+	text.append(L" #");
+	text.append(std::to_wstring(span.id));
+	text.push_back(L':');
+
+	bool first = true;
+	for (size_t i = 0; i < latency_stage_count; ++i)
+	{
+		const auto stage = static_cast<latency_stage>(i);
+		if (!span.has_reached(stage))
+		{
+			continue;
+		}
+		text.append(first ? L" " : L", ");
+		first = false;
+		append_name(text, get_latency_stage_name(stage));
+		text.push_back(L' ');
+		text.append(std::to_wstring(std::chrono::duration_cast<std::chrono::microseconds>(span.get_latency(stage)).count()));
+		text.append(L"us");
+	}
+	return text;
+}
+
+size_t latency_histogram::get_bucket(uint64_t value)
+{
+	if (value < sub_bucket_count)
+	{
+		return static_cast<size_t>(value);
+	}
+
+	const auto exponent = static_cast<uint32_t>(std::bit_width(value)) - 1;
+	if (exponent > max_exponent)
+	{
+		return bucket_count - 1;
+	}
+	const auto shift = exponent - sub_bucket_bits;
+	const auto sub_bucket = static_cast<size_t>((value >> shift) & (sub_bucket_count - 1));
+	return (exponent - sub_bucket_bits + 1) * sub_bucket_count + sub_bucket;
+}
+
+uint64_t latency_histogram::get_bucket_start(size_t bucket)
+{
+	const auto group = static_cast<uint32_t>(bucket / sub_bucket_count);
+	const auto sub_bucket = static_cast<uint64_t>(bucket % sub_bucket_count);
+	if (group == 0)
+	{
+		return sub_bucket;
+	}
+	return (sub_bucket_count + sub_bucket) << (group - 1);
+}
+
+uint64_t latency_histogram::get_bucket_width(size_t bucket)
+{
+	const auto group = static_cast<uint32_t>(bucket / sub_bucket_count);
+	return group == 0 ? 1 : uint64_t{ 1 } << (group - 1);
+}
+
+void latency_histogram::record(std::chrono::microseconds latency)
+{
+	//The input time is only as precise as the system tick, so it can land after a stage.
+	const auto value = static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(latency.count(), 0));
+	++m_buckets[get_bucket(value)];
+	++m_count;
+	m_max = std::max(m_max, value);
+}
+
+void latency_histogram::clear()
+{
+	m_buckets.fill(0);
+	m_count = 0;
+	m_max = 0;
+}
+
+uint64_t latency_histogram::get_count() const
+{
+	return m_count;
+}
+
+std::chrono::microseconds latency_histogram::get_max() const
+{
+	return std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(m_max));
+}
+
+std::chrono::microseconds latency_histogram::get_percentile(double fraction) const
+{
+	if (m_count == 0)
+	{
+		return {};
+	}
+
+	//The rank of the value, counting from 1.
+	const auto rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(m_count))), 1, m_count);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < bucket_count; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+		{
+			const auto middle = get_bucket_start(i) + get_bucket_width(i) / 2;
+			return std::chrono::microseconds(static_cast<std::chrono::microseconds::rep>(std::min(middle, m_max)));
+		}
+	}
+	return get_max();
+}
+
+latency_probe::latency_probe(std::chrono::milliseconds correlation_window) : m_correlation_window(correlation_window), m_histograms(input_kind_count * latency_stage_count)
+{
+}
+
+uint64_t latency_probe::begin(input_kind kind, clock::time_point input_time, clock::time_point dequeue_time)
+{
+	latency_span span{};
+	span.id = m_next_id++;
+	span.kind = kind;
+	span.input_time = std::min(input_time, dequeue_time);
+	span.stage_times[static_cast<size_t>(latency_stage::dequeued)] = dequeue_time;
+	span.reached = 1u << static_cast<unsigned>(latency_stage::dequeued);
+	m_open.push_back(span);
+	m_dispatching = true;
+	++m_counters.interactions;
+	return span.id;
+}
+
+//Only the newest interaction takes stages, anything that runs after the next input message
+//has been dequeued is more likely to be caused by that message.
+latency_span *latency_probe::find_target(clock::time_point time)
+{
+	if (m_open.empty())
+	{
+		return nullptr;
+	}
+
+	auto &newest = m_open.back();
+	if (m_dispatching)
+	{
+		return &newest;
+	}
+	if (time - newest.stage_times[static_cast<size_t>(latency_stage::dequeued)] > m_correlation_window)
+	{
+		return nullptr;
+	}
+	return &newest;
+}
+
+void latency_probe::mark(latency_stage stage, clock::time_point time)
+{
+	auto span = find_target(time);
+	if (!span)
+	{
+		++m_counters.unattributed_stages;
+		return;
+	}
+	if (span->has_reached(stage))
+	{
+		++m_counters.repeated_stages;
+		return;
+	}
+	span->stage_times[static_cast<size_t>(stage)] = time;
+	span->reached |= 1u << static_cast<unsigned>(stage);
+}
+
+void latency_probe::end_dispatch()
+{
+	m_dispatching = false;
+}
+
+void latency_probe::finish(latency_span const &span, span_callback const &callback)
+{
+	for (size_t i = 0; i < latency_stage_count; ++i)
+	{
+		const auto stage = static_cast<latency_stage>(i);
+		if (span.has_reached(stage))
+		{
+			get_histogram(span.kind, stage).record(std::chrono::duration_cast<std::chrono::microseconds>(span.get_latency(stage)));
+		}
+	}
+	if (callback)
+	{
+		callback(span);
+	}
+}
+
+size_t latency_probe::collect(clock::time_point now, span_callback const &callback)
+{
+	size_t finished = 0;
+	while (!m_open.empty())
+	{
+		auto &oldest = m_open.front();
+		const bool is_newest = m_open.size() == 1;
+		//Older interactions can't be given any more stages, so they are done.
+		if (is_newest && (m_dispatching || now - oldest.stage_times[static_cast<size_t>(latency_stage::dequeued)] <= m_correlation_window))
+		{
+			break;
+		}
+		finish(oldest, callback);
+		m_open.pop_front();
+		++finished;
+	}
+	return finished;
+}
+
+size_t latency_probe::flush(span_callback const &callback)
+{
+	const auto finished = m_open.size();
+	for (auto &span : m_open)
+	{
+		finish(span, callback);
+	}
+	m_open.clear();
+	m_dispatching = false;
+	return finished;
+}
+
+bool latency_probe::has_open_interactions() const
+{
+	return !m_open.empty();
+}
+
+latency_histogram &latency_probe::get_histogram(input_kind kind, latency_stage stage)
+{
+	return m_histograms[static_cast<size_t>(kind) * latency_stage_count + static_cast<size_t>(stage)];
+}
+
+latency_histogram const &latency_probe::get_histogram(input_kind kind, latency_stage stage) const
+{
+	return m_histograms[static_cast<size_t>(kind) * latency_stage_count + static_cast<size_t>(stage)];
+}
+
+latency_summary latency_probe::get_summary(input_kind kind, latency_stage stage) const
+{
+	auto &histogram = get_histogram(kind, stage);
+	latency_summary summary{};
+	summary.count = histogram.get_count();
+	summary.p50 = histogram.get_percentile(0.5);
+	summary.p90 = histogram.get_percentile(0.9);
+	summary.p99 = histogram.get_percentile(0.99);
+	summary.max = histogram.get_max();
+	return summary;
+}
+
+std::vector<latency_report_row> latency_probe::get_report() const
+{
+	std::vector<latency_report_row> rows;
+	for (size_t k = 0; k < input_kind_count; ++k)
+	{
+		for (size_t s = 0; s < latency_stage_count; ++s)
+		{
+			const auto kind = static_cast<input_kind>(k);
+			const auto stage = static_cast<latency_stage>(s);
+			if (get_histogram(kind, stage).get_count() != 0)
+			{
+				rows.push_back(latency_report_row{ kind, stage, get_summary(kind, stage) });
+			}
+		}
+	}
+	return rows;
+}
+
+latency_probe_counters const &latency_probe::get_counters() const
+{
+	return m_counters;
+}
\ No newline at end of file
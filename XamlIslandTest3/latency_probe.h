@@ -0,0 +1,191 @@
+#pragma once
+
+#ifndef _ARRAY_
+#include <array>
+#endif
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+#include <deque>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Follows input messages from the time they were generated to the handler that finally reacts
+//to them, and keeps latency percentiles for each kind of input.
+//Each input message opens an interaction, and each stage that the message goes through stamps
+//the interaction with the time it was reached. Stages that run after the message has been
+//dispatched, such as a Click that xaml raises later, are given to the most recent interaction.
+//This only uses the standard library, the caller supplies the times.
+
+enum class input_kind : uint8_t
+{
+	key,
+	character,
+	mouse_button,
+	mouse_wheel,
+	pointer,
+	kind_count
+};
+
+//The stages in the order that a message normally reaches them.
+enum class latency_stage : uint8_t
+{
+	//Removed from the message queue by the pump.
+	dequeued,
+	//The xaml sources have seen the message.
+	filtered,
+	//Keyboard navigation has seen the message.
+	navigated,
+	//An island asked the host to take focus.
+	take_focus,
+	//The handler that the input was meant for ran, such as a button's Click.
+	handled,
+	stage_count
+};
+
+constexpr size_t input_kind_count = static_cast<size_t>(input_kind::kind_count);
+constexpr size_t latency_stage_count = static_cast<size_t>(latency_stage::stage_count);
+
+std::string_view get_input_kind_name(input_kind);
+std::string_view get_latency_stage_name(latency_stage);
+
+//One input message and the stages that it reached.
+struct latency_span
+{
+	using clock = std::chrono::steady_clock;
+
+	uint64_t id = 0;
+	input_kind kind = input_kind::key;
+	//When the input was generated. This comes from the message, so it is only as precise as the
+	//system tick.
+	clock::time_point input_time{};
+	std::array<clock::time_point, latency_stage_count> stage_times{};
+	uint8_t reached = 0;
+
+	bool has_reached(latency_stage stage) const
+	{
+		return (reached & (1u << static_cast<unsigned>(stage))) != 0;
+	}
+
+	//The time from the input to the stage.
+	clock::duration get_latency(latency_stage stage) const
+	{
+		return stage_times[static_cast<size_t>(stage)] - input_time;
+	}
+};
+
+//Lists the stages that the span reached, with their latency in microseconds.
+std::wstring format_latency_span(latency_span const &);
+
+//A histogram with buckets that grow with the value, so that every bucket is within about 6% of
+//the values in it. Values are in microseconds, and anything past about 12 days goes in the
+//last bucket.
+class latency_histogram
+{
+public:
+	void record(std::chrono::microseconds);
+	void clear();
+
+	uint64_t get_count() const;
+	std::chrono::microseconds get_max() const;
+	//The value that the fraction of the recorded values are at or below, as the middle of its
+	//bucket. The fraction is from 0 to 1.
+	std::chrono::microseconds get_percentile(double) const;
+
+private:
+	static constexpr uint32_t sub_bucket_bits = 4;
+	static constexpr uint32_t sub_bucket_count = 1u << sub_bucket_bits;
+	static constexpr uint32_t max_exponent = 40;
+	//Values below the sub bucket count have a bucket each, then each power of two is split into
+	//the same number of buckets.
+	static constexpr size_t bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+
+	static size_t get_bucket(uint64_t);
+	static uint64_t get_bucket_start(size_t);
+	static uint64_t get_bucket_width(size_t);
+
+	std::array<uint32_t, bucket_count> m_buckets{};
+	uint64_t m_count = 0;
+	uint64_t m_max = 0;
+};
+
+struct latency_summary
+{
+	uint64_t count = 0;
+	std::chrono::microseconds p50{};
+	std::chrono::microseconds p90{};
+	std::chrono::microseconds p99{};
+	std::chrono::microseconds max{};
+};
+
+struct latency_report_row
+{
+	input_kind kind = input_kind::key;
+	latency_stage stage = latency_stage::dequeued;
+	latency_summary summary;
+};
+
+struct latency_probe_counters
+{
+	uint64_t interactions = 0;
+	//Stages that were stamped while there was no interaction to give them to.
+	uint64_t unattributed_stages = 0;
+	//Stages that were stamped again for an interaction that had already reached them, only the
+	//first time is kept.
+	uint64_t repeated_stages = 0;
+};
+
+//Correlates the stages into interactions and aggregates the finished interactions.
+//This is not thread safe, every stage runs on the UI thread.
+class latency_probe
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using span_callback = std::function<void(latency_span const &)>;
+
+	//Stages that are stamped longer than the window after an interaction was dequeued aren't
+	//given to it.
+	explicit latency_probe(std::chrono::milliseconds correlation_window = std::chrono::milliseconds(250));
+
+	//Opens an interaction for an input message and makes it the active one.
+	uint64_t begin(input_kind, clock::time_point input_time, clock::time_point dequeue_time);
+	//Stamps the stage on the active interaction, or if there isn't one, on the most recent
+	//interaction that is still within the window.
+	void mark(latency_stage, clock::time_point);
+	//The message has been dispatched. The interaction stays open for stages that run later.
+	void end_dispatch();
+	//Finishes the interactions that are outside of the window, adds them to the histograms and
+	//passes each of them to the callback.
+	size_t collect(clock::time_point now, span_callback const & = {});
+	//Finishes every interaction regardless of the window.
+	size_t flush(span_callback const & = {});
+
+	bool has_open_interactions() const;
+	latency_summary get_summary(input_kind, latency_stage) const;
+	//A row for each kind and stage that has recorded anything.
+	std::vector<latency_report_row> get_report() const;
+	latency_probe_counters const &get_counters() const;
+
+private:
+	latency_span *find_target(clock::time_point);
+	void finish(latency_span const &, span_callback const &);
+	latency_histogram &get_histogram(input_kind, latency_stage);
+	latency_histogram const &get_histogram(input_kind, latency_stage) const;
+
+	std::chrono::milliseconds m_correlation_window;
+	//Open interactions, oldest first.
+	std::deque<latency_span> m_open;
+	bool m_dispatching = false;
+	uint64_t m_next_id = 1;
+	std::vector<latency_histogram> m_histograms;
+	latency_probe_counters m_counters{};
+};
\ No newline at end of file
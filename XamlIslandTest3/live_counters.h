@@ -0,0 +1,357 @@
+#pragma once
+
+#ifndef _ARRAY_
+#include <array>
+#endif
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <string_view>
+#include <utility>
+
+//Counters that the island host publishes into a named shared memory region, so that they can be
+//watched from outside the process without attaching a debugger.
+//This is shared between the application, which writes the counters, and XamlIslandCounters,
+//which reads them. It only uses the standard library, creating and opening the region is
+//left to the caller.
+//
+//The region is a header followed by a fixed number of slots. Each thread that publishes claims
+//a slot of its own, so writers never share a cache line. A slot is guarded by a sequence number
+//that is odd while its owner is writing, a reader copies the slot and tries again if the
+//sequence changed, so each slot is read as it was between two writes.
+
+constexpr uint32_t live_counters_magic = 0x43495358; //XSIC
+constexpr uint32_t live_counters_version = 1;
+constexpr uint32_t live_counters_slot_count = 32;
+constexpr size_t live_counters_cache_line = 64;
+
+//The region is named with this followed by the process id.
+constexpr std::wstring_view live_counters_name_prefix = L"Local\\XamlIslandTest3.Counters.";
+
+//New counters go at the end, readers only read the counters they know about.
+enum class live_counter : uint32_t
+{
+	pump_iterations,
+	messages_dispatched,
+	//The number of messages handled in the most recent pump iteration.
+	pump_depth,
+	islands,
+	filter_calls,
+	filter_hits,
+	focus_navigations,
+	focus_navigations_handled,
+	xaml_type_lookups,
+	xaml_type_table_hits,
+	//Completions from the background executor that the pump has run.
+	executor_completions,
+	//Tasks waiting in the background executor's deques.
+	executor_queue_depth,
+	//Heap allocations made on the pump's thread while handling messages.
+	pump_heap_allocations,
+	//The bytes that the last pump iteration used from the frame arena.
+	frame_arena_bytes,
+	//The bytes held by the caches and pools that the memory governor looks after.
+	governed_memory_bytes,
+	counter_count
+};
+
+constexpr size_t live_counter_count = static_cast<size_t>(live_counter::counter_count);
+
+constexpr std::string_view live_counter_names[] =
+{
+	"pump_iterations",
+	"messages_dispatched",
+	"pump_depth",
+	"islands",
+	"filter_calls",
+	"filter_hits",
+	"focus_navigations",
+	"focus_navigations_handled",
+	"xaml_type_lookups",
+	"xaml_type_table_hits",
+	"executor_completions",
+	"executor_queue_depth",
+	"pump_heap_allocations",
+	"frame_arena_bytes",
+	"governed_memory_bytes"
+};
+static_assert(std::size(live_counter_names) == live_counter_count, "every live_counter needs a name");
+
+//Totals only go up and are summed over the slots.
+//Gauges are also summed, but they go up and down, so they are read as signed values.
+enum class live_counter_kind
+{
+	total,
+	gauge
+};
+
+constexpr live_counter_kind get_live_counter_kind(live_counter counter)
+{
+	switch (counter)
+	{
+	case live_counter::pump_depth:
+	case live_counter::islands:
+	case live_counter::executor_queue_depth:
+	case live_counter::frame_arena_bytes:
+	case live_counter::governed_memory_bytes:
+		return live_counter_kind::gauge;
+	default:
+		return live_counter_kind::total;
+	}
+}
+
+struct alignas(live_counters_cache_line) live_counters_header
+{
+	//Written last, so a reader that sees it also sees the rest of the header.
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	uint32_t counter_count;
+	uint32_t process_id;
+	//Threads that found every slot taken, what they publish is lost.
+	std::atomic<uint32_t> slots_exhausted;
+};
+
+struct alignas(live_counters_cache_line) live_counters_slot
+{
+	std::atomic<uint32_t> sequence;
+	//The id of the thread that owns the slot, or 0 if it is free.
+	std::atomic<uint32_t> owner;
+	std::atomic<uint64_t> values[live_counter_count];
+};
+
+//The region is shared between 32 and 64 bit processes, so the layout can't depend on either.
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free, "the counters must be lock free to be shared between processes");
+static_assert(sizeof(std::atomic<uint64_t>) == 8 && alignof(std::atomic<uint64_t>) == 8, "the layout needs 8 byte counters");
+static_assert(sizeof(live_counters_header) == live_counters_cache_line, "the header is one cache line");
+static_assert(offsetof(live_counters_slot, values) == 8 && sizeof(live_counters_slot) % live_counters_cache_line == 0, "slots are padded to whole cache lines");
+
+constexpr size_t live_counters_region_size = sizeof(live_counters_header) + live_counters_slot_count * sizeof(live_counters_slot);
+
+//Sets up the header of a new region.
+//The memory must be zeroed, as new mappings are, and aligned to a cache line.
+inline void initialise_live_counters(void *region, uint32_t process_id)
+{
+	auto header = new (region) live_counters_header{};
+	header->version = live_counters_version;
+	header->header_size = sizeof(live_counters_header);
+	header->slot_size = sizeof(live_counters_slot);
+	header->slot_count = live_counters_slot_count;
+	header->counter_count = static_cast<uint32_t>(live_counter_count);
+	header->process_id = process_id;
+	for (uint32_t i = 0; i < live_counters_slot_count; ++i)
+	{
+		new (static_cast<std::byte *>(region) + sizeof(live_counters_header) + i * sizeof(live_counters_slot)) live_counters_slot{};
+	}
+	header->magic.store(live_counters_magic, std::memory_order_release);
+}
+
+//Publishes counters into a slot for one thread.
+//This is not thread safe, each thread has its own writer.
+class live_counters_writer
+{
+public:
+	live_counters_writer() = default;
+	//Claims a free slot for the thread. If every slot is taken then nothing is published.
+	//The slot keeps its values when it is released, so totals carry on from where the last
+	//owner left them.
+	live_counters_writer(void *region, uint32_t thread_id)
+	{
+		if (!region)
+		{
+			return;
+		}
+
+		auto header = static_cast<live_counters_header *>(region);
+		auto slots = reinterpret_cast<live_counters_slot *>(static_cast<std::byte *>(region) + sizeof(live_counters_header));
+		for (uint32_t i = 0; i < live_counters_slot_count; ++i)
+		{
+			uint32_t free_slot = 0;
+			if (slots[i].owner.compare_exchange_strong(free_slot, thread_id, std::memory_order_acq_rel))
+			{
+				m_slot = &slots[i];
+				return;
+			}
+		}
+		header->slots_exhausted.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	~live_counters_writer()
+	{
+		if (m_slot)
+		{
+			m_slot->owner.store(0, std::memory_order_release);
+		}
+	}
+
+	live_counters_writer(live_counters_writer const &) = delete;
+	live_counters_writer &operator=(live_counters_writer const &) = delete;
+
+	void add(live_counter counter, int64_t delta = 1)
+	{
+		add({ { counter, delta } });
+	}
+
+	//Applies all of the changes in one write, so a reader sees either all of them or none of them.
+	void add(std::initializer_list<std::pair<live_counter, int64_t>> changes)
+	{
+		if (!m_slot)
+		{
+			return;
+		}
+
+		begin_write();
+		for (auto &[counter, delta] : changes)
+		{
+			auto &value = m_slot->values[static_cast<size_t>(counter)];
+			value.store(value.load(std::memory_order_relaxed) + static_cast<uint64_t>(delta), std::memory_order_relaxed);
+		}
+		end_write();
+	}
+
+	void set(live_counter counter, uint64_t value)
+	{
+		if (!m_slot)
+		{
+			return;
+		}
+
+		begin_write();
+		m_slot->values[static_cast<size_t>(counter)].store(value, std::memory_order_relaxed);
+		end_write();
+	}
+
+	bool has_slot() const
+	{
+		return m_slot != nullptr;
+	}
+
+private:
+	//Only the owner writes the sequence, so it doesn't need a read-modify-write.
+	//The fence keeps the value stores from being seen before the sequence goes odd.
+	void begin_write()
+	{
+		m_slot->sequence.store(m_slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void end_write()
+	{
+		m_slot->sequence.store(m_slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	live_counters_slot *m_slot = nullptr;
+};
+
+enum class live_counters_read_result
+{
+	ok,
+	too_small,
+	bad_magic,
+	unsupported_version,
+	bad_layout
+};
+
+struct live_counters_snapshot
+{
+	uint32_t version = 0;
+	uint32_t process_id = 0;
+	uint32_t slots_in_use = 0;
+	uint32_t slots_exhausted = 0;
+	//Counters from a newer writer that this reader doesn't know about are left out.
+	std::array<uint64_t, live_counter_count> values{};
+	//The number of times a slot had to be read again because its owner was writing to it.
+	uint32_t retries = 0;
+	//Slots that were still being written to after every retry, and weren't counted.
+	uint32_t slots_skipped = 0;
+
+	uint64_t get_total(live_counter counter) const
+	{
+		return values[static_cast<size_t>(counter)];
+	}
+
+	int64_t get_gauge(live_counter counter) const
+	{
+		return static_cast<int64_t>(values[static_cast<size_t>(counter)]);
+	}
+};
+
+//Reads every slot and sums the counters.
+//Each slot is consistent on its own, but the slots are read one after another, so the snapshot
+//as a whole isn't from a single point in time.
+inline live_counters_read_result read_live_counters(void const *region, size_t size, live_counters_snapshot &snapshot, uint32_t max_retries = 64)
+{
+	if (size < sizeof(live_counters_header))
+	{
+		return live_counters_read_result::too_small;
+	}
+
+	auto header = static_cast<live_counters_header const *>(region);
+	if (header->magic.load(std::memory_order_acquire) != live_counters_magic)
+	{
+		return live_counters_read_result::bad_magic;
+	}
+	if (header->version != live_counters_version)
+	{
+		return live_counters_read_result::unsupported_version;
+	}
+	//A newer writer may have bigger records, but never smaller ones.
+	if (header->header_size < sizeof(live_counters_header) || header->slot_size < sizeof(live_counters_slot) || header->slot_size % live_counters_cache_line != 0 || header->counter_count < live_counter_count)
+	{
+		return live_counters_read_result::bad_layout;
+	}
+	if (header->slot_count > (size - header->header_size) / header->slot_size)
+	{
+		return live_counters_read_result::too_small;
+	}
+
+	snapshot = {};
+	snapshot.version = header->version;
+	snapshot.process_id = header->process_id;
+	snapshot.slots_exhausted = header->slots_exhausted.load(std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < header->slot_count; ++i)
+	{
+		auto &slot = *reinterpret_cast<live_counters_slot const *>(static_cast<std::byte const *>(region) + header->header_size + static_cast<size_t>(i) * header->slot_size);
+
+		std::array<uint64_t, live_counter_count> values{};
+		bool consistent = false;
+		for (uint32_t attempt = 0; attempt <= max_retries && !consistent; ++attempt)
+		{
+			const auto before = slot.sequence.load(std::memory_order_acquire);
+			if ((before & 1) == 0)
+			{
+				for (size_t c = 0; c < live_counter_count; ++c)
+				{
+					values[c] = slot.values[c].load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				consistent = slot.sequence.load(std::memory_order_relaxed) == before;
+			}
+			if (!consistent)
+			{
+				++snapshot.retries;
+			}
+		}
+
+		if (!consistent)
+		{
+			++snapshot.slots_skipped;
+			continue;
+		}
+		if (slot.owner.load(std::memory_order_relaxed) != 0)
+		{
+			++snapshot.slots_in_use;
+		}
+		for (size_t c = 0; c < live_counter_count; ++c)
+		{
+			snapshot.values[c] += values[c];
+		}
+	}
+
+	return live_counters_read_result::ok;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "live_counters_region.h"
+
+//The region is never unmapped. Thread pool threads can still publish while static objects are
+//being destroyed, and the mapping goes away with the process anyway.
+void *get_live_counters_region()
+{
+	static void *const region = []() -> void *
+		{
+			const auto process_id = GetCurrentProcessId();
+			const auto name = std::wstring(live_counters_name_prefix) + std::to_wstring(process_id);
+
+			HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(live_counters_region_size), name.c_str());
+			if (!mapping)
+			{
+				return nullptr;
+			}
+			//A reader can keep the region of an earlier process with the same id open.
+			const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+			auto view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, live_counters_region_size);
+			if (!view)
+			{
+				CloseHandle(mapping);
+				return nullptr;
+			}
+			if (existed)
+			{
+				ZeroMemory(view, live_counters_region_size);
+			}
+
+			initialise_live_counters(view, process_id);
+			return view;
+		}();
+	return region;
+}
+
+//The slot is claimed the first time the thread publishes, and released when the thread exits.
+live_counters_writer &get_thread_counters()
+{
+	thread_local live_counters_writer writer(get_live_counters_region(), GetCurrentThreadId());
+	return writer;
+}
+
+void publish_counter(live_counter counter, int64_t delta)
+{
+	get_thread_counters().add(counter, delta);
+}
+
+void publish_counters(std::initializer_list<std::pair<live_counter, int64_t>> changes)
+{
+	get_thread_counters().add(changes);
+}
+
+void publish_gauge(live_counter counter, uint64_t value)
+{
+	get_thread_counters().set(counter, value);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+#include "live_counters.h"
+
+//Publishing live counters from the application.
+//The region is created the first time anything is published, and named after the process id
+//so that XamlIslandCounters can find it. Each thread publishes into its own slot.
+
+//Adds to a counter from the calling thread.
+void publish_counter(live_counter, int64_t delta = 1);
+//Adds to several counters at once, readers see either all of the changes or none of them.
+void publish_counters(std::initializer_list<std::pair<live_counter, int64_t>>);
+//Sets the calling thread's share of a gauge.
+void publish_gauge(live_counter, uint64_t);
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "log_file.h"
+
+rotating_log_file::rotating_log_file(std::filesystem::path path, uint64_t max_bytes, uint32_t max_files) : m_path(std::move(path)), m_max_bytes(max_bytes), m_max_files(max_files)
+{
+	m_line.reserve(512);
+}
+
+void rotating_log_file::write_line(std::wstring_view text)
+{
+	m_line.clear();
+	append_utf8(m_line, text);
+	m_line.push_back('\n');
+
+	if (m_file.is_open() && m_file_size != 0 && m_file_size + m_line.size() > m_max_bytes)
+	{
+		rotate();
+	}
+	if (!m_file.is_open() && !open())
+	{
+		return;
+	}
+
+	m_file.write(m_line.data(), static_cast<std::streamsize>(m_line.size()));
+	if (!m_file)
+	{
+		++m_counters.failures;
+		m_file.clear();
+		return;
+	}
+	m_file_size += m_line.size();
+	m_counters.bytes += m_line.size();
+}
+
+void rotating_log_file::flush()
+{
+	if (m_file.is_open())
+	{
+		m_file.flush();
+	}
+}
+
+void rotating_log_file::close()
+{
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+}
+
+log_file_counters const &rotating_log_file::get_counters() const
+{
+	return m_counters;
+}
+
+std::filesystem::path const &rotating_log_file::get_path() const
+{
+	return m_path;
+}
+
+//Appends to a file left over from an earlier run, so its size counts towards the limit.
+bool rotating_log_file::open()
+{
+	std::error_code ec;
+	if (m_path.has_parent_path())
+	{
+		std::filesystem::create_directories(m_path.parent_path(), ec);
+	}
+
+	m_file.open(m_path, std::ios::binary | std::ios::app);
+	if (!m_file.is_open())
+	{
+		++m_counters.failures;
+		return false;
+	}
+
+	const auto size = std::filesystem::file_size(m_path, ec);
+	m_file_size = ec ? 0 : size;
+	return true;
+}
+
+void rotating_log_file::rotate()
+{
+	close();
+
+	std::error_code ec;
+	if (m_max_files == 0)
+	{
+		std::filesystem::remove(m_path, ec);
+	}
+	else
+	{
+		//Shift the old files up by one, the oldest drops off the end.
+		std::filesystem::remove(get_rotated_path(m_max_files), ec);
+		for (auto index = m_max_files; index > 1; --index)
+		{
+			const auto from = get_rotated_path(index - 1);
+			if (std::filesystem::exists(from, ec))
+			{
+				std::filesystem::rename(from, get_rotated_path(index), ec);
+			}
+		}
+		std::filesystem::rename(m_path, get_rotated_path(1), ec);
+	}
+
+	if (ec)
+	{
+		++m_counters.failures;
+	}
+	++m_counters.rotations;
+	m_file_size = 0;
+}
+
+std::filesystem::path rotating_log_file::get_rotated_path(uint32_t index) const
+{
+	auto file_name = m_path.stem();
+	file_name += L"." + std::to_wstring(index);
+	file_name += m_path.extension();
+	return m_path.parent_path() / file_name;
+}
+
+void append_utf8(std::string &output, std::wstring_view text)
+{
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		auto code_point = static_cast<uint32_t>(text[i]);
+
+		//Only matters where wchar_t is UTF-16.
+		if constexpr (sizeof(wchar_t) == 2)
+		{
+			if (code_point >= 0xD800 && code_point <= 0xDBFF && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+			{
+				code_point = 0x10000 + ((code_point - 0xD800) << 10) + (static_cast<uint32_t>(text[i + 1]) - 0xDC00);
+				++i;
+			}
+		}
+		if ((code_point >= 0xD800 && code_point <= 0xDFFF) || code_point > 0x10FFFF)
+		{
+			code_point = 0xFFFD;
+		}
+
+		if (code_point < 0x80)
+		{
+			output.push_back(static_cast<char>(code_point));
+		}
+		else if (code_point < 0x800)
+		{
+			output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+		else if (code_point < 0x10000)
+		{
+			output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+		else
+		{
+			output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+			output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+			output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#ifndef _FILESYSTEM_
+#include <filesystem>
+#endif
+#include <fstream>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+
+//Counters for rotating_log_file.
+struct log_file_counters
+{
+	uint64_t bytes = 0;
+	uint64_t rotations = 0;
+	//Failures to open, write or rotate. Lines written while the file can't be opened are lost.
+	uint64_t failures = 0;
+};
+
+//A text log file that is moved aside once it reaches a size limit.
+//When the file at path fills up, it is renamed to stem.1.ext, the old stem.1.ext becomes stem.2.ext
+//and so on. Only max_files old files are kept.
+//Lines are written as UTF-8. Nothing here throws, failures are counted instead, logging
+//shouldn't be what takes the application down.
+class rotating_log_file
+{
+public:
+	rotating_log_file(std::filesystem::path path, uint64_t max_bytes, uint32_t max_files);
+
+	//Writes the line followed by a line break.
+	void write_line(std::wstring_view);
+	void flush();
+	void close();
+
+	log_file_counters const &get_counters() const;
+	std::filesystem::path const &get_path() const;
+
+private:
+	bool open();
+	void rotate();
+	std::filesystem::path get_rotated_path(uint32_t index) const;
+
+	std::filesystem::path m_path;
+	uint64_t m_max_bytes;
+	uint32_t m_max_files;
+	std::ofstream m_file;
+	//The size of the current file.
+	uint64_t m_file_size = 0;
+	//The UTF-8 text of the line being written, kept to avoid allocating for each line.
+	std::string m_line;
+	log_file_counters m_counters{};
+};
+
+//Appends the wide text to the string as UTF-8.
+//Unpaired surrogates become U+FFFD.
+void append_utf8(std::string &, std::wstring_view);
\ No newline at end of file
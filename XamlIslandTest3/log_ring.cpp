@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "log_ring.h"
+
+#include <algorithm>
+
+log_record_builder::log_record_builder(log_level level, uint16_t format_id, int64_t timestamp)
+{
+	header record_header{};
+	record_header.timestamp = timestamp;
+	record_header.format_id = format_id;
+	record_header.level = level;
+	append(&record_header, sizeof(record_header));
+}
+
+std::span<const std::byte> log_record_builder::get_record()
+{
+	//The argument count is only known at the end.
+	std::memcpy(m_data + offsetof(header, argument_count), &m_argument_count, sizeof(m_argument_count));
+	return std::span<const std::byte>(m_data, m_size);
+}
+
+void log_record_builder::add_signed(int64_t value)
+{
+	if (begin_argument(argument_kind::signed_integer, sizeof(value)))
+	{
+		append(&value, sizeof(value));
+	}
+}
+
+void log_record_builder::add_unsigned(uint64_t value)
+{
+	if (begin_argument(argument_kind::unsigned_integer, sizeof(value)))
+	{
+		append(&value, sizeof(value));
+	}
+}
+
+void log_record_builder::add_wide_text(std::wstring_view text)
+{
+	//Text is cut short to whatever fits, but always has at least its length.
+	const auto available = max_log_record_size - std::min(max_log_record_size, m_size + 1 + sizeof(uint16_t));
+	const auto length = static_cast<uint16_t>(std::min<size_t>({ text.size(), available / sizeof(wchar_t), 0xFFFF }));
+	if (begin_argument(argument_kind::wide_text, sizeof(length)))
+	{
+		append(&length, sizeof(length));
+		append(text.data(), length * sizeof(wchar_t));
+	}
+}
+
+void log_record_builder::add_narrow_text(std::string_view text)
+{
+	const auto available = max_log_record_size - std::min(max_log_record_size, m_size + 1 + sizeof(uint16_t));
+	const auto length = static_cast<uint16_t>(std::min<size_t>({ text.size(), available, 0xFFFF }));
+	if (begin_argument(argument_kind::narrow_text, sizeof(length)))
+	{
+		append(&length, sizeof(length));
+		append(text.data(), length);
+	}
+}
+
+//Arguments that don't fit at all are left out, the formatter fills them in as empty.
+bool log_record_builder::begin_argument(argument_kind kind, size_t value_size)
+{
+	if (m_size + 1 + value_size > max_log_record_size || m_argument_count == 0xFF)
+	{
+		return false;
+	}
+
+	append(&kind, 1);
+	++m_argument_count;
+	return true;
+}
+
+void log_record_builder::append(void const *data, size_t size)
+{
+	std::memcpy(m_data + m_size, data, size);
+	m_size += size;
+}
+
+bool decode_log_record(std::span<const std::byte> record, decoded_log_record &decoded)
+{
+	using argument_kind = log_record_builder::argument_kind;
+	using format_argument = format_buffer::format_argument;
+
+	decoded.arguments.clear();
+	decoded.widened_text.clear();
+
+	if (record.size() < sizeof(decoded.header))
+	{
+		return false;
+	}
+	std::memcpy(&decoded.header, record.data(), sizeof(decoded.header));
+	size_t offset = sizeof(decoded.header);
+
+	//Reserved up front so that the views into the widened text stay valid.
+	decoded.widened_text.reserve(decoded.header.argument_count);
+
+	auto read = [&record, &offset](void *destination, size_t size)
+	{
+		if (offset + size > record.size())
+		{
+			return false;
+		}
+		std::memcpy(destination, record.data() + offset, size);
+		offset += size;
+		return true;
+	};
+
+	for (uint8_t i = 0; i < decoded.header.argument_count; ++i)
+	{
+		argument_kind kind{};
+		if (!read(&kind, 1))
+		{
+			return false;
+		}
+
+		format_argument argument{};
+		switch (kind)
+		{
+		case argument_kind::signed_integer:
+		{
+			argument.kind = format_argument::argument_kind::signed_integer;
+			if (!read(&argument.signed_value, sizeof(argument.signed_value)))
+			{
+				return false;
+			}
+			break;
+		}
+		case argument_kind::unsigned_integer:
+		{
+			argument.kind = format_argument::argument_kind::unsigned_integer;
+			if (!read(&argument.unsigned_value, sizeof(argument.unsigned_value)))
+			{
+				return false;
+			}
+			break;
+		}
+		case argument_kind::wide_text:
+		{
+			uint16_t length = 0;
+			if (!read(&length, sizeof(length)) || offset + length * sizeof(wchar_t) > record.size())
+			{
+				return false;
+			}
+			//The record may not be aligned for wchar_t, so the text is copied out.
+			auto &text = decoded.widened_text.emplace_back(length, L'\0');
+			read(text.data(), length * sizeof(wchar_t));
+			argument.kind = format_argument::argument_kind::text;
+			argument.text = text;
+			break;
+		}
+		case argument_kind::narrow_text:
+		{
+			uint16_t length = 0;
+			if (!read(&length, sizeof(length)) || offset + length > record.size())
+			{
+				return false;
+			}
+			auto &text = decoded.widened_text.emplace_back();
+			text.reserve(length);
+			for (uint16_t c = 0; c < length; ++c)
+			{
+				text.push_back(static_cast<wchar_t>(static_cast<unsigned char>(record[offset + c])));
+			}
+			offset += length;
+			argument.kind = format_argument::argument_kind::text;
+			argument.text = text;
+			break;
+		}
+		default:
+		{
+			return false;
+		}
+		}
+
+		decoded.arguments.push_back(argument);
+	}
+
+	return true;
+}
+
+log_ring::log_ring(size_t capacity)
+{
+	m_capacity = 64;
+	while (m_capacity < capacity)
+	{
+		m_capacity *= 2;
+	}
+	m_mask = m_capacity - 1;
+	m_buffer = std::make_unique<std::byte[]>(m_capacity);
+}
+
+size_t log_ring::framed_size(size_t length)
+{
+	return (sizeof(uint32_t) + length + 3) & ~size_t(3);
+}
+
+bool log_ring::try_write(std::span<const std::byte> record)
+{
+	const auto needed = framed_size(record.size());
+	const auto write_position = m_write_position.load(std::memory_order_relaxed);
+	const auto offset = static_cast<size_t>(write_position) & m_mask;
+	//A record never wraps, if it won't fit before the end then the rest of the buffer is padding.
+	const auto padding = offset + needed > m_capacity ? m_capacity - offset : 0;
+
+	if (needed > m_capacity || write_position + padding + needed - m_cached_read_position > m_capacity)
+	{
+		m_cached_read_position = m_read_position.load(std::memory_order_acquire);
+		if (needed > m_capacity || write_position + padding + needed - m_cached_read_position > m_capacity)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+
+	auto position = write_position;
+	if (padding != 0)
+	{
+		std::memcpy(m_buffer.get() + offset, &padding_marker, sizeof(padding_marker));
+		position += padding;
+	}
+
+	const auto record_offset = static_cast<size_t>(position) & m_mask;
+	const auto length = static_cast<uint32_t>(record.size());
+	std::memcpy(m_buffer.get() + record_offset, &length, sizeof(length));
+	std::memcpy(m_buffer.get() + record_offset + sizeof(length), record.data(), record.size());
+
+	m_write_position.store(position + needed, std::memory_order_release);
+	m_written.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+uint64_t log_ring::get_dropped_count() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t log_ring::get_written_count() const
+{
+	return m_written.load(std::memory_order_relaxed);
+}
+
+size_t log_ring::get_capacity() const
+{
+	return m_capacity;
+}
\ No newline at end of file
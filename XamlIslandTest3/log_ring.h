@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#ifndef _MEMORY_
+#include <memory>
+#endif
+#include <span>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#include <type_traits>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "value_intern.h"
+
+//The binary side of logging: records, how they are encoded, and the ring buffers that carry
+//them from the thread that logs to the writer.
+//This only uses the standard library.
+
+enum class log_level : uint8_t
+{
+	trace,
+	debug,
+	info,
+	warning,
+	error
+};
+
+//Records are never bigger than this. Text arguments are cut short to make them fit.
+constexpr size_t max_log_record_size = 512;
+
+//Builds a record in a fixed buffer on the stack.
+//The layout is the header, then for each argument a one byte kind followed by its value.
+//Text is stored as raw code units, records never leave the process so the width of wchar_t
+//doesn't matter.
+class log_record_builder
+{
+public:
+	//The fixed part of every record.
+	struct header
+	{
+		int64_t timestamp = 0;
+		uint16_t format_id = 0;
+		log_level level = log_level::info;
+		uint8_t argument_count = 0;
+	};
+
+	enum class argument_kind : uint8_t
+	{
+		signed_integer,
+		unsigned_integer,
+		wide_text,
+		narrow_text
+	};
+
+	log_record_builder(log_level level, uint16_t format_id, int64_t timestamp);
+
+	template <typename T>
+	void add(T const &value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			add_unsigned(value ? 1 : 0);
+		}
+		else if constexpr (std::is_same_v<T, wchar_t>)
+		{
+			add_wide_text(std::wstring_view(&value, 1));
+		}
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+		{
+			add_signed(static_cast<int64_t>(value));
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			add_unsigned(static_cast<uint64_t>(value));
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			add(static_cast<std::underlying_type_t<T>>(value));
+		}
+		else if constexpr (std::is_convertible_v<T const &, std::wstring_view>)
+		{
+			add_wide_text(std::wstring_view(value));
+		}
+		else
+		{
+			static_assert(std::is_convertible_v<T const &, std::string_view>, "log arguments must be integers, enums or strings");
+			add_narrow_text(std::string_view(value));
+		}
+	}
+
+	std::span<const std::byte> get_record();
+
+private:
+	void add_signed(int64_t);
+	void add_unsigned(uint64_t);
+	void add_wide_text(std::wstring_view);
+	void add_narrow_text(std::string_view);
+	bool begin_argument(argument_kind, size_t value_size);
+	void append(void const *, size_t);
+
+	std::byte m_data[max_log_record_size];
+	size_t m_size = 0;
+	uint8_t m_argument_count = 0;
+};
+
+//A record decoded back into something that format_buffer can format.
+//The text views point into the record, or into the narrow text storage, so the decoded
+//record is only valid while both of those are.
+struct decoded_log_record
+{
+	log_record_builder::header header{};
+	std::vector<format_buffer::format_argument> arguments;
+	//Narrow text widened for formatting.
+	std::vector<std::wstring> widened_text;
+};
+
+//Returns false if the record is malformed.
+//Narrow text is widened a byte at a time, it is expected to be ASCII.
+bool decode_log_record(std::span<const std::byte>, decoded_log_record &);
+
+//A single producer, single consumer ring of variable length records.
+//One thread writes and one thread reads, neither ever waits for the other. If there isn't
+//room for a record the writer drops it and counts it rather than blocking.
+class log_ring
+{
+public:
+	//The capacity is rounded up to a power of two.
+	explicit log_ring(size_t capacity = 64 * 1024);
+
+	//Producer side.
+	//Returns false and counts the record as dropped if the ring is full.
+	bool try_write(std::span<const std::byte> record);
+	//Consumer side.
+	//Calls the function for each record in order and then frees the space they used.
+	//The span passed to the function is only valid during the call.
+	template <typename Function>
+	size_t read_all(Function &&function)
+	{
+		const auto write_position = m_write_position.load(std::memory_order_acquire);
+		auto read_position = m_read_position.load(std::memory_order_relaxed);
+		size_t count = 0;
+
+		while (read_position != write_position)
+		{
+			const auto offset = static_cast<size_t>(read_position) & m_mask;
+			uint32_t length = 0;
+			std::memcpy(&length, m_buffer.get() + offset, sizeof(length));
+			if (length == padding_marker)
+			{
+				read_position += m_capacity - offset;
+				continue;
+			}
+
+			function(std::span<const std::byte>(m_buffer.get() + offset + sizeof(length), length));
+			read_position += framed_size(length);
+			++count;
+		}
+
+		m_read_position.store(read_position, std::memory_order_release);
+		return count;
+	}
+
+	uint64_t get_dropped_count() const;
+	uint64_t get_written_count() const;
+	size_t get_capacity() const;
+
+private:
+	static constexpr uint32_t padding_marker = 0xFFFFFFFF;
+
+	//Records are framed with their length and kept four byte aligned, so there is always
+	//room for a padding marker at the end of the buffer.
+	static size_t framed_size(size_t length);
+
+	size_t m_capacity;
+	size_t m_mask;
+	std::unique_ptr<std::byte[]> m_buffer;
+
+	//The positions only ever increase, the offset into the buffer is the position masked.
+	//They are kept on separate cache lines so the two threads don't share a line.
+	alignas(64) std::atomic<uint64_t> m_write_position{ 0 };
+	//The producer's last view of the read position, so it only has to look at the
+	//consumer's cache line when the ring seems full.
+	uint64_t m_cached_read_position = 0;
+	std::atomic<uint64_t> m_dropped{ 0 };
+	std::atomic<uint64_t> m_written{ 0 };
+	alignas(64) std::atomic<uint64_t> m_read_position{ 0 };
+};
\ No newline at end of file
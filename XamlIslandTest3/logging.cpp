@@ -0,0 +1,386 @@
+#include "pch.h"
+#include "logging.h"
+
+#include <algorithm>
+
+//Indexed by log_message.
+constexpr std::wstring_view log_patterns[] =
+{
+	L"Exception thrown. Message: {}, Code: {}",
+	L"Exception thrown. What: {}, Code: {}",
+	L"Exception thrown. What: {}",
+	L"Shutdown step {}: {}us{}",
+	L"Value cache: {} formats, {} allocations, {} string hits, {} integer hits",
+	L"Message queue drain stopped before the queue was empty. {} messages in {}us",
+	L"GotFocus fired for island {}",
+	L"GotFocus fired for island {}, HWND does not have focus.",
+	L"Island suspension: {} suspends, {} skipped filter calls, {}ms suspended, {}us CPU saved (estimated).",
+	L"Focus navigation for message {} key {}, handled: {}",
+	L"Take focus requested for island {}, reason {}",
+	L"Pump ran {} timers",
+	L"Property staging: {} writes requested, {} applied, {} unchanged, {} flushes",
+	L"Window state snapshot ignored, result {}",
+	L"Window state snapshot not saved, error {}",
+	L"Xaml prewarm: {} planned, {} prewarmed, {} skipped, {} failed, {} cancelled, {} cache hits",
+	L"Xaml usage history not saved, error {}",
+	L"Xaml content patched: {} patches, {} elements created, {}us, in place: {}",
+	L"Xaml content reloaded with {} elements",
+	L"Consolidated {} xaml elements into {} islands",
+	L"Input {}",
+	L"Input latency {} {}: {} interactions, p50 {}us, p90 {}us, p99 {}us, max {}us",
+	L"Message trace not started, error {}",
+	L"Message trace: {} messages, {} bytes, {} stalls, {} dropped{}",
+	L"Background executor: {} workers, {} tasks, {} steals of {} tasks, {} failed, {} cancelled, {} completion batches",
+	L"Frame arena: {} resets, {} chunks, high water {} bytes, {} heap allocations while handling messages",
+	L"Pump timers: {} scheduled, {} fired, {} cancelled, {} coalesced, {} batches",
+	L"Memory trimmed, pressure {}: {} consumers, {} bytes down to {} bytes",
+	L"Memory consumer {}: {} bytes, peak {} bytes, budget {} bytes, {} trims freed {} bytes",
+	L"Memory governor: {} updates, {} pressure signals, {} low and {} critical trims, {} ignored, {} budget trims, {} bytes freed",
+	L"Child controls: {} created, {} reused, {} released, {} destroyed, at most {} pooled",
+	L"Pump {} for {}ms in {}: message {}, window {}, island {} ({}), at {}+{}",
+	L"Pump stall in {} ended after {}ms, {}",
+	L"Pump stalls: {} stalls, {} slow, {} hung, p50 {}us, p90 {}us, p99 {}us, longest {}us in {}",
+	L"Xaml resource {} failed to load, error {}",
+	L"Logging stopped: {} records written, {} dropped, {} bytes, {} rotations"
+};
+static_assert(std::size(log_patterns) == static_cast<size_t>(log_message::message_count), "every log_message needs a pattern");
+
+std::wstring_view get_log_pattern(log_message message)
+{
+	const auto index = static_cast<size_t>(message);
+	return index < std::size(log_patterns) ? log_patterns[index] : std::wstring_view(L"Unknown log message");
+}
+
+std::wstring_view get_log_level_name(log_level level)
+{
+	switch (level)
+	{
+	case log_level::trace:
+		return L"trace";
+	case log_level::debug:
+		return L"debug";
+	case log_level::info:
+		return L"info";
+	case log_level::warning:
+		return L"warning";
+	case log_level::error:
+		return L"error";
+	}
+	return L"unknown";
+}
+
+log_system::~log_system()
+{
+	stop();
+
+	std::lock_guard lock(m_rings_lock);
+	for (auto &ring : m_rings)
+	{
+		ring->closed.store(true, std::memory_order_release);
+	}
+	m_rings.clear();
+}
+
+void log_system::start(std::filesystem::path const &directory, log_options const &options)
+{
+	if (m_writer.joinable())
+	{
+		return;
+	}
+
+	m_options = options;
+	m_file = std::make_unique<rotating_log_file>(directory / m_options.file_name, m_options.max_file_bytes, m_options.max_old_files);
+	m_stop_requested = false;
+	m_running.store(true, std::memory_order_release);
+	m_writer = std::thread([this]() { writer_thread(); });
+}
+
+void log_system::stop()
+{
+	if (!m_writer.joinable())
+	{
+		return;
+	}
+
+	m_running.store(false, std::memory_order_release);
+	{
+		std::lock_guard lock(m_wake_lock);
+		m_stop_requested = true;
+	}
+	m_wake.notify_one();
+	m_writer.join();
+	m_file.reset();
+}
+
+bool log_system::is_running() const
+{
+	return m_running.load(std::memory_order_relaxed);
+}
+
+log_statistics log_system::get_statistics() const
+{
+	log_statistics statistics{};
+	statistics.records_written = m_records_written.load(std::memory_order_relaxed);
+	statistics.records_dropped = m_retired_dropped.load(std::memory_order_relaxed);
+	statistics.bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+	statistics.file_rotations = m_file_rotations.load(std::memory_order_relaxed);
+	statistics.file_failures = m_file_failures.load(std::memory_order_relaxed);
+
+	std::lock_guard lock(m_rings_lock);
+	for (auto &ring : m_rings)
+	{
+		statistics.records_dropped += ring->ring.get_dropped_count();
+	}
+	return statistics;
+}
+
+//Wall clock time, so the lines can be matched up with other logs.
+int64_t log_system::get_timestamp()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint64_t log_system::get_next_instance()
+{
+	static std::atomic<uint64_t> next_instance{ 1 };
+	return next_instance.fetch_add(1, std::memory_order_relaxed);
+}
+
+void log_system::submit(log_level level, std::span<const std::byte> record)
+{
+	get_thread_ring().ring.try_write(record);
+
+	//Errors are usually followed by the process going away, so get them to the file now.
+	if (level == log_level::error)
+	{
+		m_wake.notify_one();
+	}
+}
+
+log_system::thread_ring &log_system::get_thread_ring()
+{
+	//The thread's ring for each log_system it has logged to, almost always just the one.
+	//Marks the rings as retired when the thread exits.
+	struct ring_holder
+	{
+		struct held_ring
+		{
+			uint64_t instance;
+			std::shared_ptr<thread_ring> ring;
+		};
+
+		~ring_holder()
+		{
+			for (auto &held : rings)
+			{
+				held.ring->retired.store(true, std::memory_order_release);
+			}
+		}
+
+		std::vector<held_ring> rings;
+	};
+	thread_local ring_holder holder;
+
+	for (auto &held : holder.rings)
+	{
+		if (held.instance == m_instance)
+		{
+			return *held.ring;
+		}
+	}
+
+	//Rings of log_systems that have gone away won't be read again.
+	std::erase_if(holder.rings, [](ring_holder::held_ring const &held) { return held.ring->closed.load(std::memory_order_acquire); });
+
+	std::shared_ptr<thread_ring> ring;
+	{
+		std::lock_guard lock(m_rings_lock);
+		ring = std::make_shared<thread_ring>(m_options.ring_capacity, m_next_thread_number++);
+		m_rings.push_back(ring);
+	}
+	holder.rings.push_back({ m_instance, ring });
+	return *ring;
+}
+
+void log_system::writer_thread()
+{
+	bool stopping = false;
+	while (!stopping)
+	{
+		{
+			std::unique_lock lock(m_wake_lock);
+			m_wake.wait_for(lock, m_options.flush_interval, [this]() { return m_stop_requested; });
+			stopping = m_stop_requested;
+		}
+
+		drain_rings();
+	}
+
+	write_summary();
+}
+
+void log_system::drain_rings()
+{
+	m_record_data.clear();
+	m_pending.clear();
+
+	{
+		std::lock_guard lock(m_rings_lock);
+		for (auto it = m_rings.begin(); it != m_rings.end();)
+		{
+			auto &ring = **it;
+			//Checked before reading, so nothing the thread wrote before it exited is missed.
+			const bool retired = ring.retired.load(std::memory_order_acquire);
+
+			ring.ring.read_all([this, &ring](std::span<const std::byte> record)
+				{
+					log_record_builder::header header{};
+					if (record.size() < sizeof(header))
+					{
+						return;
+					}
+					std::memcpy(&header, record.data(), sizeof(header));
+
+					m_pending.push_back(pending_record{ header.timestamp, ring.thread_number, m_record_data.size(), record.size() });
+					m_record_data.insert(m_record_data.end(), record.begin(), record.end());
+				});
+
+			if (retired)
+			{
+				m_retired_dropped.fetch_add(ring.ring.get_dropped_count(), std::memory_order_relaxed);
+				it = m_rings.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	if (m_pending.empty())
+	{
+		return;
+	}
+
+	//Each ring is already in order, this interleaves the threads.
+	std::stable_sort(m_pending.begin(), m_pending.end(), [](pending_record const &a, pending_record const &b) { return a.timestamp < b.timestamp; });
+
+	for (auto &pending : m_pending)
+	{
+		write_record(pending);
+	}
+	m_file->flush();
+
+	m_records_written.fetch_add(m_pending.size(), std::memory_order_relaxed);
+	update_file_statistics();
+}
+
+//Written directly rather than through a ring, so it is the last line in the file. It is given
+//thread number 0, which no logging thread has.
+void log_system::write_summary()
+{
+	const auto statistics = get_statistics();
+	const auto timestamp = get_timestamp();
+	log_record_builder builder(log_level::info, static_cast<uint16_t>(log_message::logging_stopped), timestamp);
+	builder.add(statistics.records_written);
+	builder.add(statistics.records_dropped);
+	builder.add(statistics.bytes_written);
+	builder.add(statistics.file_rotations);
+
+	const auto record = builder.get_record();
+	m_record_data.assign(record.begin(), record.end());
+	write_record(pending_record{ timestamp, 0, 0, record.size() });
+	m_file->flush();
+
+	m_records_written.fetch_add(1, std::memory_order_relaxed);
+	update_file_statistics();
+}
+
+void log_system::update_file_statistics()
+{
+	const auto &counters = m_file->get_counters();
+	m_bytes_written.store(counters.bytes, std::memory_order_relaxed);
+	m_file_rotations.store(counters.rotations, std::memory_order_relaxed);
+	m_file_failures.store(counters.failures, std::memory_order_relaxed);
+}
+
+//Appends the number padded with zeros to the width.
+void append_padded(std::wstring &line, int64_t value, size_t width)
+{
+	wchar_t digits[20]{};
+	size_t count = 0;
+	auto remaining = static_cast<uint64_t>(value < 0 ? 0 : value);
+	do
+	{
+		digits[count++] = static_cast<wchar_t>(L'0' + remaining % 10);
+		remaining /= 10;
+	} while (remaining != 0 && count < std::size(digits));
+
+	for (auto i = count; i < width; ++i)
+	{
+		line.push_back(L'0');
+	}
+	while (count != 0)
+	{
+		line.push_back(digits[--count]);
+	}
+}
+
+//Lines look like:
+//2024-01-31 13:45:02.123456 [info] [1] The message.
+void log_system::write_record(pending_record const &pending)
+{
+	m_line.clear();
+
+	const auto record = std::span<const std::byte>(m_record_data.data() + pending.offset, pending.size);
+	if (!decode_log_record(record, m_decoded))
+	{
+		m_line.append(L"Malformed log record");
+		m_file->write_line(m_line);
+		return;
+	}
+
+	using namespace std::chrono;
+	const auto time = sys_time<nanoseconds>(nanoseconds(m_decoded.header.timestamp));
+	const auto day = floor<days>(time);
+	const year_month_day date(day);
+	const hh_mm_ss time_of_day(floor<microseconds>(time - day));
+
+	append_padded(m_line, static_cast<int>(date.year()), 4);
+	m_line.push_back(L'-');
+	append_padded(m_line, static_cast<unsigned>(date.month()), 2);
+	m_line.push_back(L'-');
+	append_padded(m_line, static_cast<unsigned>(date.day()), 2);
+	m_line.push_back(L' ');
+	append_padded(m_line, time_of_day.hours().count(), 2);
+	m_line.push_back(L':');
+	append_padded(m_line, time_of_day.minutes().count(), 2);
+	m_line.push_back(L':');
+	append_padded(m_line, time_of_day.seconds().count(), 2);
+	m_line.push_back(L'.');
+	append_padded(m_line, time_of_day.subseconds().count(), 6);
+	m_line.append(L" [");
+	m_line.append(get_log_level_name(m_decoded.header.level));
+	m_line.append(L"] [");
+	append_padded(m_line, pending.thread_number, 1);
+	m_line.append(L"] ");
+
+	//If arguments were left out of the record for being too big, only the pattern is written.
+	const auto pattern = get_log_pattern(static_cast<log_message>(m_decoded.header.format_id));
+	try
+	{
+		m_line.append(m_formatter.format_arguments(pattern, m_decoded.arguments));
+	}
+	catch (std::invalid_argument &)
+	{
+		m_line.append(pattern);
+	}
+
+	m_file->write_line(m_line);
+}
+
+log_system &get_log_system()
+{
+	static log_system system;
+	return system;
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#ifndef _FILESYSTEM_
+#include <filesystem>
+#endif
+#ifndef _MEMORY_
+#include <memory>
+#endif
+#include <mutex>
+#include <string_view>
+#include <thread>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "log_file.h"
+#include "log_ring.h"
+
+//Structured logging that doesn't block the thread that logs.
+//A call to log_write only builds a small binary record and copies it into a ring buffer that
+//belongs to the calling thread. Formatting, sorting and writing to the file all happen later on
+//the log writer thread. If a ring fills up the record is dropped and counted.
+
+//Levels below this are removed at compile time, the arguments aren't even evaluated into a record.
+//Define LOG_MINIMUM_LEVEL to the number of a log_level to override this.
+#ifndef LOG_MINIMUM_LEVEL
+#ifdef _DEBUG
+#define LOG_MINIMUM_LEVEL 1
+#else
+#define LOG_MINIMUM_LEVEL 2
+#endif
+#endif
+
+constexpr log_level log_minimum_level = static_cast<log_level>(LOG_MINIMUM_LEVEL);
+
+//Every message that can be logged.
+//The record only stores the id, the text comes from get_log_pattern when the record is formatted.
+enum class log_message : uint16_t
+{
+	exception_hresult,
+	exception_wil,
+	exception_std,
+	shutdown_step,
+	value_cache_summary,
+	message_drain_incomplete,
+	island_got_focus,
+	island_got_focus_without_focus,
+	suspension_summary,
+	focus_navigated,
+	take_focus_requested,
+	pump_timers_run,
+	property_staging_summary,
+	window_state_load_failed,
+	window_state_save_failed,
+	xaml_prewarm_summary,
+	xaml_usage_save_failed,
+	xaml_content_patched,
+	xaml_content_reloaded,
+	xaml_islands_consolidated,
+	input_latency_span,
+	input_latency_summary,
+	message_trace_not_started,
+	message_trace_summary,
+	background_executor_summary,
+	frame_arena_summary,
+	pump_timer_summary,
+	memory_trimmed,
+	memory_consumer_summary,
+	memory_governor_summary,
+	child_controls_summary,
+	pump_stalled,
+	pump_stall_ended,
+	pump_stall_summary,
+	xaml_load_failed,
+	logging_stopped,
+	message_count
+};
+
+//The format_buffer pattern for the message.
+std::wstring_view get_log_pattern(log_message);
+std::wstring_view get_log_level_name(log_level);
+
+struct log_statistics
+{
+	uint64_t records_written = 0;
+	uint64_t records_dropped = 0;
+	uint64_t bytes_written = 0;
+	uint64_t file_rotations = 0;
+	uint64_t file_failures = 0;
+};
+
+struct log_options
+{
+	//The name of the current file, old files get a number added.
+	std::wstring file_name = L"XamlIslandTest3.log";
+	uint64_t max_file_bytes = 4 * 1024 * 1024;
+	uint32_t max_old_files = 4;
+	//The size of each thread's ring.
+	size_t ring_capacity = 64 * 1024;
+	//How often the writer wakes up to empty the rings.
+	std::chrono::milliseconds flush_interval{ 50 };
+};
+
+//Owns the per thread rings and the writer thread.
+//The application logs through the one from get_log_system, tests make their own.
+class log_system
+{
+public:
+	log_system() = default;
+	~log_system();
+	log_system(const log_system &) = delete;
+	log_system(log_system &&) = delete;
+	log_system &operator=(const log_system &) = delete;
+	log_system &operator=(log_system &&) = delete;
+
+	//Starts the writer thread, writing files into the directory.
+	//Records logged before this are dropped.
+	void start(std::filesystem::path const &directory, log_options const & = {});
+	//Writes everything that has been logged and then stops the writer thread.
+	void stop();
+	bool is_running() const;
+
+	template <typename... Args>
+	void write(log_level level, log_message message, Args const &... args)
+	{
+		if (!m_running.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		log_record_builder builder(level, static_cast<uint16_t>(message), get_timestamp());
+		(builder.add(args), ...);
+		submit(level, builder.get_record());
+	}
+
+	log_statistics get_statistics() const;
+
+private:
+	//A ring for each thread that has logged.
+	//When the thread exits the ring is marked as retired, the writer empties it one last time
+	//and then drops it.
+	struct thread_ring
+	{
+		explicit thread_ring(size_t capacity, uint32_t thread_number) : ring(capacity), thread_number(thread_number)
+		{
+		}
+
+		log_ring ring;
+		uint32_t thread_number;
+		std::atomic<bool> retired{ false };
+		//Set when the log_system goes away, so the thread can let go of the ring.
+		std::atomic<bool> closed{ false };
+	};
+
+	//A record copied out of a ring, waiting to be sorted and written.
+	struct pending_record
+	{
+		int64_t timestamp;
+		uint32_t thread_number;
+		size_t offset;
+		size_t size;
+	};
+
+	static int64_t get_timestamp();
+	static uint64_t get_next_instance();
+
+	void submit(log_level, std::span<const std::byte>);
+	thread_ring &get_thread_ring();
+	void writer_thread();
+	//Empties every ring and writes the records out in time order.
+	void drain_rings();
+	void write_record(pending_record const &);
+	//Writes the logging_stopped line once the last records have been written, so it counts them.
+	void write_summary();
+	void update_file_statistics();
+
+	//Threads find their ring for this log_system by this, an address could be reused.
+	const uint64_t m_instance = get_next_instance();
+	std::atomic<bool> m_running{ false };
+	log_options m_options{};
+
+	mutable std::mutex m_rings_lock;
+	std::vector<std::shared_ptr<thread_ring>> m_rings;
+	uint32_t m_next_thread_number = 1;
+
+	std::mutex m_wake_lock;
+	std::condition_variable m_wake;
+	bool m_stop_requested = false;
+	std::thread m_writer;
+
+	//Only used by the writer thread.
+	std::unique_ptr<rotating_log_file> m_file;
+	std::vector<std::byte> m_record_data;
+	std::vector<pending_record> m_pending;
+	decoded_log_record m_decoded{};
+	format_buffer m_formatter{ 256 };
+	std::wstring m_line;
+
+	std::atomic<uint64_t> m_records_written{ 0 };
+	std::atomic<uint64_t> m_retired_dropped{ 0 };
+	std::atomic<uint64_t> m_bytes_written{ 0 };
+	std::atomic<uint64_t> m_file_rotations{ 0 };
+	std::atomic<uint64_t> m_file_failures{ 0 };
+};
+
+log_system &get_log_system();
+
+template <log_level Level, typename... Args>
+void log_write(log_message message, Args const &... args)
+{
+	if constexpr (Level >= log_minimum_level)
+	{
+		get_log_system().write(Level, message, args...);
+	}
+}
+
+template <typename... Args>
+void log_trace(log_message message, Args const &... args)
+{
+	log_write<log_level::trace>(message, args...);
+}
+
+template <typename... Args>
+void log_debug(log_message message, Args const &... args)
+{
+	log_write<log_level::debug>(message, args...);
+}
+
+template <typename... Args>
+void log_info(log_message message, Args const &... args)
+{
+	log_write<log_level::info>(message, args...);
+}
+
+template <typename... Args>
+void log_warning(log_message message, Args const &... args)
+{
+	log_write<log_level::warning>(message, args...);
+}
+
+template <typename... Args>
+void log_error(log_message message, Args const &... args)
+{
+	log_write<log_level::error>(message, args...);
+}
+
+//Starts logging for as long as it is in scope.
+class log_session
+{
+public:
+	explicit log_session(std::filesystem::path const &directory, log_options const &options = {})
+	{
+		get_log_system().start(directory, options);
+	}
+
+	~log_session()
+	{
+		get_log_system().stop();
+	}
+
+	log_session(const log_session &) = delete;
+	log_session &operator=(const log_session &) = delete;
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "wappsdkbootstrap.h"
+#include "logging.h"
 #include "main_application.h"
 #include "main_window.h"
 
@@ -30,25 +31,30 @@ void except_filter()
 	}
 	catch (winrt::hresult_error &he)
 	{
-		auto fmtstr = std::format(L"Message: {}, Code: {}", std::wstring_view(he.message()), int32_t(he.code()));
-		MessageBoxW(nullptr, fmtstr.c_str(), L"Exception Thrown", MB_ICONERROR | MB_OK);
+		log_error(log_message::exception_hresult, std::wstring_view(he.message()), int32_t(he.code()));
 	}
 	catch (wil::ResultException &re)
 	{
-		//Use hstring to get a wide version of what.
-		auto what_str = winrt::to_hstring(re.what());
-		auto fmtstr = std::format(L"What: {}, Code: {}", what_str, re.GetErrorCode());
-		MessageBoxW(nullptr, fmtstr.c_str(), L"Exception Thrown", MB_ICONERROR | MB_OK);
+		log_error(log_message::exception_wil, std::string_view(re.what()), re.GetErrorCode());
 	}
 	catch (std::exception &e)
 	{
-		//Use hstring to get a wide version of what.
-		auto what_str = winrt::to_hstring(e.what());
-		auto fmtstr = std::format(L"What: {}", what_str);
-		MessageBoxW(nullptr, fmtstr.c_str(), L"Exception Thrown", MB_ICONERROR | MB_OK);
+		log_error(log_message::exception_std, std::string_view(e.what()));
 	}
 }
 
+//The trace is only recorded if the environment variable names the file to write.
+std::filesystem::path get_message_trace_path()
+{
+	wchar_t path[MAX_PATH]{};
+	const auto length = GetEnvironmentVariableW(L"XAMLISLANDTEST3_MESSAGE_TRACE", path, MAX_PATH);
+	if (length == 0 || length >= MAX_PATH)
+	{
+		return {};
+	}
+	return std::filesystem::path(path);
+}
+
 int application_main(HINSTANCE inst, LPWSTR, int cmdshow)
 {
 	int main_return = 0;
@@ -66,6 +72,13 @@ int application_main(HINSTANCE inst, LPWSTR, int cmdshow)
 		muxc::XamlControlsResources resources;
 		//Merge the resources into the xaml merged dictionaries.
 		app.merge_resources({ resources });
+		//Starts decoding what the last few runs loaded, it runs once the message loop is idle.
+		app.start_xaml_prewarm();
+		//Records what the pump does with every message, for XamlIslandTraceReplay.
+		if (const auto trace_path = get_message_trace_path(); !trace_path.empty())
+		{
+			app.start_message_trace(trace_path);
+		}
 
 		//Create and show the main window.
 		main_window window(inst);
@@ -80,6 +93,9 @@ int application_main(HINSTANCE inst, LPWSTR, int cmdshow)
 int WINAPI wWinMain(_In_ HINSTANCE inst, _In_opt_ HINSTANCE, _In_ LPWSTR cmdline, _In_ int cmdshow)
 {
 	int result = 0;
+	//Logging outlives everything else, so the exception filter can still log.
+	std::error_code ec;
+	log_session logging(std::filesystem::temp_directory_path(ec) / L"XamlIslandTest3");
 
 	try
 	{
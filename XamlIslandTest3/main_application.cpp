@@ -1,19 +1,80 @@
 #include "pch.h"
 #include "main_application.h"
+#include "heap_allocations.h"
+#include "live_counters_region.h"
+#include "logging.h"
+#include "xaml_text.h"
 
 #include <microsoft.ui.xaml.hosting.desktopwindowxamlsource.h>
 
+#include <algorithm>
+
 namespace wf = winrt::Windows::Foundation;
 namespace wfc = winrt::Windows::Foundation::Collections;
 namespace mux = winrt::Microsoft::UI::Xaml;
 namespace muxm = winrt::Microsoft::UI::Xaml::Markup;
 namespace muxh = winrt::Microsoft::UI::Xaml::Hosting;
 
+//The usage history is kept with the window state snapshot.
+std::filesystem::path get_xaml_usage_path()
+{
+	std::error_code ec;
+	return std::filesystem::temp_directory_path(ec) / L"XamlIslandTest3" / L"xaml_usage.txt";
+}
+
+//A missing or unreadable history just means nothing is prewarmed.
+void load_xaml_usage_history(std::filesystem::path const &path, xaml_usage_history &history)
+{
+	try
+	{
+		if (!decode_usage_history(read_xaml_file(path), history))
+		{
+			history.clear();
+		}
+	}
+	catch (std::filesystem::filesystem_error const &)
+	{
+		history.clear();
+	}
+}
+
+//The history is only a hint, so it is written in place rather than replaced. A torn file
+//loses some of the history at worst.
+DWORD save_xaml_usage_history(std::filesystem::path const &path, xaml_usage_history const &history)
+{
+	const auto text = encode_usage_history(history);
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	wil::unique_hfile file(CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+	if (!file)
+	{
+		return GetLastError();
+	}
+
+	DWORD written = 0;
+	if (!WriteFile(file.get(), text.data(), static_cast<DWORD>(text.size()), &written, nullptr) || written != text.size())
+	{
+		const auto error = GetLastError();
+		return error == ERROR_SUCCESS ? ERROR_WRITE_FAULT : error;
+	}
+	return ERROR_SUCCESS;
+}
+
 //The thread id is required for when we look for the top level windows.
 //Only the ones that are created on the same thread as this application are
 //considered.
 main_application::main_application() : m_creator_thread_id(GetCurrentThreadId())
 {
+	//High resolution timers need Windows 10 1803, older versions get a normal one.
+	m_timer_event.reset(CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+	if (!m_timer_event)
+	{
+		m_timer_event.reset(CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+	}
+	m_low_memory_notification.reset(CreateMemoryResourceNotification(LowMemoryResourceNotification));
+	register_memory_consumers();
 }
 
 main_application &main_application::get_application()
@@ -31,13 +92,122 @@ main_application &main_application::get_application()
 
 main_application::~main_application()
 {
+	teardown_coordinator teardown;
+	//Nothing should be started while shutting down.
+	teardown.add_step("cancel_pending_work", [this]()
+		{
+			m_idle_scheduler.cancel_all();
+			const auto timers = m_timers.get_statistics();
+			log_info(log_message::pump_timer_summary, timers.scheduled, timers.fired, timers.cancelled, timers.coalesced, timers.batches);
+			m_timers.clear();
+		});
+	teardown.add_step("stop_message_trace", [this]() { stop_message_trace(); });
+	//Shutdown can take a while, that shouldn't be reported as a hang.
+	teardown.add_step("stop_hang_watchdog", [this]()
+		{
+			if (!m_hang_watchdog)
+			{
+				return;
+			}
+
+			m_hang_watchdog->stop();
+			const auto statistics = m_hang_watchdog->get_statistics();
+			log_info(log_message::pump_stall_summary, statistics.stalls, statistics.slow, statistics.hung, statistics.durations.p50.count(), statistics.durations.p90.count(), statistics.durations.p99.count(), std::chrono::duration_cast<std::chrono::microseconds>(statistics.longest).count(), get_pump_stage_name(statistics.longest_stage));
+			m_hang_watchdog.reset();
+			m_ui_thread.reset();
+		});
+	//Tasks that haven't started are thrown away, along with completions that haven't run.
+	teardown.add_step("stop_background_executor", [this]()
+		{
+			if (!m_background_executor)
+			{
+				return;
+			}
+
+			m_background_executor->shutdown();
+			const auto statistics = m_background_executor->get_statistics();
+			log_info(log_message::background_executor_summary, static_cast<uint64_t>(m_background_executor->get_worker_count()), statistics.tasks_run, statistics.steals, statistics.tasks_stolen, statistics.tasks_failed, statistics.tasks_cancelled, statistics.completion_batches);
+			m_background_executor.reset();
+		}, { "cancel_pending_work" });
+	//This run's usage is only saved if the history was read, otherwise it would replace it.
+	teardown.add_step("save_xaml_usage", [this]()
+		{
+			if (!m_xaml_prewarm_started)
+			{
+				return;
+			}
+
+			m_xaml_prewarmer.cancel();
+			const auto &statistics = m_xaml_prewarmer.get_statistics();
+			log_info(log_message::xaml_prewarm_summary, statistics.planned, statistics.prewarmed, statistics.skipped, statistics.failed, statistics.cancelled, m_xaml_text_cache.get_counters().hits);
+			m_xaml_text_cache.clear();
+
+			append_usage_run(m_xaml_usage_history, m_xaml_usage.get_records());
+			if (const auto error = save_xaml_usage_history(get_xaml_usage_path(), m_xaml_usage_history); error != ERROR_SUCCESS)
+			{
+				log_warning(log_message::xaml_usage_save_failed, error);
+			}
+		}, { "cancel_pending_work" });
+	//Interactions still waiting for late stages are finished as they are.
+	teardown.add_step("report_input_latency", [this]()
+		{
+			m_latency_probe.flush(&log_latency_span);
+			for (auto &row : m_latency_probe.get_report())
+			{
+				log_info(log_message::input_latency_summary, get_input_kind_name(row.kind), get_latency_stage_name(row.stage), row.summary.count, row.summary.p50.count(), row.summary.p90.count(), row.summary.p99.count(), row.summary.max.count());
+			}
+		});
 	//make sure the message queue/dispatcher queue is empty
 	//if this is not done, there may be a crash on process exit.
-	drain_message_queue();
-	if (m_islandapp)
+	teardown.add_step("drain_message_queue", [this]() { drain_message_queue(); }, { "cancel_pending_work", "stop_background_executor" });
+	//The windows that the pooled controls came from are gone, so nothing can reuse them.
+	teardown.add_step("destroy_pooled_controls", [this]()
+		{
+			if (!m_child_controls)
+			{
+				return;
+			}
+
+			m_memory_governor.remove_consumer(m_child_controls_consumer);
+			m_child_controls->clear();
+			const auto &statistics = m_child_controls->get_statistics();
+			log_info(log_message::child_controls_summary, statistics.created, statistics.reused, statistics.released, statistics.destroyed, statistics.max_pooled);
+			m_child_controls.reset();
+			m_parking_window.reset();
+		}, { "drain_message_queue" });
+	//The cached boxes are xaml property values, release them while the xaml host is still there.
+	teardown.add_step("release_cached_values", [this]()
+		{
+			const auto statistics = m_value_cache.get_statistics();
+			log_info(log_message::value_cache_summary, statistics.format_calls, statistics.allocations(), statistics.strings.hits, statistics.integers.hits);
+			m_value_cache.clear();
+
+			const auto &staging = m_property_staging.get_counters();
+			log_info(log_message::property_staging_summary, staging.writes_requested, staging.writes_applied, staging.writes_unchanged, staging.flushes);
+			m_property_staging.clear();
+
+			for (auto &consumer : m_memory_governor.get_report())
+			{
+				log_info(log_message::memory_consumer_summary, consumer.name, consumer.usage, consumer.peak_usage, consumer.budget, consumer.trims, consumer.bytes_trimmed);
+			}
+			const auto &memory = m_memory_governor.get_statistics();
+			log_info(log_message::memory_governor_summary, memory.updates, memory.pressure_signals, memory.low_pressure_trims, memory.critical_pressure_trims, memory.pressure_ignored, memory.budget_trims, memory.bytes_trimmed);
+
+			const auto &arena = m_frame_arena.get_statistics();
+			log_info(log_message::frame_arena_summary, arena.resets, arena.chunk_allocations, static_cast<uint64_t>(arena.high_water), m_pump_heap_allocations);
+		}, { "drain_message_queue" });
+	teardown.add_step("close_island_application", [this]()
+		{
+			if (m_islandapp)
+			{
+				m_islandapp.Close();
+				m_islandapp = nullptr;
+			}
+		}, { "release_cached_values" });
+
+	for (auto &timing : teardown.run())
 	{
-		m_islandapp.Close();
-		m_islandapp = nullptr;
+		log_info(log_message::shutdown_step, timing.name, std::chrono::duration_cast<std::chrono::microseconds>(timing.duration).count(), timing.succeeded ? L"" : L" (failed)");
 	}
 }
 
@@ -68,25 +238,38 @@ void main_application::merge_resources(std::vector<mux::ResourceDictionary> cons
 }
 
 //Clears any remaining message in the message queue.
-void main_application::drain_message_queue()
+//The drain is bounded, a window that keeps posting messages to itself can't hold up
+//shutdown forever.
+bounded_drain_result main_application::drain_message_queue(bounded_drain_limits const &limits)
 {
 	MSG msg{};
 
-	while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+	const auto result = bounded_drain([&msg]()
+		{
+			if (!PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+			{
+				return false;
+			}
+			DispatchMessageW(&msg);
+			return true;
+		}, limits);
+
+	if (result.hit_message_limit || result.hit_time_limit)
 	{
-		DispatchMessageW(&msg);
+		log_warning(log_message::message_drain_incomplete, result.messages, std::chrono::duration_cast<std::chrono::microseconds>(result.duration).count());
 	}
+	return result;
 }
 
 //Finds any top level window on the same thread that this application class was
 //created on.
 void main_application::detect_top_level_windows()
 {
-	std::vector<HWND> windows{};
+	auto windows = make_frame_vector<HWND>(m_frame_arena);
 	//Enumerates top level windows.
 	EnumThreadWindows(m_creator_thread_id, [](HWND hwnd, LPARAM param) -> BOOL
 		{
-			std::vector<HWND> &windows = *reinterpret_cast<std::vector<HWND> *>(param);
+			frame_vector<HWND> &windows = *reinterpret_cast<frame_vector<HWND> *>(param);
 
 			//Place the window handle into a vector.
 			windows.push_back(hwnd);
@@ -112,85 +295,777 @@ void main_application::detect_top_level_windows()
 	}
 }
 
-void main_application::get_xaml_sources()
+//Asks every window_base window to route the message to its xaml sources.
+//Each window decides whether its islands take part, windows with suspended
+//islands skip PreTranslateMessage entirely.
+bool main_application::filter_message(const MSG &msg)
 {
-	//For every window_base pointer that we have, request any xaml sources from them.
-	//This is then used to filter the messages.
 	for (auto &window : m_windows)
 	{
-		const auto &sources = window->get_xaml_sources();
+		if (window->pre_translate_message(msg))
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-		m_sources.insert(m_sources.end(), sources.begin(), sources.end());
+//Input that means the user is acting on the application.
+//Mouse movement doesn't count, the pointer passing over the window isn't the user doing anything.
+bool is_user_input(UINT message)
+{
+	switch (message)
+	{
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:
+	case WM_LBUTTONDOWN:
+	case WM_RBUTTONDOWN:
+	case WM_MBUTTONDOWN:
+	case WM_XBUTTONDOWN:
+	case WM_NCLBUTTONDOWN:
+	case WM_MOUSEWHEEL:
+	case WM_MOUSEHWHEEL:
+	case WM_POINTERDOWN:
+		return true;
 	}
+	return false;
 }
 
-//For every xaml source that we have obtained from the top level windows, obtain
-//the IDesktopWindowXamlSourceNative2 interface and call PreTranslateMessage.
-//This function is used to route Xaml messages to the xaml sources so they can
-//function correctly.
-bool main_application::filter_message(const MSG &msg)
+//The input messages that the latency probe follows.
+//Mouse and pointer moves aren't followed, there are too many of them and nothing waits on them.
+bool get_input_kind(UINT message, input_kind &kind)
 {
-	for (auto &source : m_sources)
+	switch (message)
 	{
-		BOOL handled = FALSE;
-		auto native = source.as<IDesktopWindowXamlSourceNative>();
+	case WM_KEYDOWN:
+	case WM_KEYUP:
+	case WM_SYSKEYDOWN:
+	case WM_SYSKEYUP:
+		kind = input_kind::key;
+		return true;
+	case WM_CHAR:
+	case WM_SYSCHAR:
+		kind = input_kind::character;
+		return true;
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONUP:
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONUP:
+	case WM_XBUTTONDOWN:
+	case WM_XBUTTONUP:
+		kind = input_kind::mouse_button;
+		return true;
+	case WM_MOUSEWHEEL:
+	case WM_MOUSEHWHEEL:
+		kind = input_kind::mouse_wheel;
+		return true;
+	case WM_POINTERDOWN:
+	case WM_POINTERUP:
+		kind = input_kind::pointer;
+		return true;
+	}
+	return false;
+}
+
+//MSG::time is the tick count when the input was generated. The tick count wraps, so the age is
+//worked out as a difference, and it can come out below zero because of the tick granularity.
+std::chrono::steady_clock::time_point get_input_time(MSG const &msg, std::chrono::steady_clock::time_point now)
+{
+	const auto age = static_cast<int32_t>(GetTickCount() - msg.time);
+	return now - std::chrono::milliseconds(std::max(age, 0));
+}
 
-		winrt::check_hresult(native->PreTranslateMessage(&msg, &handled));
-		if (handled != FALSE)
+//The spans are only formatted when trace logging is compiled in.
+void log_latency_span([[maybe_unused]] latency_span const &span)
+{
+	if constexpr (log_level::trace >= log_minimum_level)
+	{
+		log_trace(log_message::input_latency_span, format_latency_span(span));
+	}
+}
+
+//The parts of the message that the trace records before it is routed.
+message_trace_message make_message_trace_message(MSG const &msg)
+{
+	message_trace_message trace{};
+	trace.window = reinterpret_cast<uintptr_t>(msg.hwnd);
+	trace.message = msg.message;
+	trace.wparam = msg.wParam;
+	trace.lparam = msg.lParam;
+	trace.time = msg.time;
+	trace.x = msg.pt.x;
+	trace.y = msg.pt.y;
+	trace.focus = reinterpret_cast<uintptr_t>(GetFocus());
+	//The replay needs these to work out which way Tab goes and whether Alt is held.
+	if (msg.message >= WM_KEYFIRST && msg.message <= WM_KEYLAST)
+	{
+		trace.modifiers |= (GetKeyState(VK_SHIFT) & 0x8000) != 0 ? static_cast<uint8_t>(message_trace_modifier::shift) : 0;
+		trace.modifiers |= (GetKeyState(VK_CONTROL) & 0x8000) != 0 ? static_cast<uint8_t>(message_trace_modifier::control) : 0;
+		trace.modifiers |= (GetKeyState(VK_MENU) & 0x8000) != 0 ? static_cast<uint8_t>(message_trace_modifier::alt) : 0;
+	}
+	return trace;
+}
+
+//The direct children with the tab stop style, in z-order, which is the order that dialog
+//navigation goes through them.
+frame_vector<uint64_t> get_tab_stops(HWND host, frame_arena &arena)
+{
+	auto tab_stops = make_frame_vector<uint64_t>(arena);
+	for (HWND child = GetWindow(host, GW_CHILD); child; child = GetWindow(child, GW_HWNDNEXT))
+	{
+		if ((GetWindowLongPtrW(child, GWL_STYLE) & WS_TABSTOP) != 0)
 		{
-			return true;
+			tab_stops.push_back(reinterpret_cast<uintptr_t>(child));
 		}
 	}
-	return false;
+	return tab_stops;
+}
+
+//Dispatches a single message.
+//The message goes to the xaml sources first, then keyboard navigation and
+//finally the window procedure.
+void main_application::process_message(MSG &msg)
+{
+	const auto target_window = reinterpret_cast<uint64_t>(msg.hwnd);
+	m_heartbeat.beat(pump_stage::filter, msg.message, target_window);
+
+	//The user is doing something, the prewarm mustn't get in the way of that.
+	if (m_xaml_prewarm_task != invalid_idle_task_id && is_user_input(msg.message))
+	{
+		cancel_xaml_prewarm();
+	}
+
+	//Input messages are followed from here to their handlers.
+	input_kind kind{};
+	const bool is_input = get_input_kind(msg.message, kind);
+	//The clock is only read if the probe or the trace is going to use the times.
+	const bool tracing = m_message_trace != nullptr;
+	const bool timed = is_input || tracing;
+	const auto stage_time = [timed]() { return timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}; };
+
+	message_trace_message trace{};
+	if (tracing)
+	{
+		//The focus and modifiers are taken before the routing can change them.
+		trace = make_message_trace_message(msg);
+	}
+
+	const auto dequeue_time = stage_time();
+	if (is_input)
+	{
+		m_latency_probe.begin(kind, get_input_time(msg, dequeue_time), dequeue_time);
+	}
+
+	//Filter the xaml messages first.
+	//If the message isn't handled by the xaml source, then we
+	//carry on with the message processing.
+	const bool filtered = filter_message(msg);
+	const auto filter_time = stage_time();
+	if (is_input)
+	{
+		m_latency_probe.mark(latency_stage::filtered, filter_time);
+	}
+	bool navigated = false;
+	auto navigate_time = filter_time;
+	auto dispatch_time = filter_time;
+	if (!filtered)
+	{
+		//Check for keyboard navigation next.
+		//If navigation doesn't occur then carry on with message
+		//processing.
+		m_heartbeat.beat(pump_stage::navigate, msg.message, target_window);
+		for (auto &window : m_windows)
+		{
+			navigated = window->focus_navigate(&msg);
+			if (navigated)
+			{
+				break;
+			}
+		}
+		navigate_time = stage_time();
+		dispatch_time = navigate_time;
+		if (is_input)
+		{
+			m_latency_probe.mark(latency_stage::navigated, navigate_time);
+		}
+		if (!navigated)
+		{
+			m_heartbeat.beat(pump_stage::dispatch, msg.message, target_window);
+			TranslateMessage(&msg);
+			DispatchMessageW(&msg);
+			dispatch_time = stage_time();
+		}
+	}
+
+	if (is_input)
+	{
+		m_latency_probe.end_dispatch();
+	}
+	if (tracing)
+	{
+		trace.outcome = static_cast<uint8_t>(filtered ? message_trace_outcome::filtered : navigated ? message_trace_outcome::navigated : message_trace_outcome::dispatched);
+		trace.dequeue_time = dequeue_time - m_message_trace_start;
+		trace.filter_duration = filter_time - dequeue_time;
+		trace.navigate_duration = navigate_time - filter_time;
+		trace.dispatch_duration = dispatch_time - navigate_time;
+		m_message_trace->write(trace);
+	}
+}
+
+//Checks whether anything has arrived in the message queue.
+//The high word of GetQueueStatus is what is currently in the queue.
+bool main_application::is_message_pending()
+{
+	return HIWORD(GetQueueStatus(QS_ALLINPUT)) != 0;
 }
 
 //Runs the message loop/message pump.
+//Rather than blocking in GetMessage, this empties the queue and then gives
+//any idle tasks a time budget before waiting for more messages.
 int main_application::run_message_loop()
 {
 	MSG msg{};
 
-	//Gets the windows and related xaml sources.
-	//This has the obvious problem of being static, so adding any windows or
-	//xaml sources after the message pump starts isn't possible with this code.
+	//Gets the windows.
+	//This has the obvious problem of being static, so adding any windows
+	//after the message pump starts isn't possible with this code.
+	//The xaml sources are asked for on every message, so islands added to
+	//a known window are picked up.
 	//There are a couple of obvious solutions to this, including posting thread
 	//messages or making the application a singleton.
 	detect_top_level_windows();
-	get_xaml_sources();
+	if (m_message_trace)
+	{
+		record_message_trace_topology();
+	}
+	set_timer(memory_check_interval, [this]() { check_memory(); }, { memory_check_tolerance, memory_check_interval });
+	start_hang_watchdog();
 
-	while (GetMessageW(&msg, nullptr, 0, 0))
+	bool quit = false;
+	while (!quit)
 	{
-		//Filter the xaml messages first.
-		//If the message isn't handled by the xaml source, then we
-		//carry on with the message processing.
-		if (!filter_message(msg))
+		m_heartbeat.beat(pump_stage::housekeeping);
+		//Nothing from the last iteration is still using the frame arena.
+		publish_gauge(live_counter::frame_arena_bytes, m_frame_arena.get_used());
+		m_frame_arena.reset();
+		//This is the one place where the governor can release the frame arena.
+		if (m_memory_check_due || m_memory_governor.has_pending_pressure())
 		{
-			//Check for keyboard navigation next.
-			//If navigation doesn't occur then carry on with message
-			//processing.
-			bool navigated = false;
-			for (auto &window : m_windows)
+			update_memory_governor();
+		}
+
+		uint64_t messages = 0;
+		const auto heap_allocations_before = get_thread_heap_allocations().allocations;
+		m_heartbeat.beat(pump_stage::peek);
+		while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+		{
+			if (msg.message == WM_QUIT)
 			{
-				navigated = window->focus_navigate(&msg);
-				if (navigated)
-				{
-					break;
-				}
+				quit = true;
+				break;
 			}
-			if (!navigated)
+			process_message(msg);
+			++messages;
+			m_heartbeat.beat(pump_stage::peek);
+		}
+		m_heartbeat.beat(pump_stage::housekeeping);
+		const auto heap_allocations = get_thread_heap_allocations().allocations - heap_allocations_before;
+		m_pump_heap_allocations += heap_allocations;
+		publish_counters({ { live_counter::pump_iterations, 1 }, { live_counter::messages_dispatched, static_cast<int64_t>(messages) }, { live_counter::pump_heap_allocations, static_cast<int64_t>(heap_allocations) } });
+		publish_gauge(live_counter::pump_depth, messages);
+		//Anything the messages did to the islands is in the trace before the next message.
+		if (m_message_trace)
+		{
+			record_message_trace_topology();
+			m_message_trace->flush_stale(std::chrono::steady_clock::now());
+		}
+		if (quit)
+		{
+			break;
+		}
+
+		//Results from the background executor are handed over once per iteration, so whatever
+		//they change goes into the same property batch as the messages.
+		if (m_background_executor)
+		{
+			m_heartbeat.beat(pump_stage::completions);
+			if (const auto completions_run = m_background_executor->run_completions(); completions_run != 0)
 			{
-				TranslateMessage(&msg);
-				DispatchMessageW(&msg);
+				publish_counter(live_counter::executor_completions, static_cast<int64_t>(completions_run));
 			}
+			publish_gauge(live_counter::executor_queue_depth, m_background_executor->get_queued_task_count());
 		}
+
+		//Everything the messages changed goes to xaml in one batch.
+		m_heartbeat.beat(pump_stage::property_flush);
+		m_property_staging.flush();
+		m_heartbeat.beat(pump_stage::housekeeping);
+
+		//Interactions that can't be given any more stages are added to the latency percentiles.
+		if (m_latency_probe.has_open_interactions())
+		{
+			m_latency_probe.collect(std::chrono::steady_clock::now(), &log_latency_span);
+		}
+
+		//Fire any pump timers that are due.
+		m_heartbeat.beat(pump_stage::timers);
+		if (const auto timers_run = m_timers.run_due(timer_wheel::clock::now()); timers_run != 0)
+		{
+			log_trace(log_message::pump_timers_run, timers_run);
+		}
+		m_heartbeat.beat(pump_stage::housekeeping);
+		arm_pump_timer();
+
+		//The queue is empty, so this is idle time.
+		//The scheduler stops as soon as a message arrives.
+		DWORD wait_timeout = m_timer_event ? INFINITE : get_timer_wait_timeout();
+		if (m_idle_scheduler.has_pending_tasks())
+		{
+			m_heartbeat.beat(pump_stage::idle_tasks);
+			const auto result = m_idle_scheduler.run(idle_budget, &main_application::is_message_pending);
+			//If the budget ran out then there is still work to do, so only check the
+			//queue before carrying on.
+			if (result.reason == idle_run_stop_reason::budget_exhausted)
+			{
+				wait_timeout = 0;
+			}
+		}
+
+		//MWMO_INPUTAVAILABLE makes this return if there is input in the queue that
+		//was seen, but not removed, by an earlier call to GetQueueStatus.
+		//The waitable timer wakes the pump for the next pump timer.
+		HANDLE timer_event = m_timer_event.get();
+		m_heartbeat.beat(pump_stage::waiting);
+		MsgWaitForMultipleObjectsEx(timer_event ? 1 : 0, timer_event ? &timer_event : nullptr, wait_timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	}
+	//The pump has stopped, so there is nothing left to watch. Shutdown work from here on would
+	//otherwise be reported as a stall in the last stage the pump beat.
+	if (m_hang_watchdog)
+	{
+		m_hang_watchdog->stop();
 	}
+	//Idle work and timers aren't carried over once the loop exits.
+	m_idle_scheduler.cancel_all();
+	m_timers.clear();
 	//The following has a known issue.
 	//If the main window is closed while another top level window is open, there will
 	//be a short period of time where there are windows visible but not properly routing
 	//navigation messages or filtering the messages for the xaml sources.
 	//This is fine for the sample, but a method of dealing with this needs to be devised.
-	//Clear the cached xaml sources.
-	m_sources.clear();
 	//Clear the cached window_base pointers here.
 	m_windows.clear();
 	return static_cast<int>(msg.wParam);
+}
+
+//Gets the scheduler used for work that runs when the message queue is empty.
+idle_scheduler &main_application::get_idle_scheduler()
+{
+	return m_idle_scheduler;
+}
+
+//Gets the value cache used for property updates.
+xaml_value_cache &main_application::get_value_cache()
+{
+	return m_value_cache;
+}
+
+//Gets the staging used for property updates.
+xaml_property_staging &main_application::get_property_staging()
+{
+	return m_property_staging;
+}
+
+//Gets the cache that the prewarm decodes into.
+xaml_text_cache &main_application::get_xaml_text_cache()
+{
+	return m_xaml_text_cache;
+}
+
+//Gets the recorder for xaml loads.
+xaml_usage_recorder &main_application::get_xaml_usage_recorder()
+{
+	return m_xaml_usage;
+}
+
+latency_probe &main_application::get_latency_probe()
+{
+	return m_latency_probe;
+}
+
+pump_heartbeat &main_application::get_heartbeat()
+{
+	return m_heartbeat;
+}
+
+frame_arena &main_application::get_frame_arena()
+{
+	return m_frame_arena;
+}
+
+memory_governor &main_application::get_memory_governor()
+{
+	return m_memory_governor;
+}
+
+win32_child_control_recycler &main_application::get_child_controls()
+{
+	if (!m_child_controls)
+	{
+		m_child_window_manager.instance = GetModuleHandleW(nullptr);
+		m_parking_window.reset(create_parking_window(m_child_window_manager.instance));
+		THROW_LAST_ERROR_IF(!m_parking_window);
+		m_child_window_manager.parking_window = m_parking_window.get();
+		m_child_controls = std::make_unique<win32_child_control_recycler>(m_child_window_manager);
+
+		//The pool is cheap to refill compared to the value cache, but dearer than the arena.
+		m_child_controls_consumer = m_memory_governor.add_consumer({ L"child_controls", 1, 0, [this]() { return m_child_controls->get_pooled_count() * pooled_control_bytes; }, [this](size_t target) { m_child_controls->trim(target / pooled_control_bytes); } });
+	}
+	return *m_child_controls;
+}
+
+void main_application::signal_memory_pressure(memory_pressure pressure)
+{
+	m_memory_governor.signal_pressure(pressure);
+}
+
+//The caches that are quickest to rebuild are trimmed first. Prewarmed text is only a head start
+//on reading the file, and the frame arena only costs a heap allocation to get back. The value
+//cache is last, since losing it puts allocations back on the property update path.
+void main_application::register_memory_consumers()
+{
+	m_memory_governor.add_consumer({ L"xaml_text_cache", 0, 0, [this]() { return m_xaml_text_cache.get_bytes(); }, [this](size_t target) { m_xaml_text_cache.trim(target); } });
+	m_memory_governor.add_consumer({ L"frame_arena", 1, 1024 * 1024, [this]() { return m_frame_arena.get_statistics().capacity; }, [this](size_t) { m_frame_arena.release(); } });
+	m_memory_governor.add_consumer({ L"value_cache", 2, 1024 * 1024, [this]() { return m_value_cache.get_bytes(); }, [this](size_t target) { m_value_cache.trim(target); } });
+}
+
+//The notification stays signalled for as long as memory is low, the governor's cooldown keeps
+//that from trimming on every check.
+void main_application::check_memory()
+{
+	BOOL low_memory = FALSE;
+	if (m_low_memory_notification && QueryMemoryResourceNotification(m_low_memory_notification.get(), &low_memory) && low_memory)
+	{
+		m_memory_governor.signal_pressure(memory_pressure::low);
+	}
+	m_memory_check_due = true;
+}
+
+void main_application::update_memory_governor()
+{
+	m_memory_check_due = false;
+	const auto result = m_memory_governor.update();
+	publish_gauge(live_counter::governed_memory_bytes, result.usage_after);
+	if (result.consumers_trimmed != 0)
+	{
+		log_info(log_message::memory_trimmed, get_memory_pressure_name(result.pressure), result.consumers_trimmed, result.usage_before, result.usage_after);
+	}
+}
+
+//The child of the top level window that contains the window. For a message going to xaml
+//content this is the island. None of this sends messages, so it works while the UI thread is stuck.
+HWND get_top_level_child(HWND window)
+{
+	const HWND root = GetAncestor(window, GA_ROOT);
+	if (!root || root == window)
+	{
+		return nullptr;
+	}
+
+	for (;;)
+	{
+		const HWND parent = GetAncestor(window, GA_PARENT);
+		if (!parent)
+		{
+			return nullptr;
+		}
+		if (parent == root)
+		{
+			return window;
+		}
+		window = parent;
+	}
+}
+
+//Where a thread was running, as a module and an offset into it.
+struct thread_location
+{
+	std::wstring module;
+	uint64_t offset = 0;
+};
+
+//The thread is only suspended for as long as it takes to read its instruction pointer. It could be
+//holding the loader lock, so the module is looked up after it has been resumed.
+thread_location sample_thread_location(HANDLE thread)
+{
+	thread_location location{};
+	if (SuspendThread(thread) == static_cast<DWORD>(-1))
+	{
+		return location;
+	}
+	CONTEXT context{};
+	context.ContextFlags = CONTEXT_CONTROL;
+	const bool have_context = GetThreadContext(thread, &context) != FALSE;
+	ResumeThread(thread);
+	if (!have_context)
+	{
+		return location;
+	}
+
+#if defined(_M_X64)
+	const auto address = static_cast<uintptr_t>(context.Rip);
+#elif defined(_M_ARM64)
+	const auto address = static_cast<uintptr_t>(context.Pc);
+#else
+	const auto address = static_cast<uintptr_t>(context.Eip);
+#endif
+	location.offset = address;
+	HMODULE module = nullptr;
+	if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCWSTR>(address), &module))
+	{
+		wchar_t path[MAX_PATH]{};
+		const auto length = GetModuleFileNameW(module, path, MAX_PATH);
+		location.module = std::filesystem::path(std::wstring_view(path, length)).filename().wstring();
+		location.offset = address - reinterpret_cast<uintptr_t>(module);
+	}
+	return location;
+}
+
+//If the thread can't be opened the stalls are still reported, just without the location.
+void main_application::start_hang_watchdog()
+{
+	m_ui_thread.reset(OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, m_creator_thread_id));
+	m_hang_watchdog = std::make_unique<hang_watchdog>(m_heartbeat, hang_watchdog_options{}, [this](stall_report const &report) { report_stall(report); });
+}
+
+//The location is sampled first, it is the only part of the report that depends on when it is taken.
+void main_application::report_stall(stall_report const &report)
+{
+	const auto stage = get_pump_stage_name(report.sample.stage);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(report.elapsed).count();
+	if (report.ended)
+	{
+		log_info(log_message::pump_stall_ended, stage, elapsed, get_stall_severity_name(report.severity));
+		return;
+	}
+
+	const auto location = m_ui_thread ? sample_thread_location(m_ui_thread.get()) : thread_location{};
+	const HWND window = reinterpret_cast<HWND>(report.sample.window);
+	const HWND island = report.sample.island != 0 ? reinterpret_cast<HWND>(report.sample.island) : (window ? get_top_level_child(window) : nullptr);
+	wchar_t class_name[64]{};
+	const int class_name_length = island ? GetClassNameW(island, class_name, static_cast<int>(std::size(class_name))) : 0;
+	log_warning(log_message::pump_stalled, get_stall_severity_name(report.severity), elapsed, stage, report.sample.message, report.sample.window, reinterpret_cast<uintptr_t>(island), std::wstring_view(class_name, class_name_length), location.module, location.offset);
+}
+
+//A worker wakes the pump with a thread message when it posts the first completion of a batch,
+//the same way post_delayed does.
+background_executor &main_application::get_background_executor()
+{
+	if (!m_background_executor)
+	{
+		const auto thread_id = m_creator_thread_id;
+		m_background_executor = std::make_unique<background_executor>(0, [thread_id]() { PostThreadMessageW(thread_id, WM_NULL, 0, 0); });
+	}
+	return *m_background_executor;
+}
+
+//The prewarm runs as a low priority idle task, one fragment at a time so that a message
+//arriving only has to wait for the fragment being decoded.
+void main_application::start_xaml_prewarm()
+{
+	if (m_xaml_prewarm_started)
+	{
+		return;
+	}
+	m_xaml_prewarm_started = true;
+
+	load_xaml_usage_history(get_xaml_usage_path(), m_xaml_usage_history);
+	auto plan = plan_xaml_prewarm(m_xaml_usage_history);
+	if (plan.empty())
+	{
+		return;
+	}
+	m_xaml_prewarmer.start(std::move(plan));
+
+	idle_task_options options{};
+	options.priority = idle_priority::low;
+	options.name = "xaml_prewarm";
+	m_xaml_prewarm_task = m_idle_scheduler.post([this](std::chrono::steady_clock::time_point slice_end)
+		{
+			while (m_xaml_prewarmer.prewarm_next())
+			{
+				if (std::chrono::steady_clock::now() >= slice_end)
+				{
+					return idle_task_result::more_work;
+				}
+			}
+			m_xaml_prewarm_task = invalid_idle_task_id;
+			return idle_task_result::complete;
+		}, options);
+}
+
+void main_application::cancel_xaml_prewarm()
+{
+	m_xaml_prewarmer.cancel();
+	if (m_xaml_prewarm_task != invalid_idle_task_id)
+	{
+		m_idle_scheduler.cancel(m_xaml_prewarm_task);
+		m_xaml_prewarm_task = invalid_idle_task_id;
+	}
+}
+
+//The file is written from the trace's writer thread, the sink keeps it open until then.
+bool main_application::start_message_trace(std::filesystem::path const &path)
+{
+	if (m_message_trace)
+	{
+		return true;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+	auto file = std::make_shared<wil::unique_hfile>(CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+	if (!*file)
+	{
+		log_warning(log_message::message_trace_not_started, GetLastError());
+		return false;
+	}
+
+	FILETIME start_time{};
+	GetSystemTimeAsFileTime(&start_time);
+	message_trace_header header{};
+	header.start_tick = GetTickCount();
+	header.start_time = (static_cast<uint64_t>(start_time.dwHighDateTime) << 32) | start_time.dwLowDateTime;
+
+	m_message_trace_start = std::chrono::steady_clock::now();
+	m_message_trace_topology.clear();
+	m_message_trace = std::make_unique<message_trace_writer>([file](std::span<const std::byte> bytes)
+		{
+			DWORD written = 0;
+			return WriteFile(file->get(), bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr) && written == bytes.size();
+		}, header);
+	return true;
+}
+
+void main_application::stop_message_trace()
+{
+	if (!m_message_trace)
+	{
+		return;
+	}
+
+	m_message_trace->close();
+	const auto statistics = m_message_trace->get_statistics();
+	log_info(log_message::message_trace_summary, statistics.messages, statistics.bytes_written, statistics.stalls, statistics.records_dropped, statistics.failed ? L" (failed)" : L"");
+	m_message_trace.reset();
+}
+
+//The routing only looks at the islands and the tab stops, so a window's topology is only
+//written again if one of those changed.
+void main_application::record_message_trace_topology()
+{
+	m_message_trace_topology.resize(m_windows.size());
+	for (size_t i = 0; i < m_windows.size(); ++i)
+	{
+		//This runs every iteration, so the current topology is only gathered in the frame arena.
+		const auto host = reinterpret_cast<uintptr_t>(m_windows[i]->get_handle());
+		const auto tab_stops = get_tab_stops(m_windows[i]->get_handle(), m_frame_arena);
+		const auto sources = m_windows[i]->get_xaml_source_handles(m_frame_arena);
+
+		auto &previous = m_message_trace_topology[i];
+		const auto same_source = [](HWND handle, uint64_t source) { return reinterpret_cast<uintptr_t>(handle) == source; };
+		if (host != previous.host || !std::ranges::equal(tab_stops, previous.tab_stops) || !std::ranges::equal(sources, previous.sources, same_source))
+		{
+			previous.host = host;
+			previous.tab_stops.assign(tab_stops.begin(), tab_stops.end());
+			previous.sources.clear();
+			for (auto handle : sources)
+			{
+				previous.sources.push_back(reinterpret_cast<uintptr_t>(handle));
+			}
+			m_message_trace->write(previous);
+		}
+	}
+}
+
+void main_application::post_delayed(std::chrono::nanoseconds delay, timer_wheel::callback callback)
+{
+	set_timer(delay, std::move(callback));
+}
+
+timer_id main_application::set_timer(std::chrono::nanoseconds delay, timer_wheel::callback callback, timer_options const &options)
+{
+	const auto id = m_timers.schedule(timer_wheel::clock::now() + delay, std::move(callback), options);
+	arm_pump_timer();
+
+	//Without the waitable timer, a pump waiting on another thread has to recalculate its timeout.
+	if (!m_timer_event && GetCurrentThreadId() != m_creator_thread_id)
+	{
+		PostThreadMessageW(m_creator_thread_id, WM_NULL, 0, 0);
+	}
+	return id;
+}
+
+bool main_application::cancel_timer(timer_id id)
+{
+	//The waitable timer is left alone, if it goes off early the pump just finds nothing due.
+	return m_timers.cancel(id);
+}
+
+size_t main_application::cancel_window_timers(HWND window)
+{
+	return m_timers.cancel_owner(reinterpret_cast<uintptr_t>(window));
+}
+
+//This can be called from any thread, the lock keeps two threads from setting the timer to
+//deadlines out of order.
+void main_application::arm_pump_timer()
+{
+	if (!m_timer_event)
+	{
+		return;
+	}
+
+	std::scoped_lock lock(m_timer_event_mutex);
+	const auto deadline = m_timers.next_deadline();
+	const auto now = timer_wheel::clock::now();
+	//Once the deadline has passed, the timer has gone off and has to be set again even for
+	//the same deadline.
+	if (deadline == m_timer_event_deadline && deadline > now)
+	{
+		return;
+	}
+
+	m_timer_event_deadline = deadline;
+	if (deadline == timer_wheel::time_point::max())
+	{
+		CancelWaitableTimer(m_timer_event.get());
+		return;
+	}
+
+	//A negative due time is relative, in 100ns units.
+	using filetime_duration = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+	LARGE_INTEGER due_time{};
+	due_time.QuadPart = -std::max<int64_t>(std::chrono::ceil<filetime_duration>(deadline - now).count(), 1);
+	SetWaitableTimer(m_timer_event.get(), &due_time, 0, nullptr, nullptr, FALSE);
+}
+
+DWORD main_application::get_timer_wait_timeout() const
+{
+	const auto deadline = m_timers.next_deadline();
+	if (deadline == timer_wheel::time_point::max())
+	{
+		return INFINITE;
+	}
+
+	const auto now = timer_wheel::clock::now();
+	if (deadline <= now)
+	{
+		return 0;
+	}
+
+	//Round up so the pump doesn't wake just before the deadline and spin.
+	const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+	return remaining >= static_cast<int64_t>(INFINITE) ? INFINITE - 1 : static_cast<DWORD>(remaining);
 }
\ No newline at end of file
@@ -5,6 +5,12 @@
 #include <Windows.h>
 #endif
 
+#ifndef _FILESYSTEM_
+#include <filesystem>
+#endif
+#ifndef _MEMORY_
+#include <memory>
+#endif
 #ifndef _VECTOR_
 #include <vector>
 #endif
@@ -25,7 +31,20 @@
 #endif
 
 #include "application_base.h"
+#include "background_executor.h"
+#include "frame_arena.h"
+#include "hang_watchdog.h"
+#include "idle_scheduler.h"
+#include "latency_probe.h"
+#include "memory_governor.h"
+#include "message_trace_writer.h"
+#include "teardown_coordinator.h"
+#include "timer_wheel.h"
+#include "value_cache.h"
+#include "win32_window_manager.h"
 #include "window_base.h"
+#include "xaml_prewarm.h"
+#include "xaml_property_staging.h"
 
 //This class is responsible for handling application related things.
 //It handles the lifetime of the IslandApplication component. This includes the xaml host and providing 
@@ -47,10 +66,78 @@ public:
 	//Removes all remaining messages in the message queue.
 	//This is useful since crashes can occur if there are remaining messages when
 	//the xaml host closes.
-	void drain_message_queue();
+	//The drain stops when it reaches either of the limits.
+	bounded_drain_result drain_message_queue(bounded_drain_limits const & = {});
 	//Executes the main message loop/message pump for the application.
 	int run_message_loop();
+	//Gets the scheduler for low priority work, such as cache warm up, trimming pools
+	//or flushing telemetry. Tasks only run when the message queue is empty.
+	idle_scheduler &get_idle_scheduler();
+	//Runs the callback on the pump's thread once the delay has passed.
+	//This can be called from any thread.
+	void post_delayed(std::chrono::nanoseconds, timer_wheel::callback);
+	//Runs the callback on the pump's thread once the delay has passed, and then after every period
+	//if the options have one. The pump fires every timer that is due in one batch, and timers
+	//with a tolerance are lined up so that the pump wakes for several of them at once.
+	//This can be called from any thread.
+	timer_id set_timer(std::chrono::nanoseconds delay, timer_wheel::callback, timer_options const & = {});
+	//Cancels a timer from set_timer. This can be called from any thread.
+	bool cancel_timer(timer_id);
+	//Cancels every timer that the window owns, windows call this when they are destroyed.
+	size_t cancel_window_timers(HWND);
+	//Gets the cache of interned strings and boxed values for property updates on the UI thread.
+	xaml_value_cache &get_value_cache();
+	//Gets the staging for xaml property writes on the UI thread.
+	//Staged writes are applied once the pump has emptied the message queue.
+	xaml_property_staging &get_property_staging();
+	//Reads what earlier runs loaded during startup and starts decoding it in idle time.
+	//The prewarm stops as soon as the user does something, and this run's usage is saved
+	//for the next run when the application is destroyed.
+	void start_xaml_prewarm();
+	//Gets the decoded xaml text from the prewarm. This can be used from any thread.
+	xaml_text_cache &get_xaml_text_cache();
+	//Gets the recorder for xaml loads on the UI thread.
+	xaml_usage_recorder &get_xaml_usage_recorder();
+	//Gets the probe that follows input messages to their handlers on the UI thread.
+	//The pump opens an interaction for each input message, handlers stamp the stages they run.
+	latency_probe &get_latency_probe();
+	//Gets the heartbeat that the pump beats for the hang watchdog.
+	//Window procedures use it to mark the modal loops that DefWindowProc runs.
+	pump_heartbeat &get_heartbeat();
+	//Records every message that the pump handles, what the routing did with it and how long
+	//it took, into a trace that XamlIslandTraceReplay can replay.
+	//Returns false if the file couldn't be created.
+	bool start_message_trace(std::filesystem::path const &);
+	//Writes the rest of the trace and closes it.
+	void stop_message_trace();
+	//Gets the pool for CPU heavy preparation, it is started the first time this is called.
+	//This must be called on the UI thread, the executor itself can be used from any thread.
+	//Completions run on the pump's thread, in one batch per pump iteration.
+	background_executor &get_background_executor();
+	//Gets the arena for allocations on the UI thread that are only needed until the next pump
+	//iteration. The pump resets it at the start of every iteration.
+	frame_arena &get_frame_arena();
+	//Gets the governor that keeps the caches and pools within their memory budgets.
+	//Consumers must be added and removed on the UI thread.
+	memory_governor &get_memory_governor();
+	//Gets the pool of native child controls, so that released controls are reused rather than
+	//destroyed. It is started the first time this is called, which must be on the UI thread.
+	win32_child_control_recycler &get_child_controls();
+	//Trims the caches and pools as if the system were short of memory.
+	//This can be called from any thread, the trimming happens on the pump's next iteration.
+	void signal_memory_pressure(memory_pressure);
 private:
+	//The maximum amount of time that idle tasks get before the queue is checked again.
+	static constexpr std::chrono::milliseconds idle_budget{ 8 };
+	//How often the budgets and the system's low memory notification are checked.
+	static constexpr std::chrono::milliseconds memory_check_interval{ 2000 };
+	static constexpr std::chrono::milliseconds memory_check_tolerance{ 1000 };
+	//The most the governed caches and pools should hold between them.
+	static constexpr size_t memory_total_budget = 8 * 1024 * 1024;
+	//A guess at what a pooled control costs, for the memory governor. Most of it is held by the
+	//window manager rather than the process.
+	static constexpr size_t pooled_control_bytes = 2048;
+
 	main_application();
 	main_application(const main_application &) = delete;
 	main_application(main_application &&) = delete;
@@ -61,13 +148,71 @@ private:
 	//It then makes sure that it is derived from window_base, and if it is, requests
 	//the pointer to the class.
 	void detect_top_level_windows();
-	//Obtains the collection of xaml sources from the window.
-	void get_xaml_sources();
 	//Does the message filtering for the xaml source.
 	bool filter_message(const MSG &);
+	//Filters, navigates and dispatches a single message.
+	void process_message(MSG &);
+	//Returns true if there are messages waiting in the queue.
+	static bool is_message_pending();
+	//Sets the waitable timer to the earliest pump timer.
+	void arm_pump_timer();
+	//Works out how long the pump can wait for messages before the next pump timer is due.
+	//This is only used if the waitable timer couldn't be created.
+	DWORD get_timer_wait_timeout() const;
+	//Stops the prewarm, what has already been decoded is kept.
+	void cancel_xaml_prewarm();
+	//Writes the windows and islands that the routing sees into the trace, if they have changed.
+	void record_message_trace_topology();
+	//Adds the application's own caches and pools to the memory governor.
+	void register_memory_consumers();
+	//Runs from a pump timer, it looks at the low memory notification and asks for a budget check.
+	void check_memory();
+	void update_memory_governor();
+	//Starts watching the pump's heartbeat, this must be called on the UI thread.
+	void start_hang_watchdog();
+	//Runs on the watchdog's thread, so it mustn't do anything that waits for the UI thread.
+	void report_stall(stall_report const &);
 
 	winrt::XamlIslandTest3::IslandApplication m_islandapp = nullptr;
 	std::vector<window_base *> m_windows{};
-	std::vector<winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource> m_sources{};
+	idle_scheduler m_idle_scheduler{};
+	timer_wheel m_timers{};
+	//The pump waits on this along with the message queue, it goes off when the earliest timer is due.
+	wil::unique_handle m_timer_event;
+	std::mutex m_timer_event_mutex;
+	//What m_timer_event was last set to, so that it is only set again if that changed.
+	timer_wheel::time_point m_timer_event_deadline = timer_wheel::time_point::max();
+	xaml_value_cache m_value_cache{};
+	xaml_property_staging m_property_staging{};
+	xaml_usage_recorder m_xaml_usage{};
+	xaml_usage_history m_xaml_usage_history{};
+	xaml_text_cache m_xaml_text_cache{};
+	xaml_prewarmer m_xaml_prewarmer{ m_xaml_text_cache, &read_xaml_text };
+	latency_probe m_latency_probe{};
+	std::unique_ptr<message_trace_writer> m_message_trace;
+	std::unique_ptr<background_executor> m_background_executor;
+	win32_child_window_manager m_child_window_manager{};
+	wil::unique_hwnd m_parking_window;
+	std::unique_ptr<win32_child_control_recycler> m_child_controls;
+	memory_governor::consumer_id m_child_controls_consumer = memory_governor::invalid_consumer_id;
+	frame_arena m_frame_arena{};
+	//The heap allocations made while handling messages, a steady state message shouldn't make any.
+	uint64_t m_pump_heap_allocations = 0;
+	//Pressure signalled from another thread wakes the pump, like a background completion.
+	memory_governor m_memory_governor{ { memory_total_budget }, [this]() { PostThreadMessageW(m_creator_thread_id, WM_NULL, 0, 0); } };
+	//Signalled by the system while memory is low.
+	wil::unique_handle m_low_memory_notification;
+	//The governor waits for the top of the pump, when nothing is using the frame arena.
+	bool m_memory_check_due = false;
+	//The pump beats this as it moves between stages, the watchdog samples it from its own thread.
+	pump_heartbeat m_heartbeat{};
+	std::unique_ptr<hang_watchdog> m_hang_watchdog;
+	//The UI thread, opened so that the watchdog can see where a stalled pump is.
+	wil::unique_handle m_ui_thread;
+	std::chrono::steady_clock::time_point m_message_trace_start{};
+	//The topology last written for each window, at the same index as m_windows.
+	std::vector<message_trace_topology> m_message_trace_topology;
+	idle_task_id m_xaml_prewarm_task = invalid_idle_task_id;
+	bool m_xaml_prewarm_started = false;
 	uint32_t m_creator_thread_id{};
 };
\ No newline at end of file
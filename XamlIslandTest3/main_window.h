@@ -8,6 +8,12 @@
 #include <winrt/Microsoft.UI.Xaml.Controls.h>
 #endif
 
+#include <array>
+#include <optional>
+
+#include "dpi_layout.h"
+#include "idle_scheduler.h"
+#include "window_state.h"
 #include "window_t.h"
 
 //This is the main window class.
@@ -30,9 +36,22 @@ protected:
 	bool on_create(const CREATESTRUCTW &);
 	void on_destroy();
 	void on_size(UINT state, int cx, int cy);
+	void on_dpi_changed(uint32_t dpi, const RECT &suggested);
+	bool on_get_dpi_scaled_size(uint32_t dpi, SIZE &);
+	void on_xaml_button_loaded(winrt::Microsoft::UI::Xaml::Controls::Button const &);
+	void on_xaml_button_load_failed(winrt::hresult);
 private:
 	//Helper functions for various functions.
 	void initialise_dpi();
+	//Positions the child windows using the layout for the current DPI.
+	void layout_children();
+	//Creates the island for the xaml button and starts loading the button.
+	void create_xaml_button_island();
+	//Gets the child windows in the same order as child_layout.
+	//The index into this is the control id used in the window state snapshot.
+	std::array<HWND, 3> get_child_windows() const;
+	//Records the window and its children so the next launch can restore them.
+	void save_window_state() const;
 	bool check_class_registered();
 	void register_window_class();
 
@@ -42,8 +61,15 @@ private:
 	winrt::Microsoft::UI::Xaml::Controls::Button m_xaml_button = nullptr;
 	HWND m_xaml_button_handle = nullptr;
 	winrt::Microsoft::UI::Xaml::Controls::Button::Click_revoker m_xaml_button_click_revoker{};
-	wil::unique_hwnd m_native_button1 = nullptr;
-	wil::unique_hwnd m_native_button2 = nullptr;
+	//Owned by the application's control pool.
+	HWND m_native_button1 = nullptr;
+	HWND m_native_button2 = nullptr;
 	uint32_t m_window_dpi = 0;
 	float_t m_window_dpi_scale = 0.f;
+	//The child layout scaled for each DPI the window has been shown at.
+	dpi_layout_cache m_layout_cache{};
+	//The state saved by the last run, if there was one.
+	std::optional<window_state_snapshot> m_restored_state;
+	//The idle task creating islands that weren't visible last time.
+	idle_task_id m_deferred_island_task = invalid_idle_task_id;
 };
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "pch.h"
+#include "memory_governor.h"
+
+#include <algorithm>
+
+std::wstring_view get_memory_pressure_name(memory_pressure pressure)
+{
+	switch (pressure)
+	{
+	case memory_pressure::none:
+		return L"none";
+	case memory_pressure::low:
+		return L"low";
+	case memory_pressure::critical:
+		return L"critical";
+	}
+	return L"unknown";
+}
+
+memory_governor::memory_governor(memory_governor_options const &options, wake_function wake) : m_options(options), m_wake(std::move(wake))
+{
+}
+
+memory_governor::consumer_id memory_governor::add_consumer(memory_consumer consumer)
+{
+	const auto id = m_next_id++;
+	const auto position = std::upper_bound(m_consumers.begin(), m_consumers.end(), consumer.priority, [](uint32_t priority, consumer_entry const &entry)
+		{
+			return priority < entry.consumer.priority;
+		});
+	auto &entry = *m_consumers.insert(position, consumer_entry{ id, std::move(consumer) });
+	entry.usage = entry.consumer.get_usage ? entry.consumer.get_usage() : 0;
+	entry.peak_usage = entry.usage;
+	m_usage += entry.usage;
+	return id;
+}
+
+void memory_governor::remove_consumer(consumer_id id)
+{
+	auto it = std::find_if(m_consumers.begin(), m_consumers.end(), [id](consumer_entry const &entry) { return entry.id == id; });
+	if (it != m_consumers.end())
+	{
+		m_usage -= std::min(m_usage, it->usage);
+		m_consumers.erase(it);
+	}
+}
+
+void memory_governor::signal_pressure(memory_pressure pressure)
+{
+	auto pending = m_pending_pressure.load(std::memory_order_relaxed);
+	while (pending < pressure)
+	{
+		if (m_pending_pressure.compare_exchange_weak(pending, pressure, std::memory_order_acq_rel))
+		{
+			if (m_wake)
+			{
+				m_wake();
+			}
+			return;
+		}
+	}
+}
+
+bool memory_governor::has_pending_pressure() const
+{
+	return m_pending_pressure.load(std::memory_order_relaxed) != memory_pressure::none;
+}
+
+memory_trim_result memory_governor::update(time_point now)
+{
+	++m_statistics.updates;
+	memory_trim_result result{};
+
+	auto pressure = m_pending_pressure.exchange(memory_pressure::none, std::memory_order_acq_rel);
+	if (pressure != memory_pressure::none)
+	{
+		++m_statistics.pressure_signals;
+		if (pressure <= m_last_pressure && now - m_last_pressure_time < m_options.pressure_cooldown)
+		{
+			++m_statistics.pressure_ignored;
+			pressure = memory_pressure::none;
+		}
+		else
+		{
+			m_last_pressure = pressure;
+			m_last_pressure_time = now;
+		}
+	}
+	result.pressure = pressure;
+
+	size_t total = 0;
+	for (auto &entry : m_consumers)
+	{
+		entry.usage = entry.consumer.get_usage ? entry.consumer.get_usage() : 0;
+		entry.peak_usage = std::max(entry.peak_usage, entry.usage);
+		total += entry.usage;
+	}
+	m_statistics.peak_usage = std::max(m_statistics.peak_usage, total);
+	result.usage_before = total;
+
+	switch (pressure)
+	{
+	case memory_pressure::critical:
+	{
+		++m_statistics.critical_pressure_trims;
+		result.consumers_trimmed = trim_to_total(total, 0);
+		break;
+	}
+	case memory_pressure::low:
+	{
+		++m_statistics.low_pressure_trims;
+		const auto base = m_options.total_budget != 0 ? std::min(m_options.total_budget, total) : total;
+		result.consumers_trimmed = trim_to_total(total, static_cast<size_t>(static_cast<double>(base) * m_options.low_pressure_fraction));
+		break;
+	}
+	default:
+		break;
+	}
+
+	//The budgets hold whether or not there is pressure.
+	size_t budget_trimmed = 0;
+	for (auto &entry : m_consumers)
+	{
+		if (entry.consumer.budget != 0 && entry.usage > entry.consumer.budget)
+		{
+			const auto before = entry.usage;
+			if (trim_consumer(entry, entry.consumer.budget))
+			{
+				total -= before - entry.usage;
+				++budget_trimmed;
+			}
+		}
+	}
+	if (m_options.total_budget != 0 && total > m_options.total_budget)
+	{
+		budget_trimmed += trim_to_total(total, m_options.total_budget);
+	}
+	if (budget_trimmed != 0)
+	{
+		++m_statistics.budget_trims;
+	}
+
+	result.consumers_trimmed += budget_trimmed;
+	result.usage_after = total;
+	m_usage = total;
+	return result;
+}
+
+size_t memory_governor::get_usage() const
+{
+	return m_usage;
+}
+
+std::vector<memory_consumer_report> memory_governor::get_report() const
+{
+	std::vector<memory_consumer_report> report;
+	report.reserve(m_consumers.size());
+	for (auto &entry : m_consumers)
+	{
+		report.push_back({ entry.consumer.name, entry.consumer.priority, entry.consumer.budget, entry.usage, entry.peak_usage, entry.trims, entry.bytes_trimmed });
+	}
+	return report;
+}
+
+memory_governor_statistics const &memory_governor::get_statistics() const
+{
+	return m_statistics;
+}
+
+bool memory_governor::trim_consumer(consumer_entry &entry, size_t target)
+{
+	if (entry.usage <= target || !entry.consumer.trim)
+	{
+		return false;
+	}
+
+	const auto before = entry.usage;
+	entry.consumer.trim(target);
+	//A consumer that measures higher after trimming is treated as not having changed.
+	entry.usage = std::min(before, entry.consumer.get_usage ? entry.consumer.get_usage() : 0);
+
+	++entry.trims;
+	entry.bytes_trimmed += before - entry.usage;
+	m_statistics.bytes_trimmed += before - entry.usage;
+	return true;
+}
+
+//The lowest priority consumers go first, and each one is only trimmed as far as is needed to
+//reach the target, so higher priorities keep what they have whenever possible.
+size_t memory_governor::trim_to_total(size_t &total, size_t target)
+{
+	size_t trimmed = 0;
+	for (auto &entry : m_consumers)
+	{
+		if (total <= target)
+		{
+			break;
+		}
+
+		const auto excess = total - target;
+		const auto before = entry.usage;
+		if (trim_consumer(entry, before - std::min(before, excess)))
+		{
+			total -= before - entry.usage;
+			++trimmed;
+		}
+	}
+	return trimmed;
+}
\ No newline at end of file
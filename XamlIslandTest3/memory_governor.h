@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Keeps the memory held by caches and pools within bounds.
+//Each cache or pool registers as a consumer, with a way to measure what it holds, a way to
+//give memory back and a budget. The governor trims consumers that go over their own budgets,
+//and if they are over the total budget together, it trims them in priority order.
+//When the system is short of memory, consumers are trimmed in priority order well below their
+//budgets, and under critical pressure everything that can be freed is.
+//Consumers are measured and trimmed by update, on the owner's thread. Pressure can be signalled
+//from any thread, it is handled by the next update.
+//This only uses the standard library, where the pressure comes from is up to the caller.
+
+enum class memory_pressure : uint8_t
+{
+	none,
+	//The system is running low, trim down to the low pressure target.
+	low,
+	//Free everything that can be freed.
+	critical
+};
+
+std::wstring_view get_memory_pressure_name(memory_pressure);
+
+struct memory_consumer
+{
+	std::wstring name;
+	//Consumers with lower priorities are trimmed first.
+	uint32_t priority = 0;
+	//The most the consumer should hold, 0 means it only counts towards the total budget.
+	size_t budget = 0;
+	//Returns the bytes the consumer holds. Estimates are fine, as long as trimming lowers them.
+	std::function<size_t()> get_usage;
+	//Frees memory until the consumer holds no more than the target, as far as it can.
+	std::function<void(size_t target)> trim;
+};
+
+struct memory_governor_options
+{
+	//The most all of the consumers together should hold, 0 means no total budget.
+	size_t total_budget = 0;
+	//Low pressure trims down to this fraction of the total budget, or of the current usage if
+	//there is no total budget.
+	double low_pressure_fraction = 0.5;
+	//After pressure has been handled, pressure that isn't any higher is ignored for this long.
+	//The consumers have only just been trimmed, doing it again would mostly throw away what
+	//was rebuilt in between.
+	std::chrono::milliseconds pressure_cooldown{ 5000 };
+};
+
+struct memory_consumer_report
+{
+	std::wstring name;
+	uint32_t priority = 0;
+	size_t budget = 0;
+	size_t usage = 0;
+	size_t peak_usage = 0;
+	uint64_t trims = 0;
+	uint64_t bytes_trimmed = 0;
+};
+
+struct memory_governor_statistics
+{
+	uint64_t updates = 0;
+	uint64_t pressure_signals = 0;
+	uint64_t low_pressure_trims = 0;
+	uint64_t critical_pressure_trims = 0;
+	//Pressure that arrived during the cooldown.
+	uint64_t pressure_ignored = 0;
+	//Updates that had to trim for a consumer's budget or the total budget.
+	uint64_t budget_trims = 0;
+	uint64_t bytes_trimmed = 0;
+	size_t peak_usage = 0;
+};
+
+//What an update did.
+struct memory_trim_result
+{
+	memory_pressure pressure = memory_pressure::none;
+	size_t usage_before = 0;
+	size_t usage_after = 0;
+	size_t consumers_trimmed = 0;
+};
+
+class memory_governor
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+	using consumer_id = uint32_t;
+	//Called from signal_pressure when pressure is raised, so the owner knows to call update.
+	using wake_function = std::function<void()>;
+
+	static constexpr consumer_id invalid_consumer_id = 0;
+
+	explicit memory_governor(memory_governor_options const & = {}, wake_function = nullptr);
+	memory_governor(const memory_governor &) = delete;
+	memory_governor(memory_governor &&) = delete;
+	memory_governor &operator=(const memory_governor &) = delete;
+	memory_governor &operator=(memory_governor &&) = delete;
+
+	consumer_id add_consumer(memory_consumer);
+	void remove_consumer(consumer_id);
+
+	//Records pressure for the next update. This can be called from any thread.
+	//The owner is only woken if this raises the pressure that is waiting.
+	void signal_pressure(memory_pressure);
+	bool has_pending_pressure() const;
+	//Handles any pressure that is waiting and enforces the budgets.
+	memory_trim_result update(time_point now = clock::now());
+
+	//The usage from the last update.
+	size_t get_usage() const;
+	//The consumers in the order that they are trimmed.
+	std::vector<memory_consumer_report> get_report() const;
+	memory_governor_statistics const &get_statistics() const;
+
+private:
+	struct consumer_entry
+	{
+		consumer_id id = invalid_consumer_id;
+		memory_consumer consumer;
+		size_t usage = 0;
+		size_t peak_usage = 0;
+		uint64_t trims = 0;
+		uint64_t bytes_trimmed = 0;
+	};
+
+	//Trims the consumer to the target and measures it again.
+	//Returns true if it was over the target.
+	bool trim_consumer(consumer_entry &, size_t target);
+	//Trims consumers in priority order until the total is down to the target.
+	size_t trim_to_total(size_t &total, size_t target);
+
+	memory_governor_options m_options;
+	wake_function m_wake;
+	//Kept in priority order, consumers with the same priority are in the order they were added.
+	std::vector<consumer_entry> m_consumers;
+	consumer_id m_next_id = 1;
+	size_t m_usage = 0;
+	std::atomic<memory_pressure> m_pending_pressure{ memory_pressure::none };
+	memory_pressure m_last_pressure = memory_pressure::none;
+	time_point m_last_pressure_time{};
+	memory_governor_statistics m_statistics{};
+};
\ No newline at end of file
@@ -0,0 +1,600 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//A compact binary trace of every message that the pump handled, along with what the message
+//routing did with it and how long each step took.
+//This is shared between the application, which records the trace, and XamlIslandTraceReplay,
+//which reads it back. It only uses the standard library, the caller does the file handling.
+//
+//The trace is a header followed by chunks. Each chunk is a byte count and a record count
+//followed by the records. Records are delta encoded against the record before them in the same
+//chunk, and windows are written in full once per chunk and then referred to by an index, so a
+//chunk can be decoded without the ones before it. If the process ends part way through writing a
+//chunk then the trace is read up to the chunk before it.
+
+constexpr uint32_t message_trace_magic = 0x544D5358; //XSMT
+constexpr uint32_t message_trace_version = 1;
+constexpr size_t message_trace_header_size = 24;
+constexpr size_t message_trace_chunk_header_size = 8;
+
+struct message_trace_header
+{
+	uint32_t version = message_trace_version;
+	//The tick count when recording started, MSG::time is written relative to this.
+	uint32_t start_tick = 0;
+	//The wall clock time when recording started, in 100ns units since 1601.
+	uint64_t start_time = 0;
+};
+
+//What the pump did with the message.
+enum class message_trace_outcome : uint8_t
+{
+	none = 0,
+	//A xaml source handled it in PreTranslateMessage.
+	filtered = 1,
+	//Keyboard navigation handled it.
+	navigated = 2,
+	//It went to TranslateMessage and DispatchMessage.
+	dispatched = 4
+};
+
+//The modifier keys that were down when the message was removed from the queue.
+//They are only recorded for keyboard messages.
+enum class message_trace_modifier : uint8_t
+{
+	none = 0,
+	shift = 1,
+	control = 2,
+	alt = 4
+};
+
+struct message_trace_message
+{
+	uint64_t window = 0;
+	uint32_t message = 0;
+	uint64_t wparam = 0;
+	int64_t lparam = 0;
+	//MSG::time and MSG::pt.
+	uint32_t time = 0;
+	int32_t x = 0;
+	int32_t y = 0;
+	//The window with the keyboard focus before the message was routed.
+	uint64_t focus = 0;
+	uint8_t modifiers = 0;
+	uint8_t outcome = 0;
+	//When the message was removed from the queue, from the start of the trace.
+	std::chrono::nanoseconds dequeue_time{};
+	std::chrono::nanoseconds filter_duration{};
+	//Only recorded if the message wasn't filtered.
+	std::chrono::nanoseconds navigate_duration{};
+	//Only recorded if the message was dispatched.
+	std::chrono::nanoseconds dispatch_duration{};
+
+	bool has_outcome(message_trace_outcome value) const
+	{
+		return (outcome & static_cast<uint8_t>(value)) != 0;
+	}
+
+	bool has_modifier(message_trace_modifier value) const
+	{
+		return (modifiers & static_cast<uint8_t>(value)) != 0;
+	}
+};
+
+//The windows that the routing looks at for a top level window. This is written when recording
+//starts and whenever the islands change, and replaces what was written before for the window.
+struct message_trace_topology
+{
+	uint64_t host = 0;
+	//The children with the tab stop style, in tab order.
+	std::vector<uint64_t> tab_stops;
+	//The island windows, in the order the xaml sources are given to the routing.
+	std::vector<uint64_t> sources;
+};
+
+enum class message_trace_record_kind : uint8_t
+{
+	message,
+	topology
+};
+
+//Variable length integers are little endian groups of 7 bits, with the top bit set on every
+//byte but the last. Signed values are zigzag encoded first so small negative deltas stay short.
+inline void append_trace_varint(std::vector<std::byte> &buffer, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<std::byte>(value));
+}
+
+inline void append_trace_signed(std::vector<std::byte> &buffer, int64_t value)
+{
+	append_trace_varint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+inline void append_trace_fixed(std::vector<std::byte> &buffer, uint64_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		buffer.push_back(static_cast<std::byte>(value >> (i * 8)));
+	}
+}
+
+inline void write_trace_fixed(std::byte *destination, uint64_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		destination[i] = static_cast<std::byte>(value >> (i * 8));
+	}
+}
+
+inline uint64_t read_trace_fixed(std::byte const *source, size_t bytes)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		value |= static_cast<uint64_t>(source[i]) << (i * 8);
+	}
+	return value;
+}
+
+inline void append_message_trace_header(std::vector<std::byte> &buffer, message_trace_header const &header)
+{
+	append_trace_fixed(buffer, message_trace_magic, 4);
+	append_trace_fixed(buffer, header.version, 4);
+	append_trace_fixed(buffer, header.start_tick, 4);
+	append_trace_fixed(buffer, 0, 4);
+	append_trace_fixed(buffer, header.start_time, 8);
+}
+
+//Encodes records into chunks.
+//The tag byte of a message record holds the kind in the low bit, the outcome in the next three
+//and flags for the fields that are left out because they haven't changed.
+class message_trace_encoder
+{
+public:
+	explicit message_trace_encoder(uint32_t start_tick = 0) : m_start_tick(start_tick)
+	{
+	}
+
+	//Starts a chunk at the end of the buffer. The delta state starts again with each chunk.
+	void begin_chunk(std::vector<std::byte> &buffer)
+	{
+		m_chunk_start = buffer.size();
+		m_record_count = 0;
+		m_windows.clear();
+		m_previous = {};
+		m_previous.time = m_start_tick;
+		append_trace_fixed(buffer, 0, message_trace_chunk_header_size);
+	}
+
+	//Fills in the chunk header. Returns false if the chunk has no records, in which case it has
+	//been removed from the buffer.
+	bool end_chunk(std::vector<std::byte> &buffer)
+	{
+		if (m_record_count == 0)
+		{
+			buffer.resize(m_chunk_start);
+			return false;
+		}
+		const auto payload = buffer.size() - m_chunk_start - message_trace_chunk_header_size;
+		write_trace_fixed(buffer.data() + m_chunk_start, payload, 4);
+		write_trace_fixed(buffer.data() + m_chunk_start + 4, m_record_count, 4);
+		return true;
+	}
+
+	uint32_t get_record_count() const
+	{
+		return m_record_count;
+	}
+
+	void add(std::vector<std::byte> &buffer, message_trace_message const &message)
+	{
+		const bool same_message = message.message == m_previous.message;
+		const bool same_focus = message.focus == m_previous.focus;
+		uint8_t tag = static_cast<uint8_t>(message_trace_record_kind::message);
+		tag |= static_cast<uint8_t>((message.outcome & 7) << 1);
+		tag |= same_message ? 0x10 : 0;
+		tag |= same_focus ? 0 : 0x20;
+		tag |= message.modifiers != 0 ? 0x40 : 0;
+		buffer.push_back(static_cast<std::byte>(tag));
+
+		append_window(buffer, message.window);
+		if (!same_message)
+		{
+			append_trace_varint(buffer, message.message);
+		}
+		append_trace_varint(buffer, message.wparam);
+		append_trace_signed(buffer, message.lparam);
+		append_trace_signed(buffer, static_cast<int32_t>(message.time - m_previous.time));
+		append_trace_signed(buffer, static_cast<int64_t>(message.x) - m_previous.x);
+		append_trace_signed(buffer, static_cast<int64_t>(message.y) - m_previous.y);
+		//The pump removes messages in order, so this only goes backwards if the caller's clock does.
+		append_trace_signed(buffer, (message.dequeue_time - m_previous.dequeue_time).count());
+		if (!same_focus)
+		{
+			append_window(buffer, message.focus);
+		}
+		if (message.modifiers != 0)
+		{
+			buffer.push_back(static_cast<std::byte>(message.modifiers));
+		}
+		append_trace_varint(buffer, static_cast<uint64_t>(message.filter_duration.count()));
+		if (!message.has_outcome(message_trace_outcome::filtered))
+		{
+			append_trace_varint(buffer, static_cast<uint64_t>(message.navigate_duration.count()));
+		}
+		if (message.has_outcome(message_trace_outcome::dispatched))
+		{
+			append_trace_varint(buffer, static_cast<uint64_t>(message.dispatch_duration.count()));
+		}
+
+		m_previous = message;
+		++m_record_count;
+	}
+
+	void add(std::vector<std::byte> &buffer, message_trace_topology const &topology)
+	{
+		buffer.push_back(static_cast<std::byte>(message_trace_record_kind::topology));
+		append_window(buffer, topology.host);
+		append_trace_varint(buffer, topology.tab_stops.size());
+		for (auto window : topology.tab_stops)
+		{
+			append_window(buffer, window);
+		}
+		append_trace_varint(buffer, topology.sources.size());
+		for (auto window : topology.sources)
+		{
+			append_window(buffer, window);
+		}
+		++m_record_count;
+	}
+
+private:
+	//A window that has been written in the chunk is written as its index. A window that hasn't
+	//is written as the next index followed by the handle.
+	void append_window(std::vector<std::byte> &buffer, uint64_t window)
+	{
+		for (size_t i = 0; i < m_windows.size(); ++i)
+		{
+			if (m_windows[i] == window)
+			{
+				append_trace_varint(buffer, i);
+				return;
+			}
+		}
+		append_trace_varint(buffer, m_windows.size());
+		append_trace_varint(buffer, window);
+		m_windows.push_back(window);
+	}
+
+	uint32_t m_start_tick;
+	size_t m_chunk_start = 0;
+	uint32_t m_record_count = 0;
+	//There are only ever a handful of windows, so a linear search is the quickest.
+	std::vector<uint64_t> m_windows;
+	message_trace_message m_previous{};
+};
+
+enum class message_trace_read_result
+{
+	ok,
+	//There are no more records.
+	end,
+	//The last chunk was cut short, the records before it were all read.
+	truncated,
+	bad_magic,
+	unsupported_version,
+	corrupt
+};
+
+struct message_trace_entry
+{
+	message_trace_record_kind kind = message_trace_record_kind::message;
+	message_trace_message message;
+	message_trace_topology topology;
+};
+
+//Reads the records of a trace that is in memory.
+//Nothing is trusted, a damaged trace stops the reading with corrupt rather than reading out of
+//bounds.
+class message_trace_reader
+{
+public:
+	explicit message_trace_reader(std::span<const std::byte> data) : m_data(data)
+	{
+	}
+
+	message_trace_read_result read_header(message_trace_header &header)
+	{
+		if (m_data.size() < message_trace_header_size)
+		{
+			return message_trace_read_result::truncated;
+		}
+		if (read_trace_fixed(m_data.data(), 4) != message_trace_magic)
+		{
+			return message_trace_read_result::bad_magic;
+		}
+		header.version = static_cast<uint32_t>(read_trace_fixed(m_data.data() + 4, 4));
+		header.start_tick = static_cast<uint32_t>(read_trace_fixed(m_data.data() + 8, 4));
+		header.start_time = read_trace_fixed(m_data.data() + 16, 8);
+		if (header.version != message_trace_version)
+		{
+			return message_trace_read_result::unsupported_version;
+		}
+		m_start_tick = header.start_tick;
+		m_position = message_trace_header_size;
+		m_header_read = true;
+		return message_trace_read_result::ok;
+	}
+
+	//Reads the next record. The header must have been read first.
+	message_trace_read_result next(message_trace_entry &entry)
+	{
+		if (!m_header_read)
+		{
+			return message_trace_read_result::corrupt;
+		}
+		while (m_chunk_records_left == 0)
+		{
+			const auto result = begin_chunk();
+			if (result != message_trace_read_result::ok)
+			{
+				return result;
+			}
+		}
+
+		if (!read_entry(entry))
+		{
+			return message_trace_read_result::corrupt;
+		}
+		--m_chunk_records_left;
+		//Every byte of the chunk must belong to its records.
+		if ((m_chunk_records_left == 0) != (m_position == m_chunk_end))
+		{
+			return message_trace_read_result::corrupt;
+		}
+		return message_trace_read_result::ok;
+	}
+
+	uint64_t get_chunks_read() const
+	{
+		return m_chunks_read;
+	}
+
+private:
+	message_trace_read_result begin_chunk()
+	{
+		if (m_position == m_data.size())
+		{
+			return message_trace_read_result::end;
+		}
+		if (m_data.size() - m_position < message_trace_chunk_header_size)
+		{
+			return message_trace_read_result::truncated;
+		}
+		const auto payload = read_trace_fixed(m_data.data() + m_position, 4);
+		const auto records = static_cast<uint32_t>(read_trace_fixed(m_data.data() + m_position + 4, 4));
+		m_position += message_trace_chunk_header_size;
+		if (payload > m_data.size() - m_position)
+		{
+			return message_trace_read_result::truncated;
+		}
+		//Every record is at least two bytes.
+		if (records == 0 || records > payload / 2)
+		{
+			return message_trace_read_result::corrupt;
+		}
+
+		m_chunk_end = m_position + static_cast<size_t>(payload);
+		m_chunk_records_left = records;
+		m_windows.clear();
+		m_previous = {};
+		m_previous.time = m_start_tick;
+		++m_chunks_read;
+		return message_trace_read_result::ok;
+	}
+
+	bool read_varint(uint64_t &value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7)
+		{
+			if (m_position == m_chunk_end)
+			{
+				return false;
+			}
+			const auto byte = static_cast<uint8_t>(m_data[m_position++]);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool read_signed(int64_t &value)
+	{
+		uint64_t encoded = 0;
+		if (!read_varint(encoded))
+		{
+			return false;
+		}
+		value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+		return true;
+	}
+
+	bool read_byte(uint8_t &value)
+	{
+		if (m_position == m_chunk_end)
+		{
+			return false;
+		}
+		value = static_cast<uint8_t>(m_data[m_position++]);
+		return true;
+	}
+
+	bool read_window(uint64_t &window)
+	{
+		uint64_t index = 0;
+		if (!read_varint(index) || index > m_windows.size())
+		{
+			return false;
+		}
+		if (index < m_windows.size())
+		{
+			window = m_windows[static_cast<size_t>(index)];
+			return true;
+		}
+		if (!read_varint(window))
+		{
+			return false;
+		}
+		m_windows.push_back(window);
+		return true;
+	}
+
+	bool read_windows(std::vector<uint64_t> &windows)
+	{
+		uint64_t count = 0;
+		//Each window is at least a byte.
+		if (!read_varint(count) || count > m_chunk_end - m_position)
+		{
+			return false;
+		}
+		windows.resize(static_cast<size_t>(count));
+		for (auto &window : windows)
+		{
+			if (!read_window(window))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool read_entry(message_trace_entry &entry)
+	{
+		uint8_t tag = 0;
+		if (!read_byte(tag))
+		{
+			return false;
+		}
+
+		entry.kind = static_cast<message_trace_record_kind>(tag & 1);
+		if (entry.kind == message_trace_record_kind::topology)
+		{
+			return tag == 1 && read_window(entry.topology.host) && read_windows(entry.topology.tab_stops) && read_windows(entry.topology.sources);
+		}
+
+		auto &message = entry.message;
+		message = {};
+		message.outcome = static_cast<uint8_t>((tag >> 1) & 7);
+		const bool same_message = (tag & 0x10) != 0;
+		const bool same_focus = (tag & 0x20) == 0;
+		const bool has_modifiers = (tag & 0x40) != 0;
+		if ((tag & 0x80) != 0)
+		{
+			return false;
+		}
+
+		uint64_t value = 0;
+		int64_t delta = 0;
+		if (!read_window(message.window))
+		{
+			return false;
+		}
+		if (same_message)
+		{
+			message.message = m_previous.message;
+		}
+		else
+		{
+			if (!read_varint(value) || value > UINT32_MAX)
+			{
+				return false;
+			}
+			message.message = static_cast<uint32_t>(value);
+		}
+		if (!read_varint(message.wparam) || !read_signed(message.lparam))
+		{
+			return false;
+		}
+		if (!read_signed(delta))
+		{
+			return false;
+		}
+		message.time = m_previous.time + static_cast<uint32_t>(delta);
+		if (!read_signed(delta))
+		{
+			return false;
+		}
+		message.x = static_cast<int32_t>(m_previous.x + delta);
+		if (!read_signed(delta))
+		{
+			return false;
+		}
+		message.y = static_cast<int32_t>(m_previous.y + delta);
+		if (!read_signed(delta))
+		{
+			return false;
+		}
+		message.dequeue_time = m_previous.dequeue_time + std::chrono::nanoseconds(delta);
+		message.focus = m_previous.focus;
+		if (!same_focus && !read_window(message.focus))
+		{
+			return false;
+		}
+		if (has_modifiers && !read_byte(message.modifiers))
+		{
+			return false;
+		}
+		if (!read_varint(value))
+		{
+			return false;
+		}
+		message.filter_duration = std::chrono::nanoseconds(static_cast<int64_t>(value));
+		if (!message.has_outcome(message_trace_outcome::filtered))
+		{
+			if (!read_varint(value))
+			{
+				return false;
+			}
+			message.navigate_duration = std::chrono::nanoseconds(static_cast<int64_t>(value));
+		}
+		if (message.has_outcome(message_trace_outcome::dispatched))
+		{
+			if (!read_varint(value))
+			{
+				return false;
+			}
+			message.dispatch_duration = std::chrono::nanoseconds(static_cast<int64_t>(value));
+		}
+
+		m_previous = message;
+		return true;
+	}
+
+	std::span<const std::byte> m_data;
+	size_t m_position = 0;
+	size_t m_chunk_end = 0;
+	uint32_t m_chunk_records_left = 0;
+	uint32_t m_start_tick = 0;
+	bool m_header_read = false;
+	uint64_t m_chunks_read = 0;
+	std::vector<uint64_t> m_windows;
+	message_trace_message m_previous{};
+};
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "message_trace_writer.h"
+
+message_trace_writer::message_trace_writer(sink sink, message_trace_header const &header, message_trace_writer_options const &options) : m_sink(std::move(sink)), m_options(options), m_encoder(header.start_tick)
+{
+	//Both buffers are allocated up front, the chunk only goes a record past the limit.
+	m_active.reserve(m_options.chunk_bytes + 256);
+	m_pending.reserve(m_options.chunk_bytes + 256);
+
+	append_message_trace_header(m_active, header);
+	begin_chunk(clock::now());
+	m_thread = std::thread(&message_trace_writer::run, this);
+}
+
+message_trace_writer::~message_trace_writer()
+{
+	close();
+}
+
+void message_trace_writer::begin_chunk(clock::time_point now)
+{
+	m_encoder.begin_chunk(m_active);
+	m_chunk_opened = now;
+}
+
+void message_trace_writer::write(message_trace_message const &message)
+{
+	if (m_closed || m_statistics.failed)
+	{
+		++m_statistics.records_dropped;
+		return;
+	}
+
+	m_encoder.add(m_active, message);
+	++m_statistics.messages;
+	if (m_active.size() >= m_options.chunk_bytes)
+	{
+		submit_chunk(true);
+	}
+}
+
+void message_trace_writer::write(message_trace_topology const &topology)
+{
+	if (m_closed || m_statistics.failed)
+	{
+		++m_statistics.records_dropped;
+		return;
+	}
+
+	m_encoder.add(m_active, topology);
+	++m_statistics.topologies;
+	if (m_active.size() >= m_options.chunk_bytes)
+	{
+		submit_chunk(true);
+	}
+}
+
+void message_trace_writer::flush_stale(clock::time_point now)
+{
+	if (m_closed || m_encoder.get_record_count() == 0 || now - m_chunk_opened < m_options.max_chunk_age)
+	{
+		return;
+	}
+	submit_chunk(false);
+}
+
+//Swaps the full buffer with the one that the writer thread has finished with.
+void message_trace_writer::submit_chunk(bool wait)
+{
+	{
+		std::unique_lock lock(m_mutex);
+		if (m_pending_ready)
+		{
+			if (!wait)
+			{
+				return;
+			}
+			const auto stall_start = clock::now();
+			m_condition.wait(lock, [this]() { return !m_pending_ready; });
+			++m_statistics.stalls;
+			m_statistics.stall_time += clock::now() - stall_start;
+		}
+		if (m_failed)
+		{
+			m_statistics.failed = true;
+			m_statistics.records_dropped += m_encoder.get_record_count();
+			m_active.clear();
+			return;
+		}
+
+		//An empty chunk is dropped, but the trace header still has to be written.
+		m_encoder.end_chunk(m_active);
+		if (!m_active.empty())
+		{
+			m_pending.swap(m_active);
+			m_pending_ready = true;
+		}
+	}
+	m_condition.notify_all();
+
+	m_active.clear();
+	begin_chunk(clock::now());
+}
+
+void message_trace_writer::close()
+{
+	if (m_closed)
+	{
+		return;
+	}
+
+	submit_chunk(true);
+	m_closed = true;
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_statistics.failed = m_statistics.failed || m_failed;
+}
+
+message_trace_writer_statistics message_trace_writer::get_statistics() const
+{
+	auto statistics = m_statistics;
+	std::lock_guard lock(m_mutex);
+	statistics.bytes_written = m_bytes_written;
+	statistics.chunks = m_chunks_written;
+	statistics.failed = statistics.failed || m_failed;
+	return statistics;
+}
+
+//The pending buffer belongs to this thread while it is marked as ready, so the sink is called
+//without the lock held.
+void message_trace_writer::run()
+{
+	std::unique_lock lock(m_mutex);
+	for (;;)
+	{
+		m_condition.wait(lock, [this]() { return m_pending_ready || m_stopping; });
+		if (!m_pending_ready)
+		{
+			break;
+		}
+
+		lock.unlock();
+		const bool written = !m_failed && m_sink(m_pending);
+		lock.lock();
+
+		if (written)
+		{
+			m_bytes_written += m_pending.size();
+			++m_chunks_written;
+		}
+		else
+		{
+			m_failed = true;
+		}
+		m_pending.clear();
+		m_pending_ready = false;
+		m_condition.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <condition_variable>
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#include <mutex>
+#include <span>
+#include <thread>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "message_trace.h"
+
+struct message_trace_writer_statistics
+{
+	uint64_t messages = 0;
+	uint64_t topologies = 0;
+	//Writes that reached the sink, the first one includes the trace header.
+	uint64_t chunks = 0;
+	uint64_t bytes_written = 0;
+	//Times that a chunk filled up while the previous one was still being written.
+	uint64_t stalls = 0;
+	std::chrono::nanoseconds stall_time{};
+	//Records that were thrown away because writing failed.
+	uint64_t records_dropped = 0;
+	bool failed = false;
+};
+
+struct message_trace_writer_options
+{
+	//A chunk is handed to the writer thread once it reaches this size.
+	size_t chunk_bytes = 64 * 1024;
+	//flush_stale hands over a chunk that has been open for longer than this, so a trace that
+	//is cut short doesn't lose more than this much.
+	std::chrono::milliseconds max_chunk_age{ 1000 };
+};
+
+//Records a message trace with two buffers. The recording thread only encodes into one buffer,
+//and when that is full it swaps it with the other one, which a writer thread hands to the sink.
+//The recording thread only waits if the writer thread hasn't finished with the previous buffer.
+//This is not thread safe, only one thread records.
+class message_trace_writer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	//Writes the bytes to the trace, returning false if they couldn't be written.
+	//This is called on the writer thread.
+	using sink = std::function<bool(std::span<const std::byte>)>;
+
+	message_trace_writer(sink, message_trace_header const &, message_trace_writer_options const & = {});
+	~message_trace_writer();
+	message_trace_writer(const message_trace_writer &) = delete;
+	message_trace_writer(message_trace_writer &&) = delete;
+	message_trace_writer &operator=(const message_trace_writer &) = delete;
+	message_trace_writer &operator=(message_trace_writer &&) = delete;
+
+	void write(message_trace_message const &);
+	void write(message_trace_topology const &);
+	//Hands over the open chunk if it is older than the maximum age, and the writer thread isn't
+	//busy. This never waits.
+	void flush_stale(clock::time_point now);
+	//Writes everything that has been recorded and stops the writer thread.
+	void close();
+
+	//The counts from the writer thread are only up to date once the writer is closed.
+	message_trace_writer_statistics get_statistics() const;
+
+private:
+	void begin_chunk(clock::time_point);
+	void submit_chunk(bool wait);
+	void run();
+
+	sink m_sink;
+	message_trace_writer_options m_options;
+	message_trace_encoder m_encoder;
+	std::vector<std::byte> m_active;
+	clock::time_point m_chunk_opened{};
+	bool m_closed = false;
+	message_trace_writer_statistics m_statistics{};
+
+	//Shared with the writer thread.
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::byte> m_pending;
+	bool m_pending_ready = false;
+	bool m_stopping = false;
+	bool m_failed = false;
+	uint64_t m_bytes_written = 0;
+	uint64_t m_chunks_written = 0;
+	std::thread m_thread;
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#include <unordered_map>
+#include <utility>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Counters for property_staging.
+//Requested is every call to stage, applied is every value that actually reached the sink.
+struct property_staging_counters
+{
+	size_t writes_requested = 0;
+	size_t writes_applied = 0;
+	//Writes that were the same as the value already applied.
+	size_t writes_unchanged = 0;
+	//Writes replaced by a later write to the same property before the flush.
+	size_t writes_superseded = 0;
+	size_t flushes = 0;
+};
+
+//Collects property writes and applies them in a batch.
+//Staging a write only records the value. When the staging is flushed, each property that
+//was written gets its last value, and only if that differs from the value last applied.
+//Setting the same property to the same value over and over never reaches the sink.
+//
+//Element identifies the object that owns the property, it must work with Hash and Equal.
+//Properties are identified by a number that the caller chooses.
+//Values must be comparable with ==.
+template <typename Element, typename Value, typename Hash = std::hash<Element>, typename Equal = std::equal_to<Element>>
+class property_staging
+{
+public:
+	//Records the value for the property.
+	void stage(Element const &element, uint32_t property, Value const &value)
+	{
+		++m_counters.writes_requested;
+
+		const property_key key{ element, property };
+		if (auto dirty = m_dirty_index.find(key); dirty != m_dirty_index.end())
+		{
+			++m_counters.writes_superseded;
+			m_dirty[dirty->second].value = value;
+			return;
+		}
+
+		if (auto applied = m_applied.find(key); applied != m_applied.end() && applied->second == value)
+		{
+			++m_counters.writes_unchanged;
+			return;
+		}
+
+		m_dirty_index.emplace(key, m_dirty.size());
+		m_dirty.push_back(dirty_entry{ key, value });
+	}
+
+	//Applies every staged value that has changed, in the order the properties were first written.
+	//The sink is called as sink(element, property, value).
+	//The staging is emptied before the sink is called, so the sink can stage more writes, which
+	//go into the next flush.
+	template <typename Sink>
+	size_t flush(Sink &&sink)
+	{
+		if (m_dirty.empty())
+		{
+			return 0;
+		}
+
+		++m_counters.flushes;
+		//Anything left from a flush where the sink threw is thrown away.
+		m_flushing.clear();
+		m_flushing.swap(m_dirty);
+		m_dirty_index.clear();
+
+		size_t applied_count = 0;
+		for (auto &entry : m_flushing)
+		{
+			auto applied = m_applied.find(entry.key);
+			//A write that was superseded may have put the property back how it was.
+			if (applied != m_applied.end() && applied->second == entry.value)
+			{
+				++m_counters.writes_unchanged;
+				continue;
+			}
+
+			sink(entry.key.element, entry.key.property, entry.value);
+			//The sink may have staged or forgotten things, so the iterator from above isn't reused.
+			m_applied.insert_or_assign(entry.key, std::move(entry.value));
+			++applied_count;
+		}
+		m_counters.writes_applied += applied_count;
+		m_flushing.clear();
+
+		return applied_count;
+	}
+
+	//Forgets everything about the element, staged and applied.
+	//This must be called when an element goes away, otherwise the staging keeps it.
+	void forget(Element const &element)
+	{
+		std::erase_if(m_applied, [&element](auto const &applied) { return Equal{}(applied.first.element, element); });
+
+		if (std::erase_if(m_dirty, [&element](dirty_entry const &entry) { return Equal{}(entry.key.element, element); }) != 0)
+		{
+			rebuild_dirty_index();
+		}
+	}
+
+	//Drops staged writes without applying them and forgets every applied value.
+	void clear()
+	{
+		m_dirty.clear();
+		m_dirty_index.clear();
+		m_applied.clear();
+	}
+
+	bool has_pending() const
+	{
+		return !m_dirty.empty();
+	}
+
+	size_t pending_count() const
+	{
+		return m_dirty.size();
+	}
+
+	property_staging_counters const &get_counters() const
+	{
+		return m_counters;
+	}
+
+private:
+	struct property_key
+	{
+		Element element;
+		uint32_t property;
+	};
+
+	struct property_key_hash
+	{
+		size_t operator()(property_key const &key) const
+		{
+			return Hash{}(key.element) ^ (static_cast<size_t>(key.property) * 0x9E3779B97F4A7C15ull);
+		}
+	};
+
+	struct property_key_equal
+	{
+		bool operator()(property_key const &a, property_key const &b) const
+		{
+			return a.property == b.property && Equal{}(a.element, b.element);
+		}
+	};
+
+	struct dirty_entry
+	{
+		property_key key;
+		Value value;
+	};
+
+	void rebuild_dirty_index()
+	{
+		m_dirty_index.clear();
+		for (size_t i = 0; i < m_dirty.size(); ++i)
+		{
+			m_dirty_index.emplace(m_dirty[i].key, i);
+		}
+	}
+
+	//The writes waiting for the next flush, in the order they were first staged.
+	std::vector<dirty_entry> m_dirty;
+	std::unordered_map<property_key, size_t, property_key_hash, property_key_equal> m_dirty_index;
+	//Swapped with m_dirty during a flush, so neither vector gives up its storage.
+	std::vector<dirty_entry> m_flushing;
+	//The value each property was last set to.
+	std::unordered_map<property_key, Value, property_key_hash, property_key_equal> m_applied;
+	property_staging_counters m_counters{};
+};
\ No newline at end of file
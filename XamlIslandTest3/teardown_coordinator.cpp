@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "teardown_coordinator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+teardown_coordinator::teardown_coordinator(clock_function clock_fn) : m_clock(std::move(clock_fn))
+{
+}
+
+void teardown_coordinator::add_step(std::string name, step_function function, std::vector<std::string> run_after)
+{
+	m_steps.push_back(step{ std::move(name), std::move(function), std::move(run_after) });
+}
+
+std::vector<std::string> teardown_coordinator::plan() const
+{
+	std::vector<std::string> names;
+
+	for (auto index : plan_indices())
+	{
+		names.push_back(m_steps[index].name);
+	}
+
+	return names;
+}
+
+std::vector<teardown_step_timing> teardown_coordinator::run()
+{
+	std::vector<teardown_step_timing> timings;
+	const auto order = plan_indices();
+	timings.reserve(order.size());
+
+	for (auto index : order)
+	{
+		auto &current = m_steps[index];
+		teardown_step_timing timing{};
+		timing.name = current.name;
+
+		const auto start = m_clock();
+		try
+		{
+			current.function();
+		}
+		catch (...)
+		{
+			timing.succeeded = false;
+		}
+		timing.duration = m_clock() - start;
+
+		timings.push_back(std::move(timing));
+	}
+
+	return timings;
+}
+
+//Kahn's algorithm, always picking the earliest added step that is ready so the
+//order is deterministic.
+std::vector<size_t> teardown_coordinator::plan_indices() const
+{
+	const auto count = m_steps.size();
+	std::vector<std::vector<size_t>> dependents(count);
+	std::vector<size_t> remaining_dependencies(count, 0);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (auto &dependency : m_steps[i].run_after)
+		{
+			auto it = std::find_if(m_steps.begin(), m_steps.end(), [&dependency](step const &s) { return s.name == dependency; });
+			if (it == m_steps.end())
+			{
+				throw std::logic_error("teardown step depends on an unknown step: " + dependency);
+			}
+			dependents[static_cast<size_t>(it - m_steps.begin())].push_back(i);
+			++remaining_dependencies[i];
+		}
+	}
+
+	std::vector<size_t> order;
+	std::vector<bool> scheduled(count, false);
+	order.reserve(count);
+
+	while (order.size() < count)
+	{
+		size_t next = count;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!scheduled[i] && remaining_dependencies[i] == 0)
+			{
+				next = i;
+				break;
+			}
+		}
+		if (next == count)
+		{
+			throw std::logic_error("teardown steps have a dependency cycle");
+		}
+
+		scheduled[next] = true;
+		order.push_back(next);
+		for (auto dependent : dependents[next])
+		{
+			--remaining_dependencies[dependent];
+		}
+	}
+
+	return order;
+}
+
+bounded_drain_result bounded_drain(std::function<bool()> const &process_one, bounded_drain_limits const &limits, teardown_coordinator::clock_function const &clock)
+{
+	bounded_drain_result result{};
+	const auto start = clock();
+	const auto end = start + limits.max_time;
+
+	for (;;)
+	{
+		if (result.messages >= limits.max_messages)
+		{
+			result.hit_message_limit = true;
+			break;
+		}
+		if (clock() >= end)
+		{
+			result.hit_time_limit = true;
+			break;
+		}
+		if (!process_one())
+		{
+			break;
+		}
+		++result.messages;
+	}
+
+	result.duration = clock() - start;
+	return result;
+}
\ No newline at end of file
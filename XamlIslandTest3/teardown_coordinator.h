@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//The result of one teardown step.
+struct teardown_step_timing
+{
+	std::string name;
+	std::chrono::nanoseconds duration{};
+	//False if the step threw. Later steps still run.
+	bool succeeded = true;
+};
+
+//Runs shutdown steps in dependency order and times each of them.
+//Steps with no ordering between them run in the order they were added.
+class teardown_coordinator
+{
+public:
+	using step_function = std::function<void()>;
+	using clock_function = std::function<std::chrono::steady_clock::time_point()>;
+
+	explicit teardown_coordinator(clock_function = &std::chrono::steady_clock::now);
+
+	//Adds a step that runs after all of the named steps.
+	void add_step(std::string name, step_function, std::vector<std::string> run_after = {});
+	//Works out the order the steps will run in.
+	//Throws std::logic_error if a dependency is unknown or the dependencies form a cycle.
+	std::vector<std::string> plan() const;
+	//Runs every step once, in planned order.
+	//An exception from a step is recorded and doesn't stop the remaining steps, shutdown
+	//has to get as far as it can.
+	std::vector<teardown_step_timing> run();
+
+private:
+	struct step
+	{
+		std::string name;
+		step_function function;
+		std::vector<std::string> run_after;
+	};
+
+	std::vector<size_t> plan_indices() const;
+
+	clock_function m_clock;
+	std::vector<step> m_steps;
+};
+
+//Limits for a bounded drain.
+struct bounded_drain_limits
+{
+	size_t max_messages = 1024;
+	std::chrono::nanoseconds max_time = std::chrono::milliseconds(250);
+};
+
+//What a bounded drain did.
+struct bounded_drain_result
+{
+	size_t messages = 0;
+	bool hit_message_limit = false;
+	bool hit_time_limit = false;
+	std::chrono::nanoseconds duration{};
+};
+
+//Processes messages until there are none left or a limit is reached.
+//process_one removes and handles a single message, returning false if there was nothing to handle.
+bounded_drain_result bounded_drain(std::function<bool()> const &process_one, bounded_drain_limits const &, teardown_coordinator::clock_function const & = &std::chrono::steady_clock::now);
\ No newline at end of file
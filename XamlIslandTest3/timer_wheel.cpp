@@ -0,0 +1,582 @@
+#include "pch.h"
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+timer_wheel::timer_wheel(time_point start) : m_start(start)
+{
+}
+
+timer_id timer_wheel::schedule(time_point deadline, callback function, timer_options const &options)
+{
+	std::scoped_lock lock(m_mutex);
+
+	const auto index = allocate_entry();
+	auto &entry = m_entries[index];
+	entry.deadline = deadline;
+	entry.tolerance = options.tolerance;
+	entry.period = options.period;
+	entry.owner = options.owner;
+	entry.function = std::move(function);
+	entry.state = entry_state::scheduled;
+	entry.tick = get_fire_tick(deadline, options.tolerance);
+	if (entry.tick != get_tick(deadline, true))
+	{
+		++m_statistics.coalesced;
+	}
+
+	place(index);
+	link_owner(index);
+	++m_statistics.scheduled;
+
+	//A new timer can only bring the earliest tick forward.
+	if (m_next_tick_valid)
+	{
+		m_next_tick = std::min(m_next_tick, std::max(entry.tick, m_current_tick));
+	}
+	return make_id(index);
+}
+
+bool timer_wheel::cancel(timer_id id)
+{
+	//The callback is destroyed once the lock is released, in case that calls back into the wheel.
+	callback released;
+
+	std::scoped_lock lock(m_mutex);
+	auto *entry = find(id);
+	if (!entry)
+	{
+		return false;
+	}
+
+	if (entry->state == entry_state::firing || entry->state == entry_state::running)
+	{
+		//A timer that only fires once and has run can't be cancelled, a periodic timer mustn't
+		//be put back.
+		if (entry->state == entry_state::running && entry->period <= std::chrono::nanoseconds::zero())
+		{
+			return false;
+		}
+		entry->state = entry_state::cancelled;
+		++m_statistics.cancelled;
+		return true;
+	}
+	if (entry->state != entry_state::scheduled)
+	{
+		return false;
+	}
+
+	const auto index = static_cast<uint32_t>(entry - m_entries.data());
+	//The earliest tick only has to be worked out again if this timer could have been it.
+	if (entry->tick <= m_next_tick)
+	{
+		m_next_tick_valid = false;
+	}
+	released = std::move(entry->function);
+	unlink(index);
+	unlink_owner(index);
+	free_entry(index);
+	++m_statistics.cancelled;
+	return true;
+}
+
+size_t timer_wheel::cancel_owner(uint64_t owner)
+{
+	std::vector<callback> released;
+
+	std::scoped_lock lock(m_mutex);
+	const auto found = m_owners.find(owner);
+	if (owner == 0 || found == m_owners.end())
+	{
+		return 0;
+	}
+
+	size_t cancelled = 0;
+	for (auto index = found->second; index != no_entry;)
+	{
+		auto &entry = m_entries[index];
+		const auto next = entry.owner_next;
+		if (entry.state == entry_state::scheduled)
+		{
+			if (entry.tick <= m_next_tick)
+			{
+				m_next_tick_valid = false;
+			}
+			released.push_back(std::move(entry.function));
+			unlink(index);
+			unlink_owner(index);
+			free_entry(index);
+			++cancelled;
+		}
+		else if (entry.state == entry_state::firing || (entry.state == entry_state::running && entry.period > std::chrono::nanoseconds::zero()))
+		{
+			entry.state = entry_state::cancelled;
+			++cancelled;
+		}
+		index = next;
+	}
+
+	m_statistics.cancelled += cancelled;
+	return cancelled;
+}
+
+size_t timer_wheel::run_due(time_point now)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		const auto target = get_tick(now, false);
+		if (target > m_current_tick)
+		{
+			advance(target);
+		}
+
+		auto &due = m_lists[due_list];
+		for (auto index = due.head; index != no_entry;)
+		{
+			auto &entry = m_entries[index];
+			const auto next = entry.next;
+			entry.list = no_entry;
+			entry.previous = no_entry;
+			entry.next = no_entry;
+			entry.state = entry_state::firing;
+			m_batch.push_back({ index, std::move(entry.function) });
+			index = next;
+		}
+		due = {};
+
+		if (m_batch.empty())
+		{
+			return 0;
+		}
+		m_next_tick_valid = false;
+		++m_statistics.batches;
+		m_statistics.max_batch = std::max(m_statistics.max_batch, m_batch.size());
+	}
+
+	//Periodic timers are put back, and everything else freed, even if a callback throws.
+	//If one does, the rest of the batch doesn't run.
+	struct batch_guard
+	{
+		timer_wheel &wheel;
+		time_point now;
+		~batch_guard()
+		{
+			wheel.finish_batch(now);
+		}
+	};
+
+	//An earlier callback in the batch can cancel a later timer, such as by destroying the
+	//window that owns it, so each one is checked again just before it runs.
+	size_t count = 0;
+	batch_guard guard{ *this, now };
+	for (auto &fired : m_batch)
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			auto &entry = m_entries[fired.index];
+			if (entry.state != entry_state::firing)
+			{
+				continue;
+			}
+			entry.state = entry_state::running;
+			++m_statistics.fired;
+		}
+		++count;
+		fired.function();
+	}
+	return count;
+}
+
+timer_wheel::time_point timer_wheel::next_deadline() const
+{
+	std::scoped_lock lock(m_mutex);
+	if (!m_next_tick_valid)
+	{
+		m_next_tick = get_next_tick();
+		m_next_tick_valid = true;
+	}
+
+	if (m_next_tick == UINT64_MAX || m_next_tick > static_cast<uint64_t>((time_point::max() - m_start) / tick_length))
+	{
+		return time_point::max();
+	}
+	return m_start + m_next_tick * tick_length;
+}
+
+bool timer_wheel::empty() const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_statistics.active == 0;
+}
+
+//Timers that are firing are marked as cancelled, run_due frees them when they return.
+void timer_wheel::clear()
+{
+	std::vector<callback> released;
+
+	std::scoped_lock lock(m_mutex);
+	for (uint32_t index = 0; index < m_entries.size(); ++index)
+	{
+		auto &entry = m_entries[index];
+		if (entry.state == entry_state::scheduled)
+		{
+			released.push_back(std::move(entry.function));
+			unlink(index);
+			unlink_owner(index);
+			free_entry(index);
+			++m_statistics.cancelled;
+		}
+		else if (entry.state == entry_state::firing || entry.state == entry_state::running)
+		{
+			entry.state = entry_state::cancelled;
+		}
+	}
+	m_next_tick_valid = false;
+}
+
+timer_wheel_statistics timer_wheel::get_statistics() const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_statistics;
+}
+
+uint64_t timer_wheel::get_tick(time_point time, bool round_up) const
+{
+	if (time <= m_start)
+	{
+		return 0;
+	}
+
+	const auto elapsed = time - m_start;
+	const auto ticks = static_cast<uint64_t>(elapsed / tick_length);
+	return round_up && elapsed % tick_length != elapsed.zero() ? ticks + 1 : ticks;
+}
+
+uint64_t timer_wheel::get_fire_tick(time_point deadline, std::chrono::nanoseconds tolerance) const
+{
+	const auto earliest = get_tick(deadline, true);
+	if (tolerance <= std::chrono::nanoseconds::zero() || deadline > time_point::max() - tolerance)
+	{
+		return earliest;
+	}
+
+	const auto latest = get_tick(deadline + tolerance, false);
+	if (latest <= earliest)
+	{
+		return earliest;
+	}
+
+	//The largest power of two with a multiple in the window.
+	for (auto shift = static_cast<int>(std::bit_width(latest)) - 1; shift > 0; --shift)
+	{
+		const auto rounded = ((earliest + (1ull << shift) - 1) >> shift) << shift;
+		if (rounded <= latest)
+		{
+			return rounded;
+		}
+	}
+	return earliest;
+}
+
+void timer_wheel::place(uint32_t index)
+{
+	const auto tick = m_entries[index].tick;
+	if (tick <= m_current_tick)
+	{
+		link(due_list, index);
+		return;
+	}
+
+	//The level is the one whose slot field holds the highest bit where the tick differs from
+	//the current tick. Every level above that is in the same rotation.
+	const auto highest_difference = static_cast<uint32_t>(std::bit_width(tick ^ m_current_tick)) - 1;
+	const auto level = highest_difference / slot_bits;
+	if (level >= wheel_levels)
+	{
+		link(overflow_list, index);
+		return;
+	}
+
+	const auto slot = static_cast<uint32_t>((tick >> (level * slot_bits)) & (wheel_slots - 1));
+	link(level * wheel_slots + slot, index);
+	m_occupied[level] |= 1ull << slot;
+}
+
+void timer_wheel::link(uint32_t list, uint32_t index)
+{
+	auto &entries = m_lists[list];
+	auto &entry = m_entries[index];
+	entry.list = list;
+	entry.previous = entries.tail;
+	entry.next = no_entry;
+	if (entries.tail != no_entry)
+	{
+		m_entries[entries.tail].next = index;
+	}
+	else
+	{
+		entries.head = index;
+	}
+	entries.tail = index;
+}
+
+void timer_wheel::unlink(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	if (entry.list == no_entry)
+	{
+		return;
+	}
+
+	auto &entries = m_lists[entry.list];
+	(entry.previous != no_entry ? m_entries[entry.previous].next : entries.head) = entry.next;
+	(entry.next != no_entry ? m_entries[entry.next].previous : entries.tail) = entry.previous;
+	if (entries.head == no_entry && entry.list < overflow_list)
+	{
+		m_occupied[entry.list / wheel_slots] &= ~(1ull << (entry.list % wheel_slots));
+	}
+
+	entry.list = no_entry;
+	entry.previous = no_entry;
+	entry.next = no_entry;
+}
+
+void timer_wheel::link_owner(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	if (entry.owner == 0)
+	{
+		return;
+	}
+
+	auto [found, inserted] = m_owners.try_emplace(entry.owner, index);
+	entry.owner_previous = no_entry;
+	entry.owner_next = inserted ? no_entry : found->second;
+	if (!inserted)
+	{
+		m_entries[found->second].owner_previous = index;
+		found->second = index;
+	}
+}
+
+void timer_wheel::unlink_owner(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	if (entry.owner == 0)
+	{
+		return;
+	}
+
+	if (entry.owner_next != no_entry)
+	{
+		m_entries[entry.owner_next].owner_previous = entry.owner_previous;
+	}
+	if (entry.owner_previous != no_entry)
+	{
+		m_entries[entry.owner_previous].owner_next = entry.owner_next;
+	}
+	else if (entry.owner_next != no_entry)
+	{
+		m_owners[entry.owner] = entry.owner_next;
+	}
+	else
+	{
+		m_owners.erase(entry.owner);
+	}
+
+	entry.owner_previous = no_entry;
+	entry.owner_next = no_entry;
+}
+
+uint32_t timer_wheel::allocate_entry()
+{
+	++m_statistics.active;
+	if (m_free_entries != no_entry)
+	{
+		const auto index = m_free_entries;
+		m_free_entries = m_entries[index].next;
+		m_entries[index].next = no_entry;
+		return index;
+	}
+
+	m_entries.emplace_back();
+	return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+//Bumping the generation makes any id that is still held for the entry stale.
+void timer_wheel::free_entry(uint32_t index)
+{
+	auto &entry = m_entries[index];
+	entry.function = nullptr;
+	entry.owner = 0;
+	entry.state = entry_state::free;
+	++entry.generation;
+	entry.next = m_free_entries;
+	m_free_entries = index;
+	--m_statistics.active;
+}
+
+void timer_wheel::advance(uint64_t target)
+{
+	constexpr uint32_t range_bits = wheel_levels * slot_bits;
+
+	while (m_current_tick < target)
+	{
+		//Jump to the next tick that something happens on: a level 0 slot that fires, a higher
+		//slot that moves down a level, or the end of the top rotation if anything overflowed.
+		auto tick = target;
+		for (uint32_t level = 0; level < wheel_levels; ++level)
+		{
+			const auto shift = level * slot_bits;
+			const auto current_slot = (m_current_tick >> shift) & (wheel_slots - 1);
+			//Only the slots after the current one can be in use.
+			const auto later = current_slot == wheel_slots - 1 ? 0 : m_occupied[level] & (~0ull << (current_slot + 1));
+			if (later != 0)
+			{
+				const auto rotation = shift + slot_bits;
+				const auto slot_tick = ((m_current_tick >> rotation) << rotation) + (static_cast<uint64_t>(std::countr_zero(later)) << shift);
+				tick = std::min(tick, slot_tick);
+			}
+		}
+		if (m_lists[overflow_list].head != no_entry)
+		{
+			tick = std::min(tick, ((m_current_tick >> range_bits) + 1) << range_bits);
+		}
+		m_current_tick = tick;
+
+		//Higher levels go first, since what they move down can land in a slot of the level
+		//below that is also due now.
+		if ((tick & ((1ull << range_bits) - 1)) == 0)
+		{
+			redistribute(overflow_list);
+		}
+		for (uint32_t level = wheel_levels - 1; level > 0; --level)
+		{
+			const auto shift = level * slot_bits;
+			const auto slot = static_cast<uint32_t>((tick >> shift) & (wheel_slots - 1));
+			if ((tick & ((1ull << shift) - 1)) == 0 && (m_occupied[level] & (1ull << slot)) != 0)
+			{
+				redistribute(level * wheel_slots + slot);
+			}
+		}
+		if (const auto slot = static_cast<uint32_t>(tick & (wheel_slots - 1)); (m_occupied[0] & (1ull << slot)) != 0)
+		{
+			redistribute(slot);
+		}
+	}
+}
+
+//Takes every entry out of the list and places it again for the current tick.
+//For a level 0 slot this moves them all to the due list.
+void timer_wheel::redistribute(uint32_t list)
+{
+	auto index = m_lists[list].head;
+	m_lists[list] = {};
+	if (list < overflow_list)
+	{
+		m_occupied[list / wheel_slots] &= ~(1ull << (list % wheel_slots));
+	}
+
+	while (index != no_entry)
+	{
+		auto &entry = m_entries[index];
+		const auto next = entry.next;
+		entry.list = no_entry;
+		place(index);
+		if (list >= wheel_slots)
+		{
+			++m_statistics.cascaded;
+		}
+		index = next;
+	}
+}
+
+//The earliest tick is in the due list, or in the first slot in use on some level, since every
+//timer in a slot is due before any timer in a later slot of the same level.
+uint64_t timer_wheel::get_next_tick() const
+{
+	if (m_lists[due_list].head != no_entry)
+	{
+		return m_current_tick;
+	}
+
+	const auto earliest_in = [this](uint32_t list)
+		{
+			uint64_t earliest = UINT64_MAX;
+			for (auto index = m_lists[list].head; index != no_entry; index = m_entries[index].next)
+			{
+				earliest = std::min(earliest, m_entries[index].tick);
+			}
+			return earliest;
+		};
+
+	uint64_t next = earliest_in(overflow_list);
+	for (uint32_t level = 0; level < wheel_levels; ++level)
+	{
+		if (m_occupied[level] != 0)
+		{
+			next = std::min(next, earliest_in(level * wheel_slots + static_cast<uint32_t>(std::countr_zero(m_occupied[level]))));
+		}
+	}
+	return next;
+}
+
+void timer_wheel::finish_batch(time_point now)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		for (auto &fired : m_batch)
+		{
+			auto &entry = m_entries[fired.index];
+			//A periodic timer that didn't get to run, because a callback before it threw, is
+			//still put back.
+			if ((entry.state == entry_state::running || entry.state == entry_state::firing) && entry.period > std::chrono::nanoseconds::zero())
+			{
+				//Periods that have already gone by are skipped, keeping to the original phase.
+				auto deadline = entry.deadline + entry.period;
+				if (deadline <= now)
+				{
+					const auto missed = (now - deadline) / entry.period + 1;
+					m_statistics.periods_skipped += static_cast<uint64_t>(missed);
+					deadline += missed * entry.period;
+				}
+				entry.deadline = deadline;
+				entry.tick = get_fire_tick(deadline, entry.tolerance);
+				entry.function = std::move(fired.function);
+				entry.state = entry_state::scheduled;
+				place(fired.index);
+			}
+			else
+			{
+				unlink_owner(fired.index);
+				free_entry(fired.index);
+			}
+		}
+		m_next_tick_valid = false;
+	}
+
+	//The callbacks of the timers that are done are destroyed outside of the lock.
+	m_batch.clear();
+}
+
+timer_wheel::entry *timer_wheel::find(timer_id id)
+{
+	const auto index = static_cast<uint32_t>(id & 0xFFFFFFFF) - 1;
+	if (id == invalid_timer_id || index >= m_entries.size())
+	{
+		return nullptr;
+	}
+
+	auto &entry = m_entries[index];
+	if (entry.generation != static_cast<uint32_t>(id >> 32) || entry.state == entry_state::free)
+	{
+		return nullptr;
+	}
+	return &entry;
+}
+
+timer_id timer_wheel::make_id(uint32_t index) const
+{
+	return (static_cast<uint64_t>(m_entries[index].generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
\ No newline at end of file
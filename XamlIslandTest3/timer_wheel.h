@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _MUTEX_
+#include <mutex>
+#endif
+#include <unordered_map>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Timers that are fired by the message pump rather than by WM_TIMER.
+//Timers can be scheduled and cancelled from any thread, the callbacks always run on the thread
+//that calls run_due, in one batch.
+//
+//The timers are kept in a hierarchical timing wheel. Time is counted in ticks of tick_length,
+//and there are wheel_levels levels of wheel_slots slots. A level 0 slot holds the timers for one
+//tick, a level 1 slot holds the timers for wheel_slots ticks and so on. A timer goes in the lowest
+//level that can still tell its tick apart from the current one. When time reaches a slot in a
+//higher level, its timers are moved down a level, until they reach level 0 and fire. Timers too
+//far away for the top level wait in an overflow list.
+//Each slot is a list of pooled entries, so scheduling and cancelling a timer are both constant
+//time, and each level has a bitmap of the slots in use, so empty stretches of time are skipped
+//without visiting their slots.
+//
+//A timer can be given a tolerance, the time after its deadline that it can fire. The timer then
+//fires on the tick in that window that is a multiple of the largest power of two, so timers with
+//tolerances tend to land on the same ticks and the pump wakes up less often.
+//This only uses the standard library, waking the pump is left to the caller.
+
+using timer_id = uint64_t;
+constexpr timer_id invalid_timer_id = 0;
+
+struct timer_options
+{
+	//How late the timer is allowed to fire.
+	std::chrono::nanoseconds tolerance{};
+	//If this isn't zero, the timer fires again after each period until it is cancelled.
+	std::chrono::nanoseconds period{};
+	//Identifies what the timer belongs to, such as a window, so that all of its timers can be
+	//cancelled at once. 0 means no owner.
+	uint64_t owner = 0;
+};
+
+struct timer_wheel_statistics
+{
+	uint64_t scheduled = 0;
+	uint64_t fired = 0;
+	uint64_t cancelled = 0;
+	//Timers whose tick was moved later within their tolerance.
+	uint64_t coalesced = 0;
+	//Times a timer was moved down a level.
+	uint64_t cascaded = 0;
+	//Calls to run_due that fired anything.
+	uint64_t batches = 0;
+	size_t max_batch = 0;
+	//Periods that a periodic timer missed because the pump was late, they aren't made up.
+	uint64_t periods_skipped = 0;
+	size_t active = 0;
+};
+
+class timer_wheel
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+	using callback = std::function<void()>;
+
+	static constexpr std::chrono::milliseconds tick_length{ 1 };
+	static constexpr uint32_t slot_bits = 6;
+	static constexpr uint32_t wheel_slots = 1 << slot_bits;
+	static constexpr uint32_t wheel_levels = 6;
+
+	explicit timer_wheel(time_point start = clock::now());
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel(timer_wheel &&) = delete;
+	timer_wheel &operator=(const timer_wheel &) = delete;
+	timer_wheel &operator=(timer_wheel &&) = delete;
+
+	//Adds a timer that fires once the deadline has passed.
+	timer_id schedule(time_point deadline, callback, timer_options const & = {});
+	//Removes a timer. This is safe to call from a callback, including the timer's own.
+	//A timer that is in the batch being run, but hasn't run yet, doesn't run.
+	//Returns false if the timer doesn't exist or has already fired.
+	bool cancel(timer_id);
+	//Removes every timer with the owner. Returns the number removed.
+	size_t cancel_owner(uint64_t owner);
+	//Runs every callback whose tick has passed, in the order of their ticks.
+	//This must only be called from one thread, and not from a callback.
+	//Returns the number of callbacks run.
+	size_t run_due(time_point now);
+	//The time at which the earliest timer is due, or time_point::max() if there are no timers.
+	time_point next_deadline() const;
+	bool empty() const;
+	void clear();
+
+	timer_wheel_statistics get_statistics() const;
+
+private:
+	static constexpr uint32_t no_entry = UINT32_MAX;
+	static constexpr uint32_t overflow_list = wheel_levels * wheel_slots;
+	static constexpr uint32_t due_list = overflow_list + 1;
+	static constexpr uint32_t list_count = due_list + 1;
+
+	enum class entry_state : uint8_t
+	{
+		free,
+		scheduled,
+		//Taken out of the wheel into the batch, the callback hasn't run yet.
+		firing,
+		//The callback is running, or has run.
+		running,
+		//Cancelled while in the batch, the callback doesn't run if it hasn't yet, and the
+		//entry is freed once the batch is done.
+		cancelled
+	};
+
+	struct entry
+	{
+		time_point deadline{};
+		std::chrono::nanoseconds tolerance{};
+		std::chrono::nanoseconds period{};
+		uint64_t tick = 0;
+		uint64_t owner = 0;
+		callback function;
+		//The list that the entry is in, and its neighbours there.
+		//A free entry uses next for the free list.
+		uint32_t list = no_entry;
+		uint32_t previous = no_entry;
+		uint32_t next = no_entry;
+		uint32_t owner_previous = no_entry;
+		uint32_t owner_next = no_entry;
+		uint32_t generation = 1;
+		entry_state state = entry_state::free;
+	};
+
+	struct entry_list
+	{
+		uint32_t head = no_entry;
+		uint32_t tail = no_entry;
+	};
+
+	struct batch_entry
+	{
+		uint32_t index = no_entry;
+		callback function;
+	};
+
+	uint64_t get_tick(time_point, bool round_up) const;
+	//Works out the tick for a deadline and tolerance.
+	uint64_t get_fire_tick(time_point deadline, std::chrono::nanoseconds tolerance) const;
+	//Puts a scheduled entry in the list for its tick.
+	void place(uint32_t index);
+	void link(uint32_t list, uint32_t index);
+	void unlink(uint32_t index);
+	void link_owner(uint32_t index);
+	void unlink_owner(uint32_t index);
+	uint32_t allocate_entry();
+	void free_entry(uint32_t index);
+	//Moves time forward to the tick, moving timers down levels and into the due list on the way.
+	void advance(uint64_t tick);
+	void redistribute(uint32_t list);
+	uint64_t get_next_tick() const;
+	//Puts the periodic timers from the batch back in the wheel and frees the rest.
+	void finish_batch(time_point now);
+	//Gets the entry for an id, or nullptr if the id is stale.
+	entry *find(timer_id);
+	timer_id make_id(uint32_t index) const;
+
+	mutable std::mutex m_mutex;
+	time_point m_start;
+	uint64_t m_current_tick = 0;
+	std::vector<entry> m_entries;
+	uint32_t m_free_entries = no_entry;
+	std::array<entry_list, list_count> m_lists{};
+	std::array<uint64_t, wheel_levels> m_occupied{};
+	//The first entry of each owner's list.
+	std::unordered_map<uint64_t, uint32_t> m_owners;
+	//The earliest tick is worked out when it is asked for, and kept until a change could move it.
+	mutable uint64_t m_next_tick = 0;
+	mutable bool m_next_tick_valid = false;
+	//Only used by run_due, the callbacks run from here once the lock is released.
+	std::vector<batch_entry> m_batch;
+	timer_wheel_statistics m_statistics{};
+};
\ No newline at end of file
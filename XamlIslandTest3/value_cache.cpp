@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "value_cache.h"
+
+namespace wf = winrt::Windows::Foundation;
+
+xaml_value_cache::xaml_value_cache(size_t string_capacity, int32_t smallest_integer, int32_t largest_integer)
+	: m_strings(string_capacity, [](std::wstring_view text) { return interned_string{ winrt::hstring(text), nullptr }; }),
+	m_integers(smallest_integer, largest_integer, [](int32_t value) { return winrt::box_value(value); })
+{
+}
+
+//Returning the hstring by value only adds a reference, the string isn't copied.
+winrt::hstring xaml_value_cache::intern(std::wstring_view text)
+{
+	return m_strings.intern(text).text;
+}
+
+wf::IInspectable xaml_value_cache::box_string(std::wstring_view text)
+{
+	auto &entry = m_strings.intern(text);
+	if (!entry.boxed)
+	{
+		entry.boxed = winrt::box_value(entry.text);
+	}
+	return entry.boxed;
+}
+
+wf::IInspectable xaml_value_cache::box_integer(int32_t value)
+{
+	if (auto boxed = m_integers.find_or_create(value))
+	{
+		return *boxed;
+	}
+
+	++m_uncached_boxes;
+	return winrt::box_value(value);
+}
+
+void xaml_value_cache::clear()
+{
+	m_strings.clear();
+	m_integers.clear();
+}
+
+void xaml_value_cache::trim(size_t target_bytes)
+{
+	if (target_bytes == 0)
+	{
+		clear();
+		return;
+	}
+
+	while (m_strings.size() != 0 && get_bytes() > target_bytes)
+	{
+		m_strings.trim(m_strings.size() - 1);
+	}
+}
+
+//The text is held twice, once as the key and once in the hstring.
+size_t xaml_value_cache::get_bytes() const
+{
+	return m_strings.get_text_bytes() * 2 + m_strings.size() * string_overhead_bytes;
+}
+
+value_cache_statistics xaml_value_cache::get_statistics() const
+{
+	value_cache_statistics statistics{};
+	statistics.format_calls = m_buffer.get_format_count();
+	statistics.buffer_growths = m_buffer.get_growth_count();
+	statistics.strings = m_strings.get_counters();
+	statistics.integers = m_integers.get_counters();
+	statistics.uncached_boxes = m_uncached_boxes;
+	return statistics;
+}
\ No newline at end of file
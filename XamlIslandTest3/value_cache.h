@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef WINRT_Windows_Foundation_H
+#include <winrt/Windows.Foundation.h>
+#endif
+
+#include "value_intern.h"
+
+//Counts for the value cache.
+//The allocations are the strings, boxes and buffer growth the cache had to make. For repeated
+//values this should stop increasing once the cache has warmed up.
+struct value_cache_statistics
+{
+	size_t format_calls = 0;
+	size_t buffer_growths = 0;
+	value_cache_counters strings{};
+	value_cache_counters integers{};
+	//Boxes made for integers outside of the cached range.
+	size_t uncached_boxes = 0;
+
+	size_t allocations() const
+	{
+		return buffer_growths + strings.misses + integers.misses + uncached_boxes;
+	}
+};
+
+//Supplies hstrings and boxed values for xaml property updates without allocating each time.
+//Strings are formatted into a reused buffer and interned, along with their boxed form, so
+//setting the same text again reuses the same objects. Small integers are boxed once.
+//This is not thread safe, it is meant to be used from the UI thread.
+class xaml_value_cache
+{
+public:
+	explicit xaml_value_cache(size_t string_capacity = 256, int32_t smallest_integer = -128, int32_t largest_integer = 1024);
+
+	//Gets the interned hstring for the text.
+	winrt::hstring intern(std::wstring_view);
+	//Gets the boxed form of the text, suitable for ContentControl::Content and the like.
+	winrt::Windows::Foundation::IInspectable box_string(std::wstring_view);
+	winrt::Windows::Foundation::IInspectable box_integer(int32_t);
+
+	//Formats the text using format_buffer's pattern syntax and interns the result.
+	template <typename... Args>
+	winrt::hstring format(std::wstring_view pattern, Args const &... args)
+	{
+		return intern(m_buffer.format(pattern, args...));
+	}
+	//Formats the text and returns its boxed form.
+	template <typename... Args>
+	winrt::Windows::Foundation::IInspectable box_format(std::wstring_view pattern, Args const &... args)
+	{
+		return box_string(m_buffer.format(pattern, args...));
+	}
+
+	//Releases every cached value.
+	void clear();
+	//Drops the least recently used strings until the estimate from get_bytes is no more than
+	//the target. Trimming to 0 releases the boxed integers as well.
+	void trim(size_t target_bytes);
+	//Estimates the memory held by the cached strings and their boxes.
+	size_t get_bytes() const;
+	value_cache_statistics get_statistics() const;
+
+private:
+	//A guess at what each string costs beyond its text: the list and index nodes, the hstring
+	//header and the box.
+	static constexpr size_t string_overhead_bytes = 160;
+
+	struct interned_string
+	{
+		winrt::hstring text;
+		//Only made when the boxed form is asked for.
+		winrt::Windows::Foundation::IInspectable boxed = nullptr;
+	};
+
+	format_buffer m_buffer;
+	intern_table<interned_string> m_strings;
+	small_integer_cache<winrt::Windows::Foundation::IInspectable> m_integers;
+	size_t m_uncached_boxes = 0;
+};
\ No newline at end of file
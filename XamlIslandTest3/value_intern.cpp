@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "value_intern.h"
+
+#include <stdexcept>
+
+format_buffer::format_buffer(size_t initial_capacity)
+{
+	m_buffer.reserve(initial_capacity);
+}
+
+size_t format_buffer::get_growth_count() const
+{
+	return m_growth_count;
+}
+
+size_t format_buffer::get_format_count() const
+{
+	return m_format_count;
+}
+
+std::wstring_view format_buffer::format_arguments(std::wstring_view pattern, std::span<const format_argument> arguments)
+{
+	const auto capacity = m_buffer.capacity();
+	m_buffer.clear();
+	++m_format_count;
+
+	size_t next_argument = 0;
+	for (size_t i = 0; i < pattern.size(); ++i)
+	{
+		const auto c = pattern[i];
+		if (c == L'{' && i + 1 < pattern.size() && pattern[i + 1] == L'{')
+		{
+			m_buffer.push_back(L'{');
+			++i;
+		}
+		else if (c == L'}' && i + 1 < pattern.size() && pattern[i + 1] == L'}')
+		{
+			m_buffer.push_back(L'}');
+			++i;
+		}
+		else if (c == L'{' && i + 1 < pattern.size() && pattern[i + 1] == L'}')
+		{
+			if (next_argument >= arguments.size())
+			{
+				throw std::invalid_argument("format pattern has more placeholders than arguments");
+			}
+
+			auto &argument = arguments[next_argument++];
+			switch (argument.kind)
+			{
+			case format_argument::argument_kind::signed_integer:
+			{
+				if (argument.signed_value < 0)
+				{
+					m_buffer.push_back(L'-');
+					//Negating in unsigned arithmetic handles the most negative value.
+					append_unsigned(0 - static_cast<uint64_t>(argument.signed_value));
+				}
+				else
+				{
+					append_unsigned(static_cast<uint64_t>(argument.signed_value));
+				}
+				break;
+			}
+			case format_argument::argument_kind::unsigned_integer:
+			{
+				append_unsigned(argument.unsigned_value);
+				break;
+			}
+			case format_argument::argument_kind::text:
+			{
+				m_buffer.append(argument.text);
+				break;
+			}
+			case format_argument::argument_kind::none:
+			{
+				break;
+			}
+			}
+			++i;
+		}
+		else if (c == L'{' || c == L'}')
+		{
+			throw std::invalid_argument("format pattern has an unmatched brace");
+		}
+		else
+		{
+			m_buffer.push_back(c);
+		}
+	}
+
+	if (next_argument != arguments.size())
+	{
+		throw std::invalid_argument("format pattern has fewer placeholders than arguments");
+	}
+
+	if (m_buffer.capacity() != capacity)
+	{
+		++m_growth_count;
+	}
+	return m_buffer;
+}
+
+void format_buffer::append_unsigned(uint64_t value)
+{
+	//20 digits is enough for the largest 64 bit value.
+	wchar_t digits[20];
+	size_t count = 0;
+	do
+	{
+		digits[count++] = static_cast<wchar_t>(L'0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	while (count > 0)
+	{
+		m_buffer.push_back(digits[--count]);
+	}
+}
\ No newline at end of file
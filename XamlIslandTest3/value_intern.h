@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#ifndef _LIST_
+#include <list>
+#endif
+#include <optional>
+#include <span>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Building blocks for updating xaml properties at high rates without allocating.
+//These only use the standard library, the xaml specific parts are in value_cache.h.
+
+//Formats text into a buffer that is reused from call to call.
+//Once the buffer has grown to fit the longest text, formatting no longer allocates.
+//The pattern uses {} for each argument, in order, and {{ and }} for literal braces.
+//Arguments can be integers, wide strings and wide characters.
+class format_buffer
+{
+public:
+	explicit format_buffer(size_t initial_capacity = 128);
+
+	//Formats the arguments into the buffer.
+	//The view is valid until the next call.
+	//Throws std::invalid_argument if the pattern and arguments don't match.
+	template <typename... Args>
+	std::wstring_view format(std::wstring_view pattern, Args const &... args)
+	{
+		const format_argument arguments[] = { make_argument(args)..., format_argument{} };
+		return format_arguments(pattern, std::span<const format_argument>(arguments, sizeof...(Args)));
+	}
+
+	//A single argument, for when the arguments are only known at runtime.
+	struct format_argument
+	{
+		enum class argument_kind
+		{
+			none,
+			signed_integer,
+			unsigned_integer,
+			text
+		};
+
+		argument_kind kind = argument_kind::none;
+		int64_t signed_value = 0;
+		uint64_t unsigned_value = 0;
+		std::wstring_view text;
+	};
+
+	//Formats arguments that were collected at runtime, such as ones decoded from a log record.
+	std::wstring_view format_arguments(std::wstring_view pattern, std::span<const format_argument>);
+
+	//The number of times that formatting had to grow the buffer.
+	size_t get_growth_count() const;
+	size_t get_format_count() const;
+
+private:
+	template <typename T>
+	static format_argument make_argument(T const &value)
+	{
+		format_argument argument{};
+		if constexpr (std::is_same_v<T, wchar_t>)
+		{
+			argument.kind = format_argument::argument_kind::text;
+			argument.text = std::wstring_view(&value, 1);
+		}
+		else if constexpr (std::is_same_v<T, bool>)
+		{
+			argument.kind = format_argument::argument_kind::text;
+			argument.text = value ? L"true" : L"false";
+		}
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+		{
+			argument.kind = format_argument::argument_kind::signed_integer;
+			argument.signed_value = static_cast<int64_t>(value);
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			argument.kind = format_argument::argument_kind::unsigned_integer;
+			argument.unsigned_value = static_cast<uint64_t>(value);
+		}
+		else
+		{
+			static_assert(std::is_convertible_v<T const &, std::wstring_view>, "format_buffer only formats integers and wide strings");
+			argument.kind = format_argument::argument_kind::text;
+			argument.text = std::wstring_view(value);
+		}
+		return argument;
+	}
+
+	void append_unsigned(uint64_t);
+
+	std::wstring m_buffer;
+	size_t m_growth_count = 0;
+	size_t m_format_count = 0;
+};
+
+//Counters for intern_table and small_integer_cache.
+//Every miss creates a value, so after warm up the misses should stop increasing.
+struct value_cache_counters
+{
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+};
+
+//Maps strings to values made from them, so a string that is used over and over only has its
+//value made once.
+//The table holds at most capacity entries, the least recently used is dropped to make room.
+//Looking up a string that is already in the table doesn't allocate.
+template <typename Value>
+class intern_table
+{
+public:
+	using factory_function = std::function<Value(std::wstring_view)>;
+
+	intern_table(size_t capacity, factory_function factory) : m_capacity(capacity == 0 ? 1 : capacity), m_factory(std::move(factory))
+	{
+		m_index.reserve(m_capacity);
+	}
+
+	//Finds or makes the value for the string.
+	//The reference is valid until the entry is evicted, so it shouldn't be kept past the next call.
+	Value &intern(std::wstring_view text)
+	{
+		if (auto it = m_index.find(text); it != m_index.end())
+		{
+			++m_counters.hits;
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			return it->second->value;
+		}
+
+		++m_counters.misses;
+		auto value = m_factory(text);
+		if (m_entries.size() >= m_capacity)
+		{
+			//Reuse the least recently used node rather than freeing it and allocating another.
+			++m_counters.evictions;
+			auto last = std::prev(m_entries.end());
+			m_index.erase(std::wstring_view(last->key));
+			m_text_bytes -= last->key.size() * sizeof(wchar_t);
+			last->key.assign(text);
+			last->value = std::move(value);
+			m_entries.splice(m_entries.begin(), m_entries, last);
+		}
+		else
+		{
+			m_entries.push_front(entry{ std::wstring(text), std::move(value) });
+		}
+		m_text_bytes += text.size() * sizeof(wchar_t);
+
+		m_index.emplace(std::wstring_view(m_entries.front().key), m_entries.begin());
+		return m_entries.front().value;
+	}
+
+	void clear()
+	{
+		m_index.clear();
+		m_entries.clear();
+		m_text_bytes = 0;
+	}
+
+	//Drops the least recently used entries until no more than count are left.
+	void trim(size_t count)
+	{
+		while (m_entries.size() > count)
+		{
+			++m_counters.evictions;
+			auto last = std::prev(m_entries.end());
+			m_index.erase(std::wstring_view(last->key));
+			m_text_bytes -= last->key.size() * sizeof(wchar_t);
+			m_entries.pop_back();
+		}
+	}
+
+	size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	//The size of the strings in the table, in bytes.
+	size_t get_text_bytes() const
+	{
+		return m_text_bytes;
+	}
+
+	value_cache_counters const &get_counters() const
+	{
+		return m_counters;
+	}
+
+private:
+	struct entry
+	{
+		std::wstring key;
+		Value value;
+	};
+
+	size_t m_capacity;
+	factory_function m_factory;
+	//Most recently used at the front. List nodes don't move, so the index can point at the keys.
+	std::list<entry> m_entries;
+	std::unordered_map<std::wstring_view, typename std::list<entry>::iterator> m_index;
+	size_t m_text_bytes = 0;
+	value_cache_counters m_counters{};
+};
+
+//Holds a value for every integer in a small range, made the first time it is asked for.
+//The storage is allocated up front, so after each value has been made once nothing allocates.
+template <typename Value>
+class small_integer_cache
+{
+public:
+	using factory_function = std::function<Value(int32_t)>;
+
+	small_integer_cache(int32_t minimum, int32_t maximum, factory_function factory) : m_minimum(minimum), m_factory(std::move(factory))
+	{
+		m_values.resize(maximum >= minimum ? static_cast<size_t>(static_cast<int64_t>(maximum) - minimum + 1) : 0);
+	}
+
+	//Returns null if the integer is outside of the cached range.
+	Value const *find_or_create(int32_t value)
+	{
+		const auto offset = static_cast<int64_t>(value) - m_minimum;
+		if (offset < 0 || offset >= static_cast<int64_t>(m_values.size()))
+		{
+			return nullptr;
+		}
+
+		auto &slot = m_values[static_cast<size_t>(offset)];
+		if (slot)
+		{
+			++m_counters.hits;
+		}
+		else
+		{
+			++m_counters.misses;
+			slot.emplace(m_factory(value));
+		}
+		return &*slot;
+	}
+
+	void clear()
+	{
+		for (auto &slot : m_values)
+		{
+			slot.reset();
+		}
+	}
+
+	value_cache_counters const &get_counters() const
+	{
+		return m_counters;
+	}
+
+private:
+	int32_t m_minimum;
+	factory_function m_factory;
+	std::vector<std::optional<Value>> m_values;
+	value_cache_counters m_counters{};
+};
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "pch.h"
+#include "virtual_list.h"
+
+#include <algorithm>
+
+virtual_list_range get_virtual_list_range(size_t item_count, int64_t scroll_offset, int viewport_height, virtual_list_layout const &layout)
+{
+	if (item_count == 0 || viewport_height <= 0 || layout.row_height <= 0)
+	{
+		return {};
+	}
+
+	const auto offset = std::max<int64_t>(scroll_offset, 0);
+	const auto first_visible = static_cast<size_t>(offset / layout.row_height);
+	//A row that only has its top edge in view still counts.
+	const auto last_visible = static_cast<size_t>((offset + viewport_height + layout.row_height - 1) / layout.row_height);
+
+	virtual_list_range range{};
+	range.first = std::min(first_visible - std::min(first_visible, layout.overscan), item_count);
+	range.last = std::min(last_visible + layout.overscan, item_count);
+	return range;
+}
+
+int64_t get_virtual_list_scroll_limit(size_t item_count, int viewport_height, virtual_list_layout const &layout)
+{
+	const auto content_height = static_cast<int64_t>(item_count) * layout.row_height;
+	return std::max<int64_t>(content_height - std::max(viewport_height, 0), 0);
+}
\ No newline at end of file
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#include <optional>
+#include <span>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "child_control_recycler.h"
+#include "island_batch.h"
+
+//A list of native child controls, one for each row, where only the rows in view exist.
+//Rows that scroll out of view go back to a child_control_recycler, and rows that scroll into view
+//are taken from it, so scrolling through a long list only creates as many controls as fit on
+//the screen.
+//The window manager is the one used by child_control_recycler, and also has to support
+//apply_island_batch, which moves the rows that stay in view.
+
+struct virtual_list_layout
+{
+	int row_height = 24;
+	//Rows kept either side of the viewport, so that small scrolls don't have to acquire anything.
+	size_t overscan = 2;
+};
+
+//The rows first to last, not including last.
+struct virtual_list_range
+{
+	size_t first = 0;
+	size_t last = 0;
+
+	size_t size() const
+	{
+		return last - first;
+	}
+	bool contains(size_t index) const
+	{
+		return index >= first && index < last;
+	}
+};
+
+//Works out which rows need to exist for the viewport, including the overscan.
+virtual_list_range get_virtual_list_range(size_t item_count, int64_t scroll_offset, int viewport_height, virtual_list_layout const &);
+//The furthest that the list can scroll.
+int64_t get_virtual_list_scroll_limit(size_t item_count, int viewport_height, virtual_list_layout const &);
+
+struct virtual_list_statistics
+{
+	uint64_t updates = 0;
+	//Rows that came into view and were acquired and bound.
+	uint64_t rows_materialised = 0;
+	//Rows that went out of view and were given back to the recycler.
+	uint64_t rows_released = 0;
+	//Rows that were bound again without being acquired, because their item changed.
+	uint64_t rows_rebound = 0;
+	//Rows that stayed in view but had to be moved.
+	uint64_t rows_moved = 0;
+	size_t max_rows = 0;
+};
+
+template <typename WindowManager, typename Handle>
+class virtual_list_host
+{
+public:
+	using recycler_type = child_control_recycler<WindowManager, Handle>;
+	//Fills in a row's control for an item, such as setting its text.
+	using bind_function = std::function<void(Handle, size_t index)>;
+
+	//The parent should be a window of its own, sized to the viewport, so that the rows that are
+	//partly out of view are clipped. The row class's name is kept as a view, so it should be a literal.
+	virtual_list_host(WindowManager &window_manager, recycler_type &recycler, Handle parent, child_control_class const &row_class, virtual_list_layout const &layout, bind_function bind)
+		: m_window_manager(window_manager), m_recycler(recycler), m_parent(parent), m_row_class(row_class), m_layout(layout), m_bind(std::move(bind))
+	{
+	}
+	~virtual_list_host()
+	{
+		clear();
+	}
+	virtual_list_host(const virtual_list_host &) = delete;
+	virtual_list_host(virtual_list_host &&) = delete;
+	virtual_list_host &operator=(const virtual_list_host &) = delete;
+	virtual_list_host &operator=(virtual_list_host &&) = delete;
+
+	//None of these change the rows until update is called.
+	void set_item_count(size_t count)
+	{
+		m_item_count = count;
+	}
+	void set_viewport(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+	}
+	//The offset is clamped to the scroll limit.
+	void set_scroll_offset(int64_t offset)
+	{
+		const auto limit = get_virtual_list_scroll_limit(m_item_count, m_height, m_layout);
+		m_scroll_offset = offset < 0 ? 0 : (offset > limit ? limit : offset);
+	}
+	//Binds every row again at the next update, for when the items have changed.
+	void invalidate()
+	{
+		m_rebind = true;
+	}
+
+	//Brings the rows in line with the viewport.
+	//Rows that went out of view are released first, so that the rows coming into view can reuse
+	//their controls. Rows that stayed in view are only moved if the list scrolled or was resized,
+	//and then all together in one batch.
+	island_batch_statistics update()
+	{
+		++m_statistics.updates;
+		const auto range = get_virtual_list_range(m_item_count, m_scroll_offset, m_height, m_layout);
+
+		for (auto &row : m_rows)
+		{
+			if (!range.contains(row.index))
+			{
+				m_recycler.release(m_row_class, row.handle);
+				++m_statistics.rows_released;
+			}
+		}
+
+		const bool moved = m_scroll_offset != m_placed_offset || m_width != m_placed_width;
+		m_next_rows.clear();
+		m_placements.clear();
+		for (size_t index = range.first; index < range.last; ++index)
+		{
+			const auto rect = get_row_rect(index);
+			if (m_range.contains(index))
+			{
+				auto &row = m_rows[index - m_range.first];
+				if (m_rebind)
+				{
+					m_bind(row.handle, index);
+					++m_statistics.rows_rebound;
+				}
+				if (moved)
+				{
+					m_placements.push_back({ row.handle, 0, rect, true });
+				}
+				m_next_rows.push_back(row);
+				continue;
+			}
+
+			auto handle = m_recycler.acquire(m_row_class, m_parent, rect);
+			if (handle == Handle{})
+			{
+				//The rows have to stay contiguous, so the rest of the range is left out. They are
+				//tried again on the next update. Rows from the last update that are in the part
+				//left out are given back, or their controls would stay in view with no row.
+				for (auto &row : m_rows)
+				{
+					if (row.index > index && range.contains(row.index))
+					{
+						m_recycler.release(m_row_class, row.handle);
+						++m_statistics.rows_released;
+					}
+				}
+				break;
+			}
+			m_bind(handle, index);
+			++m_statistics.rows_materialised;
+			m_next_rows.push_back({ index, handle });
+		}
+
+		m_rows.swap(m_next_rows);
+		m_range = { range.first, range.first + m_rows.size() };
+		m_placed_offset = m_scroll_offset;
+		m_placed_width = m_width;
+		m_rebind = false;
+		if (m_rows.size() > m_statistics.max_rows)
+		{
+			m_statistics.max_rows = m_rows.size();
+		}
+
+		m_statistics.rows_moved += m_placements.size();
+		return apply_island_batch(m_window_manager, std::span<const island_placement<Handle>>(m_placements));
+	}
+
+	//Gives every row back to the recycler.
+	void clear()
+	{
+		for (auto &row : m_rows)
+		{
+			m_recycler.release(m_row_class, row.handle);
+			++m_statistics.rows_released;
+		}
+		m_rows.clear();
+		m_range = {};
+	}
+
+	//Returns a null handle if the row isn't materialised.
+	Handle get_row(size_t index) const
+	{
+		return m_range.contains(index) ? m_rows[index - m_range.first].handle : Handle{};
+	}
+	//Finds the item for a row's control, such as the sender of a notification.
+	std::optional<size_t> find_item(Handle handle) const
+	{
+		for (auto &row : m_rows)
+		{
+			if (row.handle == handle)
+			{
+				return row.index;
+			}
+		}
+		return std::nullopt;
+	}
+	virtual_list_range get_range() const
+	{
+		return m_range;
+	}
+	virtual_list_statistics const &get_statistics() const
+	{
+		return m_statistics;
+	}
+
+private:
+	struct row
+	{
+		size_t index = 0;
+		Handle handle{};
+	};
+
+	island_rect get_row_rect(size_t index) const
+	{
+		const auto top = static_cast<int64_t>(index) * m_layout.row_height - m_scroll_offset;
+		return { 0, static_cast<int>(top), m_width, m_layout.row_height };
+	}
+
+	WindowManager &m_window_manager;
+	recycler_type &m_recycler;
+	Handle m_parent;
+	child_control_class m_row_class;
+	virtual_list_layout m_layout;
+	bind_function m_bind;
+	size_t m_item_count = 0;
+	int m_width = 0;
+	int m_height = 0;
+	int64_t m_scroll_offset = 0;
+	//Where the rows were last put, so that they are only moved when this changes.
+	int64_t m_placed_offset = 0;
+	int m_placed_width = 0;
+	bool m_rebind = false;
+	//The materialised rows, in item order. These cover m_range.
+	std::vector<row> m_rows;
+	virtual_list_range m_range{};
+	//Reused by each update, so that a steady scroll doesn't allocate.
+	std::vector<row> m_next_rows;
+	std::vector<island_placement<Handle>> m_placements;
+	virtual_list_statistics m_statistics{};
+};
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "win32_island_platform.h"
+
+#include <microsoft.ui.xaml.hosting.desktopwindowxamlsource.h>
+
+namespace wf = winrt::Windows::Foundation;
+namespace muxh = winrt::Microsoft::UI::Xaml::Hosting;
+
+constexpr static WPARAM invalid_key = static_cast<WPARAM>(-1);
+
+//Takes a XamlSourceFocusNavigationReason value and converts it to a VK
+//code.
+WPARAM get_key_from_reason(muxh::XamlSourceFocusNavigationReason reason)
+{
+	auto key = invalid_key;
+
+	switch (reason)
+	{
+	case muxh::XamlSourceFocusNavigationReason::Last:
+	{
+		key = VK_TAB;
+		break;
+	}
+	case muxh::XamlSourceFocusNavigationReason::First:
+	{
+		key = VK_TAB;
+		break;
+	}
+	case muxh::XamlSourceFocusNavigationReason::Left:
+	{
+		key = VK_LEFT;
+		break;
+	}
+	case muxh::XamlSourceFocusNavigationReason::Right:
+	{
+		key = VK_RIGHT;
+		break;
+	}
+	case muxh::XamlSourceFocusNavigationReason::Up:
+	{
+		key = VK_UP;
+		break;
+	}
+	case muxh::XamlSourceFocusNavigationReason::Down:
+	{
+		key = VK_DOWN;
+		break;
+	}
+	}
+
+	return key;
+}
+
+HWND win32_island_platform::get_focus()
+{
+	return GetFocus();
+}
+
+void win32_island_platform::set_focus(HWND window)
+{
+	SetFocus(window);
+}
+
+//Uses GetNextDlgTabItem, which searches for the next control with the WS_TABSTOP style.
+HWND win32_island_platform::get_next_tab_item(HWND host, HWND from, bool previous)
+{
+	return GetNextDlgTabItem(host, from, previous);
+}
+
+bool win32_island_platform::is_menu_modifier_down()
+{
+	byte keyboard_state[256] = {};
+	THROW_IF_WIN32_BOOL_FALSE(GetKeyboardState(keyboard_state));
+	return (keyboard_state[VK_MENU] & 0x80) != 0;
+}
+
+bool win32_island_platform::is_dialog_message(HWND host, MSG &msg)
+{
+	return !!IsDialogMessageW(host, &msg);
+}
+
+std::optional<win32_island_platform::reason_type> win32_island_platform::get_navigation_reason(MSG const &msg)
+{
+	//This only happens if we are working with a key down mesage.
+	if (msg.message != WM_KEYDOWN)
+	{
+		return std::nullopt;
+	}
+
+	switch (msg.wParam)
+	{
+	case VK_TAB:
+	{
+		byte keyboard_state[256] = {};
+		THROW_IF_WIN32_BOOL_FALSE(GetKeyboardState(keyboard_state));
+		return (keyboard_state[VK_SHIFT] & 0x80) ? muxh::XamlSourceFocusNavigationReason::Last : muxh::XamlSourceFocusNavigationReason::First;
+	}
+	case VK_LEFT:
+	{
+		return muxh::XamlSourceFocusNavigationReason::Left;
+	}
+	case VK_RIGHT:
+	{
+		return muxh::XamlSourceFocusNavigationReason::Right;
+	}
+	case VK_UP:
+	{
+		return muxh::XamlSourceFocusNavigationReason::Up;
+	}
+	case VK_DOWN:
+	{
+		return muxh::XamlSourceFocusNavigationReason::Down;
+	}
+	}
+
+	return std::nullopt;
+}
+
+bool win32_island_platform::is_previous(reason_type reason)
+{
+	return !((reason == muxh::XamlSourceFocusNavigationReason::First) || (reason == muxh::XamlSourceFocusNavigationReason::Down) || (reason == muxh::XamlSourceFocusNavigationReason::Right));
+}
+
+MSG win32_island_platform::make_navigation_message(HWND window, reason_type reason)
+{
+	MSG msg{};
+	msg.hwnd = window;
+	msg.message = WM_KEYDOWN;
+	msg.wParam = get_key_from_reason(reason);
+	return msg;
+}
+
+HWND win32_island_platform::get_source_window(source_type const &source)
+{
+	HWND island_window{};
+	winrt::check_hresult(source.as<IDesktopWindowXamlSourceNative>()->get_WindowHandle(&island_window));
+	return island_window;
+}
+
+bool win32_island_platform::source_has_focus(source_type const &source)
+{
+	return source.HasFocus();
+}
+
+bool win32_island_platform::pre_translate_message(source_type const &source, MSG const &msg)
+{
+	BOOL handled = FALSE;
+	winrt::check_hresult(source.as<IDesktopWindowXamlSourceNative>()->PreTranslateMessage(&msg, &handled));
+	return handled != FALSE;
+}
+
+//Asks the island to take the focus.
+//The rectangle of the previously focused window is used as the hint rectangle.
+bool win32_island_platform::navigate_source(source_type const &source, reason_type reason, HWND previous_focus, winrt::guid &last_request_id)
+{
+	RECT rc_prev{};
+	THROW_IF_WIN32_BOOL_FALSE(GetWindowRect(previous_focus, &rc_prev));
+	const auto island_window = get_source_window(source);
+
+	POINT pt = { rc_prev.left, rc_prev.top };
+	SIZE sz = { rc_prev.right - rc_prev.left, rc_prev.bottom - rc_prev.top };
+	ScreenToClient(island_window, &pt);
+	const auto hint_rect = wf::Rect({ static_cast<float>(pt.x), static_cast<float>(pt.y), static_cast<float>(sz.cx), static_cast<float>(sz.cy) });
+	const auto request = muxh::XamlSourceFocusNavigationRequest(reason, hint_rect);
+	last_request_id = request.CorrelationId();
+
+	return source.NavigateFocus(request).WasFocusMoved();
+}
+
+void win32_island_platform::restore_source(source_type const &source, winrt::guid &last_request_id)
+{
+	const auto request = muxh::XamlSourceFocusNavigationRequest(muxh::XamlSourceFocusNavigationReason::Restore);
+	last_request_id = request.CorrelationId();
+	source.NavigateFocus(request);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifndef _WINDOWS_
+#define _WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#ifndef WINRT_Microsoft_UI_Xaml_Hosting_H
+#include <winrt/Microsoft.UI.Xaml.Hosting.h>
+#endif
+
+#include <optional>
+
+//The Windows API and DesktopWindowXamlSource implementation of the platform used by
+//island_focus_navigator.
+struct win32_island_platform
+{
+	using window_type = HWND;
+	using message_type = MSG;
+	using source_type = winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource;
+	using reason_type = winrt::Microsoft::UI::Xaml::Hosting::XamlSourceFocusNavigationReason;
+	using request_id_type = winrt::guid;
+
+	HWND get_focus();
+	void set_focus(HWND);
+	HWND get_next_tab_item(HWND host, HWND from, bool previous);
+	bool is_menu_modifier_down();
+	bool is_dialog_message(HWND host, MSG &);
+
+	//Takes a WM_KEYDOWN message and converts the virtual key to a navigation reason.
+	//Tab goes to first or last depending on whether shift has been pressed.
+	std::optional<reason_type> get_navigation_reason(MSG const &);
+	//First, Down and Right move forward in the control order.
+	//Last, Left and Up move backward in the control order.
+	bool is_previous(reason_type);
+	//Makes the WM_KEYDOWN message for the key that corresponds to the reason.
+	MSG make_navigation_message(HWND, reason_type);
+
+	HWND get_source_window(source_type const &);
+	bool source_has_focus(source_type const &);
+	bool pre_translate_message(source_type const &, MSG const &);
+	bool navigate_source(source_type const &, reason_type, HWND previous_focus, winrt::guid &last_request_id);
+	void restore_source(source_type const &, winrt::guid &last_request_id);
+};
\ No newline at end of file
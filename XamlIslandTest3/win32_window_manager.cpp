@@ -0,0 +1,41 @@
+#include "pch.h"
+#include "win32_window_manager.h"
+
+//The class name has to be null terminated for CreateWindowExW, class_name is only a view.
+HWND win32_child_window_manager::create_control(child_control_class const &control_class, HWND parent, island_rect const &rect, uint32_t id, wchar_t const *text)
+{
+	const std::wstring class_name(control_class.class_name);
+	return CreateWindowExW(control_class.extended_style, class_name.c_str(), text, control_class.style | WS_CHILD | WS_VISIBLE, rect.x, rect.y, rect.width, rect.height, parent, reinterpret_cast<HMENU>(static_cast<UINT_PTR>(id)), instance, nullptr);
+}
+
+//A new control goes to the bottom of the z-order, so a reused one is put there too. That keeps
+//the tab order the same as it would have been had the control been created.
+void win32_child_window_manager::reuse_control(HWND control, HWND parent, island_rect const &rect, uint32_t id, wchar_t const *text)
+{
+	SetParent(control, parent);
+	SetWindowLongPtrW(control, GWLP_ID, static_cast<LONG_PTR>(id));
+	SetWindowTextW(control, text != nullptr ? text : L"");
+	EnableWindow(control, TRUE);
+	SetWindowPos(control, HWND_BOTTOM, rect.x, rect.y, rect.width, rect.height, SWP_NOACTIVATE | SWP_SHOWWINDOW);
+}
+
+void win32_child_window_manager::park_control(HWND control)
+{
+	//Focus would otherwise be left on a hidden window.
+	if (GetFocus() == control)
+	{
+		SetFocus(GetParent(control));
+	}
+	ShowWindow(control, SW_HIDE);
+	SetParent(control, parking_window);
+}
+
+void win32_child_window_manager::destroy_control(HWND control)
+{
+	DestroyWindow(control);
+}
+
+HWND create_parking_window(HINSTANCE instance)
+{
+	return CreateWindowExW(WS_EX_TOOLWINDOW, L"Static", L"", WS_POPUP, 0, 0, 0, 0, nullptr, nullptr, instance, nullptr);
+}
\ No newline at end of file
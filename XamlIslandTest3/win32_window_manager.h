@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef _WINDOWS_
+#define _WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include "child_control_recycler.h"
+#include "island_batch.h"
+#include "virtual_list.h"
+
+//The Windows API implementation of the window manager used by apply_island_batch.
+struct win32_island_window_manager
+{
+	uint32_t get_style(HWND window)
+	{
+		return static_cast<uint32_t>(GetWindowLongPtrW(window, GWL_STYLE));
+	}
+	void set_style(HWND window, uint32_t style)
+	{
+		SetWindowLongPtrW(window, GWL_STYLE, static_cast<LONG_PTR>(style));
+	}
+	HDWP begin_deferred_positions(size_t count)
+	{
+		return BeginDeferWindowPos(static_cast<int>(count));
+	}
+	bool defer_position(HDWP &deferral, HWND window, island_rect const &rect, bool show)
+	{
+		if (deferral == nullptr)
+		{
+			return false;
+		}
+		//DeferWindowPos can return a different handle, and frees the old one if it fails.
+		deferral = DeferWindowPos(deferral, window, nullptr, rect.x, rect.y, rect.width, rect.height, position_flags(show));
+		return deferral != nullptr;
+	}
+	bool end_deferred_positions(HDWP &deferral)
+	{
+		return deferral != nullptr && EndDeferWindowPos(deferral) != FALSE;
+	}
+	void set_position(HWND window, island_rect const &rect, bool show)
+	{
+		SetWindowPos(window, nullptr, rect.x, rect.y, rect.width, rect.height, position_flags(show));
+	}
+
+	static UINT position_flags(bool show)
+	{
+		return SWP_NOZORDER | SWP_NOACTIVATE | (show ? SWP_SHOWWINDOW : 0);
+	}
+};
+
+//The Windows API implementation of the window manager used by child_control_recycler and
+//virtual_list_host.
+//Released controls are kept hidden under the parking window, which is never shown. The parking
+//window has to outlive every control parked under it.
+struct win32_child_window_manager : win32_island_window_manager
+{
+	HINSTANCE instance = nullptr;
+	HWND parking_window = nullptr;
+
+	HWND create_control(child_control_class const &, HWND parent, island_rect const &, uint32_t id, wchar_t const *text);
+	void reuse_control(HWND, HWND parent, island_rect const &, uint32_t id, wchar_t const *text);
+	void park_control(HWND);
+	void destroy_control(HWND);
+};
+
+using win32_child_control_recycler = child_control_recycler<win32_child_window_manager, HWND>;
+using win32_virtual_list_host = virtual_list_host<win32_child_window_manager, HWND>;
+
+//Creates the hidden window that released controls are parked under.
+HWND create_parking_window(HINSTANCE);
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "pch.h"
+#include "window_awaitables.h"
+
+void background_awaitable::await_suspend(std::coroutine_handle<> handle) const
+{
+	auto callback = [](PTP_CALLBACK_INSTANCE, void *context)
+	{
+		std::coroutine_handle<>::from_address(context).resume();
+	};
+
+	//If this throws, the exception comes out of the co_await in the coroutine.
+	THROW_IF_WIN32_BOOL_FALSE(TrySubmitThreadpoolCallback(callback, handle.address(), nullptr));
+}
+
+context_awaitable resume_on_window(window_base &window)
+{
+	return context_awaitable(window.get_coroutine_context());
+}
+
+context_awaitable resume_after(window_base &window, std::chrono::nanoseconds delay)
+{
+	//A zero delay would resume straight away on the window thread, it should still go
+	//through the pump.
+	if (delay.count() <= 0)
+	{
+		delay = std::chrono::nanoseconds(1);
+	}
+	return context_awaitable(window.get_coroutine_context(), delay);
+}
+
+background_awaitable resume_background(window_base &window)
+{
+	return background_awaitable(window.get_coroutine_context());
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef _WINDOWS_
+#define _WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include "coroutine_support.h"
+#include "window_base.h"
+
+//Awaitable that continues the coroutine on the thread pool.
+//If the window's context is cancelled by the time the coroutine gets there,
+//it throws operation_cancelled rather than doing the background work.
+class background_awaitable
+{
+public:
+	explicit background_awaitable(std::shared_ptr<coroutine_context> context) : m_context(std::move(context))
+	{
+	}
+
+	bool await_ready() const
+	{
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle) const;
+	void await_resume() const
+	{
+		if (m_context->is_cancelled())
+		{
+			throw operation_cancelled();
+		}
+	}
+
+private:
+	std::shared_ptr<coroutine_context> m_context;
+};
+
+//Continues the coroutine on the window's UI thread through the window's message queue.
+//Throws operation_cancelled if the window is destroyed first.
+[[nodiscard]] context_awaitable resume_on_window(window_base &);
+//Continues the coroutine on the window's UI thread once the delay has passed.
+//The delay is driven by the message pump, not by WM_TIMER.
+[[nodiscard]] context_awaitable resume_after(window_base &, std::chrono::nanoseconds);
+//Continues the coroutine on the thread pool.
+[[nodiscard]] background_awaitable resume_background(window_base &);
\ No newline at end of file
@@ -1,16 +1,24 @@
 #include "pch.h"
 #include "window_base.h"
+#include "live_counters_region.h"
+#include "logging.h"
+#include "main_application.h"
+#include "win32_window_manager.h"
+#include "window_awaitables.h"
+#include "xaml_text.h"
 
 #include <microsoft.ui.xaml.hosting.desktopwindowxamlsource.h>
+#include <dwmapi.h>
+
+#pragma comment(lib, "dwmapi.lib")
 
 namespace wf = winrt::Windows::Foundation;
 namespace mux = winrt::Microsoft::UI::Xaml;
 namespace muxh = winrt::Microsoft::UI::Xaml::Hosting;
 namespace muxm = winrt::Microsoft::UI::Xaml::Markup;
+namespace muxc = winrt::Microsoft::UI::Xaml::Controls;
 
 constexpr uint16_t xamlresourcetype = 255;
-constexpr auto static invalid_reason = static_cast<muxh::XamlSourceFocusNavigationReason>(-1);
-constexpr static WPARAM invalid_key = static_cast<WPARAM>(-1);
 
 HWND window_base::get_handle() const
 {
@@ -19,276 +27,368 @@ HWND window_base::get_handle() const
 void window_base::set_handle(HWND handle)
 {
 	m_handle = handle;
-}
 
-//Takes a VK code from a WM_KEYDOWN message and converts it to
-//a xaml XamlSourceFocusNavigationReason value.
-//Tab goes to first or last depending on whether shift has been pressed.
-muxh::XamlSourceFocusNavigationReason get_reason_from_key(WPARAM key)
-{
-	auto reason = invalid_reason;
-	switch(key)
+	//The coroutine context is created here, on the window's thread, so that it already
+	//exists when coroutines on other threads ask for it.
+	//Resumptions are posted to the window. Delayed resumptions are posted by the
+	//application's pump timers once the delay has passed.
+	auto post_resumption = [handle](resumption_id id)
 	{
-	case VK_TAB:
-	{
-		byte keyboard_state[256] = {};
-		THROW_IF_WIN32_BOOL_FALSE(GetKeyboardState(keyboard_state));
-		reason = (keyboard_state[VK_SHIFT] & 0x80) ? muxh::XamlSourceFocusNavigationReason::Last : muxh::XamlSourceFocusNavigationReason::First;
-		break;
-	}
-	case VK_LEFT:
+		return PostMessageW(handle, WM_USER_RESUME_COROUTINE, static_cast<WPARAM>(id & 0xFFFFFFFF), static_cast<LPARAM>(id >> 32)) != FALSE;
+	};
+	auto post_resumption_after = [post_resumption](resumption_id id, std::chrono::nanoseconds delay)
 	{
-		reason = muxh::XamlSourceFocusNavigationReason::Left;
-		break;
-	}
-	case VK_RIGHT:
+		main_application::get_application().post_delayed(delay, [post_resumption, id]() { post_resumption(id); });
+		return true;
+	};
+	m_coroutine_context = std::make_shared<coroutine_context>(std::this_thread::get_id(), post_resumption, post_resumption_after);
+}
+
+//Obtains the total CPU time, kernel and user, used by the current thread.
+std::chrono::nanoseconds get_thread_cpu_time()
+{
+	FILETIME creation_time{};
+	FILETIME exit_time{};
+	FILETIME kernel_time{};
+	FILETIME user_time{};
+	THROW_IF_WIN32_BOOL_FALSE(GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time));
+
+	//FILETIME values are in 100ns units.
+	auto to_ticks = [](FILETIME const &ft) { return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+	return std::chrono::nanoseconds(static_cast<int64_t>((to_ticks(kernel_time) + to_ticks(user_time)) * 100));
+}
+
+//Checks whether DWM has cloaked the window.
+//This happens when the window is on another virtual desktop, for example.
+bool is_window_cloaked(HWND window)
+{
+	DWORD cloaked = 0;
+	if (FAILED(DwmGetWindowAttribute(window, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))))
 	{
-		reason = muxh::XamlSourceFocusNavigationReason::Right;
-		break;
+		return false;
 	}
-	case VK_UP:
+	return cloaked != 0;
+}
+
+//Moves focus between controls.
+bool window_base::navigate_focus(MSG *msg)
+{
+	const bool handled = m_focus_navigator.navigate_focus(get_handle(), m_xaml_sources, *msg);
+	log_trace(log_message::focus_navigated, msg->message, static_cast<uint64_t>(msg->wParam), handled);
+	return handled;
+}
+
+//This event should fire when you navigate into a xaml source.
+//For some reason it currently doesn't.
+void window_base::on_got_focus(muxh::DesktopWindowXamlSource const &sender, muxh::DesktopWindowXamlSourceGotFocusEventArgs const &)
+{
+	HWND island_handle = get_handle(sender);
+	log_debug(log_message::island_got_focus, reinterpret_cast<uintptr_t>(island_handle));
+
+	if (GetFocus() != island_handle)
 	{
-		reason = muxh::XamlSourceFocusNavigationReason::Up;
-		break;
+		log_warning(log_message::island_got_focus_without_focus, reinterpret_cast<uintptr_t>(island_handle));
 	}
-	case VK_DOWN:
+}
+
+//This event fires when you navigate out of a xaml source. I.e, if a xaml source has focus and you press tab.
+void window_base::on_take_focus_requested(muxh::DesktopWindowXamlSource const & sender, muxh::DesktopWindowXamlSourceTakeFocusRequestedEventArgs const &args)
+{
+	const auto request = args.Request();
+	log_debug(log_message::take_focus_requested, reinterpret_cast<uintptr_t>(get_handle(sender)), request.Reason());
+	main_application::get_application().get_latency_probe().mark(latency_stage::take_focus, std::chrono::steady_clock::now());
+	m_focus_navigator.on_take_focus_requested(get_handle(), m_xaml_sources, sender, request.Reason(), request.CorrelationId());
+}
+
+bool window_base::focus_navigate(MSG *msg)
+{
+	const bool navigated = navigate_focus(msg);
+	publish_counters({ { live_counter::focus_navigations, 1 }, { live_counter::focus_navigations_handled, navigated ? 1 : 0 } });
+	return navigated;
+}
+
+//Calls PreTranslateMessage on the xaml sources owned by this window.
+//This function is used to route Xaml messages to the xaml sources so they can
+//function correctly.
+bool window_base::pre_translate_message(const MSG &msg)
+{
+	//Suspended islands are either hidden or in an inactive window that has been idle for a while,
+	//neither of which gets keyboard input. Activating the window resumes them.
+	if (m_suspension.is_suspended())
 	{
-		reason = muxh::XamlSourceFocusNavigationReason::Down;
-		break;
-	}
+		if (!m_xaml_sources.empty())
+		{
+			m_suspension.note_skipped_filter();
+		}
+		return false;
 	}
 
-	return reason;
+	const bool handled = m_focus_navigator.pre_translate_message(m_xaml_sources, msg);
+	publish_counters({ { live_counter::filter_calls, 1 }, { live_counter::filter_hits, handled ? 1 : 0 } });
+	return handled;
 }
-//Takes a XamlSourceFocusNavigationReason value and converts it to a VK
-//code.
-WPARAM get_key_from_reason(muxh::XamlSourceFocusNavigationReason reason)
+
+bool window_base::xaml_islands_suspended() const
 {
-	auto key = invalid_key;
+	return m_suspension.is_suspended();
+}
 
-	switch (reason)
-	{
-	case muxh::XamlSourceFocusNavigationReason::Last:
+bool window_base::is_child_window_visible(HWND handle) const
+{
+	for (auto &island : m_suspended_islands)
 	{
-		key = VK_TAB;
-		break;
+		if (island.handle == handle)
+		{
+			return island.window_was_visible;
+		}
 	}
-	case muxh::XamlSourceFocusNavigationReason::First:
+	return IsWindowVisible(handle) != FALSE;
+}
+
+suspension_policy const &window_base::get_suspension_policy() const
+{
+	return m_suspension.get_policy();
+}
+
+void window_base::set_suspension_policy(suspension_policy const &policy)
+{
+	//A more relaxed policy can remove the reasons to be hidden.
+	m_suspension.set_policy(policy);
+	update_hidden_islands();
+}
+
+suspension_statistics window_base::get_suspension_statistics() const
+{
+	return m_suspension.get_statistics(island_suspension::clock::now(), get_thread_cpu_time());
+}
+
+std::shared_ptr<coroutine_context> const &window_base::get_coroutine_context() const
+{
+	_ASSERTE(m_coroutine_context != nullptr);
+	return m_coroutine_context;
+}
+
+void window_base::resume_coroutine(WPARAM wparam, LPARAM lparam)
+{
+	const auto id = (static_cast<resumption_id>(static_cast<uint32_t>(lparam)) << 32) | static_cast<uint32_t>(wparam);
+	//If the coroutine was cancelled, the id is no longer known and this does nothing.
+	m_coroutine_context->resume(id);
+}
+
+void window_base::cancel_coroutines()
+{
+	if (m_coroutine_context)
 	{
-		key = VK_TAB;
-		break;
+		m_coroutine_context->cancel();
 	}
-	case muxh::XamlSourceFocusNavigationReason::Left:
+}
+
+//The window's handle is the owner, so that the timers can all be cancelled when it is destroyed.
+timer_id window_base::set_timer(std::chrono::nanoseconds delay, timer_wheel::callback callback, timer_options options)
+{
+	options.owner = reinterpret_cast<uintptr_t>(m_handle);
+	return main_application::get_application().set_timer(delay, std::move(callback), options);
+}
+
+void window_base::cancel_timers()
+{
+	main_application::get_application().cancel_window_timers(m_handle);
+	m_suspension_timer = invalid_timer_id;
+}
+
+void window_base::enter_modal_loop()
+{
+	main_application::get_application().get_heartbeat().enter_modal_loop();
+}
+
+void window_base::exit_modal_loop()
+{
+	main_application::get_application().get_heartbeat().exit_modal_loop();
+}
+
+//Runs the event through the state machine and acts on the result.
+void window_base::process_suspension_event(suspension_event event)
+{
+	m_suspension.process_event(event, island_suspension::clock::now(), get_thread_cpu_time());
+	update_hidden_islands();
+	update_suspension_timer();
+}
+
+//Only windows that can't be seen have their islands hidden. An idle window is still on screen, so
+//its islands are paused, which stops the filtering, but otherwise left as they are.
+void window_base::update_hidden_islands()
+{
+	const bool hide = m_suspension.is_hidden();
+	if (hide == m_xaml_islands_hidden)
 	{
-		key = VK_LEFT;
-		break;
+		return;
 	}
-	case muxh::XamlSourceFocusNavigationReason::Right:
+
+	m_xaml_islands_hidden = hide;
+	if (hide)
 	{
-		key = VK_RIGHT;
-		break;
+		suspend_xaml_islands();
 	}
-	case muxh::XamlSourceFocusNavigationReason::Up:
+	else
 	{
-		key = VK_UP;
-		break;
+		resume_xaml_islands();
 	}
-	case muxh::XamlSourceFocusNavigationReason::Down:
+}
+
+//While the window is in the background, poll for occlusion and for the idle timeout.
+//There is no notification for a window being covered by other windows.
+void window_base::on_suspension_timer()
+{
+	//Minimised windows are handled by WM_SIZE, the occlusion test isn't meaningful for them.
+	if (!IsIconic(m_handle))
 	{
-		key = VK_DOWN;
-		break;
-	}
+		const bool occluded = is_window_occluded();
+		const bool marked_occluded = (m_suspension.reasons() & static_cast<uint32_t>(suspension_reason::occluded)) != 0;
+		if (occluded != marked_occluded)
+		{
+			process_suspension_event(occluded ? suspension_event::occluded : suspension_event::unoccluded);
+		}
 	}
 
-	return key;
+	process_suspension_event(suspension_event::tick);
 }
 
-muxh::DesktopWindowXamlSource window_base::get_next_focused_island(const MSG *msg)
+void window_base::shutdown_suspension()
 {
-	//This only happens if we are working with a key down mesage.
-	if (msg->message == WM_KEYDOWN)
+	if (m_suspension_timer != invalid_timer_id)
 	{
-		//Obtains the reason from the WM_KEYDOWN's virtual key code.
-		const auto key = msg->wParam;
-		auto reason = get_reason_from_key(key);
-		if (reason != invalid_reason)
-		{
-			//This works out the direction of navigation.
-			//First, Down and Right moves forward in the control order.
-			//Last, Left and Up moves backward in the control order.
-			const bool previous = ((reason == muxh::XamlSourceFocusNavigationReason::First) || (reason == muxh::XamlSourceFocusNavigationReason::Down) || (reason == muxh::XamlSourceFocusNavigationReason::Right)) ? false : true;
-			//Obtains the currently focused window.
-			const auto current_focused_window = GetFocus();
-			//Uses the GetNextDlgTabItem to get focus next.
-			//This basically searches for the next control with the WS_TABSTOP style.
-			//This is where we use the direction calculated above. We want to work out
-			//whether we want to get the previous or next window.
-			const auto next_element = GetNextDlgTabItem(get_handle(), current_focused_window, previous);
-			//Go through the cached xaml source objects.
-			//If the window handle we want to change focus to matches one of the xaml sources window handles
-			//then that is the xaml source that we wish to navigate to.
-			for (auto &xaml_source : m_xaml_sources)
-			{
-				HWND island_window{};
-				winrt::check_hresult(xaml_source.as<IDesktopWindowXamlSourceNative>()->get_WindowHandle(&island_window));
-				if (next_element == island_window)
-				{
-					return xaml_source;
-				}
-			}
-		}
+		main_application::get_application().cancel_timer(m_suspension_timer);
+		m_suspension_timer = invalid_timer_id;
 	}
 
-	return nullptr;
+	const auto statistics = get_suspension_statistics();
+	log_info(log_message::suspension_summary,
+		statistics.suspend_count,
+		statistics.skipped_filter_calls,
+		std::chrono::duration_cast<std::chrono::milliseconds>(statistics.suspended_wall_time).count(),
+		std::chrono::duration_cast<std::chrono::microseconds>(statistics.estimated_cpu_time_saved()).count());
 }
 
-//Get the xaml source, if any, that has focus.
-muxh::DesktopWindowXamlSource window_base::get_focused_island()
+void window_base::suspend_xaml_islands()
 {
+	m_suspended_islands.clear();
+	m_suspended_islands.reserve(m_xaml_sources.size());
+
 	for (auto &xaml_source : m_xaml_sources)
 	{
-		if (xaml_source.HasFocus())
+		suspended_island island{};
+		island.handle = get_handle(xaml_source);
+		island.window_was_visible = IsWindowVisible(island.handle) != FALSE;
+		island.content = xaml_source.Content();
+		if (island.content)
+		{
+			island.content_visibility = island.content.Visibility();
+			island.content.Visibility(mux::Visibility::Collapsed);
+		}
+		if (island.window_was_visible)
 		{
-			return xaml_source;
+			ShowWindow(island.handle, SW_HIDE);
 		}
+		m_suspended_islands.push_back(island);
 	}
-
-	return nullptr;
 }
 
-//Moves focus between controls.
-bool window_base::navigate_focus(MSG *msg)
+void window_base::resume_xaml_islands()
 {
-	//The following is equivalent to:
-	//const auto next_focused_island = get_next_focused_island(msg);
-	//if(next_focused_island)
-	//In otherwords if get_focused_island returns anything besides nullptr, the if case executes,
-	//otherwise the else case executes.
-	//This is important to navigate properly to a xaml island window.
-	if (const auto next_focused_island = get_next_focused_island(msg))
-	{
-		//Gets the previous/currently focused window.
-		const auto previous_focused_window = GetFocus();
-		//Obtains the current window rectangle.
-		//This is used for the hint rectangle.
-		RECT rc_prev{};
-		THROW_IF_WIN32_BOOL_FALSE(GetWindowRect(previous_focused_window, &rc_prev));
-		HWND island_window = get_handle(next_focused_island);
-		
-		//Generates the XamlSourceFocusNavigationRequest object.
-		POINT pt = { rc_prev.left, rc_prev.top };
-		SIZE sz = { rc_prev.right - rc_prev.left, rc_prev.bottom - rc_prev.top };
-		ScreenToClient(island_window, &pt);
-		const auto hint_rect = wf::Rect({static_cast<float>(pt.x), static_cast<float>(pt.y), static_cast<float>(sz.cx), static_cast<float>(sz.cy)});
-		const auto reason = get_reason_from_key(msg->wParam);
-		const auto request = muxh::XamlSourceFocusNavigationRequest(reason, hint_rect);
-		//Store the correlation id for the current request.
-		m_last_focus_request_id = request.CorrelationId();
-		//Attempt to navigate focus.
-		const auto result = next_focused_island.NavigateFocus(request);
-		auto focus_moved = result.WasFocusMoved();
-		//I do not know if it is a bug, but NavigateFocus doesn't move the keyboard focus
-		//for the associated HWND.
-		//If WasFocusMoved indicates that the focus was moved, call SetFocus on the HWND itself
-		//to move the keyboard focus.
-		//Without this, the xaml content doesn't receive keyboard focus when pressing tab.
-		if (focus_moved)
+	for (auto &island : m_suspended_islands)
+	{
+		if (island.content)
 		{
-			SetFocus(island_window);
+			island.content.Visibility(island.content_visibility);
 		}
-		return focus_moved;
-	}
-	else
-	{
-		//Figures out if an island has keyboard focus.
-		const bool island_is_focused = get_focused_island() != nullptr;
-		//Gets the state of the Alt key.
-		byte keyboard_state[256] = {};
-		THROW_IF_WIN32_BOOL_FALSE(GetKeyboardState(keyboard_state));
-		const bool is_menu_modifier = (keyboard_state[VK_MENU] & 0x80);
-		//If a xaml island has focus then we ignore any message that comes through here
-		//unless the Alt key is being held. This allows us to access Windows API menu bars.
-		if (island_is_focused && !is_menu_modifier)
+		if (island.window_was_visible)
 		{
-			return false;
+			ShowWindow(island.handle, SW_SHOWNA);
 		}
-		//Passes the message through to IsDialogMessage.
-		//If the xaml source isn't handling the message, this function implements
-		//the Windows API dialog keyboard navigation. It handles Tab, Shift+Tab,
-		//Left, Right, Up and Down cursor messages and more.
-		//While the function has Dialog in the name, it is documented to work
-		//on regular windows, not just dialog boxes.
-		const bool is_dialog_message = !!IsDialogMessageW(get_handle(), msg);
-		//The message pump and TakeFocusRequested events need to know if IsDialogMessage
-		//handled the message.
-		return is_dialog_message;
 	}
+	m_suspended_islands.clear();
 }
 
-//This event should fire when you navigate into a xaml source.
-//For some reason it currently doesn't.
-void window_base::on_got_focus(muxh::DesktopWindowXamlSource const &sender, muxh::DesktopWindowXamlSourceGotFocusEventArgs const &)
+bool window_base::is_window_occluded() const
 {
-	MessageBoxW(get_handle(), L"GotFocusEvent", L"GotFocusEvent", MB_OK);
-	HWND island_handle = get_handle(sender);
+	if (is_window_cloaked(m_handle))
+	{
+		return true;
+	}
 
-	if (GetFocus() != island_handle)
+	RECT window_rect{};
+	if (!GetWindowRect(m_handle, &window_rect))
 	{
-		OutputDebugStringW(L"GotFocus fired, HWND does not have focus.");
+		return false;
 	}
-}
 
-//This event fires when you navigate out of a xaml source. I.e, if a xaml source has focus and you press tab.
-void window_base::on_take_focus_requested(muxh::DesktopWindowXamlSource const & sender, muxh::DesktopWindowXamlSourceTakeFocusRequestedEventArgs const &args)
-{
-	HWND sender_handle = get_handle(sender);
+	wil::unique_hrgn visible_region(CreateRectRgnIndirect(&window_rect));
+	wil::unique_hrgn covering_region(CreateRectRgn(0, 0, 0, 0));
+	if (!visible_region || !covering_region)
+	{
+		return false;
+	}
 
-	//If the correlation id isn't the same as the last one, this means that we are 
-	//navigating to a new window. 
-	if (args.Request().CorrelationId() != m_last_focus_request_id)
+	//Walk up the z-order, removing every window above this one from the visible region.
+	for (HWND above = GetWindow(m_handle, GW_HWNDPREV); above != nullptr; above = GetWindow(above, GW_HWNDPREV))
 	{
-		const auto reason = args.Request().Reason();
-		const bool previous = ((reason == muxh::XamlSourceFocusNavigationReason::First) || (reason == muxh::XamlSourceFocusNavigationReason::Down) || (reason == muxh::XamlSourceFocusNavigationReason::Right)) ? false : true;
+		if (!IsWindowVisible(above) || IsIconic(above) || is_window_cloaked(above))
+		{
+			continue;
+		}
+		//Layered windows can be partially transparent, so they don't count as covering this window.
+		if ((GetWindowLongPtrW(above, GWL_EXSTYLE) & WS_EX_LAYERED) != 0)
+		{
+			continue;
+		}
 
-		//Synthesise a MSG to navigate.
-		MSG msg{};
-		msg.hwnd = sender_handle;
-		msg.message = WM_KEYDOWN;
-		msg.wParam = get_key_from_reason(reason);
-		//Try to move focus.
-		if (!navigate_focus(&msg))
+		RECT above_rect{};
+		if (!GetWindowRect(above, &above_rect))
 		{
-			//If the navigate focus fails, get the next window with the WS_TABSTOP style
-			//and set the focus on this window.
-			const auto next_element = GetNextDlgTabItem(get_handle(), sender_handle, previous);
-			SetFocus(next_element);
+			continue;
+		}
+		SetRectRgn(covering_region.get(), above_rect.left, above_rect.top, above_rect.right, above_rect.bottom);
+		if (CombineRgn(visible_region.get(), visible_region.get(), covering_region.get(), RGN_DIFF) == NULLREGION)
+		{
+			return true;
 		}
 	}
-	else
-	{
-		const auto request = muxh::XamlSourceFocusNavigationRequest(muxh::XamlSourceFocusNavigationReason::Restore);
-		m_last_focus_request_id = request.CorrelationId();
-		sender.NavigateFocus(request);
-		SetFocus(sender_handle);
-	}
+
+	return false;
 }
 
-bool window_base::focus_navigate(MSG *msg)
+//The timer is only needed while the window is in the background.
+void window_base::update_suspension_timer()
 {
-	return navigate_focus(msg);
+	const bool timer_required = m_handle != nullptr && !m_suspension.is_foreground();
+
+	if (timer_required && m_suspension_timer == invalid_timer_id)
+	{
+		m_suspension_timer = set_timer(suspension_poll_interval, [this]() { on_suspension_timer(); }, { suspension_poll_tolerance, suspension_poll_interval });
+	}
+	else if (!timer_required && m_suspension_timer != invalid_timer_id)
+	{
+		main_application::get_application().cancel_timer(m_suspension_timer);
+		m_suspension_timer = invalid_timer_id;
+	}
 }
 
 //Retrieves all of the created xaml sources for this window.
-std::vector<muxh::DesktopWindowXamlSource> window_base::get_xaml_sources()
+std::span<const muxh::DesktopWindowXamlSource> window_base::get_xaml_sources() const
 {
-	std::vector<muxh::DesktopWindowXamlSource> sources;
+	return m_xaml_sources;
+}
 
-	for (auto &xaml_source : m_xaml_sources)
+//Retrieves the window handles of the created xaml sources.
+frame_vector<HWND> window_base::get_xaml_source_handles(frame_arena &arena) const
+{
+	auto handles = make_frame_vector<HWND>(arena, m_xaml_source_events.size());
+	for (auto &events : m_xaml_source_events)
 	{
-		sources.push_back(xaml_source);
+		handles.push_back(events.handle);
 	}
 
-	return sources;
+	return handles;
 }
 
 //Creates a DesktopWindowXamlSource out of a xaml UIElement.
@@ -308,33 +408,248 @@ HWND window_base::create_desktop_window_xaml_source(DWORD extra_styles, const mu
 
 	//Adds the provided content as content for the xaml source.
 	desktop_source.Content(content);
+	register_xaml_source(desktop_source, xaml_source_handle);
+
+	return xaml_source_handle;
+}
+
+//Hooks up the events for a new xaml source and caches it.
+void window_base::register_xaml_source(const muxh::DesktopWindowXamlSource &desktop_source, HWND xaml_source_handle)
+{
+	xaml_source_events events{};
+	events.handle = xaml_source_handle;
 	//Wires up the TakeFocusRequested event to the xaml source and stores the event token.
-	m_take_focus_event_tokens.emplace(std::make_pair(xaml_source_handle, desktop_source.TakeFocusRequested({ this, &window_base::on_take_focus_requested })));
+	events.take_focus_token = desktop_source.TakeFocusRequested({ this, &window_base::on_take_focus_requested });
 	//Wires up the GotFocus event to the xaml source and stores the event token.
-	m_got_focus_event_tokens.emplace(std::make_pair(xaml_source_handle, desktop_source.GotFocus({ this, &window_base::on_got_focus })));
-	//Stores the xaml source.
+	events.got_focus_token = desktop_source.GotFocus({ this, &window_base::on_got_focus });
+	//Stores the xaml source and its event tokens at the same index.
 	m_xaml_sources.push_back(desktop_source);
+	m_xaml_source_events.push_back(events);
+	publish_counter(live_counter::islands);
+}
 
-	return xaml_source_handle;
+//Creates many DesktopWindowXamlSource objects at once.
+//Rather than each island going through the window manager separately, every source is created first,
+//then all of the styles are applied, then everything is positioned and shown in one DeferWindowPos
+//batch.
+std::vector<HWND> window_base::create_desktop_window_xaml_sources(std::span<const xaml_island_descriptor> descriptors, island_batch_statistics *statistics)
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<HWND> handles;
+	std::vector<island_placement<HWND>> placements;
+	handles.reserve(descriptors.size());
+	placements.reserve(descriptors.size());
+
+	const auto start = clock::now();
+	for (auto &descriptor : descriptors)
+	{
+		muxh::DesktopWindowXamlSource desktop_source;
+		HWND xaml_source_handle = get_handle_and_attach(desktop_source, get_handle());
+		_ASSERTE(xaml_source_handle != nullptr);
+		desktop_source.Content(descriptor.content);
+		register_xaml_source(desktop_source, xaml_source_handle);
+
+		handles.push_back(xaml_source_handle);
+		placements.push_back({ xaml_source_handle, descriptor.extra_styles, descriptor.rect, descriptor.show });
+	}
+	const auto create_time = clock::now() - start;
+
+	win32_island_window_manager window_manager{};
+	auto batch_statistics = apply_island_batch(window_manager, std::span<const island_placement<HWND>>(placements));
+	batch_statistics.create_time = create_time;
+	batch_statistics.total_time += create_time;
+	if (statistics)
+	{
+		*statistics = batch_statistics;
+	}
+
+	return handles;
 }
 
-//Unhooks the events and clears the xaml sources.
-void window_base::clear_xaml_islands()
+//Uses the same batch as island creation, with no styles to apply.
+std::vector<HWND> window_base::create_consolidated_xaml_sources(std::span<const consolidated_child_descriptor> children, float scale, consolidation_options const &options, island_batch_statistics *statistics)
+{
+	std::vector<consolidation_child> layout;
+	layout.reserve(children.size());
+	uint64_t xaml_children = 0;
+	for (auto &child : children)
+	{
+		layout.push_back({ child.content ? consolidation_child_kind::xaml : consolidation_child_kind::native, child.rect });
+		xaml_children += child.content ? 1 : 0;
+	}
+	const auto plan = plan_island_consolidation(layout, options);
+
+	//Sizes are set on the elements, since a Canvas doesn't stretch its children.
+	const auto place = [scale](mux::UIElement const &content, island_rect const &rect)
+		{
+			if (auto element = content.try_as<mux::FrameworkElement>())
+			{
+				element.Width(rect.width / scale);
+				element.Height(rect.height / scale);
+			}
+		};
+
+	std::vector<xaml_island_descriptor> descriptors;
+	descriptors.reserve(plan.islands.size());
+	for (auto &island : plan.islands)
+	{
+		if (island.children.size() == 1)
+		{
+			auto &child = children[island.children.front()];
+			descriptors.push_back({ child.content, WS_TABSTOP, island.rect });
+			continue;
+		}
+
+		muxc::Canvas canvas;
+		int32_t tab_index = 0;
+		for (auto index : island.children)
+		{
+			auto &child = children[index];
+			const auto rect = get_rect_within(island.rect, child.rect);
+			place(child.content, rect);
+			muxc::Canvas::SetLeft(child.content, rect.x / scale);
+			muxc::Canvas::SetTop(child.content, rect.y / scale);
+			if (auto control = child.content.try_as<muxc::Control>())
+			{
+				control.TabIndex(tab_index++);
+			}
+			canvas.Children().Append(child.content);
+		}
+		descriptors.push_back({ canvas, WS_TABSTOP, island.rect });
+	}
+
+	const auto islands = create_desktop_window_xaml_sources(descriptors, statistics);
+
+	std::vector<HWND> handles;
+	handles.reserve(children.size());
+	for (size_t i = 0; i < children.size(); ++i)
+	{
+		const auto island = plan.island_of_child[i];
+		handles.push_back(island == consolidation_plan::no_island ? children[i].native : islands[island]);
+	}
+
+	//The focus navigation follows the z-order, so the islands are put in between the native
+	//controls in tab order. An island comes up once, for its first element.
+	HWND previous = HWND_TOP;
+	for (size_t i = 0; i < children.size(); ++i)
+	{
+		const auto island = plan.island_of_child[i];
+		if (island != consolidation_plan::no_island && plan.islands[island].children.front() != i)
+		{
+			continue;
+		}
+		SetWindowPos(handles[i], previous, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+		previous = handles[i];
+	}
+
+	log_info(log_message::xaml_islands_consolidated, xaml_children, static_cast<uint64_t>(plan.islands.size()));
+
+	return handles;
+}
+
+island_batch_statistics window_base::position_child_windows(std::span<const island_placement<HWND>> placements)
+{
+	win32_island_window_manager window_manager{};
+	return apply_island_batch(window_manager, placements);
+}
+
+//Creates a DesktopWindowXamlSource with empty content.
+//This gives the window something to lay out and put in the tab order while the real
+//content loads.
+HWND window_base::create_placeholder_xaml_source(DWORD extra_styles)
+{
+	return create_desktop_window_xaml_source(extra_styles, muxc::Grid());
+}
+
+//Replaces the content of one of this window's xaml sources.
+void window_base::set_xaml_source_content(HWND xaml_source_handle, const mux::UIElement &content)
 {
 	for (auto &xaml_source : m_xaml_sources)
 	{
-		HWND xaml_source_handle = get_handle(xaml_source);
-		auto take_focus_it = m_take_focus_event_tokens.find(xaml_source_handle);
-		_ASSERTE(take_focus_it != m_take_focus_event_tokens.end());
-		xaml_source.TakeFocusRequested((*take_focus_it).second);
-		auto got_focus_it = m_got_focus_event_tokens.find(xaml_source_handle);
-		_ASSERTE(got_focus_it != m_got_focus_event_tokens.end());
-		xaml_source.GotFocus((*got_focus_it).second);
-		xaml_source.Close();
-	}
-	m_take_focus_event_tokens.clear();
-	m_got_focus_event_tokens.clear();
+		if (get_handle(xaml_source) != xaml_source_handle)
+		{
+			continue;
+		}
+
+		xaml_source.Content(content);
+		//If the islands are suspended, the new content has to be suspended too, and
+		//restored to its own visibility on resume.
+		for (auto &island : m_suspended_islands)
+		{
+			if (island.handle == xaml_source_handle)
+			{
+				island.content = content;
+				island.content_visibility = content.Visibility();
+				content.Visibility(mux::Visibility::Collapsed);
+			}
+		}
+		return;
+	}
+
+	THROW_HR(E_INVALIDARG);
+}
+
+//Unhooks the events and clears the xaml sources.
+//This is done in phases rather than source by source. Focus is taken away from the islands
+//and every event is revoked before anything is closed, so closing one source can't start
+//focus navigation into another one, or queue work for a source that is about to go.
+void window_base::clear_xaml_islands()
+{
+	_ASSERTE(m_xaml_sources.size() == m_xaml_source_events.size());
+
+	teardown_coordinator teardown;
+	teardown.add_step("release_focus", [this]()
+		{
+			//If an island has the keyboard focus, give it to the window itself.
+			const auto focused_window = GetFocus();
+			for (auto &events : m_xaml_source_events)
+			{
+				if (focused_window == events.handle || IsChild(events.handle, focused_window))
+				{
+					SetFocus(get_handle());
+					break;
+				}
+			}
+		});
+	teardown.add_step("revoke_events", [this]()
+		{
+			for (size_t i = 0; i < m_xaml_sources.size(); ++i)
+			{
+				m_xaml_sources[i].TakeFocusRequested(m_xaml_source_events[i].take_focus_token);
+				m_xaml_sources[i].GotFocus(m_xaml_source_events[i].got_focus_token);
+			}
+			m_xaml_source_events.clear();
+		}, { "release_focus" });
+	teardown.add_step("hide_islands", [this]()
+		{
+			for (auto &xaml_source : m_xaml_sources)
+			{
+				ShowWindow(get_handle(xaml_source), SW_HIDE);
+			}
+		}, { "revoke_events" });
+	teardown.add_step("close_sources", [this]()
+		{
+			//Newest first, the reverse of creation.
+			for (auto it = m_xaml_sources.rbegin(); it != m_xaml_sources.rend(); ++it)
+			{
+				it->Close();
+			}
+			m_xaml_sources.clear();
+		}, { "hide_islands" });
+
+	publish_counter(live_counter::islands, -static_cast<int64_t>(m_xaml_sources.size()));
+	m_teardown_timings = teardown.run();
 	m_xaml_sources.clear();
+	m_xaml_source_events.clear();
+	m_suspended_islands.clear();
+	m_xaml_islands_hidden = false;
+}
+
+//Gets the time taken by each phase of the last clear_xaml_islands.
+std::vector<teardown_step_timing> const &window_base::get_teardown_timings() const
+{
+	return m_teardown_timings;
 }
 
 //Helper function that just obtains the window handle from the xaml source.
@@ -362,8 +677,9 @@ HWND window_base::get_handle_and_attach(muxh::DesktopWindowXamlSource const &sou
 	return island_handle;
 }
 
-//Loads a xaml file from a disk file.
-mux::UIElement LoadControlFromFile(std::wstring const &file_name)
+//Reads and decodes a xaml file.
+//This doesn't touch any xaml objects, so it can run on any thread.
+std::wstring read_xaml_text_from_file(std::wstring const &file_name)
 {
 	std::filesystem::path file_path = file_name;
 	if (!std::filesystem::exists(file_path))
@@ -371,45 +687,120 @@ mux::UIElement LoadControlFromFile(std::wstring const &file_name)
 		THROW_HR(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
 	}
 
-	auto file_size = std::filesystem::file_size(file_path);
+	return decode_xaml_text(read_xaml_file(file_path));
+}
 
-	wil::unique_file xaml_control;
-	std::wstring file_content;
+//Finds and decodes a xaml resource.
+//Resource loading only maps the module's resource section, so this can also run on any thread.
+std::wstring read_xaml_text_from_resource(uint16_t id)
+{
+	auto resource_handle = FindResourceW(nullptr, MAKEINTRESOURCEW(id), MAKEINTRESOURCEW(xamlresourcetype));
+	THROW_LAST_ERROR_IF(!resource_handle);
 
-	auto result = _wfopen_s(xaml_control.addressof(), file_path.c_str(), L"rb");
-	if (result != 0)
-	{
-		THROW_HR(E_FAIL);
-	}
-	
-	while (!feof(xaml_control.get()))
+	HGLOBAL resource_data = LoadResource(nullptr, resource_handle);
+	THROW_LAST_ERROR_IF(!resource_data);
+
+	//The resource isn't null terminated, so the size has to come from the resource itself.
+	const auto resource_size = SizeofResource(nullptr, resource_handle);
+	THROW_LAST_ERROR_IF(resource_size == 0);
+
+	auto data = static_cast<const char *>(LockResource(resource_data));
+	return decode_xaml_text(std::string_view(data, resource_size));
+}
+
+std::wstring read_xaml_text(xaml_source_key const &source)
+{
+	if (source.kind == xaml_source_kind::file)
 	{
-		int val = fgetc(xaml_control.get());
-		if (val != EOF)
-		{
-			file_content += static_cast<wchar_t>(val);
-		}
+		return read_xaml_text_from_file(source.path);
 	}
+	return read_xaml_text_from_resource(source.resource_id);
+}
 
-	if (file_content.size() < file_size)
+//Uses the text from the startup prewarm if it is there, otherwise it is read now.
+//The cache is thread safe, so this can also run on any thread.
+std::wstring take_or_read_xaml_text(xaml_source_key const &source)
+{
+	if (auto text = main_application::get_application().get_xaml_text_cache().take(source); text)
 	{
-		THROW_HR(E_FAIL);
+		return std::move(*text);
 	}
+	return read_xaml_text(source);
+}
+
+//Notes the load for the next run's prewarm.
+//This must be called on the UI thread.
+void record_xaml_usage(xaml_source_key const &source, std::wstring const &text)
+{
+	main_application::get_application().get_xaml_usage_recorder().record(source, text.size() * sizeof(wchar_t));
+}
 
-	return muxm::XamlReader::Load(static_cast<winrt::hstring>(file_content)).as<mux::UIElement>();
+mux::UIElement load_control(xaml_source_key const &source)
+{
+	auto text = take_or_read_xaml_text(source);
+	record_xaml_usage(source, text);
+	return muxm::XamlReader::Load(text).as<mux::UIElement>();
+}
+
+//Loads a xaml file from a disk file.
+mux::UIElement LoadControlFromFile(std::wstring const &file_name)
+{
+	return load_control(make_file_source(file_name));
 }
 
 //Loads a xaml file from an embedded resource.
 //The resource must be type 255.
 mux::UIElement LoadControlFromResource(uint16_t id)
 {
-	auto resource_handle = FindResourceW(nullptr, MAKEINTRESOURCEW(id), MAKEINTRESOURCEW(xamlresourcetype));
-	THROW_LAST_ERROR_IF(!resource_handle);
+	return load_control(make_resource_source(id));
+}
 
-	HGLOBAL resource_data = LoadResource(nullptr, resource_handle);
-	THROW_LAST_ERROR_IF(!resource_data);
+//The asynchronous load pipeline.
+//Reading and decoding happens on the thread pool and only XamlReader::Load runs on the window's thread.
+//The window is the first parameter so the coroutine frame comes from the window's pool, and the
+//coroutine is cancelled if the window is destroyed before it finishes.
+//The window can be destroyed while the coroutine is on the thread pool, so it isn't used after the
+//first await. The coroutine goes back through the context instead, which it keeps alive.
+window_task load_control_async(window_base &window, xaml_source_key source, xaml_loaded_handler on_loaded)
+{
+	std::wstring text;
+	HRESULT hr = S_OK;
 
-	auto data = static_cast<char *>(LockResource(resource_data));
-	auto hstr_data = winrt::to_hstring(data);
-	return muxm::XamlReader::Load(hstr_data).as<mux::UIElement>();
+	const auto context = window.get_coroutine_context();
+	co_await background_awaitable(context);
+	try
+	{
+		text = take_or_read_xaml_text(source);
+	}
+	catch (...)
+	{
+		hr = wil::ResultFromCaughtException();
+	}
+
+	co_await context_awaitable(context);
+	mux::UIElement element = nullptr;
+	if (SUCCEEDED(hr))
+	{
+		record_xaml_usage(source, text);
+		try
+		{
+			element = muxm::XamlReader::Load(text).as<mux::UIElement>();
+		}
+		catch (...)
+		{
+			hr = wil::ResultFromCaughtException();
+		}
+	}
+
+	on_loaded(winrt::hresult(hr), element);
+}
+
+void LoadControlFromFileAsync(window_base &window, std::wstring const &file_name, xaml_loaded_handler on_loaded)
+{
+	load_control_async(window, make_file_source(file_name), std::move(on_loaded));
+}
+
+void LoadControlFromResourceAsync(window_base &window, uint16_t id, xaml_loaded_handler on_loaded)
+{
+	load_control_async(window, make_resource_source(id), std::move(on_loaded));
 }
\ No newline at end of file
@@ -12,6 +12,17 @@
 #include <winrt/Microsoft.UI.Xaml.Hosting.h>
 #endif
 
+#include "coroutine_support.h"
+#include "frame_arena.h"
+#include "island_batch.h"
+#include "island_consolidation.h"
+#include "island_focus.h"
+#include "island_suspension.h"
+#include "teardown_coordinator.h"
+#include "timer_wheel.h"
+#include "win32_island_platform.h"
+#include "xaml_prewarm.h"
+
 //Message used to query if this is a window that derives from window_base;
 #ifndef WM_USER_QUERY_WINDOWBASE
 #define WM_USER_QUERY_WINDOWBASE WM_USER + 10
@@ -29,6 +40,12 @@
 #define WM_USER_VERIFY_POINTER WM_USER + 12
 #endif
 
+//Message used to resume a coroutine on the window's thread.
+//The wparam and lparam hold the low and high 32 bits of the resumption id.
+#ifndef WM_USER_RESUME_COROUTINE
+#define WM_USER_RESUME_COROUTINE WM_USER + 13
+#endif
+
 //Value returned to indicate that this is a window that derives from window_base.
 constexpr uint32_t query_window_base_identified = 0xFEEDF00D;
 //Value returned to indicate that the pointer we verified is the same as the
@@ -38,17 +55,64 @@ constexpr uint32_t verify_window_base_pointer_match = 0x0000900D;
 //pointer to the class that backs the window we are verifying against.
 constexpr uint32_t verify_window_base_pointer_no_match = 0x0000BAAD;
 
+//How often to poll for occlusion and idleness while the window is in the background.
+//The poll is a pump timer, and it doesn't need to be exact.
+constexpr std::chrono::milliseconds suspension_poll_interval{ 1000 };
+constexpr std::chrono::milliseconds suspension_poll_tolerance{ 250 };
+
+//Describes one island for window_base::create_desktop_window_xaml_sources.
+//The rectangle is in the parent's client coordinates, in physical pixels.
+struct xaml_island_descriptor
+{
+	winrt::Microsoft::UI::Xaml::UIElement content = nullptr;
+	DWORD extra_styles = 0;
+	island_rect rect{};
+	bool show = true;
+};
+
+//Describes one child for window_base::create_consolidated_xaml_sources.
+//Either the native window is set, for a control that already exists, or the content is set for
+//a xaml element that needs an island. The rectangle is in the parent's client coordinates, in
+//physical pixels.
+struct consolidated_child_descriptor
+{
+	HWND native = nullptr;
+	winrt::Microsoft::UI::Xaml::UIElement content = nullptr;
+	island_rect rect{};
+};
+
 //Base class that our windows derive from.
 class window_base
 {
 public:
 	//Obtains all of the xaml sources from the window.
-	//This is used for the message filtering.
-	std::vector<winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource> get_xaml_sources();
+	//This is a view of the window's own list, it is only valid until islands are added or cleared.
+	std::span<const winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource> get_xaml_sources() const;
+	//Obtains the window handles of the xaml sources, in the same order as get_xaml_sources.
+	//The list is allocated from the arena, so it only lasts for the current frame.
+	frame_vector<HWND> get_xaml_source_handles(frame_arena &) const;
 	//Obtains the handle for the window that this class represents.
 	HWND get_handle() const;
 	//Used to move the focus around the controls contained by the window that this class represents.
 	bool focus_navigate(MSG *);
+	//Passes the message to the PreTranslateMessage of every xaml source in this window.
+	//This is skipped entirely while the islands are suspended.
+	bool pre_translate_message(const MSG &);
+	//Returns true if the xaml islands in this window are currently suspended.
+	bool xaml_islands_suspended() const;
+	//Gets whether the child window is visible, as far as the window is concerned.
+	//Islands hidden by suspension count as visible if they were visible before it.
+	bool is_child_window_visible(HWND) const;
+	//Gets the suspension policy and time accounting.
+	suspension_policy const &get_suspension_policy() const;
+	void set_suspension_policy(suspension_policy const &);
+	suspension_statistics get_suspension_statistics() const;
+	//Gets the time taken by each phase of the last clear_xaml_islands.
+	std::vector<teardown_step_timing> const &get_teardown_timings() const;
+	//Gets the context used to run coroutines on this window's thread.
+	//Coroutines that take the window as their first parameter, or are members of the window,
+	//have their frames allocated from this context's pool.
+	std::shared_ptr<coroutine_context> const &get_coroutine_context() const;
 protected:
 	//Sets the handle for this class.
 	//This must only be called once when the window initialises.
@@ -56,35 +120,134 @@ protected:
 
 	//Creates a DesktopWindowXamlSource object from the given xaml element.
 	HWND create_desktop_window_xaml_source(DWORD extra_styles, const winrt::Microsoft::UI::Xaml::UIElement &);
+	//Creates a DesktopWindowXamlSource object for each descriptor, then styles, positions and shows
+	//them all in one batch. The handles are returned in the same order as the descriptors.
+	//If statistics is provided, it receives the timings for each phase.
+	std::vector<HWND> create_desktop_window_xaml_sources(std::span<const xaml_island_descriptor>, island_batch_statistics *statistics = nullptr);
+	//Creates as few islands as possible for the xaml children. The children are given in tab order
+	//and xaml elements that are next to each other share an island, laid out on a Canvas, unless
+	//plan_island_consolidation splits them up. The scale is the DPI scale used to turn the
+	//physical pixel rectangles into xaml units.
+	//Every child gets a handle back, in the same order as the children. For a native child this
+	//is its own window, for a xaml child it is the island that hosts it.
+	std::vector<HWND> create_consolidated_xaml_sources(std::span<const consolidated_child_descriptor>, float scale, consolidation_options const & = {}, island_batch_statistics *statistics = nullptr);
+	//Moves and resizes child windows, native controls and islands alike, in one deferred batch.
+	//This is what a DPI change uses to rescale everything at once.
+	island_batch_statistics position_child_windows(std::span<const island_placement<HWND>>);
+	//Creates a DesktopWindowXamlSource with placeholder content.
+	//The real content is provided later with set_xaml_source_content.
+	HWND create_placeholder_xaml_source(DWORD extra_styles);
+	//Replaces the content of a DesktopWindowXamlSource created by this class.
+	void set_xaml_source_content(HWND, const winrt::Microsoft::UI::Xaml::UIElement &);
 	//Destroys all DesktopWindowXamlSource objects cached by this class.
 	void clear_xaml_islands();
+
+	//Feeds a window state change into the suspension state machine, suspending or resuming
+	//the xaml islands as required.
+	void process_suspension_event(suspension_event);
+	//Runs every suspension_poll_interval while the window is in the background.
+	void on_suspension_timer();
+	//Stops the suspension timer and reports the statistics.
+	void shutdown_suspension();
+
+	//Resumes a coroutine posted with WM_USER_RESUME_COROUTINE.
+	void resume_coroutine(WPARAM, LPARAM);
+	//Cancels every outstanding coroutine for this window.
+	//This is called when the window is destroyed.
+	void cancel_coroutines();
+
+	//Sets a pump timer that belongs to this window, see main_application::set_timer.
+	timer_id set_timer(std::chrono::nanoseconds delay, timer_wheel::callback, timer_options = {});
+	//Cancels every pump timer that belongs to this window.
+	//This is called when the window is destroyed.
+	void cancel_timers();
+
+	//Marks the start and end of a modal loop that DefWindowProc runs for this window, so that
+	//the hang watchdog doesn't take a long move or an open menu for a stalled pump.
+	void enter_modal_loop();
+	void exit_modal_loop();
 private:
+	//State saved for each island when it is suspended, so that resuming only shows
+	//what was visible before.
+	struct suspended_island
+	{
+		HWND handle = nullptr;
+		bool window_was_visible = false;
+		winrt::Microsoft::UI::Xaml::UIElement content = nullptr;
+		winrt::Microsoft::UI::Xaml::Visibility content_visibility = winrt::Microsoft::UI::Xaml::Visibility::Visible;
+	};
+
+	//The events hooked up for a xaml source, along with its handle.
+	struct xaml_source_events
+	{
+		HWND handle = nullptr;
+		winrt::event_token take_focus_token{};
+		winrt::event_token got_focus_token{};
+	};
+
 	HWND m_handle = nullptr;
 
+	//Pauses the xaml content.
+	//Hiding the island window stops it from being composed and collapsing the content
+	//removes it from layout, which also stops any animations from rendering.
+	void suspend_xaml_islands();
+	//Restores the xaml content to the state it was in before suspend_xaml_islands.
+	void resume_xaml_islands();
+	//Suspends or resumes the xaml content to match whether the window can be seen.
+	void update_hidden_islands();
+	//Checks whether higher z-order windows completely cover this window, or it is cloaked.
+	bool is_window_occluded() const;
+	//Starts or stops the suspension poll timer depending on the window state.
+	void update_suspension_timer();
+
 	//Helper function to get a window handle from a DesktopWindowXamlSource object.
 	HWND get_handle(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &);
+	//Hooks up the events for a newly created xaml source and caches it.
+	void register_xaml_source(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &, HWND);
 	//Helper function to get a window handle from a DesktopWindowXamlSource object.
 	//It attaches the source to a window while it is doing this.
 	HWND get_handle_and_attach(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &, HWND);
-	//Checks cached xaml sources to see if one of them currently has focus.
-	winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource get_focused_island();
 	//Take focus requested event handler. This event fires when when focus changes from a xaml island to a different control.
 	void on_take_focus_requested(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &, winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSourceTakeFocusRequestedEventArgs const &);
 	//Got focus event handler. This event (allegedly) fires when the focus changes to a xaml island.
 	void on_got_focus(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &, winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSourceGotFocusEventArgs const &);
-	//Obtains which island is to get the focus next.
-	winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource get_next_focused_island(const MSG*);
 	//Moves the focus between controlls.
 	bool navigate_focus(MSG *);
 
-	winrt::guid m_last_focus_request_id{};
-	std::map<HWND, winrt::event_token> m_take_focus_event_tokens;
-	std::map<HWND, winrt::event_token> m_got_focus_event_tokens;
+	//The focus navigation and message filtering logic, which is kept separate from the
+	//Windows API so it only sees the platform interface.
+	island_focus_navigator<win32_island_platform> m_focus_navigator;
 	std::vector<winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource> m_xaml_sources;
+	//The event tokens for each source, at the same index as the source in m_xaml_sources.
+	std::vector<xaml_source_events> m_xaml_source_events;
+	std::vector<teardown_step_timing> m_teardown_timings;
+
+	island_suspension m_suspension{};
+	std::vector<suspended_island> m_suspended_islands;
+	//Set while suspend_xaml_islands is in effect.
+	bool m_xaml_islands_hidden = false;
+	timer_id m_suspension_timer = invalid_timer_id;
+
+	std::shared_ptr<coroutine_context> m_coroutine_context;
 };
 
 //Loads xaml content from a file on the filesystem.
 winrt::Microsoft::UI::Xaml::UIElement LoadControlFromFile(std::wstring const &);
 //Loads xaml content from a Windows API resource.
 //Resource must be type 255.
-winrt::Microsoft::UI::Xaml::UIElement LoadControlFromResource(uint16_t);
\ No newline at end of file
+winrt::Microsoft::UI::Xaml::UIElement LoadControlFromResource(uint16_t);
+
+//Reads and decodes a xaml fragment without going through the prewarm cache.
+//This doesn't touch any xaml objects, so it can run on any thread.
+std::wstring read_xaml_text(xaml_source_key const &);
+
+//Called on the window's thread when an asynchronous load completes.
+//If the load failed, the element is null and the result holds the error.
+using xaml_loaded_handler = std::function<void(winrt::hresult, winrt::Microsoft::UI::Xaml::UIElement const &)>;
+//Loads xaml content from a file without blocking the window's thread.
+//The file is read and decoded on the thread pool, then parsed on the window's thread.
+//The handler isn't called if the window is destroyed first.
+void LoadControlFromFileAsync(window_base &, std::wstring const &, xaml_loaded_handler);
+//Loads xaml content from a Windows API resource without blocking the window's thread.
+//Resource must be type 255.
+void LoadControlFromResourceAsync(window_base &, uint16_t, xaml_loaded_handler);
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "window_state.h"
+
+#include <algorithm>
+
+//The header.
+//uint32 magic
+//uint16 version
+//uint16 header size
+//uint16 window record size
+//uint16 control record size
+//uint32 control count
+//uint32 checksum of everything after the header
+constexpr size_t header_size = 20;
+//int32 x, y, width, height
+//uint32 dpi
+//uint32 focused control
+//uint32 flags
+constexpr size_t window_record_size = 28;
+//uint32 control id
+//int32 x, y, width, height
+//uint32 flags
+constexpr size_t control_record_size = 24;
+
+constexpr uint32_t window_flag_maximized = 0x1;
+constexpr uint32_t control_flag_visible = 0x1;
+
+//FNV-1a.
+uint32_t window_state_checksum(std::span<const std::byte> data)
+{
+	uint32_t hash = 0x811C9DC5u;
+	for (auto b : data)
+	{
+		hash ^= static_cast<uint32_t>(b);
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
+//Writes and reads values a byte at a time so that neither alignment nor the byte order of
+//the machine matters.
+class state_writer
+{
+public:
+	explicit state_writer(std::vector<std::byte> &data) : m_data(data)
+	{
+	}
+
+	void write_u16(uint16_t value)
+	{
+		write(value, 2);
+	}
+
+	void write_u32(uint32_t value)
+	{
+		write(value, 4);
+	}
+
+	void write_i32(int32_t value)
+	{
+		write(static_cast<uint32_t>(value), 4);
+	}
+
+	void write_rect(island_rect const &rect)
+	{
+		write_i32(rect.x);
+		write_i32(rect.y);
+		write_i32(rect.width);
+		write_i32(rect.height);
+	}
+
+private:
+	void write(uint32_t value, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_data.push_back(static_cast<std::byte>((value >> (i * 8)) & 0xFF));
+		}
+	}
+
+	std::vector<std::byte> &m_data;
+};
+
+class state_reader
+{
+public:
+	explicit state_reader(std::span<const std::byte> data) : m_data(data)
+	{
+	}
+
+	uint16_t read_u16()
+	{
+		return static_cast<uint16_t>(read(2));
+	}
+
+	uint32_t read_u32()
+	{
+		return read(4);
+	}
+
+	int32_t read_i32()
+	{
+		return static_cast<int32_t>(read(4));
+	}
+
+	island_rect read_rect()
+	{
+		island_rect rect{};
+		rect.x = read_i32();
+		rect.y = read_i32();
+		rect.width = read_i32();
+		rect.height = read_i32();
+		return rect;
+	}
+
+private:
+	//The caller has already checked the size, so this never reads past the end.
+	uint32_t read(size_t size)
+	{
+		uint32_t value = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			value |= static_cast<uint32_t>(m_data[m_position + i]) << (i * 8);
+		}
+		m_position += size;
+		return value;
+	}
+
+	std::span<const std::byte> m_data;
+	size_t m_position = 0;
+};
+
+std::vector<std::byte> encode_window_state(window_state_snapshot const &snapshot)
+{
+	const auto control_count = static_cast<uint32_t>(std::min<size_t>(snapshot.controls.size(), window_state_max_controls));
+
+	std::vector<std::byte> data;
+	data.reserve(header_size + window_record_size + control_count * control_record_size);
+	state_writer writer(data);
+
+	writer.write_u32(window_state_magic);
+	writer.write_u16(window_state_version);
+	writer.write_u16(static_cast<uint16_t>(header_size));
+	writer.write_u16(static_cast<uint16_t>(window_record_size));
+	writer.write_u16(static_cast<uint16_t>(control_record_size));
+	writer.write_u32(control_count);
+	//The checksum is filled in once the rest has been written.
+	writer.write_u32(0);
+
+	writer.write_rect(snapshot.window_rect);
+	writer.write_u32(snapshot.dpi);
+	writer.write_u32(snapshot.focused_control);
+	writer.write_u32(snapshot.maximized ? window_flag_maximized : 0);
+
+	for (uint32_t i = 0; i < control_count; ++i)
+	{
+		auto &control = snapshot.controls[i];
+		writer.write_u32(control.control_id);
+		writer.write_rect(control.rect);
+		writer.write_u32(control.visible ? control_flag_visible : 0);
+	}
+
+	const auto checksum = window_state_checksum(std::span<const std::byte>(data).subspan(header_size));
+	for (size_t i = 0; i < 4; ++i)
+	{
+		data[header_size - 4 + i] = static_cast<std::byte>((checksum >> (i * 8)) & 0xFF);
+	}
+
+	return data;
+}
+
+window_state_result decode_window_state(std::span<const std::byte> data, window_state_snapshot &snapshot)
+{
+	if (data.size() < header_size)
+	{
+		return window_state_result::too_small;
+	}
+
+	state_reader header(data);
+	if (header.read_u32() != window_state_magic)
+	{
+		return window_state_result::bad_magic;
+	}
+	if (header.read_u16() != window_state_version)
+	{
+		return window_state_result::unsupported_version;
+	}
+
+	const size_t file_header_size = header.read_u16();
+	const size_t file_window_size = header.read_u16();
+	const size_t file_control_size = header.read_u16();
+	const uint32_t control_count = header.read_u32();
+	const uint32_t checksum = header.read_u32();
+
+	//Records may be bigger than this version knows about, but never smaller.
+	if (file_header_size < header_size || file_window_size < window_record_size || file_control_size < control_record_size)
+	{
+		return window_state_result::bad_size;
+	}
+	if (control_count > window_state_max_controls)
+	{
+		return window_state_result::too_many_controls;
+	}
+	//The limits above keep this well away from overflowing.
+	const size_t expected_size = file_header_size + file_window_size + static_cast<size_t>(control_count) * file_control_size;
+	if (data.size() != expected_size)
+	{
+		return window_state_result::bad_size;
+	}
+	if (window_state_checksum(data.subspan(file_header_size)) != checksum)
+	{
+		return window_state_result::bad_checksum;
+	}
+
+	window_state_snapshot decoded{};
+	state_reader window_record(data.subspan(file_header_size, file_window_size));
+	decoded.window_rect = window_record.read_rect();
+	decoded.dpi = window_record.read_u32();
+	decoded.focused_control = window_record.read_u32();
+	decoded.maximized = (window_record.read_u32() & window_flag_maximized) != 0;
+
+	decoded.controls.reserve(control_count);
+	auto control_records = data.subspan(file_header_size + file_window_size);
+	for (uint32_t i = 0; i < control_count; ++i)
+	{
+		state_reader control_record(control_records.subspan(i * file_control_size, file_control_size));
+		child_control_state control{};
+		control.control_id = control_record.read_u32();
+		control.rect = control_record.read_rect();
+		control.visible = (control_record.read_u32() & control_flag_visible) != 0;
+		decoded.controls.push_back(control);
+	}
+
+	snapshot = std::move(decoded);
+	return window_state_result::ok;
+}
\ No newline at end of file
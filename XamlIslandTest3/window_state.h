@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+#include "island_batch.h"
+
+//A snapshot of a window's state, saved on exit so that the next launch can put things back
+//before the first paint.
+//This only uses the standard library. Reading and writing the file is in window_state_store.h.
+
+//A child control of the window, either a native control or an island.
+struct child_control_state
+{
+	//Chosen by the window, it is only used to match the control up on the next launch.
+	uint32_t control_id = 0;
+	//In physical pixels at the snapshot's DPI.
+	island_rect rect{};
+	bool visible = true;
+};
+
+constexpr uint32_t no_focused_control = 0xFFFFFFFF;
+
+struct window_state_snapshot
+{
+	//The restored (not maximised) window rectangle in screen coordinates.
+	island_rect window_rect{};
+	bool maximized = false;
+	uint32_t dpi = 0;
+	//The control_id of the control that had focus.
+	uint32_t focused_control = no_focused_control;
+	std::vector<child_control_state> controls;
+};
+
+enum class window_state_result
+{
+	ok,
+	//The file couldn't be opened or mapped, usually because this is the first launch.
+	not_found,
+	too_small,
+	bad_magic,
+	unsupported_version,
+	bad_size,
+	bad_checksum,
+	too_many_controls
+};
+
+//The file is a fixed header followed by the window record and then the control records.
+//All values are little endian. The header records the size of each record, so a newer
+//version can add fields to the end of a record and still be read by this one.
+constexpr uint32_t window_state_magic = 0x53495358; //XSIS
+constexpr uint16_t window_state_version = 1;
+constexpr uint32_t window_state_max_controls = 1024;
+
+std::vector<std::byte> encode_window_state(window_state_snapshot const &);
+//Checks everything before trusting it, the file may be truncated, from another version or
+//simply garbage. The snapshot is only written to if the result is ok.
+window_state_result decode_window_state(std::span<const std::byte>, window_state_snapshot &);
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "window_state_store.h"
+#include "dpi_layout.h"
+
+#include <ShellScalingApi.h>
+
+#pragma comment(lib, "shcore.lib")
+
+std::filesystem::path get_window_state_path()
+{
+	std::error_code ec;
+	return std::filesystem::temp_directory_path(ec) / L"XamlIslandTest3" / L"window_state.bin";
+}
+
+window_state_result load_window_state(std::filesystem::path const &path, window_state_snapshot &snapshot)
+{
+	wil::unique_hfile file(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+	if (!file)
+	{
+		return window_state_result::not_found;
+	}
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file.get(), &size) || size.QuadPart == 0)
+	{
+		return window_state_result::too_small;
+	}
+	//Anything this big can't be a snapshot.
+	if (size.QuadPart > 1024 * 1024)
+	{
+		return window_state_result::bad_size;
+	}
+
+	wil::unique_handle mapping(CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!mapping)
+	{
+		return window_state_result::not_found;
+	}
+	wil::unique_mapview_ptr<std::byte> view(static_cast<std::byte *>(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0)));
+	if (!view)
+	{
+		return window_state_result::not_found;
+	}
+
+	return decode_window_state(std::span<const std::byte>(view.get(), static_cast<size_t>(size.QuadPart)), snapshot);
+}
+
+DWORD save_window_state(std::filesystem::path const &path, window_state_snapshot const &snapshot)
+{
+	const auto data = encode_window_state(snapshot);
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	auto temporary_path = path;
+	temporary_path += L".tmp";
+	{
+		wil::unique_hfile file(CreateFileW(temporary_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+		if (!file)
+		{
+			return GetLastError();
+		}
+
+		DWORD written = 0;
+		if (!WriteFile(file.get(), data.data(), static_cast<DWORD>(data.size()), &written, nullptr) || written != data.size() || !FlushFileBuffers(file.get()))
+		{
+			const auto error = GetLastError();
+			file.reset();
+			DeleteFileW(temporary_path.c_str());
+			return error == ERROR_SUCCESS ? ERROR_WRITE_FAULT : error;
+		}
+	}
+
+	if (!MoveFileExW(temporary_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		const auto error = GetLastError();
+		DeleteFileW(temporary_path.c_str());
+		return error;
+	}
+	return ERROR_SUCCESS;
+}
+
+//The restored rectangle from GetWindowPlacement is in workspace coordinates, which are
+//offset from screen coordinates when the taskbar is at the top or left of the monitor.
+void capture_window_placement(HWND window, window_state_snapshot &snapshot)
+{
+	WINDOWPLACEMENT placement{ sizeof(WINDOWPLACEMENT) };
+	if (!GetWindowPlacement(window, &placement))
+	{
+		return;
+	}
+
+	RECT rect = placement.rcNormalPosition;
+	if ((GetWindowLongPtrW(window, GWL_EXSTYLE) & WS_EX_TOOLWINDOW) == 0)
+	{
+		MONITORINFO monitor_info{ sizeof(MONITORINFO) };
+		if (GetMonitorInfoW(MonitorFromRect(&rect, MONITOR_DEFAULTTONEAREST), &monitor_info))
+		{
+			OffsetRect(&rect, monitor_info.rcWork.left - monitor_info.rcMonitor.left, monitor_info.rcWork.top - monitor_info.rcMonitor.top);
+		}
+	}
+
+	snapshot.window_rect = { rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top };
+	snapshot.maximized = placement.showCmd == SW_SHOWMAXIMIZED || (placement.showCmd == SW_SHOWMINIMIZED && (placement.flags & WPF_RESTORETOMAXIMIZED) != 0);
+	snapshot.dpi = GetDpiForWindow(window);
+}
+
+//The monitor may have a different scale since the snapshot was taken.
+bool get_restore_rect(window_state_snapshot const &snapshot, RECT &rect)
+{
+	if (snapshot.window_rect.width <= 0 || snapshot.window_rect.height <= 0 || snapshot.dpi == 0)
+	{
+		return false;
+	}
+
+	rect = { snapshot.window_rect.x, snapshot.window_rect.y, snapshot.window_rect.x + snapshot.window_rect.width, snapshot.window_rect.y + snapshot.window_rect.height };
+	const auto monitor = MonitorFromRect(&rect, MONITOR_DEFAULTTONULL);
+	if (monitor == nullptr)
+	{
+		return false;
+	}
+
+	UINT dpi_x = 0;
+	UINT dpi_y = 0;
+	if (SUCCEEDED(GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &dpi_x, &dpi_y)) && dpi_x != snapshot.dpi)
+	{
+		rect.right = rect.left + scale_between_dpi(snapshot.window_rect.width, snapshot.dpi, dpi_x);
+		rect.bottom = rect.top + scale_between_dpi(snapshot.window_rect.height, snapshot.dpi, dpi_x);
+	}
+	return true;
+}
\ No newline at end of file
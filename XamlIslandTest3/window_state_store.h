@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef _WINDOWS_
+#define _WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#ifndef _FILESYSTEM_
+#include <filesystem>
+#endif
+
+#include "window_state.h"
+
+//Reading and writing window_state_snapshot files with the Windows API.
+
+//Where the main window keeps its snapshot.
+std::filesystem::path get_window_state_path();
+//Reads the snapshot through a single read only mapping of the file.
+window_state_result load_window_state(std::filesystem::path const &, window_state_snapshot &);
+//Writes the snapshot to a temporary file next to the real one, flushes it and then replaces the
+//real one, so a crash part way through leaves either the old snapshot or the new one.
+//Returns the Windows error code, or ERROR_SUCCESS.
+DWORD save_window_state(std::filesystem::path const &, window_state_snapshot const &);
+
+//Fills in the restored window rectangle, in screen coordinates, the maximised state and the DPI.
+void capture_window_placement(HWND, window_state_snapshot &);
+//Gets the rectangle to create the window with, scaled to the DPI of the monitor it will be on.
+//Returns false if the rectangle is no longer on any monitor.
+bool get_restore_rect(window_state_snapshot const &, RECT &);
\ No newline at end of file
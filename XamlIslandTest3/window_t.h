@@ -19,19 +19,30 @@ protected:
 	//This would have to be modified for multiple top level windows.
 	void on_destroy()
 	{
+		//Outstanding coroutines and timers must not continue to run against a window that is going away.
+		cancel_coroutines();
+		shutdown_suspension();
+		cancel_timers();
 		PostQuitMessage(0);
 	}
 
 	//WM_ACTIVATE handler.
-	//This handler just stores what window has keyboard
+	//This handler stores what window has keyboard
 	//focus when we deactivate the window. This allows the window
 	//to restore the focus correctly when the window regains
 	//focus.
+	//Activation also feeds the island suspension, background windows
+	//have their islands suspended after an idle period.
 	void on_activate(uint16_t state, HWND, uint16_t)
 	{
 		if (state == WA_INACTIVE)
 		{
 			m_window_focus = GetFocus();
+			process_suspension_event(suspension_event::deactivated);
+		}
+		else
+		{
+			process_suspension_event(suspension_event::activated);
 		}
 	}
 
@@ -66,6 +77,19 @@ protected:
 			on_setfocus(reinterpret_cast<HWND>(wparam));
 			return 0;
 		}
+		case WM_ENTERSIZEMOVE:
+		case WM_ENTERMENULOOP:
+		{
+			//DefWindowProc pumps messages itself until the move, size or menu ends.
+			enter_modal_loop();
+			break;
+		}
+		case WM_EXITSIZEMOVE:
+		case WM_EXITMENULOOP:
+		{
+			exit_modal_loop();
+			break;
+		}
 		case WM_USER_QUERY_WINDOWBASE:
 		{
 			//This handles the WM_USER_QUERY_WINDOWBASE user message.
@@ -78,6 +102,13 @@ protected:
 			//This retrieves the window_base pointer for this class.
 			return reinterpret_cast<LRESULT>(static_cast<window_base *>(this));
 		}
+		case WM_USER_RESUME_COROUTINE:
+		{
+			//This handles the WM_USER_RESUME_COROUTINE user message.
+			//This continues a coroutine that awaited this window's thread.
+			resume_coroutine(wparam, lparam);
+			return 0;
+		}
 		case WM_USER_VERIFY_POINTER:
 		{
 			//This handles the WM_USER_VERIFY_POINTER user message.
@@ -187,4 +218,22 @@ template<typename T>
 auto LoadControlFromResource(uint16_t id) -> T
 {
 	return LoadControlFromResource(id).as<T>();
+}
+//Asynchronous versions that give the handler the content as T.
+//If the content isn't a T then the handler gets E_NOINTERFACE.
+template<typename T, typename F>
+void LoadControlFromFileAsync(window_base &window, std::wstring const &file_name, F &&handler)
+{
+	LoadControlFromFileAsync(window, file_name, [handler = std::forward<F>(handler)](winrt::hresult result, winrt::Microsoft::UI::Xaml::UIElement const &element) mutable {
+		T control = element ? element.try_as<T>() : T{ nullptr };
+		handler(element && !control ? winrt::hresult(E_NOINTERFACE) : result, control);
+		});
+}
+template<typename T, typename F>
+void LoadControlFromResourceAsync(window_base &window, uint16_t id, F &&handler)
+{
+	LoadControlFromResourceAsync(window, id, [handler = std::forward<F>(handler)](winrt::hresult result, winrt::Microsoft::UI::Xaml::UIElement const &element) mutable {
+		T control = element ? element.try_as<T>() : T{ nullptr };
+		handler(element && !control ? winrt::hresult(E_NOINTERFACE) : result, control);
+		});
 }
\ No newline at end of file
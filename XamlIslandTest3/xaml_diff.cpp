@@ -0,0 +1,370 @@
+#include "pch.h"
+#include "xaml_diff.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+size_t count_xaml_elements(xaml_element const &element)
+{
+	size_t count = 1;
+	for (auto &child : element.children)
+	{
+		count += count_xaml_elements(child);
+	}
+	return count;
+}
+
+//Records the size of each subtree, indexed by the pre-order position of its root.
+//The id of a child is the id of its parent plus one plus the sizes of the children before it.
+size_t measure_subtrees(xaml_element const &element, std::vector<uint32_t> &sizes)
+{
+	const auto id = sizes.size();
+	sizes.push_back(0);
+
+	size_t size = 1;
+	for (auto &child : element.children)
+	{
+		size += measure_subtrees(child, sizes);
+	}
+	sizes[id] = static_cast<uint32_t>(size);
+	return size;
+}
+
+//Finds the longest increasing subsequence of the values, the entries in it are marked.
+//Values of SIZE_MAX aren't part of the sequence.
+void mark_longest_increasing(std::span<const size_t> values, std::vector<bool> &marked)
+{
+	//The value index at the end of the best run of each length, and the previous index in each run.
+	std::vector<size_t> run_ends;
+	std::vector<size_t> previous(values.size(), SIZE_MAX);
+
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		if (values[i] == SIZE_MAX)
+		{
+			continue;
+		}
+
+		auto position = std::lower_bound(run_ends.begin(), run_ends.end(), values[i], [&values](size_t end, size_t value) { return values[end] < value; });
+		if (position != run_ends.begin())
+		{
+			previous[i] = *(position - 1);
+		}
+		if (position == run_ends.end())
+		{
+			run_ends.push_back(i);
+		}
+		else
+		{
+			*position = i;
+		}
+	}
+
+	marked.assign(values.size(), false);
+	for (auto i = run_ends.empty() ? SIZE_MAX : run_ends.back(); i != SIZE_MAX; i = previous[i])
+	{
+		marked[i] = true;
+	}
+}
+
+class xaml_differ
+{
+public:
+	xaml_differ(xaml_diff_result &result) : m_result(result)
+	{
+	}
+
+	void diff(xaml_element const &old_tree, xaml_element const &new_tree)
+	{
+		measure_subtrees(old_tree, m_sizes);
+		m_result.statistics.old_nodes = m_sizes.size();
+		m_result.statistics.new_nodes = count_xaml_elements(new_tree);
+
+		if (old_tree.type != new_tree.type || old_tree.key != new_tree.key)
+		{
+			xaml_patch patch{};
+			patch.operation = xaml_patch_operation::replace_root;
+			patch.element = &new_tree;
+			m_result.patches.push_back(patch);
+			return;
+		}
+		diff_element(0, old_tree, new_tree);
+	}
+
+private:
+	void diff_element(uint32_t node, xaml_element const &old_element, xaml_element const &new_element)
+	{
+		++m_result.statistics.matched_nodes;
+		diff_properties(node, old_element, new_element);
+		diff_children(node, old_element, new_element);
+	}
+
+	void diff_properties(uint32_t node, xaml_element const &old_element, xaml_element const &new_element)
+	{
+		for (auto &property : new_element.properties)
+		{
+			auto existing = std::find_if(old_element.properties.begin(), old_element.properties.end(), [&property](xaml_element_property const &old_property) { return old_property.name == property.name; });
+			if (existing == old_element.properties.end() || existing->value != property.value)
+			{
+				xaml_patch patch{};
+				patch.operation = xaml_patch_operation::set_property;
+				patch.node = node;
+				patch.name = property.name;
+				patch.value = property.value;
+				m_result.patches.push_back(patch);
+				++m_result.statistics.property_sets;
+			}
+		}
+
+		for (auto &property : old_element.properties)
+		{
+			auto remaining = std::find_if(new_element.properties.begin(), new_element.properties.end(), [&property](xaml_element_property const &new_property) { return new_property.name == property.name; });
+			if (remaining == new_element.properties.end())
+			{
+				xaml_patch patch{};
+				patch.operation = xaml_patch_operation::clear_property;
+				patch.node = node;
+				patch.name = property.name;
+				m_result.patches.push_back(patch);
+				++m_result.statistics.property_clears;
+			}
+		}
+	}
+
+	void diff_children(uint32_t node, xaml_element const &old_element, xaml_element const &new_element)
+	{
+		auto &old_children = old_element.children;
+		auto &new_children = new_element.children;
+		if (old_children.empty() && new_children.empty())
+		{
+			return;
+		}
+
+		//Most updates leave the children where they were, so that is checked first.
+		const bool unchanged_children = old_children.size() == new_children.size() && std::equal(old_children.begin(), old_children.end(), new_children.begin(), [](xaml_element const &a, xaml_element const &b)
+			{
+				return a.type == b.type && a.key == b.key;
+			});
+		if (unchanged_children)
+		{
+			auto child_node = node + 1;
+			for (size_t i = 0; i < old_children.size(); ++i)
+			{
+				diff_element(child_node, old_children[i], new_children[i]);
+				child_node += m_sizes[child_node];
+			}
+			return;
+		}
+
+		//Pair each new child with an old one.
+		//Keyed children are looked up by key, the others are handed out by type in order.
+		std::unordered_map<std::wstring_view, size_t> keyed;
+		std::unordered_map<std::wstring_view, std::vector<size_t>> unkeyed;
+		for (size_t i = old_children.size(); i-- > 0;)
+		{
+			auto &child = old_children[i];
+			if (child.key.empty())
+			{
+				unkeyed[child.type].push_back(i);
+			}
+			else
+			{
+				keyed.emplace(child.key, i);
+			}
+		}
+
+		std::vector<size_t> new_to_old(new_children.size(), SIZE_MAX);
+		std::vector<bool> old_matched(old_children.size(), false);
+		for (size_t j = 0; j < new_children.size(); ++j)
+		{
+			auto &child = new_children[j];
+			size_t i = SIZE_MAX;
+			if (child.key.empty())
+			{
+				auto candidates = unkeyed.find(child.type);
+				if (candidates != unkeyed.end() && !candidates->second.empty())
+				{
+					i = candidates->second.back();
+					candidates->second.pop_back();
+				}
+			}
+			else if (auto match = keyed.find(child.key); match != keyed.end())
+			{
+				i = match->second;
+				keyed.erase(match);
+			}
+
+			if (i != SIZE_MAX && old_children[i].type == child.type)
+			{
+				new_to_old[j] = i;
+				old_matched[i] = true;
+			}
+		}
+
+		//Removes go from the end so that the indices of the children before are unchanged.
+		for (size_t i = old_children.size(); i-- > 0;)
+		{
+			if (!old_matched[i])
+			{
+				xaml_patch patch{};
+				patch.operation = xaml_patch_operation::remove_child;
+				patch.node = node;
+				patch.index = static_cast<uint32_t>(i);
+				m_result.patches.push_back(patch);
+				++m_result.statistics.removes;
+			}
+		}
+
+		//After the removes, the children are the matched ones in their old order.
+		//Entries below the old child count are old children, the rest are new children being inserted.
+		std::vector<size_t> current;
+		current.reserve(new_children.size());
+		for (size_t i = 0; i < old_children.size(); ++i)
+		{
+			if (old_matched[i])
+			{
+				current.push_back(i);
+			}
+		}
+
+		std::vector<bool> in_place;
+		mark_longest_increasing(new_to_old, in_place);
+
+		//Working from the end, each child that isn't already in place is put just before the
+		//child that follows it in the new order, which has already been dealt with.
+		const auto inserted_base = old_children.size();
+		for (size_t j = new_children.size(); j-- > 0;)
+		{
+			if (in_place[j])
+			{
+				continue;
+			}
+
+			size_t anchor = current.size();
+			if (j + 1 < new_children.size())
+			{
+				const auto next = new_to_old[j + 1] == SIZE_MAX ? inserted_base + j + 1 : new_to_old[j + 1];
+				anchor = static_cast<size_t>(std::find(current.begin(), current.end(), next) - current.begin());
+			}
+
+			xaml_patch patch{};
+			patch.node = node;
+			if (new_to_old[j] == SIZE_MAX)
+			{
+				patch.operation = xaml_patch_operation::insert_child;
+				patch.index = static_cast<uint32_t>(anchor);
+				patch.element = &new_children[j];
+				current.insert(current.begin() + anchor, inserted_base + j);
+				++m_result.statistics.inserts;
+			}
+			else
+			{
+				const auto from = static_cast<size_t>(std::find(current.begin(), current.end(), new_to_old[j]) - current.begin());
+				const auto to = from < anchor ? anchor - 1 : anchor;
+				if (from == to)
+				{
+					continue;
+				}
+				patch.operation = xaml_patch_operation::move_child;
+				patch.from = static_cast<uint32_t>(from);
+				patch.index = static_cast<uint32_t>(to);
+				current.erase(current.begin() + from);
+				current.insert(current.begin() + to, new_to_old[j]);
+				++m_result.statistics.moves;
+			}
+			m_result.patches.push_back(patch);
+		}
+
+		//The children that were kept are diffed in turn.
+		std::vector<uint32_t> child_nodes(old_children.size());
+		auto child_node = node + 1;
+		for (size_t i = 0; i < old_children.size(); ++i)
+		{
+			child_nodes[i] = child_node;
+			child_node += m_sizes[child_node];
+		}
+		for (size_t j = 0; j < new_children.size(); ++j)
+		{
+			if (new_to_old[j] != SIZE_MAX)
+			{
+				diff_element(child_nodes[new_to_old[j]], old_children[new_to_old[j]], new_children[j]);
+			}
+		}
+	}
+
+	xaml_diff_result &m_result;
+	std::vector<uint32_t> m_sizes;
+};
+
+xaml_diff_result diff_xaml_trees(xaml_element const &old_tree, xaml_element const &new_tree)
+{
+	xaml_diff_result result{};
+	xaml_differ differ(result);
+	differ.diff(old_tree, new_tree);
+	return result;
+}
+
+void append_escaped_markup(std::wstring &markup, std::wstring_view text)
+{
+	for (auto c : text)
+	{
+		switch (c)
+		{
+		case L'&':
+			markup.append(L"&amp;");
+			break;
+		case L'<':
+			markup.append(L"&lt;");
+			break;
+		case L'>':
+			markup.append(L"&gt;");
+			break;
+		case L'"':
+			markup.append(L"&quot;");
+			break;
+		default:
+			markup.push_back(c);
+			break;
+		}
+	}
+}
+
+void append_element_markup(std::wstring &markup, xaml_element const &element, bool root)
+{
+	markup.push_back(L'<');
+	markup.append(element.type);
+	if (root)
+	{
+		markup.append(L" xmlns=\"http://schemas.microsoft.com/winfx/2006/xaml/presentation\"");
+	}
+	for (auto &property : element.properties)
+	{
+		markup.push_back(L' ');
+		markup.append(property.name);
+		markup.append(L"=\"");
+		append_escaped_markup(markup, property.value);
+		markup.push_back(L'"');
+	}
+
+	if (element.children.empty())
+	{
+		markup.append(L"/>");
+		return;
+	}
+
+	markup.push_back(L'>');
+	for (auto &child : element.children)
+	{
+		append_element_markup(markup, child, false);
+	}
+	markup.append(L"</");
+	markup.append(element.type);
+	markup.push_back(L'>');
+}
+
+std::wstring write_xaml_markup(xaml_element const &element)
+{
+	std::wstring markup;
+	append_element_markup(markup, element, true);
+	return markup;
+}
\ No newline at end of file
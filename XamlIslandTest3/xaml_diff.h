@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//A lightweight description of a xaml tree, and a diff between two of them.
+//Panels that are regenerated often can describe their content and have only the differences
+//applied to the live tree, rather than loading a whole new tree and replacing the old one.
+//This only uses the standard library, applying the patches is in xaml_patch.h.
+
+struct xaml_element_property
+{
+	std::wstring name;
+	//The value as it would be written in markup.
+	std::wstring value;
+};
+
+struct xaml_element
+{
+	//The element name as it would be written in markup, for example StackPanel.
+	std::wstring type;
+	//Identifies the element among its siblings so it can be matched up when they are reordered.
+	//It is only used by the diff. Elements without a key are matched by type, in order.
+	std::wstring key;
+	//Elements are expected to have a small number of properties.
+	std::vector<xaml_element_property> properties;
+	std::vector<xaml_element> children;
+};
+
+enum class xaml_patch_operation : uint8_t
+{
+	set_property,
+	clear_property,
+	//Inserts a new element, along with all of its children, at index.
+	insert_child,
+	remove_child,
+	//Moves the child at from to index. The index is the position after the child has been taken out.
+	move_child,
+	//The root elements don't match, so the whole tree is replaced.
+	replace_root
+};
+
+//Elements are identified by their position in a pre-order walk of the old tree, so the root is 0.
+//The child indices for one parent are in terms of its children as they are when the patch is
+//applied, so the patches for a parent must be applied in order.
+//Patches for different elements don't depend on each other.
+struct xaml_patch
+{
+	xaml_patch_operation operation = xaml_patch_operation::set_property;
+	uint32_t node = 0;
+	uint32_t index = 0;
+	uint32_t from = 0;
+	//The property for set_property and clear_property.
+	std::wstring_view name;
+	std::wstring_view value;
+	//The new element for insert_child and replace_root.
+	xaml_element const *element = nullptr;
+};
+
+struct xaml_diff_statistics
+{
+	size_t old_nodes = 0;
+	size_t new_nodes = 0;
+	size_t matched_nodes = 0;
+	size_t property_sets = 0;
+	size_t property_clears = 0;
+	size_t inserts = 0;
+	size_t removes = 0;
+	size_t moves = 0;
+};
+
+//The patches refer to strings and elements in the new tree, so it has to outlive them.
+struct xaml_diff_result
+{
+	std::vector<xaml_patch> patches;
+	xaml_diff_statistics statistics{};
+};
+
+//Works out the patches that turn the old tree into the new one.
+//Children are matched by key, or by type and order for those without a key. An element that
+//doesn't match anything in the old tree is inserted, and one that matches an element of a
+//different type replaces it. Matched children are only moved if they aren't part of the
+//longest run of children that are already in the right order, so the number of moves is
+//as small as it can be. Elements are never moved between parents.
+xaml_diff_result diff_xaml_trees(xaml_element const &old_tree, xaml_element const &new_tree);
+
+//Counts the elements in a tree, including the root.
+size_t count_xaml_elements(xaml_element const &);
+
+//Writes the element and its children as markup.
+//The default xaml namespace is declared on the element, so the result can be given straight
+//to XamlReader::Load. Keys aren't written.
+std::wstring write_xaml_markup(xaml_element const &);
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "pch.h"
+#include "xaml_patch.h"
+#include "logging.h"
+
+namespace mux = winrt::Microsoft::UI::Xaml;
+namespace muxc = winrt::Microsoft::UI::Xaml::Controls;
+namespace muxh = winrt::Microsoft::UI::Xaml::Hosting;
+namespace muxm = winrt::Microsoft::UI::Xaml::Markup;
+
+//Gets the property if the target is an Owner.
+template <typename Owner, typename F>
+mux::DependencyProperty owned_property(mux::DependencyObject const &target, F get_property)
+{
+	return target.try_as<Owner>() ? get_property() : nullptr;
+}
+
+struct known_property
+{
+	std::wstring_view name;
+	mux::DependencyProperty (*find)(mux::DependencyObject const &);
+};
+
+//Properties that are commonly changed when panels are regenerated.
+//A name can belong to more than one type, so the lookup checks what the target is.
+const known_property known_properties[] =
+{
+	{ L"Width", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::WidthProperty(); }); } },
+	{ L"Height", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::HeightProperty(); }); } },
+	{ L"MinWidth", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::MinWidthProperty(); }); } },
+	{ L"MinHeight", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::MinHeightProperty(); }); } },
+	{ L"MaxWidth", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::MaxWidthProperty(); }); } },
+	{ L"MaxHeight", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::MaxHeightProperty(); }); } },
+	{ L"Margin", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::MarginProperty(); }); } },
+	{ L"HorizontalAlignment", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::HorizontalAlignmentProperty(); }); } },
+	{ L"VerticalAlignment", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::VerticalAlignmentProperty(); }); } },
+	{ L"Tag", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return mux::FrameworkElement::TagProperty(); }); } },
+	{ L"Opacity", [](mux::DependencyObject const &target) { return owned_property<mux::UIElement>(target, [] { return mux::UIElement::OpacityProperty(); }); } },
+	{ L"Visibility", [](mux::DependencyObject const &target) { return owned_property<mux::UIElement>(target, [] { return mux::UIElement::VisibilityProperty(); }); } },
+	{ L"IsEnabled", [](mux::DependencyObject const &target) { return owned_property<muxc::Control>(target, [] { return muxc::Control::IsEnabledProperty(); }); } },
+	{ L"Content", [](mux::DependencyObject const &target) { return owned_property<muxc::ContentControl>(target, [] { return muxc::ContentControl::ContentProperty(); }); } },
+	{ L"Text", [](mux::DependencyObject const &target) { return owned_property<muxc::TextBlock>(target, [] { return muxc::TextBlock::TextProperty(); }); } },
+	{ L"Orientation", [](mux::DependencyObject const &target) { return owned_property<muxc::StackPanel>(target, [] { return muxc::StackPanel::OrientationProperty(); }); } },
+	{ L"Spacing", [](mux::DependencyObject const &target) { return owned_property<muxc::StackPanel>(target, [] { return muxc::StackPanel::SpacingProperty(); }); } },
+	{ L"Background", [](mux::DependencyObject const &target) -> mux::DependencyProperty
+		{
+			if (target.try_as<muxc::Control>())
+			{
+				return muxc::Control::BackgroundProperty();
+			}
+			if (target.try_as<muxc::Panel>())
+			{
+				return muxc::Panel::BackgroundProperty();
+			}
+			return owned_property<muxc::Border>(target, [] { return muxc::Border::BackgroundProperty(); });
+		} },
+	{ L"Foreground", [](mux::DependencyObject const &target) -> mux::DependencyProperty
+		{
+			if (target.try_as<muxc::Control>())
+			{
+				return muxc::Control::ForegroundProperty();
+			}
+			return owned_property<muxc::TextBlock>(target, [] { return muxc::TextBlock::ForegroundProperty(); });
+		} },
+	{ L"FontSize", [](mux::DependencyObject const &target) -> mux::DependencyProperty
+		{
+			if (target.try_as<muxc::Control>())
+			{
+				return muxc::Control::FontSizeProperty();
+			}
+			return owned_property<muxc::TextBlock>(target, [] { return muxc::TextBlock::FontSizeProperty(); });
+		} },
+	{ L"Padding", [](mux::DependencyObject const &target) -> mux::DependencyProperty
+		{
+			if (target.try_as<muxc::Control>())
+			{
+				return muxc::Control::PaddingProperty();
+			}
+			return owned_property<muxc::Border>(target, [] { return muxc::Border::PaddingProperty(); });
+		} },
+	{ L"Grid.Row", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Grid::RowProperty(); }); } },
+	{ L"Grid.Column", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Grid::ColumnProperty(); }); } },
+	{ L"Grid.RowSpan", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Grid::RowSpanProperty(); }); } },
+	{ L"Grid.ColumnSpan", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Grid::ColumnSpanProperty(); }); } },
+	{ L"Canvas.Left", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Canvas::LeftProperty(); }); } },
+	{ L"Canvas.Top", [](mux::DependencyObject const &target) { return owned_property<mux::FrameworkElement>(target, [] { return muxc::Canvas::TopProperty(); }); } }
+};
+
+mux::DependencyProperty find_dependency_property(mux::DependencyObject const &target, std::wstring_view name)
+{
+	for (auto &property : known_properties)
+	{
+		if (property.name == name)
+		{
+			return property.find(target);
+		}
+	}
+	return nullptr;
+}
+
+//The ways an element can hold children.
+enum class child_container
+{
+	none,
+	panel,
+	border,
+	content_control
+};
+
+child_container get_child_container(mux::UIElement const &element)
+{
+	if (element.try_as<muxc::Panel>())
+	{
+		return child_container::panel;
+	}
+	if (element.try_as<muxc::Border>())
+	{
+		return child_container::border;
+	}
+	if (element.try_as<muxc::ContentControl>())
+	{
+		return child_container::content_control;
+	}
+	return child_container::none;
+}
+
+uint32_t get_child_count(mux::UIElement const &element, child_container container)
+{
+	switch (container)
+	{
+	case child_container::panel:
+		return element.as<muxc::Panel>().Children().Size();
+	case child_container::border:
+		return element.as<muxc::Border>().Child() ? 1 : 0;
+	case child_container::content_control:
+		//Content that isn't an element, such as text, isn't a child as far as the patches are concerned.
+		return element.as<muxc::ContentControl>().Content().try_as<mux::UIElement>() ? 1 : 0;
+	}
+	return 0;
+}
+
+mux::UIElement get_child(mux::UIElement const &element, child_container container, uint32_t index)
+{
+	switch (container)
+	{
+	case child_container::panel:
+		return element.as<muxc::Panel>().Children().GetAt(index);
+	case child_container::border:
+		return element.as<muxc::Border>().Child();
+	case child_container::content_control:
+		return element.as<muxc::ContentControl>().Content().as<mux::UIElement>();
+	}
+	return nullptr;
+}
+
+//The live elements in the same pre-order as the old tree, along with how each holds its children.
+struct live_tree_map
+{
+	std::vector<mux::UIElement> elements;
+	std::vector<child_container> containers;
+	//Kept up to date as the patches are checked.
+	std::vector<uint32_t> child_counts;
+};
+
+//Returns false if the live tree doesn't have the same shape as the description.
+bool map_live_tree(mux::UIElement const &element, xaml_element const &description, live_tree_map &map)
+{
+	const auto container = get_child_container(element);
+	const auto child_count = get_child_count(element, container);
+	if (child_count != description.children.size())
+	{
+		return false;
+	}
+
+	map.elements.push_back(element);
+	map.containers.push_back(container);
+	map.child_counts.push_back(child_count);
+	for (uint32_t i = 0; i < child_count; ++i)
+	{
+		if (!map_live_tree(get_child(element, container, i), description.children[i], map))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//A patch with everything it needs already looked up.
+struct prepared_patch
+{
+	xaml_patch const *patch = nullptr;
+	mux::DependencyProperty property{ nullptr };
+	mux::UIElement element{ nullptr };
+};
+
+bool prepare_xaml_patch(xaml_patch const &patch, live_tree_map &map, prepared_patch &prepared)
+{
+	prepared.patch = &patch;
+	if (patch.operation == xaml_patch_operation::replace_root)
+	{
+		prepared.element = muxm::XamlReader::Load(write_xaml_markup(*patch.element)).as<mux::UIElement>();
+		return true;
+	}
+
+	if (patch.node >= map.elements.size())
+	{
+		return false;
+	}
+	auto &target = map.elements[patch.node];
+	const auto container = map.containers[patch.node];
+	auto &child_count = map.child_counts[patch.node];
+
+	switch (patch.operation)
+	{
+	case xaml_patch_operation::set_property:
+	case xaml_patch_operation::clear_property:
+		prepared.property = find_dependency_property(target, patch.name);
+		return prepared.property != nullptr;
+	case xaml_patch_operation::insert_child:
+		//Borders and content controls only have room for one child.
+		if (container == child_container::none || patch.index > child_count || (container != child_container::panel && child_count != 0))
+		{
+			return false;
+		}
+		prepared.element = muxm::XamlReader::Load(write_xaml_markup(*patch.element)).as<mux::UIElement>();
+		++child_count;
+		return true;
+	case xaml_patch_operation::remove_child:
+		if (patch.index >= child_count)
+		{
+			return false;
+		}
+		--child_count;
+		return true;
+	case xaml_patch_operation::move_child:
+		return container == child_container::panel && patch.from < child_count && patch.index < child_count;
+	}
+	return false;
+}
+
+void apply_prepared_patch(prepared_patch const &prepared, live_tree_map const &map, mux::UIElement &root)
+{
+	auto &patch = *prepared.patch;
+	if (patch.operation == xaml_patch_operation::replace_root)
+	{
+		root = prepared.element;
+		return;
+	}
+
+	auto &target = map.elements[patch.node];
+	switch (patch.operation)
+	{
+	case xaml_patch_operation::set_property:
+		//Content takes any object, so the text would just be set as is.
+		if (prepared.property == muxc::ContentControl::ContentProperty())
+		{
+			target.SetValue(prepared.property, winrt::box_value(winrt::hstring(patch.value)));
+		}
+		else
+		{
+			muxm::XamlBindingHelper::SetPropertyFromString(target, prepared.property, winrt::hstring(patch.value));
+		}
+		break;
+	case xaml_patch_operation::clear_property:
+		target.ClearValue(prepared.property);
+		break;
+	case xaml_patch_operation::insert_child:
+		switch (map.containers[patch.node])
+		{
+		case child_container::panel:
+			target.as<muxc::Panel>().Children().InsertAt(patch.index, prepared.element);
+			break;
+		case child_container::border:
+			target.as<muxc::Border>().Child(prepared.element);
+			break;
+		case child_container::content_control:
+			target.as<muxc::ContentControl>().Content(prepared.element);
+			break;
+		}
+		break;
+	case xaml_patch_operation::remove_child:
+		switch (map.containers[patch.node])
+		{
+		case child_container::panel:
+			target.as<muxc::Panel>().Children().RemoveAt(patch.index);
+			break;
+		case child_container::border:
+			target.as<muxc::Border>().Child(nullptr);
+			break;
+		case child_container::content_control:
+			target.as<muxc::ContentControl>().Content(nullptr);
+			break;
+		}
+		break;
+	case xaml_patch_operation::move_child:
+		//Move keeps the element in the tree, so it isn't unloaded and loaded again.
+		target.as<muxc::Panel>().Children().Move(patch.from, patch.index);
+		break;
+	}
+}
+
+bool apply_xaml_patches(mux::UIElement &root, xaml_element const &old_tree, std::span<const xaml_patch> patches, xaml_patch_statistics &statistics)
+{
+	using clock = std::chrono::steady_clock;
+
+	if (patches.empty())
+	{
+		return true;
+	}
+
+	const auto prepare_start = clock::now();
+	live_tree_map map;
+	const bool replaces_root = patches.front().operation == xaml_patch_operation::replace_root;
+	if (!replaces_root && !map_live_tree(root, old_tree, map))
+	{
+		return false;
+	}
+
+	std::vector<prepared_patch> prepared(patches.size());
+	try
+	{
+		for (size_t i = 0; i < patches.size(); ++i)
+		{
+			if (!prepare_xaml_patch(patches[i], map, prepared[i]))
+			{
+				return false;
+			}
+			if (prepared[i].element)
+			{
+				++statistics.elements_created;
+			}
+		}
+	}
+	catch (...)
+	{
+		//The markup for an inserted element couldn't be loaded.
+		return false;
+	}
+
+	const auto apply_start = clock::now();
+	for (auto &patch : prepared)
+	{
+		apply_prepared_patch(patch, map, root);
+	}
+	statistics.patches_applied += prepared.size();
+
+	const auto apply_end = clock::now();
+	statistics.prepare_time += apply_start - prepare_start;
+	statistics.apply_time += apply_end - apply_start;
+	return true;
+}
+
+bool update_xaml_content(muxh::DesktopWindowXamlSource const &source, xaml_element const &old_tree, xaml_element const &new_tree)
+{
+	auto root = source.Content();
+	if (root)
+	{
+		const auto diff = diff_xaml_trees(old_tree, new_tree);
+		xaml_patch_statistics statistics{};
+		if (apply_xaml_patches(root, old_tree, diff.patches, statistics))
+		{
+			const bool patched = root == source.Content();
+			if (!patched)
+			{
+				source.Content(root);
+			}
+			log_trace(log_message::xaml_content_patched, statistics.patches_applied, statistics.elements_created, std::chrono::duration_cast<std::chrono::microseconds>(statistics.prepare_time + statistics.apply_time).count(), patched);
+			return patched;
+		}
+	}
+
+	source.Content(muxm::XamlReader::Load(write_xaml_markup(new_tree)).as<mux::UIElement>());
+	log_debug(log_message::xaml_content_reloaded, count_xaml_elements(new_tree));
+	return false;
+}
\ No newline at end of file
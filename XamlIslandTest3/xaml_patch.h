@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <span>
+
+#ifndef WINRT_Microsoft_UI_Xaml_H
+#include <winrt/Microsoft.UI.Xaml.h>
+#endif
+#ifndef WINRT_Microsoft_UI_Xaml_Hosting_H
+#include <winrt/Microsoft.UI.Xaml.Hosting.h>
+#endif
+
+#include "xaml_diff.h"
+
+//Applying xaml_diff patches to a live xaml tree.
+//Children are only supported for panels, borders and content controls. Properties are set by
+//name from the markup text, but only the properties known to find_dependency_property can be
+//set this way.
+
+struct xaml_patch_statistics
+{
+	size_t patches_applied = 0;
+	size_t elements_created = 0;
+	//Resolving elements and properties and creating the inserted elements.
+	std::chrono::nanoseconds prepare_time{};
+	//Changing the live tree.
+	std::chrono::nanoseconds apply_time{};
+};
+
+//Finds the dependency property for a property name, or returns null if it isn't known.
+//Attached properties are written as Owner.Property, for example Grid.Row.
+winrt::Microsoft::UI::Xaml::DependencyProperty find_dependency_property(winrt::Microsoft::UI::Xaml::DependencyObject const &, std::wstring_view);
+
+//Applies the patches to the live tree, which must match the old tree the patches were made from.
+//Everything is checked, and every inserted element is created, before the live tree is touched,
+//so if this returns false then nothing has been changed. The root is replaced if the patches
+//replace the root.
+//This must be called on the UI thread.
+bool apply_xaml_patches(winrt::Microsoft::UI::Xaml::UIElement &root, xaml_element const &old_tree, std::span<const xaml_patch>, xaml_patch_statistics &);
+
+//Changes the content of a xaml source from the old tree to the new tree.
+//The content is patched in place if possible, otherwise the new tree is loaded and replaces it.
+//Returns true if the content was patched in place.
+bool update_xaml_content(winrt::Microsoft::UI::Xaml::Hosting::DesktopWindowXamlSource const &, xaml_element const &old_tree, xaml_element const &new_tree);
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include "pch.h"
+#include "xaml_prewarm.h"
+#include "log_file.h"
+#include "xaml_text.h"
+
+#include <algorithm>
+#include <charconv>
+
+size_t xaml_source_key_hash::operator()(xaml_source_key const &key) const
+{
+	if (key.kind == xaml_source_kind::resource)
+	{
+		return std::hash<uint32_t>{}(key.resource_id);
+	}
+	return std::hash<std::wstring>{}(key.path) ^ 0x5BD1E995u;
+}
+
+xaml_source_key make_resource_source(uint16_t id)
+{
+	xaml_source_key key{};
+	key.kind = xaml_source_kind::resource;
+	key.resource_id = id;
+	return key;
+}
+
+xaml_source_key make_file_source(std::wstring_view path)
+{
+	xaml_source_key key{};
+	key.kind = xaml_source_kind::file;
+	key.path = path;
+	return key;
+}
+
+xaml_usage_recorder::xaml_usage_recorder(std::chrono::milliseconds window, clock_function clock) : m_clock(std::move(clock)), m_window(window)
+{
+	m_start = m_clock();
+}
+
+void xaml_usage_recorder::record(xaml_source_key const &source, size_t text_bytes)
+{
+	const auto since_start = std::chrono::duration_cast<std::chrono::milliseconds>(m_clock() - m_start);
+	if (since_start > m_window)
+	{
+		return;
+	}
+	//Paths with line breaks or tabs can't be written to the history.
+	if (source.path.find_first_of(L"\t\r\n") != std::wstring::npos)
+	{
+		return;
+	}
+
+	auto existing = std::find_if(m_records.begin(), m_records.end(), [&source](xaml_usage_record const &record) { return record.source == source; });
+	if (existing != m_records.end())
+	{
+		return;
+	}
+	m_records.push_back(xaml_usage_record{ source, since_start, text_bytes });
+}
+
+std::span<const xaml_usage_record> xaml_usage_recorder::get_records() const
+{
+	return m_records;
+}
+
+constexpr std::string_view usage_history_header = "xaml-usage 1";
+
+std::string encode_usage_history(xaml_usage_history const &history)
+{
+	std::string text(usage_history_header);
+	text.push_back('\n');
+
+	const auto first = history.size() > max_usage_history_runs ? history.size() - max_usage_history_runs : 0;
+	for (auto run = history.begin() + first; run != history.end(); ++run)
+	{
+		text.append("run\n");
+		for (auto &record : *run)
+		{
+			text.append(std::to_string(record.since_start.count()));
+			text.push_back('\t');
+			text.append(std::to_string(record.text_bytes));
+			if (record.source.kind == xaml_source_kind::resource)
+			{
+				text.append("\tresource\t");
+				text.append(std::to_string(record.source.resource_id));
+			}
+			else
+			{
+				text.append("\tfile\t");
+				append_utf8(text, record.source.path);
+			}
+			text.push_back('\n');
+		}
+	}
+
+	return text;
+}
+
+//Splits off the next tab separated field.
+std::string_view next_field(std::string_view &line)
+{
+	const auto tab = line.find('\t');
+	const auto field = line.substr(0, tab);
+	line = tab == std::string_view::npos ? std::string_view{} : line.substr(tab + 1);
+	return field;
+}
+
+template <typename T>
+bool parse_number(std::string_view field, T &value)
+{
+	const auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+	return result.ec == std::errc{} && result.ptr == field.data() + field.size();
+}
+
+bool decode_usage_record(std::string_view line, xaml_usage_record &record)
+{
+	int64_t milliseconds = 0;
+	if (!parse_number(next_field(line), milliseconds) || milliseconds < 0)
+	{
+		return false;
+	}
+	size_t text_bytes = 0;
+	if (!parse_number(next_field(line), text_bytes))
+	{
+		return false;
+	}
+
+	const auto kind = next_field(line);
+	if (kind == "resource")
+	{
+		uint16_t id = 0;
+		if (!parse_number(line, id))
+		{
+			return false;
+		}
+		record.source = make_resource_source(id);
+	}
+	else if (kind == "file" && !line.empty())
+	{
+		record.source = make_file_source(decode_xaml_text(line));
+	}
+	else
+	{
+		return false;
+	}
+
+	record.since_start = std::chrono::milliseconds(milliseconds);
+	record.text_bytes = text_bytes;
+	return true;
+}
+
+bool decode_usage_history(std::string_view text, xaml_usage_history &history)
+{
+	history.clear();
+
+	bool first_line = true;
+	while (!text.empty())
+	{
+		const auto end = text.find('\n');
+		auto line = text.substr(0, end);
+		text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+
+		if (first_line)
+		{
+			if (line != usage_history_header)
+			{
+				return false;
+			}
+			first_line = false;
+			continue;
+		}
+
+		if (line == "run")
+		{
+			history.emplace_back();
+			continue;
+		}
+
+		xaml_usage_record record{};
+		if (!history.empty() && decode_usage_record(line, record))
+		{
+			history.back().push_back(std::move(record));
+		}
+	}
+
+	return !first_line;
+}
+
+void append_usage_run(xaml_usage_history &history, std::span<const xaml_usage_record> run)
+{
+	history.emplace_back(run.begin(), run.end());
+	if (history.size() > max_usage_history_runs)
+	{
+		history.erase(history.begin(), history.begin() + (history.size() - max_usage_history_runs));
+	}
+}
+
+std::vector<prewarm_item> plan_xaml_prewarm(xaml_usage_history const &history, prewarm_planner_options const &options)
+{
+	struct fragment_usage
+	{
+		std::vector<std::chrono::milliseconds> first_uses;
+		size_t text_bytes = 0;
+		size_t last_run = SIZE_MAX;
+	};
+
+	std::unordered_map<xaml_source_key, fragment_usage, xaml_source_key_hash> usage;
+	for (size_t run = 0; run < history.size(); ++run)
+	{
+		for (auto &record : history[run])
+		{
+			auto &fragment = usage[record.source];
+			//A run only counts once per fragment, even if the history has it twice.
+			if (fragment.last_run != run)
+			{
+				fragment.last_run = run;
+				fragment.first_uses.push_back(record.since_start);
+			}
+			fragment.text_bytes = std::max(fragment.text_bytes, record.text_bytes);
+		}
+	}
+
+	std::vector<prewarm_item> candidates;
+	for (auto &[source, fragment] : usage)
+	{
+		const auto frequency = history.empty() ? 0.0 : static_cast<double>(fragment.first_uses.size()) / history.size();
+		if (frequency < options.minimum_frequency)
+		{
+			continue;
+		}
+
+		auto first_uses = fragment.first_uses;
+		std::nth_element(first_uses.begin(), first_uses.begin() + first_uses.size() / 2, first_uses.end());
+		candidates.push_back(prewarm_item{ source, first_uses[first_uses.size() / 2], frequency, fragment.text_bytes });
+	}
+
+	//The key comparison at the end keeps the plan the same from run to run.
+	std::sort(candidates.begin(), candidates.end(), [](prewarm_item const &a, prewarm_item const &b)
+		{
+			if (a.expected_use != b.expected_use)
+			{
+				return a.expected_use < b.expected_use;
+			}
+			if (a.frequency != b.frequency)
+			{
+				return a.frequency > b.frequency;
+			}
+			if (a.source.kind != b.source.kind)
+			{
+				return a.source.kind < b.source.kind;
+			}
+			return a.source.resource_id != b.source.resource_id ? a.source.resource_id < b.source.resource_id : a.source.path < b.source.path;
+		});
+
+	std::vector<prewarm_item> plan;
+	size_t planned_bytes = 0;
+	for (auto &candidate : candidates)
+	{
+		if (plan.size() == options.max_items)
+		{
+			break;
+		}
+		if (planned_bytes + candidate.text_bytes > options.memory_budget)
+		{
+			continue;
+		}
+		planned_bytes += candidate.text_bytes;
+		plan.push_back(std::move(candidate));
+	}
+
+	return plan;
+}
+
+xaml_text_cache::xaml_text_cache(size_t budget) : m_budget(budget)
+{
+}
+
+bool xaml_text_cache::insert(xaml_source_key const &source, std::wstring text)
+{
+	const auto bytes = text.size() * sizeof(wchar_t);
+
+	std::lock_guard lock(m_lock);
+	if (m_entries.contains(source) || m_requested.contains(source) || m_bytes + bytes > m_budget)
+	{
+		++m_counters.rejected;
+		return false;
+	}
+
+	m_bytes += bytes;
+	m_entries.emplace(source, std::move(text));
+	++m_counters.inserted;
+	return true;
+}
+
+std::optional<std::wstring> xaml_text_cache::take(xaml_source_key const &source)
+{
+	std::lock_guard lock(m_lock);
+	m_requested.insert(source);
+	auto it = m_entries.find(source);
+	if (it == m_entries.end())
+	{
+		++m_counters.misses;
+		return std::nullopt;
+	}
+
+	++m_counters.hits;
+	auto text = std::move(it->second);
+	m_entries.erase(it);
+	m_bytes -= text.size() * sizeof(wchar_t);
+	return text;
+}
+
+bool xaml_text_cache::is_wanted(xaml_source_key const &source) const
+{
+	std::lock_guard lock(m_lock);
+	return !m_entries.contains(source) && !m_requested.contains(source);
+}
+
+void xaml_text_cache::clear()
+{
+	std::lock_guard lock(m_lock);
+	m_entries.clear();
+	m_bytes = 0;
+}
+
+void xaml_text_cache::trim(size_t target_bytes)
+{
+	std::lock_guard lock(m_lock);
+	for (auto it = m_entries.begin(); it != m_entries.end() && m_bytes > target_bytes;)
+	{
+		m_bytes -= it->second.size() * sizeof(wchar_t);
+		it = m_entries.erase(it);
+		++m_counters.trimmed;
+	}
+}
+
+size_t xaml_text_cache::get_bytes() const
+{
+	std::lock_guard lock(m_lock);
+	return m_bytes;
+}
+
+xaml_text_cache_counters xaml_text_cache::get_counters() const
+{
+	std::lock_guard lock(m_lock);
+	return m_counters;
+}
+
+xaml_prewarmer::xaml_prewarmer(xaml_text_cache &cache, read_function read) : m_cache(cache), m_read(std::move(read))
+{
+}
+
+void xaml_prewarmer::start(std::vector<prewarm_item> plan)
+{
+	m_plan = std::move(plan);
+	m_next = 0;
+	m_statistics.planned += m_plan.size();
+}
+
+bool xaml_prewarmer::prewarm_next()
+{
+	while (m_next < m_plan.size())
+	{
+		auto &item = m_plan[m_next++];
+		//It may have been loaded for real already.
+		if (!m_cache.is_wanted(item.source))
+		{
+			++m_statistics.skipped;
+			continue;
+		}
+
+		try
+		{
+			if (m_cache.insert(item.source, m_read(item.source)))
+			{
+				++m_statistics.prewarmed;
+			}
+			else
+			{
+				++m_statistics.failed;
+			}
+		}
+		catch (...)
+		{
+			//A fragment that has gone away since the last run isn't a problem, it just isn't prewarmed.
+			++m_statistics.failed;
+		}
+		return m_next < m_plan.size();
+	}
+
+	return false;
+}
+
+void xaml_prewarmer::cancel()
+{
+	if (m_next < m_plan.size())
+	{
+		m_statistics.cancelled += m_plan.size() - m_next;
+	}
+	m_plan.clear();
+	m_next = 0;
+}
+
+bool xaml_prewarmer::is_active() const
+{
+	return m_next < m_plan.size();
+}
+
+prewarm_statistics const &xaml_prewarmer::get_statistics() const
+{
+	return m_statistics;
+}
\ No newline at end of file
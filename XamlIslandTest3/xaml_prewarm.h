@@ -0,0 +1,201 @@
+#pragma once
+
+#ifndef _CHRONO_
+#include <chrono>
+#endif
+#include <cstdint>
+#ifndef _FUNCTIONAL_
+#include <functional>
+#endif
+#include <mutex>
+#include <optional>
+#include <span>
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#ifndef _VECTOR_
+#include <vector>
+#endif
+
+//Records which xaml fragments are loaded soon after start, and uses what earlier runs recorded to
+//read and decode those fragments during startup idle time, before they are asked for.
+//This only uses the standard library, reading resources is supplied by the caller.
+
+enum class xaml_source_kind : uint8_t
+{
+	resource,
+	file
+};
+
+//Identifies a xaml fragment, either a resource id or a file path.
+struct xaml_source_key
+{
+	xaml_source_kind kind = xaml_source_kind::resource;
+	uint16_t resource_id = 0;
+	std::wstring path;
+
+	bool operator==(xaml_source_key const &) const = default;
+};
+
+struct xaml_source_key_hash
+{
+	size_t operator()(xaml_source_key const &) const;
+};
+
+xaml_source_key make_resource_source(uint16_t id);
+xaml_source_key make_file_source(std::wstring_view path);
+
+//A fragment that was loaded, and when.
+struct xaml_usage_record
+{
+	xaml_source_key source;
+	//Time from the start of the run to the first load.
+	std::chrono::milliseconds since_start{};
+	//The size of the decoded text, in bytes.
+	size_t text_bytes = 0;
+};
+
+//Records the first load of each fragment during the first part of a run.
+//This is not thread safe, loads are recorded on the UI thread.
+class xaml_usage_recorder
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using clock_function = std::function<clock::time_point()>;
+
+	//Loads after the window has passed aren't part of startup, so they aren't recorded.
+	explicit xaml_usage_recorder(std::chrono::milliseconds window = std::chrono::seconds(30), clock_function = &clock::now);
+
+	void record(xaml_source_key const &, size_t text_bytes);
+	std::span<const xaml_usage_record> get_records() const;
+
+private:
+	clock_function m_clock;
+	clock::time_point m_start;
+	std::chrono::milliseconds m_window;
+	std::vector<xaml_usage_record> m_records;
+};
+
+//The usage history is the records of the last few runs, newest last.
+using xaml_usage_history = std::vector<std::vector<xaml_usage_record>>;
+constexpr size_t max_usage_history_runs = 8;
+
+//The history is stored as UTF-8 text, one fragment per line:
+//  xaml-usage 1
+//  run
+//  <milliseconds>\t<bytes>\tresource\t<id>
+//  <milliseconds>\t<bytes>\tfile\t<path>
+//Only the newest max_usage_history_runs runs are written.
+std::string encode_usage_history(xaml_usage_history const &);
+//Lines that can't be understood are skipped, a bad line shouldn't lose the rest of the history.
+//Returns false if the text isn't a usage history at all.
+bool decode_usage_history(std::string_view, xaml_usage_history &);
+//Adds a run to the history, dropping the oldest runs past the limit.
+void append_usage_run(xaml_usage_history &, std::span<const xaml_usage_record>);
+
+struct prewarm_planner_options
+{
+	//The fraction of runs a fragment has to appear in to be prewarmed.
+	double minimum_frequency = 0.5;
+	//The total size of decoded text to hold.
+	size_t memory_budget = 4 * 1024 * 1024;
+	size_t max_items = 32;
+};
+
+struct prewarm_item
+{
+	xaml_source_key source;
+	//The median time into the run at which the fragment was first used.
+	std::chrono::milliseconds expected_use{};
+	double frequency = 0.0;
+	size_t text_bytes = 0;
+};
+
+//Works out what to prewarm, in the order it is expected to be needed.
+//Fragments that are needed earliest come first, ties go to the one used most often.
+//Fragments that would go over the memory budget are left out.
+std::vector<prewarm_item> plan_xaml_prewarm(xaml_usage_history const &, prewarm_planner_options const & = {});
+
+struct xaml_text_cache_counters
+{
+	size_t inserted = 0;
+	size_t hits = 0;
+	size_t misses = 0;
+	//Inserts refused for going over the budget.
+	size_t rejected = 0;
+	//Entries dropped by trim.
+	size_t trimmed = 0;
+};
+
+//Decoded xaml text waiting to be loaded.
+//Each entry is used once, taking it removes it from the cache. Once a fragment has been asked
+//for it isn't cached again, the prewarm is only for the first load.
+//This is thread safe, the asynchronous loaders take text from the thread pool.
+class xaml_text_cache
+{
+public:
+	explicit xaml_text_cache(size_t budget = 4 * 1024 * 1024);
+
+	bool insert(xaml_source_key const &, std::wstring text);
+	std::optional<std::wstring> take(xaml_source_key const &);
+	//Returns true if the fragment isn't cached and hasn't been asked for yet.
+	bool is_wanted(xaml_source_key const &) const;
+	void clear();
+	//Drops entries until the cache holds no more than the target.
+	//Dropped fragments are read from the file when they are needed, as if they were never prewarmed.
+	void trim(size_t target_bytes);
+
+	size_t get_bytes() const;
+	xaml_text_cache_counters get_counters() const;
+
+private:
+	mutable std::mutex m_lock;
+	size_t m_budget;
+	size_t m_bytes = 0;
+	std::unordered_map<xaml_source_key, std::wstring, xaml_source_key_hash> m_entries;
+	//Every fragment that has been taken or asked for.
+	std::unordered_set<xaml_source_key, xaml_source_key_hash> m_requested;
+	xaml_text_cache_counters m_counters{};
+};
+
+struct prewarm_statistics
+{
+	size_t planned = 0;
+	size_t prewarmed = 0;
+	//Items that were already loaded or cached by the time their turn came.
+	size_t skipped = 0;
+	size_t failed = 0;
+	//Items that were still waiting when the prewarm was cancelled.
+	size_t cancelled = 0;
+};
+
+//Works through a plan one item at a time, reading and decoding each fragment into the cache.
+//It is meant to be driven by an idle task, so that it only runs while nothing else needs the thread.
+class xaml_prewarmer
+{
+public:
+	//Reads and decodes a fragment. It can throw, the item is then counted as failed.
+	using read_function = std::function<std::wstring(xaml_source_key const &)>;
+
+	xaml_prewarmer(xaml_text_cache &, read_function);
+
+	void start(std::vector<prewarm_item> plan);
+	//Prewarms the next item in the plan.
+	//Returns false once there is nothing left to do.
+	bool prewarm_next();
+	//Stops the prewarm, what has already been decoded stays in the cache.
+	void cancel();
+	bool is_active() const;
+
+	prewarm_statistics const &get_statistics() const;
+
+private:
+	xaml_text_cache &m_cache;
+	read_function m_read;
+	std::vector<prewarm_item> m_plan;
+	size_t m_next = 0;
+	prewarm_statistics m_statistics{};
+};
\ No newline at end of file
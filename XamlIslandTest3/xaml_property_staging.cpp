@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "xaml_property_staging.h"
+
+namespace wf = winrt::Windows::Foundation;
+namespace mux = winrt::Microsoft::UI::Xaml;
+namespace muxc = winrt::Microsoft::UI::Xaml::Controls;
+
+void xaml_property_staging::set_width(mux::FrameworkElement const &element, double width)
+{
+	m_staging.stage(element, static_cast<uint32_t>(xaml_property::width), width);
+}
+
+void xaml_property_staging::set_height(mux::FrameworkElement const &element, double height)
+{
+	m_staging.stage(element, static_cast<uint32_t>(xaml_property::height), height);
+}
+
+void xaml_property_staging::set_content(mux::FrameworkElement const &element, wf::IInspectable const &content)
+{
+	m_staging.stage(element, static_cast<uint32_t>(xaml_property::content), content);
+}
+
+size_t xaml_property_staging::flush()
+{
+	return m_staging.flush([](mux::FrameworkElement const &element, uint32_t property, property_value const &value)
+		{
+			switch (static_cast<xaml_property>(property))
+			{
+			case xaml_property::width:
+			{
+				element.Width(std::get<double>(value));
+				break;
+			}
+			case xaml_property::height:
+			{
+				element.Height(std::get<double>(value));
+				break;
+			}
+			case xaml_property::content:
+			{
+				element.as<muxc::ContentControl>().Content(std::get<wf::IInspectable>(value));
+				break;
+			}
+			}
+		});
+}
+
+void xaml_property_staging::forget(mux::FrameworkElement const &element)
+{
+	m_staging.forget(element);
+}
+
+void xaml_property_staging::clear()
+{
+	m_staging.clear();
+}
+
+property_staging_counters const &xaml_property_staging::get_counters() const
+{
+	return m_staging.get_counters();
+}
\ No newline at end of file
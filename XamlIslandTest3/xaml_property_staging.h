@@ -0,0 +1,64 @@
+#pragma once
+
+#include <variant>
+
+#ifndef WINRT_Windows_Foundation_H
+#include <winrt/Windows.Foundation.h>
+#endif
+#ifndef WINRT_Microsoft_UI_Xaml_H
+#include <winrt/Microsoft.UI.Xaml.h>
+#endif
+
+#include "property_staging.h"
+
+//The properties that can be staged.
+enum class xaml_property : uint32_t
+{
+	width,
+	height,
+	content
+};
+
+//Stages property writes for xaml elements on the UI thread and applies them in one batch.
+//Every write crosses the WinRT ABI and may invalidate layout, so writes that don't change
+//anything are dropped and the rest are applied once per pump iteration.
+//Objects are compared by identity, which works well with the boxed values from xaml_value_cache
+//since the same text always gives the same box.
+//This is not thread safe, it is meant to be used from the UI thread.
+class xaml_property_staging
+{
+public:
+	void set_width(winrt::Microsoft::UI::Xaml::FrameworkElement const &, double);
+	void set_height(winrt::Microsoft::UI::Xaml::FrameworkElement const &, double);
+	//The element must be a ContentControl.
+	void set_content(winrt::Microsoft::UI::Xaml::FrameworkElement const &, winrt::Windows::Foundation::IInspectable const &);
+
+	//Applies the staged writes. This is called by the pump once it has emptied the queue.
+	size_t flush();
+	//Must be called for elements that are being thrown away.
+	void forget(winrt::Microsoft::UI::Xaml::FrameworkElement const &);
+	void clear();
+
+	property_staging_counters const &get_counters() const;
+
+private:
+	struct element_hash
+	{
+		size_t operator()(winrt::Microsoft::UI::Xaml::FrameworkElement const &element) const
+		{
+			return std::hash<void *>{}(winrt::get_abi(element));
+		}
+	};
+
+	struct element_equal
+	{
+		bool operator()(winrt::Microsoft::UI::Xaml::FrameworkElement const &a, winrt::Microsoft::UI::Xaml::FrameworkElement const &b) const
+		{
+			return winrt::get_abi(a) == winrt::get_abi(b);
+		}
+	};
+
+	using property_value = std::variant<double, winrt::Windows::Foundation::IInspectable>;
+
+	property_staging<winrt::Microsoft::UI::Xaml::FrameworkElement, property_value, element_hash, element_equal> m_staging;
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "pch.h"
+#include "xaml_text.h"
+
+#include <cstdint>
+#include <fstream>
+#include <system_error>
+
+constexpr char32_t replacement_character = 0xFFFD;
+
+//Appends a code point as UTF-16.
+void append_utf16(std::wstring &text, char32_t code_point)
+{
+	if (code_point >= 0x10000)
+	{
+		code_point -= 0x10000;
+		text.push_back(static_cast<wchar_t>(0xD800 + (code_point >> 10)));
+		text.push_back(static_cast<wchar_t>(0xDC00 + (code_point & 0x3FF)));
+	}
+	else
+	{
+		text.push_back(static_cast<wchar_t>(code_point));
+	}
+}
+
+void decode_utf8(std::string_view bytes, std::wstring &text)
+{
+	size_t i = 0;
+	while (i < bytes.size())
+	{
+		const auto lead = static_cast<uint8_t>(bytes[i]);
+
+		//The common case for markup, a run of ASCII.
+		if (lead < 0x80)
+		{
+			text.push_back(static_cast<wchar_t>(lead));
+			++i;
+			continue;
+		}
+
+		size_t length = 0;
+		char32_t code_point = 0;
+		char32_t minimum = 0;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			length = 2;
+			code_point = lead & 0x1F;
+			minimum = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 3;
+			code_point = lead & 0x0F;
+			minimum = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			length = 4;
+			code_point = lead & 0x07;
+			minimum = 0x10000;
+		}
+		else
+		{
+			append_utf16(text, replacement_character);
+			++i;
+			continue;
+		}
+
+		size_t consumed = 1;
+		bool valid = true;
+		for (; consumed < length; ++consumed)
+		{
+			if (i + consumed >= bytes.size() || (static_cast<uint8_t>(bytes[i + consumed]) & 0xC0) != 0x80)
+			{
+				valid = false;
+				break;
+			}
+			code_point = (code_point << 6) | (static_cast<uint8_t>(bytes[i + consumed]) & 0x3F);
+		}
+
+		//Overlong encodings, surrogates and values past the Unicode range are all invalid.
+		if (!valid || code_point < minimum || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF))
+		{
+			append_utf16(text, replacement_character);
+		}
+		else
+		{
+			append_utf16(text, code_point);
+		}
+		i += consumed;
+	}
+}
+
+void decode_utf16(std::string_view bytes, bool big_endian, std::wstring &text)
+{
+	const size_t unit_count = bytes.size() / 2;
+	text.reserve(text.size() + unit_count);
+
+	for (size_t i = 0; i < unit_count; ++i)
+	{
+		const auto first = static_cast<uint8_t>(bytes[i * 2]);
+		const auto second = static_cast<uint8_t>(bytes[i * 2 + 1]);
+		text.push_back(static_cast<wchar_t>(big_endian ? (first << 8) | second : (second << 8) | first));
+	}
+
+	//An odd trailing byte can't be part of a valid document.
+	if (bytes.size() % 2 != 0)
+	{
+		append_utf16(text, replacement_character);
+	}
+}
+
+//Normalises line endings to \n and drops anything after an embedded null.
+//XamlReader::Load treats a null as the end of the string anyway.
+void preprocess_xaml_text(std::wstring &text)
+{
+	size_t write = 0;
+	for (size_t read = 0; read < text.size(); ++read)
+	{
+		const auto c = text[read];
+		if (c == L'\0')
+		{
+			break;
+		}
+		if (c == L'\r')
+		{
+			text[write++] = L'\n';
+			if (read + 1 < text.size() && text[read + 1] == L'\n')
+			{
+				++read;
+			}
+			continue;
+		}
+		text[write++] = c;
+	}
+	text.resize(write);
+}
+
+std::string read_xaml_file(std::filesystem::path const &file_path)
+{
+	std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		throw std::filesystem::filesystem_error("unable to open xaml file", file_path, std::make_error_code(std::errc::no_such_file_or_directory));
+	}
+
+	const auto file_size = static_cast<std::streamoff>(file.tellg());
+	std::string content(static_cast<size_t>(file_size), '\0');
+	file.seekg(0);
+	if (!file.read(content.data(), file_size))
+	{
+		throw std::filesystem::filesystem_error("unable to read xaml file", file_path, std::make_error_code(std::errc::io_error));
+	}
+
+	return content;
+}
+
+std::wstring decode_xaml_text(std::string_view bytes)
+{
+	std::wstring text;
+
+	if (bytes.size() >= 2 && static_cast<uint8_t>(bytes[0]) == 0xFF && static_cast<uint8_t>(bytes[1]) == 0xFE)
+	{
+		decode_utf16(bytes.substr(2), false, text);
+	}
+	else if (bytes.size() >= 2 && static_cast<uint8_t>(bytes[0]) == 0xFE && static_cast<uint8_t>(bytes[1]) == 0xFF)
+	{
+		decode_utf16(bytes.substr(2), true, text);
+	}
+	else
+	{
+		if (bytes.size() >= 3 && static_cast<uint8_t>(bytes[0]) == 0xEF && static_cast<uint8_t>(bytes[1]) == 0xBB && static_cast<uint8_t>(bytes[2]) == 0xBF)
+		{
+			bytes.remove_prefix(3);
+		}
+		//Markup is overwhelmingly ASCII, so the byte count is a good estimate.
+		text.reserve(bytes.size());
+		decode_utf8(bytes, text);
+	}
+
+	preprocess_xaml_text(text);
+	return text;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef _FILESYSTEM_
+#include <filesystem>
+#endif
+#ifndef _STRING_
+#include <string>
+#endif
+#include <string_view>
+
+//The stages of loading xaml that don't need the UI thread.
+//These only use the standard library so they can run on any thread.
+
+//Reads the entire contents of a file.
+//Throws std::filesystem::filesystem_error if the file can't be read.
+std::string read_xaml_file(std::filesystem::path const &);
+
+//Converts raw xaml bytes into UTF-16 text ready for XamlReader::Load.
+//The encoding is taken from the byte order mark, UTF-8 is assumed if there isn't one.
+//Invalid sequences are replaced with U+FFFD.
+//This also does the preprocessing: the byte order mark is removed, line endings are
+//normalised and anything after an embedded null is dropped.
+std::wstring decode_xaml_text(std::string_view);
\ No newline at end of file
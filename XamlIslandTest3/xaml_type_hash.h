@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef _ARRAY_
+#include <array>
+#endif
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+//The perfect hash used by the generated xaml type table.
+//This is shared between XamlTypeTableGen, which searches for seeds that place every known
+//type name in its own slot, and the application, which looks names up in the generated table.
+//It only uses the standard library so that the generator builds anywhere.
+
+//Where a known type name came from.
+enum class xaml_type_origin
+{
+	//An empty slot.
+	none,
+	//An element in one of the project's xaml resources.
+	markup,
+	//A runtime class declared in the project's IDL.
+	idl
+};
+
+//Which metadata provider creates the IXamlType for a known type.
+//The application asks that provider directly, the others are only asked if it doesn't
+//have the type after all.
+enum class xaml_type_factory
+{
+	none,
+	//XamlControlsXamlMetaDataProvider, for the framework's own types.
+	controls_provider,
+	//The application's provider, for types that the project declares.
+	application_provider,
+	factory_count
+};
+
+struct xaml_type_table_entry
+{
+	std::wstring_view name;
+	xaml_type_origin origin = xaml_type_origin::none;
+	xaml_type_factory factory = xaml_type_factory::none;
+};
+
+constexpr size_t xaml_type_not_found = static_cast<size_t>(-1);
+
+//FNV-1a over the code units of the name, followed by a 32 bit finaliser.
+//FNV-1a on its own leaves the low bits poorly mixed and the slot is taken from the low bits.
+//The generator works with narrow names and the application with wide names, type names are
+//ASCII so the code units, and so the hashes, are the same for both.
+template <typename Char>
+constexpr uint32_t xaml_type_hash(std::basic_string_view<Char> name, uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+	for (auto c : name)
+	{
+		hash ^= static_cast<uint32_t>(static_cast<std::make_unsigned_t<Char>>(c));
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+//Names are first split into buckets with a fixed seed, then each bucket has its own seed,
+//found by the generator, that sends its names to free slots. This is hash and displace, a single
+//seed for the whole table stops being practical once there are more than a handful of names.
+constexpr uint32_t xaml_type_bucket_seed = 0x9E3779B9u;
+
+//The bucket count and table size are always powers of two.
+template <typename Char>
+constexpr size_t xaml_type_bucket(std::basic_string_view<Char> name, size_t bucket_count)
+{
+	return static_cast<size_t>(xaml_type_hash(name, xaml_type_bucket_seed)) & (bucket_count - 1);
+}
+
+template <typename Char>
+constexpr size_t xaml_type_slot(std::basic_string_view<Char> name, std::span<const uint32_t> displacements, size_t table_size)
+{
+	const auto seed = displacements[xaml_type_bucket(name, displacements.size())];
+	return static_cast<size_t>(xaml_type_hash(name, seed)) & (table_size - 1);
+}
+
+//Returns the slot holding the name, or xaml_type_not_found if the name isn't in the table.
+//There are no collisions to resolve, so this is two hashes and a single string compare.
+template <size_t Size, size_t Buckets>
+constexpr size_t find_xaml_type_slot(std::array<xaml_type_table_entry, Size> const &table, std::array<uint32_t, Buckets> const &displacements, std::wstring_view name)
+{
+	const auto slot = xaml_type_slot(name, std::span<const uint32_t>(displacements), Size);
+	if (table[slot].origin != xaml_type_origin::none && table[slot].name == name)
+	{
+		return slot;
+	}
+
+	return xaml_type_not_found;
+}
+
+//Checks that every name is in the slot that it hashes to.
+//Since a slot only holds one name this also means there are no collisions or duplicates.
+template <size_t Size, size_t Buckets>
+constexpr bool xaml_type_table_is_perfect(std::array<xaml_type_table_entry, Size> const &table, std::array<uint32_t, Buckets> const &displacements)
+{
+	if constexpr (Size == 0 || (Size & (Size - 1)) != 0 || Buckets == 0 || (Buckets & (Buckets - 1)) != 0)
+	{
+		return false;
+	}
+	else
+	{
+		for (size_t i = 0; i < Size; ++i)
+		{
+			if (table[i].origin != xaml_type_origin::none && xaml_type_slot(table[i].name, std::span<const uint32_t>(displacements), Size) != i)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "background_executor.h"
+#include "benchmark_support.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+	//A small piece of work, about the size of parsing a short property value.
+	uint64_t spin_work(uint64_t seed)
+	{
+		uint64_t value = seed;
+		for (int i = 0; i < 200; ++i)
+		{
+			value = value * 6364136223846793005ull + 1442695040888963407ull;
+		}
+		return value;
+	}
+
+	//Waits for a number of tasks to finish without keeping a core busy.
+	class task_countdown
+	{
+	public:
+		explicit task_countdown(size_t count) : m_remaining(count)
+		{
+		}
+		void done()
+		{
+			if (m_remaining.fetch_sub(1) == 1)
+			{
+				std::lock_guard lock(m_mutex);
+				m_finished = true;
+				m_changed.notify_all();
+			}
+		}
+		void wait()
+		{
+			std::unique_lock lock(m_mutex);
+			m_changed.wait(lock, [this]() { return m_finished; });
+		}
+
+	private:
+		std::atomic<size_t> m_remaining;
+		std::mutex m_mutex;
+		std::condition_variable m_changed;
+		bool m_finished = false;
+	};
+}
+
+//How the cost of a task changes with the number of workers, for tasks submitted from outside
+//the pool and for tasks that a task fans out from a worker, where the others have to steal.
+//On a machine with fewer cores than workers this shows the cost of the extra threads, not a speedup.
+XAML_BENCHMARK(background_executor, scaling)
+{
+	const size_t count = context.pick<size_t>(200000, 5000);
+	const std::vector<size_t> worker_counts = context.is_quick() ? std::vector<size_t>{ 1, 2, 4 } : std::vector<size_t>{ 1, 2, 4, 8, 16, 32, 64 };
+	for (auto workers : worker_counts)
+	{
+		const auto suffix = "_" + std::to_string(workers) + "_workers";
+		background_executor executor(workers);
+		context.measure("submit_ns" + suffix, count, [&]()
+			{
+				task_countdown countdown(count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					executor.submit([&countdown, i]()
+						{
+							keep_value(spin_work(i));
+							countdown.done();
+						});
+				}
+				countdown.wait();
+			});
+
+		const auto steals_before = executor.get_statistics().steals;
+		context.measure("fan_out_ns" + suffix, count, [&]()
+			{
+				task_countdown countdown(count);
+				executor.submit([&executor, &countdown, count]()
+					{
+						for (size_t i = 0; i < count; ++i)
+						{
+							executor.submit([&countdown, i]()
+								{
+									keep_value(spin_work(i));
+									countdown.done();
+								});
+						}
+					});
+				countdown.wait();
+			});
+		context.report("fan_out_steals" + suffix, static_cast<double>(executor.get_statistics().steals - steals_before), "count");
+	}
+}
+
+//A task and its completion, from submitting it to the completion running on the owning thread.
+XAML_BENCHMARK(background_executor, completion_round_trip)
+{
+	const size_t count = context.pick<size_t>(100000, 2000);
+	std::mutex mutex;
+	std::condition_variable woken;
+	bool posted = false;
+	background_executor executor(2, [&]()
+		{
+			{
+				std::lock_guard lock(mutex);
+				posted = true;
+			}
+			woken.notify_all();
+		});
+
+	context.measure("round_trip_ns", count, [&]()
+		{
+			size_t completed = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				executor.submit_with_completion([i]() { return spin_work(i); }, [&completed](uint64_t value)
+					{
+						keep_value(value);
+						++completed;
+					});
+			}
+			while (completed != count)
+			{
+				{
+					std::unique_lock lock(mutex);
+					woken.wait(lock, [&posted]() { return posted; });
+					posted = false;
+				}
+				executor.run_completions();
+			}
+		});
+	const auto statistics = executor.get_statistics();
+	context.report("completions_per_batch", static_cast<double>(statistics.completions_run) / static_cast<double>(std::max<uint64_t>(statistics.completion_batches, 1)), "ratio");
+}
\ No newline at end of file
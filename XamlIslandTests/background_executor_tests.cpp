@@ -0,0 +1,320 @@
+#include "background_executor.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	//Holds workers in a task until the test lets them go.
+	class worker_gate
+	{
+	public:
+		void enter()
+		{
+			std::unique_lock lock(m_mutex);
+			++m_entered;
+			m_changed.notify_all();
+			m_changed.wait(lock, [this]() { return m_open; });
+		}
+		//Waits for the number of workers to be held.
+		bool wait_for_entered(size_t count)
+		{
+			std::unique_lock lock(m_mutex);
+			return m_changed.wait_for(lock, 10s, [this, count]() { return m_entered >= count; });
+		}
+		void open()
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_open = true;
+			}
+			m_changed.notify_all();
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_changed;
+		size_t m_entered = 0;
+		bool m_open = false;
+	};
+
+	//Stands in for the owning thread's message queue, the wake posts a message to it.
+	struct owner_queue
+	{
+		std::mutex mutex;
+		std::condition_variable posted;
+		size_t wakes = 0;
+
+		background_executor::wake_function function()
+		{
+			return [this]()
+				{
+					{
+						std::lock_guard lock(mutex);
+						++wakes;
+					}
+					posted.notify_all();
+				};
+		}
+		size_t get_wakes()
+		{
+			std::lock_guard lock(mutex);
+			return wakes;
+		}
+		//Pumps until the condition holds, running completions the way main_application does.
+		template <typename Condition>
+		bool pump_until(background_executor &executor, Condition condition)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + 10s;
+			while (!condition())
+			{
+				{
+					std::unique_lock lock(mutex);
+					posted.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + 10ms), [&executor]() { return executor.has_completions(); });
+				}
+				executor.run_completions();
+				if (std::chrono::steady_clock::now() > deadline)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	bool wait_for(std::function<bool()> condition)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + 10s;
+		while (!condition())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				return false;
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		return true;
+	}
+}
+
+TEST(background_executor, runs_every_task)
+{
+	background_executor executor(4);
+	EXPECT_EQ(executor.get_worker_count(), 4u);
+
+	std::atomic<int> sum = 0;
+	std::vector<std::thread> submitters;
+	for (int t = 0; t < 4; ++t)
+	{
+		submitters.emplace_back([&executor, &sum]()
+			{
+				for (int i = 1; i <= 1000; ++i)
+				{
+					executor.submit([&sum, i]() { sum.fetch_add(i); });
+				}
+			});
+	}
+	for (auto &thread : submitters)
+	{
+		thread.join();
+	}
+
+	ASSERT_TRUE(wait_for([&sum]() { return sum.load() == 4 * 500500; }));
+	ASSERT_TRUE(wait_for([&executor]() { return executor.get_statistics().tasks_run == 4000; }));
+	const auto statistics = executor.get_statistics();
+	EXPECT_EQ(statistics.tasks_submitted, 4000u);
+	EXPECT_EQ(statistics.queued, 0u);
+	EXPECT_EQ(statistics.workers.size(), 4u);
+}
+
+TEST(background_executor, keyed_tasks_queue_on_one_worker)
+{
+	background_executor executor(4);
+	worker_gate gate;
+	for (int i = 0; i < 4; ++i)
+	{
+		executor.submit([&gate]() { gate.enter(); });
+	}
+	ASSERT_TRUE(gate.wait_for_entered(4));
+
+	//Every worker is busy, so nothing is stolen and the deques show where the tasks went.
+	std::atomic<int> run = 0;
+	for (int i = 0; i < 20; ++i)
+	{
+		executor.submit([&run]() { run.fetch_add(1); }, executor_affinity{ 42 });
+	}
+	auto statistics = executor.get_statistics();
+	EXPECT_EQ(statistics.queued, 20u);
+	size_t loaded_workers = 0;
+	for (auto &worker : statistics.workers)
+	{
+		if (worker.queue_depth != 0)
+		{
+			EXPECT_EQ(worker.queue_depth, 20u);
+			++loaded_workers;
+		}
+	}
+	EXPECT_EQ(loaded_workers, 1u);
+
+	gate.open();
+	ASSERT_TRUE(wait_for([&run]() { return run.load() == 20; }));
+}
+
+TEST(background_executor, idle_workers_steal)
+{
+	background_executor executor(4);
+	std::atomic<int> run = 0;
+	//All on one worker, each taking a while, so the others have time to come and take some.
+	for (int i = 0; i < 200; ++i)
+	{
+		executor.submit([&run]()
+			{
+				std::this_thread::sleep_for(200us);
+				run.fetch_add(1);
+			}, executor_affinity{ 7 });
+	}
+	ASSERT_TRUE(wait_for([&run]() { return run.load() == 200; }));
+	ASSERT_TRUE(wait_for([&executor]() { return executor.get_statistics().tasks_run == 200; }));
+
+	const auto statistics = executor.get_statistics();
+	EXPECT_GT(statistics.steals, 0u);
+	EXPECT_GE(statistics.tasks_stolen, statistics.steals);
+	size_t workers_that_ran = 0;
+	for (auto &worker : statistics.workers)
+	{
+		workers_that_ran += worker.tasks_run != 0 ? 1 : 0;
+	}
+	EXPECT_GT(workers_that_ran, 1u);
+}
+
+TEST(background_executor, tasks_can_submit_more_tasks)
+{
+	background_executor executor(3);
+	std::atomic<int> leaves = 0;
+	//A tree of tasks, each splitting its range in two until it is small.
+	std::function<void(int, int)> split = [&](int first, int last)
+		{
+			if (last - first <= 4)
+			{
+				leaves.fetch_add(last - first);
+				return;
+			}
+			const int middle = (first + last) / 2;
+			executor.submit([&split, first, middle]() { split(first, middle); });
+			executor.submit([&split, middle, last]() { split(middle, last); });
+		};
+	executor.submit([&split]() { split(0, 4096); });
+	ASSERT_TRUE(wait_for([&leaves]() { return leaves.load() == 4096; }));
+	ASSERT_TRUE(wait_for([&executor]() { return executor.get_queued_task_count() == 0; }));
+}
+
+TEST(background_executor, completions_come_back_to_the_owner_in_batches)
+{
+	owner_queue owner;
+	background_executor executor(2, owner.function());
+	const auto owner_thread = std::this_thread::get_id();
+
+	std::vector<int> results;
+	bool on_owner = true;
+	for (int i = 0; i < 50; ++i)
+	{
+		executor.submit_with_completion([i]() { return i * i; }, [&results, &on_owner, owner_thread](int result)
+			{
+				on_owner = on_owner && std::this_thread::get_id() == owner_thread;
+				results.push_back(result);
+			});
+	}
+	bool void_done = false;
+	executor.submit_with_completion([]() {}, [&void_done]() { void_done = true; });
+	executor.submit_with_completion([]() -> int { throw std::runtime_error("bad data"); }, [&results](int) { results.push_back(-1); });
+
+	ASSERT_TRUE(owner.pump_until(executor, [&]() { return results.size() == 50 && void_done && executor.get_statistics().tasks_failed == 1; }));
+	EXPECT_TRUE(on_owner);
+	std::sort(results.begin(), results.end());
+	EXPECT_EQ(results.back(), 49 * 49);
+
+	const auto statistics = executor.get_statistics();
+	EXPECT_EQ(statistics.completions_posted, 51u);
+	EXPECT_EQ(statistics.completions_run, 51u);
+	//The owner is only woken once for each batch it runs.
+	EXPECT_EQ(owner.get_wakes(), statistics.completion_batches);
+	EXPECT_LE(statistics.completion_batches, 51u);
+}
+
+TEST(background_executor, one_wake_for_a_whole_batch)
+{
+	owner_queue owner;
+	background_executor executor(1, owner.function());
+	std::vector<int> order;
+	for (int i = 0; i < 100; ++i)
+	{
+		executor.post_completion([&order, i]() { order.push_back(i); });
+	}
+	EXPECT_EQ(owner.get_wakes(), 1u);
+	EXPECT_TRUE(executor.has_completions());
+	EXPECT_EQ(executor.run_completions(), 100u);
+	EXPECT_EQ(executor.run_completions(), 0u);
+	ASSERT_EQ(order.size(), 100u);
+	EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+
+	executor.post_completion([]() {});
+	EXPECT_EQ(owner.get_wakes(), 2u);
+	const auto statistics = executor.get_statistics();
+	EXPECT_EQ(statistics.completion_batches, 2u);
+	EXPECT_EQ(statistics.max_completion_batch, 100u);
+}
+
+TEST(background_executor, a_throwing_task_doesnt_stop_its_worker)
+{
+	background_executor executor(1);
+	std::atomic<int> run = 0;
+	executor.submit([]() { throw std::runtime_error("oops"); });
+	executor.submit([&run]() { run.fetch_add(1); });
+	ASSERT_TRUE(wait_for([&run]() { return run.load() == 1; }));
+	EXPECT_EQ(executor.get_statistics().tasks_failed, 1u);
+}
+
+TEST(background_executor, shutdown_drops_queued_work)
+{
+	owner_queue owner;
+	background_executor executor(2, owner.function());
+	worker_gate gate;
+	executor.submit([&gate]() { gate.enter(); });
+	executor.submit([&gate]() { gate.enter(); });
+	ASSERT_TRUE(gate.wait_for_entered(2));
+
+	std::atomic<int> run = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		executor.submit([&run]() { run.fetch_add(1); });
+	}
+	executor.post_completion([&run]() { run.fetch_add(100); });
+
+	//The workers are let go once the shutdown has started, it waits for them.
+	std::thread release([&gate]()
+		{
+			std::this_thread::sleep_for(50ms);
+			gate.open();
+		});
+	executor.shutdown();
+	release.join();
+	executor.submit([&run]() { run.fetch_add(1); });
+
+	EXPECT_EQ(run.load(), 0);
+	EXPECT_FALSE(executor.has_completions());
+	EXPECT_EQ(executor.run_completions(), 0u);
+	const auto statistics = executor.get_statistics();
+	EXPECT_EQ(statistics.tasks_cancelled, 11u);
+	EXPECT_EQ(statistics.queued, 0u);
+}
\ No newline at end of file
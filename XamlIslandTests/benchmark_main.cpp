@@ -0,0 +1,166 @@
+#include "benchmark_support.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+
+//Usage: xaml_island_benchmarks [--quick] [--filter text] [--output file] [--baseline file [--tolerance fraction]]
+//Each result is written to stdout, and to the output file if there is one, as a line of JSON.
+//Given the output of an earlier run as a baseline, every time that is slower than the baseline by
+//more than the tolerance, 0.2 unless given, is reported and the exit code is 1. Other units, such
+//as throughput and counts, are written but not compared.
+
+std::string format_result(benchmark_result const &result)
+{
+	char value[64]{};
+	std::snprintf(value, sizeof(value), "%.6g", result.value);
+	return "{\"benchmark\":\"" + result.name + "\",\"metric\":\"" + result.metric + "\",\"value\":" + value + ",\"unit\":\"" + result.unit + "\"}";
+}
+
+//Gets a field from a line written by format_result.
+std::optional<std::string> get_json_field(std::string_view line, std::string_view field)
+{
+	const auto key = "\"" + std::string(field) + "\":";
+	const auto start = line.find(key);
+	if (start == std::string_view::npos)
+	{
+		return std::nullopt;
+	}
+
+	auto value = line.substr(start + key.size());
+	if (value.starts_with('"'))
+	{
+		const auto end = value.find('"', 1);
+		return end == std::string_view::npos ? std::nullopt : std::optional<std::string>(value.substr(1, end - 1));
+	}
+	return std::string(value.substr(0, value.find_first_of(",}")));
+}
+
+//The times from a baseline, keyed by benchmark and metric.
+using baseline_times = std::map<std::pair<std::string, std::string>, double>;
+
+std::optional<baseline_times> read_baseline(std::string const &path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return std::nullopt;
+	}
+
+	baseline_times times;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const auto benchmark = get_json_field(line, "benchmark");
+		const auto metric = get_json_field(line, "metric");
+		const auto value = get_json_field(line, "value");
+		if (benchmark && metric && value && get_json_field(line, "unit") == "ns")
+		{
+			times[{ *benchmark, *metric }] = std::strtod(value->c_str(), nullptr);
+		}
+	}
+	return times;
+}
+
+int main(int argc, char **argv)
+{
+	bool quick = false;
+	std::string filter;
+	std::string output_path;
+	std::string baseline_path;
+	double tolerance = 0.2;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view argument = argv[i];
+		if (argument == "--quick")
+		{
+			quick = true;
+		}
+		else if (argument == "--filter" && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+		else if (argument == "--output" && i + 1 < argc)
+		{
+			output_path = argv[++i];
+		}
+		else if (argument == "--baseline" && i + 1 < argc)
+		{
+			baseline_path = argv[++i];
+		}
+		else if (argument == "--tolerance" && i + 1 < argc)
+		{
+			tolerance = std::strtod(argv[++i], nullptr);
+		}
+		else
+		{
+			std::cerr << "unknown argument " << argument << "\n";
+			return 2;
+		}
+	}
+
+	auto benchmarks = get_registered_benchmarks();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](registered_benchmark const &left, registered_benchmark const &right) { return left.name < right.name; });
+
+	std::ofstream output;
+	if (!output_path.empty())
+	{
+		output.open(output_path);
+		if (!output)
+		{
+			std::cerr << "unable to write " << output_path << "\n";
+			return 2;
+		}
+	}
+
+	baseline_times baseline;
+	if (!baseline_path.empty())
+	{
+		auto times = read_baseline(baseline_path);
+		if (!times)
+		{
+			std::cerr << "unable to read " << baseline_path << "\n";
+			return 2;
+		}
+		baseline = std::move(*times);
+	}
+
+	size_t regressions = 0;
+	for (auto &benchmark : benchmarks)
+	{
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		benchmark_context context(benchmark.name, quick);
+		benchmark.function(context);
+		for (auto &result : context.get_results())
+		{
+			const auto line = format_result(result);
+			std::cout << line << "\n";
+			if (output)
+			{
+				output << line << "\n";
+			}
+
+			const auto it = baseline.find({ result.name, result.metric });
+			if (result.unit == "ns" && it != baseline.end() && result.value > it->second * (1 + tolerance))
+			{
+				std::cerr << "regression: " << result.name << " " << result.metric << " " << it->second << "ns -> " << result.value << "ns\n";
+				++regressions;
+			}
+		}
+	}
+
+	if (regressions != 0)
+	{
+		std::cerr << regressions << " results are slower than the baseline\n";
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "benchmark_support.h"
+
+benchmark_context::benchmark_context(std::string name, bool quick) : m_name(std::move(name)), m_quick(quick)
+{
+}
+
+bool benchmark_context::is_quick() const
+{
+	return m_quick;
+}
+
+void benchmark_context::report(std::string_view metric, double value, std::string_view unit)
+{
+	m_results.push_back({ m_name, std::string(metric), value, std::string(unit) });
+}
+
+std::vector<benchmark_result> const &benchmark_context::get_results() const
+{
+	return m_results;
+}
+
+std::vector<registered_benchmark> &get_registered_benchmarks()
+{
+	static std::vector<registered_benchmark> benchmarks;
+	return benchmarks;
+}
+
+benchmark_registration::benchmark_registration(std::string name, benchmark_function function)
+{
+	get_registered_benchmarks().push_back({ std::move(name), std::move(function) });
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//A small benchmark runner for the portable parts of the island host.
+//Every measurement is written as a line of JSON, so the results can be kept and compared
+//between runs.
+
+struct benchmark_result
+{
+	std::string name;
+	std::string metric;
+	double value = 0;
+	std::string unit;
+};
+
+class benchmark_context
+{
+public:
+	benchmark_context(std::string name, bool quick);
+
+	//Set for a smoke run, where the benchmarks should use small sizes and few repetitions.
+	bool is_quick() const;
+	//Picks the size to use, depending on whether this is a quick run.
+	template <typename T>
+	T pick(T full, T quick) const
+	{
+		return m_quick ? quick : full;
+	}
+
+	//Times the body a few times and reports the best run as nanoseconds per operation.
+	//The body does the given number of operations each time it is called.
+	template <typename F>
+	double measure(std::string_view metric, uint64_t operations, F &&body)
+	{
+		const int repetitions = m_quick ? 1 : 5;
+		double best = 0;
+		for (int i = 0; i < repetitions; ++i)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			body();
+			const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			const auto per_operation = elapsed / static_cast<double>(operations == 0 ? 1 : operations);
+			if (i == 0 || per_operation < best)
+			{
+				best = per_operation;
+			}
+		}
+		report(metric, best, "ns");
+		return best;
+	}
+
+	void report(std::string_view metric, double value, std::string_view unit);
+	std::vector<benchmark_result> const &get_results() const;
+
+private:
+	std::string m_name;
+	bool m_quick = false;
+	std::vector<benchmark_result> m_results;
+};
+
+using benchmark_function = std::function<void(benchmark_context &)>;
+
+//Adds a benchmark to the list that benchmark_main runs.
+struct benchmark_registration
+{
+	benchmark_registration(std::string name, benchmark_function);
+};
+
+struct registered_benchmark
+{
+	std::string name;
+	benchmark_function function;
+};
+std::vector<registered_benchmark> &get_registered_benchmarks();
+
+#define XAML_BENCHMARK_NAME(group, name) group##_##name##_benchmark
+#define XAML_BENCHMARK(group, name) \
+	void XAML_BENCHMARK_NAME(group, name)(benchmark_context &); \
+	static benchmark_registration XAML_BENCHMARK_NAME(group, name##_registration)(#group "." #name, &XAML_BENCHMARK_NAME(group, name)); \
+	void XAML_BENCHMARK_NAME(group, name)(benchmark_context &context)
+
+//Stops the compiler from removing work whose result isn't used.
+template <typename T>
+void keep_value(T const &value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static void const *volatile sink = nullptr;
+	sink = &value;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "coroutine_support.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	//Holds the reference that create gives, the same as coroutine_context does.
+	struct pool_reference
+	{
+		coroutine_frame_pool *pool = coroutine_frame_pool::create();
+
+		~pool_reference()
+		{
+			pool->release();
+		}
+		coroutine_frame_pool *operator->() const
+		{
+			return pool;
+		}
+	};
+
+	//Posts resumptions to a queue that the test runs, like the window's message queue.
+	struct fake_owner
+	{
+		std::deque<resumption_id> posted;
+		std::shared_ptr<coroutine_context> context = std::make_shared<coroutine_context>(
+			std::this_thread::get_id(),
+			[this](resumption_id id) { posted.push_back(id); return true; },
+			[this](resumption_id id, std::chrono::nanoseconds) { posted.push_back(id); return true; });
+
+		std::shared_ptr<coroutine_context> get_coroutine_context() const
+		{
+			return context;
+		}
+		size_t run_posted()
+		{
+			size_t resumed = 0;
+			while (!posted.empty())
+			{
+				const auto id = posted.front();
+				posted.pop_front();
+				resumed += context->resume(id) ? 1 : 0;
+			}
+			return resumed;
+		}
+	};
+
+	window_task wait_twice(fake_owner &owner, std::vector<int> &steps)
+	{
+		steps.push_back(1);
+		co_await context_awaitable(owner.get_coroutine_context(), std::chrono::milliseconds(1));
+		steps.push_back(2);
+		co_await context_awaitable(owner.get_coroutine_context(), std::chrono::milliseconds(1));
+		steps.push_back(3);
+	}
+
+	struct destructor_flag
+	{
+		bool *destroyed;
+		~destructor_flag()
+		{
+			*destroyed = true;
+		}
+	};
+
+	window_task wait_until_cancelled(fake_owner &owner, bool &finished, bool &destroyed)
+	{
+		destructor_flag flag{ &destroyed };
+		co_await context_awaitable(owner.get_coroutine_context(), std::chrono::milliseconds(1));
+		finished = true;
+	}
+}
+
+TEST(coroutine_frame_pool, reuses_frames_and_returns_them_to_the_pool)
+{
+	pool_reference pool;
+	auto first = pool->allocate(100);
+	coroutine_frame_pool::deallocate(first);
+
+	//A reused frame has to find its way back to the pool when it is released again.
+	for (int i = 0; i < 4; ++i)
+	{
+		auto frame = pool->allocate(100);
+		EXPECT_EQ(frame, first);
+		coroutine_frame_pool::deallocate(frame);
+	}
+
+	const auto statistics = pool->get_statistics();
+	EXPECT_EQ(statistics.allocations, 5u);
+	EXPECT_EQ(statistics.pool_hits, 4u);
+	EXPECT_EQ(statistics.live_frames, 0u);
+}
+
+TEST(coroutine_frame_pool, keeps_size_classes_apart)
+{
+	pool_reference pool;
+	auto small = pool->allocate(10);
+	auto large = pool->allocate(500);
+	coroutine_frame_pool::deallocate(small);
+	coroutine_frame_pool::deallocate(large);
+
+	auto small_again = pool->allocate(64);
+	auto large_again = pool->allocate(450);
+	auto middle = pool->allocate(200);
+	EXPECT_EQ(small_again, small);
+	EXPECT_EQ(large_again, large);
+	EXPECT_NE(middle, nullptr);
+	EXPECT_EQ(pool->get_statistics().pool_hits, 2u);
+	EXPECT_EQ(pool->get_statistics().live_frames, 3u);
+
+	coroutine_frame_pool::deallocate(small_again);
+	coroutine_frame_pool::deallocate(large_again);
+	coroutine_frame_pool::deallocate(middle);
+}
+
+TEST(coroutine_frame_pool, free_lists_are_bounded)
+{
+	pool_reference pool;
+	std::vector<void *> frames;
+	for (size_t i = 0; i < coroutine_frame_pool::max_free_frames + 8; ++i)
+	{
+		frames.push_back(pool->allocate(32));
+	}
+	for (auto frame : frames)
+	{
+		coroutine_frame_pool::deallocate(frame);
+	}
+
+	frames.clear();
+	for (size_t i = 0; i < coroutine_frame_pool::max_free_frames + 8; ++i)
+	{
+		frames.push_back(pool->allocate(32));
+	}
+	EXPECT_EQ(pool->get_statistics().pool_hits, coroutine_frame_pool::max_free_frames);
+	for (auto frame : frames)
+	{
+		coroutine_frame_pool::deallocate(frame);
+	}
+
+	EXPECT_GT(pool->trim(), coroutine_frame_pool::max_free_frames * coroutine_frame_pool::size_class_granularity);
+	EXPECT_EQ(pool->trim(), 0u);
+	EXPECT_EQ(pool->get_statistics().live_frames, 0u);
+}
+
+TEST(coroutine_frame_pool, oversized_frames_are_not_pooled)
+{
+	pool_reference pool;
+	auto frame = pool->allocate(coroutine_frame_pool::max_pooled_size + 1);
+	coroutine_frame_pool::deallocate(frame);
+	coroutine_frame_pool::deallocate(pool->allocate(coroutine_frame_pool::max_pooled_size + 1));
+
+	const auto statistics = pool->get_statistics();
+	EXPECT_EQ(statistics.oversized_allocations, 2u);
+	EXPECT_EQ(statistics.pool_hits, 0u);
+	EXPECT_EQ(statistics.live_frames, 0u);
+}
+
+TEST(coroutine_frame_pool, frames_keep_the_pool_alive)
+{
+	auto pool = coroutine_frame_pool::create();
+	auto frame = pool->allocate(100);
+	std::memset(frame, 0xcd, 100);
+	pool->release();
+	//This releases the last reference, which frees the pool along with the frame.
+	coroutine_frame_pool::deallocate(frame);
+
+	auto unpooled = coroutine_frame_pool::allocate_unpooled(100);
+	coroutine_frame_pool::deallocate(unpooled);
+	coroutine_frame_pool::deallocate(nullptr);
+}
+
+//Frames of every size class are allocated on one thread and released on others, the way a
+//coroutine that finishes on the thread pool releases its frame.
+//Each frame is filled with a pattern so that handing out a frame that is still in use shows up.
+TEST(coroutine_frame_pool, stress_across_threads_and_size_classes)
+{
+	constexpr int thread_count = 4;
+	constexpr int frames_per_thread = 20000;
+	pool_reference pool;
+
+	std::mutex handoff_mutex;
+	std::vector<std::pair<void *, size_t>> handoff;
+	std::atomic<int> corrupted{ 0 };
+
+	const auto check_and_free = [&corrupted](void *frame, size_t size)
+		{
+			const auto bytes = static_cast<unsigned char *>(frame);
+			const auto pattern = static_cast<unsigned char>(size);
+			for (size_t i = 0; i < size; ++i)
+			{
+				if (bytes[i] != pattern)
+				{
+					++corrupted;
+					break;
+				}
+			}
+			coroutine_frame_pool::deallocate(frame);
+		};
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_count; ++t)
+	{
+		threads.emplace_back([&, t]()
+			{
+				std::mt19937 random(static_cast<unsigned>(t) + 1);
+				std::uniform_int_distribution<size_t> size_distribution(1, coroutine_frame_pool::max_pooled_size + 200);
+				std::vector<std::pair<void *, size_t>> mine;
+				for (int i = 0; i < frames_per_thread; ++i)
+				{
+					const auto size = size_distribution(random);
+					auto frame = pool->allocate(size);
+					std::memset(frame, static_cast<unsigned char>(size), size);
+					mine.emplace_back(frame, size);
+
+					if (mine.size() >= 16)
+					{
+						//Half go to another thread, the rest are released here.
+						std::vector<std::pair<void *, size_t>> taken;
+						{
+							std::lock_guard lock(handoff_mutex);
+							for (size_t j = 0; j < mine.size() / 2; ++j)
+							{
+								handoff.push_back(mine[j]);
+							}
+							taken.swap(handoff);
+							handoff.assign(taken.begin() + static_cast<std::ptrdiff_t>(taken.size() / 2), taken.end());
+							taken.resize(taken.size() / 2);
+						}
+						for (auto &[frame_to_free, frame_size] : taken)
+						{
+							check_and_free(frame_to_free, frame_size);
+						}
+						for (size_t j = mine.size() / 2; j < mine.size(); ++j)
+						{
+							check_and_free(mine[j].first, mine[j].second);
+						}
+						mine.clear();
+					}
+				}
+				for (auto &[frame, size] : mine)
+				{
+					check_and_free(frame, size);
+				}
+			});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	for (auto &[frame, size] : handoff)
+	{
+		check_and_free(frame, size);
+	}
+
+	const auto statistics = pool->get_statistics();
+	EXPECT_EQ(corrupted.load(), 0);
+	EXPECT_EQ(statistics.allocations, static_cast<uint64_t>(thread_count) * frames_per_thread);
+	EXPECT_EQ(statistics.live_frames, 0u);
+	EXPECT_GT(statistics.pool_hits, statistics.allocations / 2);
+	EXPECT_GT(statistics.oversized_allocations, 0u);
+}
+
+TEST(coroutine_context, resumes_through_the_owner)
+{
+	fake_owner owner;
+	std::vector<int> steps;
+	wait_twice(owner, steps);
+	EXPECT_EQ(steps, (std::vector<int>{ 1 }));
+	EXPECT_EQ(owner.context->pending_count(), 1u);
+
+	EXPECT_EQ(owner.run_posted(), 2u);
+	EXPECT_EQ(steps, (std::vector<int>{ 1, 2, 3 }));
+	EXPECT_EQ(owner.context->pending_count(), 0u);
+
+	//The frame came from the owner's pool and has gone back to it.
+	const auto statistics = owner.context->get_frame_pool().get_statistics();
+	EXPECT_EQ(statistics.allocations, 1u);
+	EXPECT_EQ(statistics.live_frames, 0u);
+}
+
+TEST(coroutine_context, cancel_unwinds_waiting_coroutines)
+{
+	fake_owner owner;
+	bool finished = false;
+	bool destroyed = false;
+	wait_until_cancelled(owner, finished, destroyed);
+	ASSERT_EQ(owner.context->pending_count(), 1u);
+
+	owner.context->cancel();
+	EXPECT_FALSE(finished);
+	EXPECT_TRUE(destroyed);
+	//The posted resumption is now stale.
+	EXPECT_EQ(owner.run_posted(), 0u);
+	EXPECT_FALSE(owner.context->schedule(std::noop_coroutine(), {}));
+	EXPECT_EQ(owner.context->get_frame_pool().get_statistics().live_frames, 0u);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "benchmark_support.h"
+#include "dpi_layout.h"
+
+#include <vector>
+
+//A window with many children going back and forth between two monitors.
+XAML_BENCHMARK(dpi_layout, monitor_switch)
+{
+	const size_t children = context.pick<size_t>(1000, 100);
+	const int switches = context.pick(10000, 100);
+	std::vector<island_rect> layout;
+	for (size_t i = 0; i < children; ++i)
+	{
+		layout.push_back({ 10, 10 + static_cast<int>(i) * 30, 150, 25 });
+	}
+
+	dpi_layout_cache cache;
+	cache.set_logical_layout(layout);
+	context.measure("cached_ns_per_switch", static_cast<uint64_t>(switches), [&]()
+		{
+			for (int i = 0; i < switches; ++i)
+			{
+				keep_value(cache.get_layout(i % 2 == 0 ? 96u : 144u).data());
+			}
+		});
+
+	std::vector<island_rect> scaled(children);
+	context.measure("scaled_ns_per_switch", static_cast<uint64_t>(switches), [&]()
+		{
+			for (int i = 0; i < switches; ++i)
+			{
+				const auto dpi = i % 2 == 0 ? 96u : 144u;
+				for (size_t j = 0; j < children; ++j)
+				{
+					scaled[j] = scale_rect_to_dpi(layout[j], dpi);
+				}
+				keep_value(scaled.data());
+			}
+		});
+}
\ No newline at end of file
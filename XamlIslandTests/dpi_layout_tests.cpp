@@ -0,0 +1,112 @@
+#include "dpi_layout.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t common_dpis[] = { 96, 120, 144, 168, 192, 240, 288 };
+
+	std::vector<island_rect> make_layout(size_t count)
+	{
+		std::vector<island_rect> layout;
+		for (size_t i = 0; i < count; ++i)
+		{
+			layout.push_back({ 10, 10 + static_cast<int>(i) * 30, 150, 25 });
+		}
+		return layout;
+	}
+}
+
+TEST(dpi_layout, scales_like_muldiv)
+{
+	EXPECT_EQ(scale_to_dpi(100, 96), 100);
+	EXPECT_EQ(scale_to_dpi(100, 120), 125);
+	EXPECT_EQ(scale_to_dpi(100, 144), 150);
+	EXPECT_EQ(scale_to_dpi(25, 168), 44);
+	//25 * 120 / 96 is 31.25, and 3 * 120 / 96 is 3.75.
+	EXPECT_EQ(scale_to_dpi(25, 120), 31);
+	EXPECT_EQ(scale_to_dpi(3, 120), 4);
+	//Halves round away from zero, on both sides.
+	EXPECT_EQ(scale_to_dpi(2, 120), 3);
+	EXPECT_EQ(scale_to_dpi(-2, 120), -3);
+	EXPECT_EQ(scale_to_dpi(-100, 144), -150);
+	EXPECT_EQ(scale_between_dpi(150, 144, 96), 100);
+	EXPECT_EQ(scale_between_dpi(7, 0, 144), 7);
+	EXPECT_FLOAT_EQ(get_dpi_scale(144), 1.5f);
+}
+
+TEST(dpi_layout, equal_controls_stay_equal_at_every_dpi)
+{
+	//Two controls with the same size at positions that round differently.
+	const island_rect first{ 3, 3, 25, 25 };
+	const island_rect second{ 31, 41, 25, 25 };
+	for (const auto dpi : common_dpis)
+	{
+		const auto a = scale_rect_to_dpi(first, dpi);
+		const auto b = scale_rect_to_dpi(second, dpi);
+		EXPECT_EQ(a.width, b.width) << dpi;
+		EXPECT_EQ(a.height, b.height) << dpi;
+	}
+}
+
+TEST(dpi_layout, moving_between_monitors_uses_the_cache)
+{
+	dpi_layout_cache cache;
+	const auto layout = make_layout(10);
+	cache.set_logical_layout(layout);
+
+	const auto at_144 = cache.get_layout(144);
+	ASSERT_EQ(at_144.size(), layout.size());
+	EXPECT_EQ(at_144[1].y, 60);
+	cache.get_layout(96);
+	const auto back_at_144 = cache.get_layout(144);
+	EXPECT_EQ(back_at_144[1].y, 60);
+
+	EXPECT_EQ(cache.get_counters().misses, 2u);
+	EXPECT_EQ(cache.get_counters().hits, 1u);
+	EXPECT_EQ(cache.size(), 2u);
+}
+
+TEST(dpi_layout, evicts_the_least_recently_used_dpi)
+{
+	dpi_layout_cache cache(3);
+	cache.set_logical_layout(make_layout(2));
+	cache.get_layout(96);
+	cache.get_layout(120);
+	cache.get_layout(144);
+	cache.get_layout(96);
+	//120 is the oldest now.
+	cache.get_layout(192);
+	EXPECT_EQ(cache.get_counters().evictions, 1u);
+
+	const auto misses = cache.get_counters().misses;
+	cache.get_layout(96);
+	cache.get_layout(144);
+	cache.get_layout(192);
+	EXPECT_EQ(cache.get_counters().misses, misses);
+	cache.get_layout(120);
+	EXPECT_EQ(cache.get_counters().misses, misses + 1);
+}
+
+TEST(dpi_layout, only_a_changed_layout_throws_the_cache_away)
+{
+	dpi_layout_cache cache;
+	auto layout = make_layout(4);
+	cache.set_logical_layout(layout);
+	for (const auto dpi : common_dpis)
+	{
+		cache.get_layout(dpi);
+	}
+
+	cache.set_logical_layout(make_layout(4));
+	EXPECT_EQ(cache.get_counters().invalidations, 0u);
+	EXPECT_EQ(cache.size(), std::size(common_dpis));
+
+	layout[2].width = 200;
+	cache.set_logical_layout(layout);
+	EXPECT_EQ(cache.get_counters().invalidations, 1u);
+	EXPECT_EQ(cache.size(), 0u);
+	EXPECT_EQ(cache.get_layout(192)[2].width, 400);
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "child_control_recycler.h"
+#include "island_batch.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+//A window manager for apply_island_batch and child_control_recycler that keeps the windows in
+//memory and counts the calls made to it.
+//It has no way to redraw or invalidate anything, so a batch that tried to would not compile.
+struct fake_window_manager
+{
+	using handle_type = uint32_t;
+
+	struct window
+	{
+		uint32_t style = 0;
+		island_rect rect{};
+		bool visible = false;
+		//0 for a top level window, or a control that is parked.
+		handle_type parent = 0;
+		uint32_t id = 0;
+	};
+
+	struct pending_position
+	{
+		handle_type handle = 0;
+		island_rect rect{};
+		bool show = false;
+	};
+	//Nothing moves until the batch ends.
+	using deferral = std::vector<pending_position>;
+
+	struct call_counts
+	{
+		size_t get_style = 0;
+		size_t set_style = 0;
+		size_t begin_deferred = 0;
+		size_t defer_position = 0;
+		size_t end_deferred = 0;
+		size_t set_position = 0;
+		size_t create_control = 0;
+		size_t reuse_control = 0;
+		size_t park_control = 0;
+		size_t destroy_control = 0;
+	};
+
+	std::unordered_map<handle_type, window> windows;
+	call_counts calls{};
+	//Makes the deferred batch fail at this position, as DeferWindowPos can when memory runs out.
+	size_t fail_deferral_at = SIZE_MAX;
+	bool fail_end_deferred = false;
+	//Makes create_control fail, as CreateWindowEx does when the desktop heap runs out.
+	bool fail_create_control = false;
+	handle_type next_handle = 1;
+
+	handle_type add_window(uint32_t style = 0)
+	{
+		const auto handle = next_handle++;
+		windows[handle].style = style;
+		return handle;
+	}
+
+	uint32_t get_style(handle_type handle)
+	{
+		++calls.get_style;
+		return windows.at(handle).style;
+	}
+	void set_style(handle_type handle, uint32_t style)
+	{
+		++calls.set_style;
+		windows.at(handle).style = style;
+	}
+	deferral begin_deferred_positions(size_t)
+	{
+		++calls.begin_deferred;
+		return {};
+	}
+	bool defer_position(deferral &batch, handle_type handle, island_rect const &rect, bool show)
+	{
+		++calls.defer_position;
+		if (batch.size() == fail_deferral_at)
+		{
+			return false;
+		}
+		batch.push_back({ handle, rect, show });
+		return true;
+	}
+	bool end_deferred_positions(deferral &batch)
+	{
+		++calls.end_deferred;
+		if (fail_end_deferred)
+		{
+			return false;
+		}
+		for (auto &position : batch)
+		{
+			move(position.handle, position.rect, position.show);
+		}
+		return true;
+	}
+	void set_position(handle_type handle, island_rect const &rect, bool show)
+	{
+		++calls.set_position;
+		move(handle, rect, show);
+	}
+
+	handle_type create_control(child_control_class const &control_class, handle_type parent, island_rect const &rect, uint32_t id, wchar_t const *)
+	{
+		++calls.create_control;
+		if (fail_create_control)
+		{
+			return 0;
+		}
+		const auto handle = add_window(control_class.style);
+		windows[handle] = { control_class.style, rect, true, parent, id };
+		return handle;
+	}
+	void reuse_control(handle_type handle, handle_type parent, island_rect const &rect, uint32_t id, wchar_t const *)
+	{
+		++calls.reuse_control;
+		auto &control = windows.at(handle);
+		control.parent = parent;
+		control.id = id;
+		control.rect = rect;
+		control.visible = true;
+	}
+	void park_control(handle_type handle)
+	{
+		++calls.park_control;
+		auto &control = windows.at(handle);
+		control.visible = false;
+		control.parent = 0;
+	}
+	void destroy_control(handle_type handle)
+	{
+		++calls.destroy_control;
+		windows.erase(handle);
+	}
+
+	void move(handle_type handle, island_rect const &rect, bool show)
+	{
+		auto &target = windows.at(handle);
+		target.rect = rect;
+		target.visible = target.visible || show;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "benchmark_support.h"
+#include "frame_arena.h"
+
+#include <string>
+#include <vector>
+
+//The lists the pump builds for each message, from the arena and from the heap.
+XAML_BENCHMARK(frame_arena, pump_frame)
+{
+	const size_t frames = context.pick<size_t>(200000, 2000);
+	const size_t windows = 16;
+
+	frame_arena arena;
+	context.measure("arena_frame_ns", frames, [&]()
+		{
+			for (size_t frame = 0; frame < frames; ++frame)
+			{
+				auto handles = make_frame_vector<uintptr_t>(arena);
+				for (size_t i = 0; i < windows; ++i)
+				{
+					handles.push_back(i + frame);
+				}
+				auto tab_stops = make_frame_vector<uint64_t>(arena, handles.size());
+				for (auto handle : handles)
+				{
+					tab_stops.push_back(handle);
+				}
+				frame_wstring text{ frame_allocator<wchar_t>(arena) };
+				text += L"Button clicked on island ";
+				text += static_cast<wchar_t>(L'0' + frame % 10);
+				keep_value(tab_stops.back() + text.size());
+				arena.reset();
+			}
+		});
+	context.report("arena_chunk_allocations", static_cast<double>(arena.get_statistics().chunk_allocations), "count");
+
+	context.measure("heap_frame_ns", frames, [&]()
+		{
+			for (size_t frame = 0; frame < frames; ++frame)
+			{
+				std::vector<uintptr_t> handles;
+				for (size_t i = 0; i < windows; ++i)
+				{
+					handles.push_back(i + frame);
+				}
+				std::vector<uint64_t> tab_stops;
+				tab_stops.reserve(handles.size());
+				for (auto handle : handles)
+				{
+					tab_stops.push_back(handle);
+				}
+				std::wstring text = L"Button clicked on island ";
+				text += static_cast<wchar_t>(L'0' + frame % 10);
+				keep_value(tab_stops.back() + text.size());
+			}
+		});
+}
+
+//A single allocation and its free, the cost that replaces a trip to the heap.
+XAML_BENCHMARK(frame_arena, allocate)
+{
+	const size_t count = context.pick<size_t>(10000000, 100000);
+	frame_arena arena(count * 32 + 1024);
+	context.measure("allocate_ns", count, [&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				keep_value(arena.allocate(24, 8));
+			}
+			arena.reset();
+		});
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "frame_arena.h"
+#include "heap_allocations.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <new>
+#include <random>
+#include <thread>
+
+namespace
+{
+	//Allocations are stored here, so the compiler can't leave out new and delete pairs.
+	void *volatile allocation_sink = nullptr;
+
+	//What the pump builds while routing a message: the windows, the tab stops and some text.
+	void build_frame(frame_arena &arena, size_t windows)
+	{
+		auto handles = make_frame_vector<uintptr_t>(arena);
+		for (size_t i = 0; i < windows; ++i)
+		{
+			handles.push_back(i);
+		}
+		auto tab_stops = make_frame_vector<uint64_t>(arena, windows);
+		for (auto handle : handles)
+		{
+			tab_stops.push_back(handle * 2);
+		}
+		frame_wstring text{ frame_allocator<wchar_t>(arena) };
+		for (size_t i = 0; i < windows; ++i)
+		{
+			text += L"island ";
+		}
+		EXPECT_EQ(tab_stops.size(), windows);
+		EXPECT_EQ(text.size(), windows * 7);
+	}
+}
+
+TEST(frame_arena, allocations_are_aligned_and_separate)
+{
+	frame_arena arena(256);
+	std::mt19937 random(3);
+	std::vector<std::pair<std::byte *, size_t>> allocations;
+	for (int i = 0; i < 2000; ++i)
+	{
+		const size_t alignment = size_t{ 1 } << (random() % 7);
+		const size_t size = random() % 300 + 1;
+		auto *allocation = static_cast<std::byte *>(arena.allocate(size, alignment));
+		ASSERT_EQ(reinterpret_cast<uintptr_t>(allocation) % alignment, 0u);
+		std::memset(allocation, i & 0xff, size);
+		allocations.push_back({ allocation, size });
+	}
+	//Nothing was written over by a later allocation.
+	for (size_t i = 0; i < allocations.size(); ++i)
+	{
+		auto [allocation, size] = allocations[i];
+		for (size_t j = 0; j < size; ++j)
+		{
+			ASSERT_EQ(allocation[j], static_cast<std::byte>(i & 0xff));
+		}
+	}
+	EXPECT_EQ(arena.get_statistics().allocations, 2000u);
+	EXPECT_GT(arena.get_statistics().chunk_allocations, 1u);
+}
+
+TEST(frame_arena, only_the_latest_allocation_is_given_back)
+{
+	frame_arena arena(1024);
+	auto *first = arena.allocate(64);
+	auto *second = arena.allocate(64);
+	const auto used = arena.get_used();
+
+	arena.deallocate(first, 64);
+	EXPECT_EQ(arena.get_used(), used);
+	arena.deallocate(second, 64);
+	EXPECT_LT(arena.get_used(), used);
+	EXPECT_EQ(arena.allocate(64), second);
+	EXPECT_EQ(arena.get_statistics().frees_reclaimed, 1u);
+}
+
+TEST(frame_arena, a_big_frame_gets_one_chunk_at_the_next_reset)
+{
+	frame_arena arena(128);
+	for (int i = 0; i < 100; ++i)
+	{
+		arena.allocate(100);
+	}
+	const auto chunks = arena.get_statistics().chunk_allocations;
+	EXPECT_GT(chunks, 2u);
+	EXPECT_GE(arena.get_statistics().high_water, 100u * 100u);
+
+	arena.reset();
+	EXPECT_EQ(arena.get_used(), 0u);
+	EXPECT_EQ(arena.get_statistics().chunk_allocations, chunks + 1);
+	//The same frame again fits in the one chunk.
+	for (int i = 0; i < 100; ++i)
+	{
+		arena.allocate(100);
+	}
+	arena.reset();
+	EXPECT_EQ(arena.get_statistics().chunk_allocations, chunks + 1);
+	EXPECT_EQ(arena.get_statistics().resets, 2u);
+}
+
+TEST(frame_arena, release_gives_the_chunks_back)
+{
+	frame_arena arena;
+	arena.allocate(100);
+	arena.reset();
+	EXPECT_EQ(arena.get_statistics().capacity, frame_arena::default_chunk_size);
+	arena.release();
+	EXPECT_EQ(arena.get_statistics().capacity, 0u);
+	EXPECT_EQ(arena.get_used(), 0u);
+
+	auto *allocation = arena.allocate(frame_arena::default_chunk_size * 2, 64);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(allocation) % 64, 0u);
+	EXPECT_GE(arena.get_statistics().capacity, frame_arena::default_chunk_size * 2);
+}
+
+TEST(frame_arena, steady_state_frames_dont_touch_the_heap)
+{
+	frame_arena arena(64);
+	//The first frames grow the arena.
+	for (int i = 0; i < 4; ++i)
+	{
+		build_frame(arena, 200);
+		arena.reset();
+	}
+
+	const auto chunks = arena.get_statistics().chunk_allocations;
+	const auto before = get_thread_heap_allocations();
+	for (int i = 0; i < 100; ++i)
+	{
+		build_frame(arena, 200);
+		arena.reset();
+	}
+	const auto after = get_thread_heap_allocations();
+	EXPECT_EQ(after.allocations, before.allocations);
+	EXPECT_EQ(arena.get_statistics().chunk_allocations, chunks);
+}
+
+TEST(heap_allocations, counts_every_form_of_new)
+{
+	struct alignas(64) over_aligned
+	{
+		std::byte data[64];
+	};
+
+	const auto before = get_thread_heap_allocations();
+	auto *single = new int(1);
+	allocation_sink = single;
+	delete single;
+	auto *array = new int[4];
+	allocation_sink = array;
+	delete[] array;
+	auto *single_nothrow = new (std::nothrow) int(2);
+	allocation_sink = single_nothrow;
+	delete single_nothrow;
+	auto *array_nothrow = new (std::nothrow) int[4];
+	allocation_sink = array_nothrow;
+	delete[] array_nothrow;
+	auto *aligned = new over_aligned;
+	allocation_sink = aligned;
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 64, 0u);
+	delete aligned;
+	auto *aligned_array = new over_aligned[3];
+	allocation_sink = aligned_array;
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned_array) % 64, 0u);
+	delete[] aligned_array;
+	auto *aligned_nothrow = new (std::nothrow) over_aligned;
+	allocation_sink = aligned_nothrow;
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned_nothrow) % 64, 0u);
+	delete aligned_nothrow;
+	auto *aligned_array_nothrow = new (std::nothrow) over_aligned[2];
+	allocation_sink = aligned_array_nothrow;
+	delete[] aligned_array_nothrow;
+	const auto after = get_thread_heap_allocations();
+
+	EXPECT_EQ(after.allocations - before.allocations, 8u);
+	EXPECT_GE(after.bytes - before.bytes, sizeof(int) * 10 + sizeof(over_aligned) * 6);
+}
+
+TEST(heap_allocations, counts_each_thread_on_its_own)
+{
+	const auto before = get_thread_heap_allocations();
+	std::thread other([]()
+		{
+			for (int i = 0; i < 10; ++i)
+			{
+				auto *value = new int(i);
+				allocation_sink = value;
+				delete value;
+			}
+		});
+	const auto after_start = get_thread_heap_allocations();
+	other.join();
+	EXPECT_EQ(get_thread_heap_allocations().allocations, after_start.allocations);
+	EXPECT_GE(after_start.allocations, before.allocations);
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "hang_watchdog.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	const stall_classifier::time_point start = stall_classifier::time_point{} + 1h;
+
+	heartbeat_sample make_sample(uint64_t sequence, pump_stage stage, uint32_t message = 0)
+	{
+		return { sequence, stage, message, 0, 0 };
+	}
+
+	//Collects the watchdog's reports, which arrive on its own thread.
+	struct report_log
+	{
+		std::mutex mutex;
+		std::condition_variable added;
+		std::vector<stall_report> reports;
+
+		hang_watchdog::report_function function()
+		{
+			return [this](stall_report const &report)
+				{
+					{
+						std::lock_guard lock(mutex);
+						reports.push_back(report);
+					}
+					added.notify_all();
+				};
+		}
+		bool wait_for_count(size_t count)
+		{
+			std::unique_lock lock(mutex);
+			return added.wait_for(lock, 10s, [this, count]() { return reports.size() >= count; });
+		}
+		std::vector<stall_report> get()
+		{
+			std::lock_guard lock(mutex);
+			return reports;
+		}
+	};
+}
+
+TEST(hang_watchdog, every_stage_has_a_name)
+{
+	for (uint8_t stage = 0; stage < static_cast<uint8_t>(pump_stage::stage_count); ++stage)
+	{
+		EXPECT_NE(get_pump_stage_name(static_cast<pump_stage>(stage)), L"unknown");
+	}
+	EXPECT_EQ(get_pump_stage_name(pump_stage::stage_count), L"unknown");
+	EXPECT_EQ(get_stall_severity_name(stall_severity::hung), L"hung");
+}
+
+TEST(hang_watchdog, a_moving_heartbeat_is_never_a_stall)
+{
+	stall_classifier classifier({ 50ms, 250ms, 2000ms });
+	for (uint64_t i = 0; i < 100; ++i)
+	{
+		EXPECT_FALSE(classifier.observe(make_sample(i * 2, pump_stage::dispatch), start + i * 50ms));
+	}
+	const auto statistics = classifier.get_statistics();
+	EXPECT_EQ(statistics.samples, 100u);
+	EXPECT_EQ(statistics.stalls, 0u);
+}
+
+TEST(hang_watchdog, waiting_is_never_a_stall)
+{
+	stall_classifier classifier({ 50ms, 250ms, 2000ms });
+	for (int i = 0; i < 200; ++i)
+	{
+		EXPECT_FALSE(classifier.observe(make_sample(2, pump_stage::waiting), start + i * 50ms));
+	}
+	EXPECT_FALSE(classifier.observe(make_sample(4, pump_stage::peek), start + 10s));
+	EXPECT_EQ(classifier.get_statistics().stalls, 0u);
+}
+
+TEST(hang_watchdog, a_stall_is_reported_at_each_threshold_and_when_it_ends)
+{
+	stall_classifier classifier({ 50ms, 250ms, 2000ms });
+	EXPECT_FALSE(classifier.observe(make_sample(2, pump_stage::dispatch, 0x100), start));
+
+	std::vector<stall_report> reports;
+	for (int i = 1; i <= 60; ++i)
+	{
+		if (auto report = classifier.observe(make_sample(2, pump_stage::dispatch, 0x100), start + i * 50ms))
+		{
+			reports.push_back(*report);
+		}
+	}
+	auto ended = classifier.observe(make_sample(4, pump_stage::peek), start + 3050ms);
+	ASSERT_TRUE(ended);
+	reports.push_back(*ended);
+
+	ASSERT_EQ(reports.size(), 3u);
+	EXPECT_EQ(reports[0].severity, stall_severity::slow);
+	EXPECT_EQ(reports[0].elapsed, 250ms);
+	EXPECT_FALSE(reports[0].ended);
+	EXPECT_EQ(reports[1].severity, stall_severity::hung);
+	EXPECT_EQ(reports[1].elapsed, 2000ms);
+	EXPECT_EQ(reports[2].severity, stall_severity::hung);
+	EXPECT_TRUE(reports[2].ended);
+	EXPECT_EQ(reports[2].elapsed, 3050ms);
+	EXPECT_EQ(reports[2].sample.stage, pump_stage::dispatch);
+	EXPECT_EQ(reports[2].sample.message, 0x100u);
+
+	const auto statistics = classifier.get_statistics();
+	EXPECT_EQ(statistics.stalls, 1u);
+	EXPECT_EQ(statistics.slow, 1u);
+	EXPECT_EQ(statistics.hung, 1u);
+	EXPECT_EQ(statistics.longest, 3050ms);
+	EXPECT_EQ(statistics.longest_stage, pump_stage::dispatch);
+}
+
+TEST(hang_watchdog, a_short_busy_period_is_counted_but_not_reported)
+{
+	stall_classifier classifier({ 50ms, 250ms, 2000ms });
+	classifier.observe(make_sample(2, pump_stage::timers), start);
+	EXPECT_FALSE(classifier.observe(make_sample(2, pump_stage::timers), start + 50ms));
+	EXPECT_FALSE(classifier.observe(make_sample(2, pump_stage::timers), start + 100ms));
+	EXPECT_FALSE(classifier.observe(make_sample(4, pump_stage::peek), start + 150ms));
+	EXPECT_EQ(classifier.get_statistics().stalls, 1u);
+	EXPECT_EQ(classifier.get_statistics().slow, 0u);
+}
+
+//Dragging a window: the dispatch of WM_SYSCOMMAND runs DefWindowProc's move loop for as long as
+//the mouse is held.
+TEST(hang_watchdog, a_modal_loop_counts_as_waiting)
+{
+	pump_heartbeat heartbeat;
+	stall_classifier classifier({ 50ms, 250ms, 2000ms });
+	heartbeat.beat(pump_stage::dispatch, 0x112, 7, 9);
+	classifier.observe(heartbeat.sample(), start);
+
+	heartbeat.enter_modal_loop();
+	//A menu opened from inside the move loop.
+	heartbeat.enter_modal_loop();
+	EXPECT_EQ(heartbeat.sample().stage, pump_stage::waiting);
+	heartbeat.exit_modal_loop();
+	EXPECT_EQ(heartbeat.sample().stage, pump_stage::waiting);
+	for (int i = 1; i <= 100; ++i)
+	{
+		EXPECT_FALSE(classifier.observe(heartbeat.sample(), start + i * 50ms));
+	}
+
+	heartbeat.exit_modal_loop();
+	const auto restored = heartbeat.sample();
+	EXPECT_EQ(restored.stage, pump_stage::dispatch);
+	EXPECT_EQ(restored.message, 0x112u);
+	EXPECT_EQ(restored.window, 7u);
+	EXPECT_EQ(restored.island, 9u);
+	//An exit without an enter changes nothing.
+	heartbeat.exit_modal_loop();
+	EXPECT_EQ(heartbeat.sample().sequence, restored.sequence);
+	EXPECT_EQ(classifier.get_statistics().stalls, 0u);
+}
+
+TEST(hang_watchdog, samples_are_never_torn)
+{
+	pump_heartbeat heartbeat;
+	std::atomic<bool> running = true;
+	std::thread pump([&heartbeat, &running]()
+		{
+			for (uint32_t i = 1; running.load(std::memory_order_relaxed); ++i)
+			{
+				heartbeat.beat(static_cast<pump_stage>(i % static_cast<uint32_t>(pump_stage::stage_count)), i, i, i);
+			}
+		});
+	for (int i = 0; i < 100000; ++i)
+	{
+		const auto sample = heartbeat.sample();
+		ASSERT_EQ(sample.sequence % 2, 0u);
+		ASSERT_EQ(sample.window, sample.message);
+		ASSERT_EQ(sample.island, sample.message);
+	}
+	running = false;
+	pump.join();
+}
+
+//A pump thread that stalls in the dispatch of a message, then carries on.
+TEST(hang_watchdog, reports_an_injected_stall)
+{
+	pump_heartbeat heartbeat;
+	report_log log;
+	hang_watchdog watchdog(heartbeat, { 5ms, 100ms, 300ms }, log.function());
+
+	//The pump doesn't sleep anywhere but in the stall, so a loaded machine can't make a stall of
+	//its own elsewhere.
+	std::thread pump([&heartbeat]()
+		{
+			for (uint32_t i = 0; i < 1000; ++i)
+			{
+				heartbeat.beat(pump_stage::peek, i);
+			}
+			heartbeat.beat(pump_stage::dispatch, 0x201, 42);
+			std::this_thread::sleep_for(600ms);
+			heartbeat.beat(pump_stage::waiting);
+		});
+	ASSERT_TRUE(log.wait_for_count(3));
+	pump.join();
+	watchdog.stop();
+
+	const auto reports = log.get();
+	ASSERT_EQ(reports.size(), 3u);
+	EXPECT_EQ(reports[0].severity, stall_severity::slow);
+	EXPECT_EQ(reports[1].severity, stall_severity::hung);
+	EXPECT_TRUE(reports[2].ended);
+	for (auto &report : reports)
+	{
+		EXPECT_EQ(report.sample.stage, pump_stage::dispatch);
+		EXPECT_EQ(report.sample.message, 0x201u);
+		EXPECT_EQ(report.sample.window, 42u);
+	}
+	//Stall times are measured from the first sample that saw the beat, so under load they can be
+	//short of the sleep by a poll or more; it must still have passed the hang threshold.
+	EXPECT_GE(reports[2].elapsed, 300ms);
+	EXPECT_EQ(watchdog.get_statistics().hung, 1u);
+}
+
+//The pump left in a busy stage when it stops must not be reported once the watchdog is stopped.
+TEST(hang_watchdog, nothing_is_reported_after_stop)
+{
+	pump_heartbeat heartbeat;
+	report_log log;
+	{
+		hang_watchdog watchdog(heartbeat, { 5ms, 20ms, 40ms }, log.function());
+		heartbeat.beat(pump_stage::housekeeping);
+		std::this_thread::sleep_for(10ms);
+		watchdog.stop();
+		watchdog.stop();
+	}
+	std::this_thread::sleep_for(60ms);
+	EXPECT_TRUE(log.get().empty());
+}
\ No newline at end of file
@@ -0,0 +1,327 @@
+#pragma once
+
+#include "fake_window_manager.h"
+#include "island_batch.h"
+#include "island_focus.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+//A window hosting xaml islands, with the desktop, the islands and the window manager all kept in
+//memory, so that focus navigation, message filtering and layout can be driven without a session.
+
+enum class fake_key
+{
+	none,
+	tab,
+	left,
+	right,
+	enter,
+	other
+};
+
+enum class fake_navigation_reason
+{
+	first,
+	last,
+	left,
+	right
+};
+
+struct fake_message
+{
+	uint32_t window = 0;
+	fake_key key = fake_key::none;
+	bool shift = false;
+};
+
+//Stands in for a DesktopWindowXamlSource.
+//An island without anything focusable behaves like xaml does, it hands the focus straight
+//back by raising TakeFocusRequested with the id of the navigation that it was given.
+struct fake_xaml_source
+{
+	uint32_t window = 0;
+	bool has_focusable_content = true;
+	//The key that the island's content handles as an accelerator, none if it handles nothing.
+	fake_key accelerator = fake_key::none;
+};
+
+//The state of the desktop: the host's children in tab order, the focus, and the keyboard.
+struct fake_desktop
+{
+	struct child
+	{
+		uint32_t window = 0;
+		bool tab_stop = true;
+	};
+
+	std::vector<child> tab_order;
+	std::unordered_map<uint32_t, size_t> tab_positions;
+	uint32_t focus = 0;
+	bool alt_down = false;
+	uint64_t next_request_id = 1;
+	//Called when an island gives the focus back, with the request id it was given.
+	std::function<void(fake_xaml_source const &, fake_navigation_reason, uint64_t)> take_focus_requested;
+
+	struct call_counts
+	{
+		size_t navigate_source = 0;
+		size_t restore_source = 0;
+		size_t dialog_navigations = 0;
+		size_t pre_translate = 0;
+	} calls;
+
+	void add_child(uint32_t window, bool tab_stop = true)
+	{
+		tab_positions[window] = tab_order.size();
+		tab_order.push_back({ window, tab_stop });
+	}
+	void remove_child(uint32_t window)
+	{
+		const auto it = tab_positions.find(window);
+		if (it == tab_positions.end())
+		{
+			return;
+		}
+		const auto removed = it->second;
+		tab_order.erase(tab_order.begin() + static_cast<std::ptrdiff_t>(removed));
+		tab_positions.erase(it);
+		for (auto &[handle, position] : tab_positions)
+		{
+			if (position > removed)
+			{
+				--position;
+			}
+		}
+		if (focus == window)
+		{
+			focus = 0;
+		}
+	}
+
+	//The same wrapping search as GetNextDlgTabItem.
+	uint32_t next_tab_item(uint32_t from, bool previous) const
+	{
+		if (tab_order.empty())
+		{
+			return 0;
+		}
+		const auto count = tab_order.size();
+		const auto it = tab_positions.find(from);
+		size_t position = it != tab_positions.end() ? it->second : (previous ? 0 : count - 1);
+		for (size_t i = 0; i < count; ++i)
+		{
+			position = previous ? (position + count - 1) % count : (position + 1) % count;
+			if (tab_order[position].tab_stop)
+			{
+				return tab_order[position].window;
+			}
+		}
+		return 0;
+	}
+};
+
+//The platform for island_focus_navigator, over a fake_desktop.
+struct fake_island_platform
+{
+	using window_type = uint32_t;
+	using message_type = fake_message;
+	using source_type = fake_xaml_source;
+	using reason_type = fake_navigation_reason;
+	using request_id_type = uint64_t;
+
+	fake_desktop *desktop = nullptr;
+
+	uint32_t get_focus()
+	{
+		return desktop->focus;
+	}
+	void set_focus(uint32_t window)
+	{
+		desktop->focus = window;
+	}
+	uint32_t get_next_tab_item(uint32_t, uint32_t from, bool previous)
+	{
+		return desktop->next_tab_item(from, previous);
+	}
+	bool is_menu_modifier_down()
+	{
+		return desktop->alt_down;
+	}
+	bool is_dialog_message(uint32_t, fake_message &msg)
+	{
+		if (msg.key != fake_key::tab)
+		{
+			return false;
+		}
+		++desktop->calls.dialog_navigations;
+		desktop->focus = desktop->next_tab_item(desktop->focus, msg.shift);
+		return true;
+	}
+	std::optional<fake_navigation_reason> get_navigation_reason(fake_message const &msg)
+	{
+		switch (msg.key)
+		{
+		case fake_key::tab:
+			return msg.shift ? fake_navigation_reason::last : fake_navigation_reason::first;
+		case fake_key::left:
+			return fake_navigation_reason::left;
+		case fake_key::right:
+			return fake_navigation_reason::right;
+		default:
+			return std::nullopt;
+		}
+	}
+	bool is_previous(fake_navigation_reason reason)
+	{
+		return reason == fake_navigation_reason::last || reason == fake_navigation_reason::left;
+	}
+	fake_message make_navigation_message(uint32_t window, fake_navigation_reason reason)
+	{
+		switch (reason)
+		{
+		case fake_navigation_reason::last:
+			return { window, fake_key::tab, true };
+		case fake_navigation_reason::left:
+			return { window, fake_key::left, false };
+		case fake_navigation_reason::right:
+			return { window, fake_key::right, false };
+		default:
+			return { window, fake_key::tab, false };
+		}
+	}
+	uint32_t get_source_window(fake_xaml_source const &source)
+	{
+		return source.window;
+	}
+	bool source_has_focus(fake_xaml_source const &source)
+	{
+		return desktop->focus == source.window;
+	}
+	bool pre_translate_message(fake_xaml_source const &source, fake_message const &msg)
+	{
+		++desktop->calls.pre_translate;
+		return source.accelerator != fake_key::none && source.accelerator == msg.key && desktop->focus == source.window;
+	}
+	bool navigate_source(fake_xaml_source const &source, fake_navigation_reason reason, uint32_t, uint64_t &last_request_id)
+	{
+		++desktop->calls.navigate_source;
+		last_request_id = desktop->next_request_id++;
+		if (!source.has_focusable_content)
+		{
+			if (desktop->take_focus_requested)
+			{
+				desktop->take_focus_requested(source, reason, last_request_id);
+			}
+			return false;
+		}
+		return true;
+	}
+	void restore_source(fake_xaml_source const &, uint64_t &last_request_id)
+	{
+		++desktop->calls.restore_source;
+		last_request_id = desktop->next_request_id++;
+	}
+};
+
+//A host window with native controls and islands, laid out in a column.
+//Like window_base, the islands are kept in a vector that the navigator is given as a span.
+class headless_island_host
+{
+public:
+	static constexpr uint32_t host_window = 1000000;
+	static constexpr int row_height = 24;
+
+	headless_island_host() : m_navigator(fake_island_platform{ &m_desktop })
+	{
+		m_desktop.take_focus_requested = [this](fake_xaml_source const &sender, fake_navigation_reason reason, uint64_t request_id)
+			{
+				m_navigator.on_take_focus_requested(host_window, m_sources, sender, reason, request_id);
+			};
+	}
+	headless_island_host(headless_island_host const &) = delete;
+	headless_island_host &operator=(headless_island_host const &) = delete;
+
+	uint32_t add_native_control(bool tab_stop = true)
+	{
+		const auto window = m_window_manager.add_window();
+		m_desktop.add_child(window, tab_stop);
+		return window;
+	}
+	uint32_t add_island(bool has_focusable_content = true, fake_key accelerator = fake_key::none)
+	{
+		const auto window = m_window_manager.add_window();
+		m_desktop.add_child(window);
+		m_sources.push_back({ window, has_focusable_content, accelerator });
+		return window;
+	}
+	void remove_island(uint32_t window)
+	{
+		std::erase_if(m_sources, [window](fake_xaml_source const &source) { return source.window == window; });
+		m_desktop.remove_child(window);
+		m_window_manager.windows.erase(window);
+	}
+
+	//Places every child in a column, in one batch, the way a window lays out on WM_SIZE.
+	island_batch_statistics layout(int width)
+	{
+		m_placements.clear();
+		int y = 0;
+		for (auto &child : m_desktop.tab_order)
+		{
+			m_placements.push_back({ child.window, 0, { 0, y, width, row_height } });
+			y += row_height;
+		}
+		return apply_island_batch(m_window_manager, std::span<const island_placement<uint32_t>>(m_placements));
+	}
+
+	//Runs a key press through the same path as window_base's message filter.
+	bool press(fake_key key, bool shift = false)
+	{
+		fake_message msg{ m_desktop.focus, key, shift };
+		if (m_navigator.navigate_focus(host_window, m_sources, msg))
+		{
+			return true;
+		}
+		return m_navigator.pre_translate_message(m_sources, msg);
+	}
+	//A message that isn't for navigation, such as a character or a mouse move.
+	bool deliver(fake_key key)
+	{
+		return m_navigator.pre_translate_message(m_sources, fake_message{ m_desktop.focus, key, false });
+	}
+
+	fake_desktop &get_desktop()
+	{
+		return m_desktop;
+	}
+	fake_window_manager &get_window_manager()
+	{
+		return m_window_manager;
+	}
+	std::vector<fake_xaml_source> const &get_sources() const
+	{
+		return m_sources;
+	}
+	bool is_island(uint32_t window) const
+	{
+		for (auto &source : m_sources)
+		{
+			if (source.window == window)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	fake_desktop m_desktop;
+	fake_window_manager m_window_manager;
+	std::vector<fake_xaml_source> m_sources;
+	std::vector<island_placement<uint32_t>> m_placements;
+	island_focus_navigator<fake_island_platform> m_navigator;
+};
\ No newline at end of file
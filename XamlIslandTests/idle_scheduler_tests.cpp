@@ -0,0 +1,183 @@
+#include "idle_scheduler.h"
+#include "virtual_clock.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+//A task that does a fixed amount of work in each slice, on the virtual clock.
+idle_scheduler::task_function make_work(virtual_clock &clock, std::chrono::nanoseconds cost, int slices, std::vector<int> *order = nullptr, int tag = 0)
+{
+	return [&clock, cost, slices, order, tag](idle_scheduler::time_point) mutable
+		{
+			clock.advance(cost);
+			if (order)
+			{
+				order->push_back(tag);
+			}
+			return --slices > 0 ? idle_task_result::more_work : idle_task_result::complete;
+		};
+}
+
+TEST(idle_scheduler, runs_higher_priority_first_then_oldest)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	std::vector<int> order;
+	scheduler.post(make_work(clock, 10us, 1, &order, 1), { idle_priority::low });
+	scheduler.post(make_work(clock, 10us, 1, &order, 2), { idle_priority::normal });
+	scheduler.post(make_work(clock, 10us, 1, &order, 3), { idle_priority::high });
+	scheduler.post(make_work(clock, 10us, 1, &order, 4), { idle_priority::normal });
+
+	const auto result = scheduler.run(1ms, nullptr);
+	EXPECT_EQ(result.reason, idle_run_stop_reason::no_tasks);
+	EXPECT_EQ(order, (std::vector<int>{ 3, 2, 4, 1 }));
+	EXPECT_EQ(scheduler.get_statistics().tasks_completed, 4u);
+	EXPECT_FALSE(scheduler.has_pending_tasks());
+}
+
+TEST(idle_scheduler, stops_when_the_budget_is_used)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	scheduler.post(make_work(clock, 1ms, 100));
+
+	const auto result = scheduler.run(8ms, nullptr);
+	EXPECT_EQ(result.reason, idle_run_stop_reason::budget_exhausted);
+	EXPECT_EQ(result.slices_run, 8u);
+	EXPECT_EQ(result.time_used, 8ms);
+	EXPECT_TRUE(scheduler.has_pending_tasks());
+}
+
+TEST(idle_scheduler, slices_end_at_the_budget)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	scheduler.set_slice_length(2ms);
+	std::vector<std::chrono::nanoseconds> slice_lengths;
+	scheduler.post([&](idle_scheduler::time_point slice_end)
+		{
+			slice_lengths.push_back(slice_end - clock.now);
+			clock.advance(slice_end - clock.now);
+			return idle_task_result::more_work;
+		});
+
+	scheduler.run(5ms, nullptr);
+	EXPECT_EQ(slice_lengths, (std::vector<std::chrono::nanoseconds>{ 2ms, 2ms, 1ms }));
+}
+
+TEST(idle_scheduler, yields_to_input)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	bool input = false;
+	int slices = 0;
+	scheduler.post([&](idle_scheduler::time_point)
+		{
+			clock.advance(100us);
+			input = ++slices == 3;
+			return idle_task_result::more_work;
+		});
+
+	const auto result = scheduler.run(10ms, [&]() { return input; });
+	EXPECT_EQ(result.reason, idle_run_stop_reason::input_pending);
+	EXPECT_EQ(result.slices_run, 3u);
+	EXPECT_EQ(scheduler.get_statistics().yields_for_input, 1u);
+}
+
+//Input arrives at random times while the pump alternates between idle work and messages.
+//Idle work may only hold up input for as long as the slice it is in the middle of.
+TEST(idle_scheduler, input_waits_at_most_one_slice)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	scheduler.set_slice_length(1ms);
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> cost_us(50, 1000);
+	std::exponential_distribution<double> arrival_ms(0.5);
+
+	for (int i = 0; i < 64; ++i)
+	{
+		scheduler.post([&](idle_scheduler::time_point slice_end)
+			{
+				//Well behaved tasks stop at the end of the slice.
+				clock.advance(std::min<std::chrono::nanoseconds>(std::chrono::microseconds(cost_us(random)), slice_end - clock.now));
+				return random() % 4 == 0 ? idle_task_result::complete : idle_task_result::more_work;
+			}, { static_cast<idle_priority>(i % 3) });
+	}
+
+	auto next_input = clock.now + std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(arrival_ms(random)));
+	std::chrono::nanoseconds worst_delay{};
+	uint64_t inputs = 0;
+	while (scheduler.has_pending_tasks())
+	{
+		scheduler.run(8ms, [&]() { return clock.now >= next_input; });
+		if (clock.now >= next_input)
+		{
+			worst_delay = std::max(worst_delay, clock.now - next_input);
+			++inputs;
+			//Handling the input takes a little while, then the next one is due.
+			clock.advance(200us);
+			next_input = clock.now + std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>(arrival_ms(random)));
+		}
+	}
+
+	EXPECT_GT(inputs, 0u);
+	EXPECT_LE(worst_delay, scheduler.get_slice_length());
+	EXPECT_EQ(scheduler.get_statistics().tasks_completed, 64u);
+}
+
+TEST(idle_scheduler, overdue_tasks_run_first)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	std::vector<int> order;
+	scheduler.post(make_work(clock, 10us, 1, &order, 1), { idle_priority::high });
+	scheduler.post(make_work(clock, 10us, 1, &order, 2), { idle_priority::low, clock.now + 2ms });
+	scheduler.post(make_work(clock, 10us, 1, &order, 3), { idle_priority::low, clock.now + 1ms });
+
+	clock.advance(5ms);
+	scheduler.run(1ms, nullptr);
+	EXPECT_EQ(order, (std::vector<int>{ 3, 2, 1 }));
+	EXPECT_EQ(scheduler.get_statistics().deadlines_missed, 2u);
+}
+
+TEST(idle_scheduler, promotes_starved_tasks)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	std::vector<int> order;
+	scheduler.post(make_work(clock, 10us, 1, &order, 1), { idle_priority::low });
+	scheduler.post(make_work(clock, 10us, 1000, &order, 2), { idle_priority::high });
+
+	scheduler.run(1ms, nullptr);
+	ASSERT_NE(std::find(order.begin(), order.end(), 1), order.end());
+	EXPECT_LE(std::find(order.begin(), order.end(), 1) - order.begin(), static_cast<std::ptrdiff_t>(2 * idle_scheduler::starvation_threshold));
+	EXPECT_EQ(scheduler.get_statistics().starvation_promotions, 2u);
+}
+
+TEST(idle_scheduler, tasks_can_cancel_and_post_while_running)
+{
+	virtual_clock clock;
+	idle_scheduler scheduler(clock.function());
+	std::vector<int> order;
+	idle_task_id self = invalid_idle_task_id;
+	idle_task_id other = invalid_idle_task_id;
+	self = scheduler.post([&](idle_scheduler::time_point)
+		{
+			order.push_back(1);
+			EXPECT_TRUE(scheduler.cancel(other));
+			scheduler.post(make_work(clock, 10us, 1, &order, 3));
+			EXPECT_TRUE(scheduler.cancel(self));
+			return idle_task_result::more_work;
+		}, { idle_priority::high });
+	other = scheduler.post(make_work(clock, 10us, 1, &order, 2));
+
+	scheduler.run(1ms, nullptr);
+	EXPECT_EQ(order, (std::vector<int>{ 1, 3 }));
+	EXPECT_EQ(scheduler.get_statistics().tasks_cancelled, 2u);
+	EXPECT_FALSE(scheduler.cancel(self));
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "fake_window_manager.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+	using placement = island_placement<fake_window_manager::handle_type>;
+
+	island_batch_statistics run_batch(fake_window_manager &window_manager, std::vector<placement> const &placements)
+	{
+		return apply_island_batch(window_manager, std::span<const placement>(placements));
+	}
+
+	std::vector<placement> make_placements(fake_window_manager &window_manager, size_t count, uint32_t extra_styles)
+	{
+		std::vector<placement> placements;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const int offset = static_cast<int>(i) * 10;
+			placements.push_back({ window_manager.add_window(), extra_styles, { offset, offset, 100, 20 } });
+		}
+		return placements;
+	}
+}
+
+TEST(island_batch, empty_batch_makes_no_calls)
+{
+	fake_window_manager window_manager;
+	run_batch(window_manager, std::vector<placement>{});
+	EXPECT_EQ(window_manager.calls.begin_deferred, 0u);
+	EXPECT_EQ(window_manager.calls.get_style, 0u);
+}
+
+TEST(island_batch, moves_everything_in_one_deferred_batch)
+{
+	fake_window_manager window_manager;
+	const auto placements = make_placements(window_manager, 50, 0);
+	const auto statistics = run_batch(window_manager, placements);
+
+	EXPECT_EQ(window_manager.calls.begin_deferred, 1u);
+	EXPECT_EQ(window_manager.calls.defer_position, 50u);
+	EXPECT_EQ(window_manager.calls.end_deferred, 1u);
+	EXPECT_EQ(window_manager.calls.set_position, 0u);
+	EXPECT_EQ(statistics.positions_deferred, 50u);
+	EXPECT_FALSE(statistics.used_fallback);
+
+	for (auto &placement : placements)
+	{
+		auto &window = window_manager.windows.at(placement.handle);
+		EXPECT_EQ(window.rect.x, placement.rect.x);
+		EXPECT_EQ(window.rect.width, placement.rect.width);
+		EXPECT_TRUE(window.visible);
+	}
+}
+
+TEST(island_batch, only_writes_styles_that_change)
+{
+	constexpr uint32_t tab_stop = 0x00010000;
+	fake_window_manager window_manager;
+	auto placements = make_placements(window_manager, 4, tab_stop);
+	placements[2].extra_styles = 0;
+	window_manager.windows.at(placements[1].handle).style = tab_stop;
+
+	const auto statistics = run_batch(window_manager, placements);
+	//The island without extra styles isn't read, the one that already has them isn't written.
+	EXPECT_EQ(window_manager.calls.get_style, 3u);
+	EXPECT_EQ(window_manager.calls.set_style, 2u);
+	EXPECT_EQ(statistics.style_reads, 3u);
+	EXPECT_EQ(statistics.style_writes, 2u);
+
+	//Running the same batch again, as a resize does, writes nothing.
+	window_manager.calls = {};
+	run_batch(window_manager, placements);
+	EXPECT_EQ(window_manager.calls.set_style, 0u);
+	EXPECT_EQ(window_manager.windows.at(placements[0].handle).style, tab_stop);
+}
+
+TEST(island_batch, falls_back_to_single_moves_when_the_deferral_fails)
+{
+	fake_window_manager window_manager;
+	window_manager.fail_deferral_at = 3;
+	const auto placements = make_placements(window_manager, 10, 0);
+	const auto statistics = run_batch(window_manager, placements);
+
+	EXPECT_TRUE(statistics.used_fallback);
+	EXPECT_EQ(statistics.positions_deferred, 3u);
+	//The abandoned batch is never ended.
+	EXPECT_EQ(window_manager.calls.end_deferred, 0u);
+	EXPECT_EQ(window_manager.calls.set_position, 10u);
+	EXPECT_EQ(window_manager.windows.at(placements.back().handle).rect.y, 90);
+}
+
+TEST(island_batch, falls_back_when_ending_the_deferral_fails)
+{
+	fake_window_manager window_manager;
+	window_manager.fail_end_deferred = true;
+	const auto placements = make_placements(window_manager, 5, 0);
+	const auto statistics = run_batch(window_manager, placements);
+
+	EXPECT_TRUE(statistics.used_fallback);
+	EXPECT_EQ(window_manager.calls.end_deferred, 1u);
+	EXPECT_EQ(window_manager.calls.set_position, 5u);
+	EXPECT_TRUE(window_manager.windows.at(placements.front().handle).visible);
+}
\ No newline at end of file
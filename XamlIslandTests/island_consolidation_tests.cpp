@@ -0,0 +1,221 @@
+#include "island_consolidation.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr auto native = consolidation_child_kind::native;
+	constexpr auto xaml = consolidation_child_kind::xaml;
+
+	//A form laid out in a column, with each child in a row of its own.
+	std::vector<consolidation_child> make_column(std::initializer_list<consolidation_child_kind> kinds, int row_height = 30)
+	{
+		std::vector<consolidation_child> children;
+		int y = 10;
+		for (auto kind : kinds)
+		{
+			children.push_back({ kind, { 10, y, 200, row_height - 5 } });
+			y += row_height;
+		}
+		return children;
+	}
+
+	bool intersects(island_rect const &a, island_rect const &b)
+	{
+		return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+	}
+
+	//What every plan has to hold to, for children that don't overlap each other.
+	void check_plan(std::span<const consolidation_child> children, consolidation_plan const &plan, consolidation_options const &options)
+	{
+		ASSERT_EQ(plan.island_of_child.size(), children.size());
+		size_t hosted = 0;
+		for (size_t i = 0; i < plan.islands.size(); ++i)
+		{
+			auto &island = plan.islands[i];
+			ASSERT_FALSE(island.children.empty());
+			EXPECT_LE(island.children.size(), options.max_elements);
+			hosted += island.children.size();
+
+			//The elements are next to each other in the tab order, with no native child between them.
+			for (size_t j = 0; j < island.children.size(); ++j)
+			{
+				const auto child = island.children[j];
+				EXPECT_EQ(children[child].kind, xaml);
+				EXPECT_EQ(plan.island_of_child[child], i);
+				if (j != 0)
+				{
+					EXPECT_EQ(child, island.children[j - 1] + 1);
+				}
+			}
+
+			//The island is exactly the bounds of its elements, and covers nothing else.
+			auto bounds = children[island.children.front()].rect;
+			for (auto child : island.children)
+			{
+				auto &rect = children[child].rect;
+				const int right = std::max(bounds.x + bounds.width, rect.x + rect.width);
+				const int bottom = std::max(bounds.y + bounds.height, rect.y + rect.height);
+				bounds.x = std::min(bounds.x, rect.x);
+				bounds.y = std::min(bounds.y, rect.y);
+				bounds.width = right - bounds.x;
+				bounds.height = bottom - bounds.y;
+			}
+			EXPECT_EQ(island.rect.x, bounds.x);
+			EXPECT_EQ(island.rect.y, bounds.y);
+			EXPECT_EQ(island.rect.width, bounds.width);
+			EXPECT_EQ(island.rect.height, bounds.height);
+			for (size_t c = 0; c < children.size(); ++c)
+			{
+				if (plan.island_of_child[c] != i)
+				{
+					EXPECT_FALSE(intersects(island.rect, children[c].rect)) << "island " << i << " covers child " << c;
+				}
+			}
+		}
+
+		const auto xaml_children = static_cast<size_t>(std::count_if(children.begin(), children.end(), [](consolidation_child const &child) { return child.kind == xaml; }));
+		EXPECT_EQ(hosted, xaml_children);
+	}
+}
+
+TEST(island_consolidation, a_run_of_xaml_elements_shares_one_island)
+{
+	const auto children = make_column({ xaml, xaml, xaml, xaml });
+	const auto plan = plan_island_consolidation(children);
+	check_plan(children, plan, {});
+	ASSERT_EQ(plan.islands.size(), 1u);
+	EXPECT_EQ(plan.islands[0].rect.y, 10);
+	EXPECT_EQ(plan.islands[0].rect.height, 3 * 30 + 25);
+
+	const auto within = get_rect_within(plan.islands[0].rect, children[2].rect);
+	EXPECT_EQ(within.x, 0);
+	EXPECT_EQ(within.y, 60);
+	EXPECT_EQ(within.width, 200);
+}
+
+TEST(island_consolidation, native_controls_split_the_islands)
+{
+	//The main window: two native buttons around a xaml button, then a xaml panel.
+	const auto children = make_column({ native, xaml, native, xaml, xaml, native });
+	const auto plan = plan_island_consolidation(children);
+	check_plan(children, plan, {});
+	ASSERT_EQ(plan.islands.size(), 2u);
+	EXPECT_EQ(plan.islands[0].children, (std::vector<size_t>{ 1 }));
+	EXPECT_EQ(plan.islands[1].children, (std::vector<size_t>{ 3, 4 }));
+	EXPECT_EQ(plan.island_of_child[0], consolidation_plan::no_island);
+	EXPECT_EQ(plan.island_of_child[5], consolidation_plan::no_island);
+
+	EXPECT_TRUE(plan_island_consolidation({}).islands.empty());
+	EXPECT_TRUE(plan_island_consolidation(make_column({ native, native })).islands.empty());
+}
+
+TEST(island_consolidation, distant_elements_get_their_own_island)
+{
+	auto children = make_column({ xaml, xaml, xaml });
+	//The last one is at the bottom of the window.
+	children[2].rect.y = 500;
+	const auto plan = plan_island_consolidation(children);
+	check_plan(children, plan, {});
+	ASSERT_EQ(plan.islands.size(), 2u);
+	EXPECT_EQ(plan.islands[1].children, (std::vector<size_t>{ 2 }));
+
+	consolidation_options far{};
+	far.max_gap = 1000;
+	EXPECT_EQ(plan_island_consolidation(children, far).islands.size(), 1u);
+}
+
+TEST(island_consolidation, islands_never_cover_other_controls)
+{
+	//Three xaml elements in an L around a native control that comes after them in the tab order.
+	//Taking in the third would put the island over the native control.
+	std::vector<consolidation_child> children{
+		{ xaml, { 10, 10, 100, 25 } },
+		{ xaml, { 120, 10, 100, 25 } },
+		{ xaml, { 120, 40, 100, 25 } },
+		{ native, { 10, 40, 100, 25 } },
+	};
+	const auto plan = plan_island_consolidation(children);
+	check_plan(children, plan, {});
+	ASSERT_EQ(plan.islands.size(), 2u);
+	EXPECT_EQ(plan.islands[0].children, (std::vector<size_t>{ 0, 1 }));
+	EXPECT_EQ(plan.islands[1].children, (std::vector<size_t>{ 2 }));
+}
+
+TEST(island_consolidation, elements_are_given_back_so_the_next_island_fits)
+{
+	//The first island is full after two elements, but those two are far apart and the third
+	//element sits between them, so the second one is given back to the next island.
+	std::vector<consolidation_child> children{
+		{ xaml, { 0, 0, 50, 20 } },
+		{ xaml, { 0, 100, 50, 20 } },
+		{ xaml, { 10, 50, 30, 10 } },
+	};
+	consolidation_options options{};
+	options.max_gap = 100;
+	options.max_elements = 2;
+	const auto plan = plan_island_consolidation(children, options);
+	check_plan(children, plan, options);
+	ASSERT_EQ(plan.islands.size(), 2u);
+	EXPECT_EQ(plan.islands[0].children, (std::vector<size_t>{ 0 }));
+	EXPECT_EQ(plan.islands[1].children, (std::vector<size_t>{ 1, 2 }));
+}
+
+TEST(island_consolidation, islands_have_an_element_limit)
+{
+	std::vector<consolidation_child> children;
+	for (int i = 0; i < 10; ++i)
+	{
+		children.push_back({ xaml, { 10, 10 + i * 30, 200, 25 } });
+	}
+	consolidation_options options{};
+	options.max_elements = 4;
+	const auto plan = plan_island_consolidation(children, options);
+	check_plan(children, plan, options);
+	ASSERT_EQ(plan.islands.size(), 3u);
+	EXPECT_EQ(plan.islands[2].children.size(), 2u);
+}
+
+TEST(island_consolidation, random_forms_keep_every_rule)
+{
+	std::mt19937 random(2024);
+	for (int iteration = 0; iteration < 2000; ++iteration)
+	{
+		//Controls in the cells of a grid, so they never overlap, in mostly reading order.
+		const int columns = std::uniform_int_distribution<int>(1, 4)(random);
+		const int rows = std::uniform_int_distribution<int>(1, 12)(random);
+		std::vector<consolidation_child> children;
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int column = 0; column < columns; ++column)
+			{
+				if (random() % 4 == 0)
+				{
+					continue;
+				}
+				const auto kind = random() % 3 == 0 ? native : xaml;
+				const int width = std::uniform_int_distribution<int>(20, 110)(random);
+				const int height = std::uniform_int_distribution<int>(10, 28)(random);
+				children.push_back({ kind, { column * 120, row * 30 + (row > rows / 2 ? 200 : 0), width, height } });
+			}
+		}
+		//Some forms have a tab order that jumps around.
+		if (random() % 4 == 0 && children.size() > 2)
+		{
+			std::swap(children[random() % children.size()], children[random() % children.size()]);
+		}
+
+		consolidation_options options{};
+		options.max_gap = std::uniform_int_distribution<int>(0, 60)(random);
+		options.max_elements = std::uniform_int_distribution<size_t>(1, 8)(random);
+		check_plan(children, plan_island_consolidation(children, options), options);
+		if (::testing::Test::HasFailure())
+		{
+			FAIL() << "iteration " << iteration;
+		}
+	}
+}
\ No newline at end of file
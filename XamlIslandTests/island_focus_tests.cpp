@@ -0,0 +1,145 @@
+#include "headless_island_host.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+	//A native control, two islands and another native control.
+	struct mixed_host
+	{
+		headless_island_host host;
+		uint32_t first_native = host.add_native_control();
+		uint32_t first_island = host.add_island();
+		uint32_t second_island = host.add_island();
+		uint32_t last_native = host.add_native_control();
+
+		mixed_host()
+		{
+			host.get_desktop().focus = first_native;
+		}
+	};
+}
+
+TEST(island_focus, tab_moves_through_native_controls_and_islands)
+{
+	mixed_host mixed;
+	auto &desktop = mixed.host.get_desktop();
+
+	EXPECT_TRUE(mixed.host.press(fake_key::tab));
+	EXPECT_EQ(desktop.focus, mixed.first_island);
+	EXPECT_EQ(desktop.calls.navigate_source, 1u);
+
+	EXPECT_TRUE(mixed.host.press(fake_key::tab));
+	EXPECT_EQ(desktop.focus, mixed.second_island);
+
+	//The next control is native, and an island has the focus, so the island keeps the key.
+	EXPECT_FALSE(mixed.host.press(fake_key::tab));
+	EXPECT_EQ(desktop.focus, mixed.second_island);
+	EXPECT_EQ(desktop.calls.dialog_navigations, 0u);
+}
+
+TEST(island_focus, shift_tab_goes_backwards_and_wraps)
+{
+	mixed_host mixed;
+	auto &desktop = mixed.host.get_desktop();
+
+	EXPECT_TRUE(mixed.host.press(fake_key::tab, true));
+	EXPECT_EQ(desktop.focus, mixed.last_native);
+	EXPECT_EQ(desktop.calls.dialog_navigations, 1u);
+
+	EXPECT_TRUE(mixed.host.press(fake_key::tab, true));
+	EXPECT_EQ(desktop.focus, mixed.second_island);
+}
+
+TEST(island_focus, alt_lets_dialog_navigation_through_from_an_island)
+{
+	mixed_host mixed;
+	auto &desktop = mixed.host.get_desktop();
+	desktop.focus = mixed.second_island;
+	desktop.alt_down = true;
+
+	EXPECT_TRUE(mixed.host.press(fake_key::tab));
+	EXPECT_EQ(desktop.focus, mixed.last_native);
+}
+
+TEST(island_focus, controls_without_tab_stops_are_skipped)
+{
+	headless_island_host host;
+	const auto start = host.add_native_control();
+	host.add_native_control(false);
+	const auto island = host.add_island();
+	host.get_desktop().focus = start;
+
+	EXPECT_TRUE(host.press(fake_key::tab));
+	EXPECT_EQ(host.get_desktop().focus, island);
+}
+
+//An island with nothing focusable bounces the navigation straight back with the same request id.
+//The navigator recognises its own request and leaves the focus on the island.
+TEST(island_focus, an_island_bouncing_its_own_request_keeps_the_focus)
+{
+	headless_island_host host;
+	const auto start = host.add_native_control();
+	const auto empty_island = host.add_island(false);
+	host.add_native_control();
+	host.get_desktop().focus = start;
+
+	EXPECT_FALSE(host.press(fake_key::tab));
+	EXPECT_EQ(host.get_desktop().calls.restore_source, 1u);
+	EXPECT_EQ(host.get_desktop().focus, empty_island);
+}
+
+//Tabbing past the last element in an island raises TakeFocusRequested with a new id, and the
+//focus moves on to whatever comes after the island.
+TEST(island_focus, an_island_giving_up_the_focus_moves_it_on)
+{
+	mixed_host mixed;
+	auto &desktop = mixed.host.get_desktop();
+	desktop.focus = mixed.second_island;
+	const uint64_t island_request = 12345;
+
+	desktop.take_focus_requested(mixed.host.get_sources()[1], fake_navigation_reason::first, island_request);
+	EXPECT_EQ(desktop.focus, mixed.last_native);
+
+	desktop.focus = mixed.first_island;
+	desktop.take_focus_requested(mixed.host.get_sources()[0], fake_navigation_reason::last, island_request);
+	EXPECT_EQ(desktop.focus, mixed.first_native);
+}
+
+TEST(island_focus, messages_stop_at_the_island_that_handles_them)
+{
+	headless_island_host host;
+	host.add_island();
+	const auto handling = host.add_island(true, fake_key::enter);
+	host.add_island(true, fake_key::enter);
+	auto &desktop = host.get_desktop();
+	desktop.focus = handling;
+
+	EXPECT_TRUE(host.deliver(fake_key::enter));
+	EXPECT_EQ(desktop.calls.pre_translate, 2u);
+
+	desktop.calls = {};
+	EXPECT_FALSE(host.deliver(fake_key::other));
+	EXPECT_EQ(desktop.calls.pre_translate, 3u);
+}
+
+TEST(island_focus, layout_places_every_child_in_one_batch)
+{
+	headless_island_host host;
+	for (int i = 0; i < 20; ++i)
+	{
+		host.add_island();
+		host.add_native_control();
+	}
+	const auto statistics = host.layout(300);
+	EXPECT_EQ(statistics.positions_deferred, 40u);
+	EXPECT_EQ(host.get_window_manager().calls.end_deferred, 1u);
+
+	//Removing islands takes them out of the tab order and the next layout closes the gap.
+	const auto removed = host.get_sources()[3].window;
+	host.remove_island(removed);
+	host.layout(300);
+	EXPECT_FALSE(host.is_island(removed));
+	EXPECT_EQ(host.get_window_manager().windows.size(), 39u);
+	EXPECT_EQ(host.get_window_manager().windows.at(host.get_desktop().tab_order.back().window).rect.y, 38 * headless_island_host::row_height);
+}
\ No newline at end of file
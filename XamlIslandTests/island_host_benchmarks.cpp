@@ -0,0 +1,91 @@
+#include "benchmark_support.h"
+#include "headless_island_host.h"
+
+#include <string>
+
+//Focus navigation, message filtering and layout for hosts with 10 to 10000 islands.
+//Every other child is a native control, as in a form that mixes the two.
+
+std::vector<size_t> get_island_counts(benchmark_context const &context)
+{
+	return context.pick<std::vector<size_t>>({ 10, 100, 1000, 10000 }, { 10, 100 });
+}
+
+void fill_host(headless_island_host &host, size_t islands)
+{
+	for (size_t i = 0; i < islands; ++i)
+	{
+		host.add_native_control();
+		host.add_island();
+	}
+	host.get_desktop().focus = host.get_desktop().tab_order.front().window;
+}
+
+//Alt is held, so that tabbing out of an island goes through dialog navigation and a press
+//always moves the focus.
+XAML_BENCHMARK(island_host, tab_cycle)
+{
+	for (const auto islands : get_island_counts(context))
+	{
+		headless_island_host host;
+		fill_host(host, islands);
+		host.get_desktop().alt_down = true;
+		const size_t presses = islands * 2;
+		context.measure("tab_ns_per_press_" + std::to_string(islands), presses, [&]()
+			{
+				for (size_t i = 0; i < presses; ++i)
+				{
+					keep_value(host.press(fake_key::tab));
+				}
+			});
+	}
+}
+
+//Messages that no island handles, so every island sees each of them.
+XAML_BENCHMARK(island_host, message_storm)
+{
+	for (const auto islands : get_island_counts(context))
+	{
+		headless_island_host host;
+		fill_host(host, islands);
+		const size_t messages = context.pick<size_t>(2000000, 20000) / islands;
+		context.measure("filter_ns_per_message_" + std::to_string(islands), messages, [&]()
+			{
+				for (size_t i = 0; i < messages; ++i)
+				{
+					keep_value(host.deliver(fake_key::other));
+				}
+			});
+	}
+}
+
+XAML_BENCHMARK(island_host, layout)
+{
+	for (const auto islands : get_island_counts(context))
+	{
+		headless_island_host host;
+		fill_host(host, islands);
+		int width = 300;
+		context.measure("layout_ns_per_child_" + std::to_string(islands), islands * 2, [&]() { keep_value(host.layout(++width)); });
+	}
+}
+
+//A tenth of the islands are replaced and the window is laid out again.
+XAML_BENCHMARK(island_host, churn)
+{
+	for (const auto islands : get_island_counts(context))
+	{
+		headless_island_host host;
+		fill_host(host, islands);
+		const size_t replaced = islands / 10 + 1;
+		context.measure("churn_ns_per_replaced_island_" + std::to_string(islands), replaced, [&]()
+			{
+				for (size_t i = 0; i < replaced; ++i)
+				{
+					host.remove_island(host.get_sources().front().window);
+					host.add_island();
+				}
+				keep_value(host.layout(300));
+			});
+	}
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "island_suspension.h"
+#include "virtual_clock.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	//An event at a time, with the thread's CPU time at that point.
+	struct timed_event
+	{
+		std::chrono::milliseconds at;
+		suspension_event event;
+		std::chrono::milliseconds cpu_time;
+	};
+
+	std::vector<suspension_transition> play(island_suspension &suspension, std::vector<timed_event> const &events)
+	{
+		const auto start = island_suspension::time_point{} + 1h;
+		std::vector<suspension_transition> transitions;
+		for (auto &event : events)
+		{
+			transitions.push_back(suspension.process_event(event.event, start + event.at, event.cpu_time));
+		}
+		return transitions;
+	}
+
+	constexpr uint32_t reason_bit(suspension_reason reason)
+	{
+		return static_cast<uint32_t>(reason);
+	}
+}
+
+TEST(island_suspension, minimise_and_restore)
+{
+	island_suspension suspension;
+	const auto transitions = play(suspension, {
+		{ 0ms, suspension_event::activated, 0ms },
+		{ 10ms, suspension_event::minimized, 0ms },
+		{ 20ms, suspension_event::restored, 0ms } });
+
+	EXPECT_EQ(transitions, (std::vector<suspension_transition>{ suspension_transition::none, suspension_transition::suspend, suspension_transition::resume }));
+	EXPECT_FALSE(suspension.is_suspended());
+	EXPECT_FALSE(suspension.is_hidden());
+}
+
+TEST(island_suspension, reasons_overlap)
+{
+	island_suspension suspension;
+	play(suspension, {
+		{ 0ms, suspension_event::deactivated, 0ms },
+		{ 10ms, suspension_event::occluded, 0ms },
+		{ 20ms, suspension_event::minimized, 0ms } });
+	EXPECT_EQ(suspension.reasons(), reason_bit(suspension_reason::occluded) | reason_bit(suspension_reason::minimized));
+
+	//Uncovering a minimised window doesn't resume it.
+	EXPECT_EQ(suspension.process_event(suspension_event::unoccluded, island_suspension::time_point{} + 2h, 0ns), suspension_transition::none);
+	EXPECT_TRUE(suspension.is_hidden());
+	EXPECT_EQ(suspension.process_event(suspension_event::restored, island_suspension::time_point{} + 2h, 0ns), suspension_transition::resume);
+}
+
+TEST(island_suspension, activation_ends_occlusion)
+{
+	island_suspension suspension;
+	const auto transitions = play(suspension, {
+		{ 0ms, suspension_event::deactivated, 0ms },
+		{ 10ms, suspension_event::occluded, 0ms },
+		{ 20ms, suspension_event::activated, 0ms } });
+	EXPECT_EQ(transitions.back(), suspension_transition::resume);
+	EXPECT_TRUE(suspension.is_foreground());
+}
+
+TEST(island_suspension, idle_suspension_is_off_by_default)
+{
+	island_suspension suspension;
+	play(suspension, {
+		{ 0ms, suspension_event::deactivated, 0ms },
+		{ 1h, suspension_event::tick, 0ms } });
+	EXPECT_FALSE(suspension.is_suspended());
+	EXPECT_EQ(suspension.idle_deadline(), island_suspension::time_point::max());
+}
+
+TEST(island_suspension, idle_windows_are_paused_but_not_hidden)
+{
+	suspension_policy policy{};
+	policy.background_idle_timeout = 30s;
+	island_suspension suspension(policy);
+	const auto transitions = play(suspension, {
+		{ 0ms, suspension_event::activated, 0ms },
+		{ 5s, suspension_event::deactivated, 0ms },
+		{ 20s, suspension_event::tick, 0ms },
+		{ 35s, suspension_event::tick, 0ms } });
+
+	EXPECT_EQ(transitions, (std::vector<suspension_transition>{ suspension_transition::none, suspension_transition::none, suspension_transition::none, suspension_transition::suspend }));
+	EXPECT_EQ(suspension.reasons(), reason_bit(suspension_reason::idle));
+	EXPECT_TRUE(suspension.is_suspended());
+	EXPECT_FALSE(suspension.is_hidden());
+
+	//Being covered as well hides it, and being uncovered only takes it back to paused.
+	suspension.process_event(suspension_event::occluded, island_suspension::time_point{} + 1h + 40s, 0ns);
+	EXPECT_TRUE(suspension.is_hidden());
+	EXPECT_EQ(suspension.process_event(suspension_event::unoccluded, island_suspension::time_point{} + 1h + 45s, 0ns), suspension_transition::none);
+	EXPECT_FALSE(suspension.is_hidden());
+	EXPECT_TRUE(suspension.is_suspended());
+
+	EXPECT_EQ(suspension.process_event(suspension_event::activated, island_suspension::time_point{} + 1h + 50s, 0ns), suspension_transition::resume);
+}
+
+TEST(island_suspension, policy_controls_the_reasons)
+{
+	suspension_policy policy{};
+	policy.suspend_when_occluded = false;
+	island_suspension suspension(policy);
+	play(suspension, {
+		{ 0ms, suspension_event::deactivated, 0ms },
+		{ 10ms, suspension_event::occluded, 0ms } });
+	EXPECT_FALSE(suspension.is_suspended());
+
+	play(suspension, { { 20ms, suspension_event::minimized, 0ms } });
+	ASSERT_TRUE(suspension.is_suspended());
+	policy.suspend_when_minimized = false;
+	suspension.set_policy(policy);
+	EXPECT_FALSE(suspension.is_suspended());
+}
+
+TEST(island_suspension, accounts_time_and_estimates_the_saving)
+{
+	island_suspension suspension;
+	//Active for a second using half a second of CPU, then minimised for two seconds using 100ms.
+	play(suspension, {
+		{ 0ms, suspension_event::activated, 0ms },
+		{ 1000ms, suspension_event::minimized, 500ms },
+		{ 3000ms, suspension_event::restored, 600ms } });
+
+	const auto statistics = suspension.get_statistics(island_suspension::time_point{} + 1h + 4000ms, 1100ms);
+	EXPECT_EQ(statistics.suspend_count, 1u);
+	EXPECT_EQ(statistics.resume_count, 1u);
+	EXPECT_EQ(statistics.active_wall_time, 2000ms);
+	EXPECT_EQ(statistics.active_cpu_time, 1000ms);
+	EXPECT_EQ(statistics.suspended_wall_time, 2000ms);
+	EXPECT_EQ(statistics.suspended_cpu_time, 100ms);
+	EXPECT_EQ(statistics.estimated_cpu_time_saved(), 900ms);
+}
+
+TEST(island_suspension, counts_skipped_filter_calls)
+{
+	island_suspension suspension;
+	suspension.note_skipped_filter();
+	suspension.note_skipped_filter();
+	EXPECT_EQ(suspension.get_statistics(island_suspension::time_point{}, 0ns).skipped_filter_calls, 2u);
+}
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "latency_probe.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	using time_point = latency_probe::clock::time_point;
+
+	const time_point start = time_point{} + 1h;
+
+	//A key press that goes through the filter and navigation, then moves the focus into an
+	//island, with the times after the input in microseconds.
+	struct synthetic_interaction
+	{
+		input_kind kind = input_kind::key;
+		std::chrono::microseconds dequeued{};
+		std::chrono::microseconds filtered{};
+		std::chrono::microseconds navigated{};
+		std::chrono::microseconds take_focus{};
+	};
+
+	void run_interaction(latency_probe &probe, time_point input_time, synthetic_interaction const &interaction)
+	{
+		probe.begin(interaction.kind, input_time, input_time + interaction.dequeued);
+		probe.mark(latency_stage::filtered, input_time + interaction.filtered);
+		probe.mark(latency_stage::navigated, input_time + interaction.navigated);
+		probe.mark(latency_stage::take_focus, input_time + interaction.take_focus);
+		probe.end_dispatch();
+	}
+}
+
+TEST(latency_probe, names_every_kind_and_stage)
+{
+	EXPECT_EQ(get_input_kind_name(input_kind::mouse_wheel), "mouse_wheel");
+	EXPECT_EQ(get_input_kind_name(input_kind::kind_count), "unknown");
+	EXPECT_EQ(get_latency_stage_name(latency_stage::take_focus), "take_focus");
+	EXPECT_EQ(get_latency_stage_name(latency_stage::stage_count), "unknown");
+}
+
+TEST(latency_probe, histogram_percentiles_are_close)
+{
+	latency_histogram histogram;
+	EXPECT_EQ(histogram.get_percentile(0.5), 0us);
+
+	//Values below the sub bucket count are exact.
+	for (int i = 1; i <= 10; ++i)
+	{
+		histogram.record(std::chrono::microseconds(i));
+	}
+	EXPECT_EQ(histogram.get_percentile(0.5), 5us);
+	EXPECT_EQ(histogram.get_percentile(1.0), 10us);
+	EXPECT_EQ(histogram.get_percentile(0.0), 1us);
+
+	histogram.clear();
+	std::mt19937 random(3);
+	std::vector<int64_t> values;
+	for (int i = 0; i < 10000; ++i)
+	{
+		values.push_back(std::uniform_int_distribution<int64_t>(100, 2000000)(random));
+		histogram.record(std::chrono::microseconds(values.back()));
+	}
+	std::sort(values.begin(), values.end());
+	for (const double fraction : { 0.5, 0.9, 0.99 })
+	{
+		const auto expected = static_cast<double>(values[static_cast<size_t>(fraction * values.size()) - 1]);
+		const auto actual = static_cast<double>(histogram.get_percentile(fraction).count());
+		EXPECT_NEAR(actual, expected, expected * 0.07) << fraction;
+	}
+	EXPECT_EQ(histogram.get_max().count(), values.back());
+	EXPECT_EQ(histogram.get_count(), 10000u);
+}
+
+TEST(latency_probe, histogram_clamps_odd_values)
+{
+	latency_histogram histogram;
+	//An input time from a coarse tick can be after the stage.
+	histogram.record(-5us);
+	EXPECT_EQ(histogram.get_percentile(1.0), 0us);
+	//Past the last bucket.
+	const auto huge = std::chrono::microseconds(int64_t{ 1 } << 50);
+	histogram.record(huge);
+	EXPECT_EQ(histogram.get_max(), huge);
+	EXPECT_LE(histogram.get_percentile(1.0), huge);
+}
+
+TEST(latency_probe, late_handlers_go_to_the_interaction_that_caused_them)
+{
+	latency_probe probe(250ms);
+	std::vector<latency_span> spans;
+	const auto collect = [&spans](latency_span const &span) { spans.push_back(span); };
+
+	run_interaction(probe, start, { input_kind::key, 2000us, 2100us, 2200us, 2500us });
+	//The button's Click runs once xaml has had a turn.
+	probe.mark(latency_stage::handled, start + 40ms);
+	EXPECT_EQ(probe.collect(start + 100ms, collect), 0u);
+	EXPECT_EQ(probe.collect(start + 300ms, collect), 1u);
+
+	ASSERT_EQ(spans.size(), 1u);
+	EXPECT_TRUE(spans[0].has_reached(latency_stage::handled));
+	EXPECT_EQ(spans[0].get_latency(latency_stage::handled), 40ms);
+	EXPECT_EQ(spans[0].get_latency(latency_stage::take_focus), 2500us);
+	EXPECT_EQ(format_latency_span(spans[0]), L"key #1: dequeued 2000us, filtered 2100us, navigated 2200us, take_focus 2500us, handled 40000us");
+
+	//Too late for anything.
+	probe.mark(latency_stage::handled, start + 400ms);
+	EXPECT_EQ(probe.get_counters().unattributed_stages, 1u);
+	EXPECT_FALSE(probe.has_open_interactions());
+}
+
+TEST(latency_probe, the_next_input_takes_later_stages)
+{
+	latency_probe probe(250ms);
+	std::vector<uint64_t> finished;
+	const auto collect = [&finished](latency_span const &span) { finished.push_back(span.id); };
+
+	const auto first = probe.begin(input_kind::mouse_button, start, start + 1ms);
+	probe.end_dispatch();
+	const auto second = probe.begin(input_kind::key, start + 5ms, start + 6ms);
+	probe.mark(latency_stage::filtered, start + 7ms);
+	probe.mark(latency_stage::filtered, start + 8ms);
+	probe.end_dispatch();
+	probe.mark(latency_stage::handled, start + 20ms);
+
+	//The first can't get any more stages, so it is finished straight away.
+	EXPECT_EQ(probe.collect(start + 10ms, collect), 1u);
+	EXPECT_EQ(probe.flush(collect), 1u);
+	EXPECT_EQ(finished, (std::vector<uint64_t>{ first, second }));
+	EXPECT_EQ(probe.get_counters().repeated_stages, 1u);
+	EXPECT_EQ(probe.get_summary(input_kind::key, latency_stage::handled).count, 1u);
+	EXPECT_EQ(probe.get_summary(input_kind::mouse_button, latency_stage::handled).count, 0u);
+	//The first time a stage is reached is the one that is kept.
+	EXPECT_EQ(probe.get_summary(input_kind::key, latency_stage::filtered).max, 2ms);
+}
+
+TEST(latency_probe, stages_during_dispatch_are_never_dropped)
+{
+	latency_probe probe(10ms);
+	probe.begin(input_kind::key, start, start);
+	//A handler that takes longer than the window, while the message is still being dispatched.
+	probe.mark(latency_stage::handled, start + 50ms);
+	EXPECT_EQ(probe.collect(start + 60ms), 0u);
+	probe.end_dispatch();
+	EXPECT_EQ(probe.collect(start + 61ms), 1u);
+	EXPECT_EQ(probe.get_counters().unattributed_stages, 0u);
+	EXPECT_EQ(probe.get_summary(input_kind::key, latency_stage::handled).max, 50ms);
+}
+
+TEST(latency_probe, reports_percentiles_per_input_kind)
+{
+	latency_probe probe;
+	std::mt19937 random(11);
+	auto input_time = start;
+	//Tabbing between native buttons is quick, moving into the island is slow.
+	for (int i = 0; i < 1000; ++i)
+	{
+		const bool into_island = i % 10 == 0;
+		const auto navigated = std::chrono::microseconds(std::uniform_int_distribution<int>(200, 400)(random));
+		const auto take_focus = into_island ? navigated + 30ms : navigated;
+		run_interaction(probe, input_time, { input_kind::key, 100us, 150us, navigated, take_focus });
+		input_time += 1s;
+		probe.collect(input_time);
+	}
+	for (int i = 0; i < 100; ++i)
+	{
+		probe.begin(input_kind::mouse_wheel, input_time, input_time + 5ms);
+		probe.end_dispatch();
+		input_time += 1s;
+		probe.collect(input_time);
+	}
+	probe.flush();
+
+	const auto report = probe.get_report();
+	//Four stages for keys and one for the wheel.
+	ASSERT_EQ(report.size(), 5u);
+	EXPECT_EQ(report.back().kind, input_kind::mouse_wheel);
+	EXPECT_EQ(report.back().summary.count, 100u);
+
+	const auto navigated = probe.get_summary(input_kind::key, latency_stage::navigated);
+	EXPECT_EQ(navigated.count, 1000u);
+	EXPECT_GE(navigated.p50, 250us);
+	EXPECT_LE(navigated.p99, 430us);
+	const auto take_focus = probe.get_summary(input_kind::key, latency_stage::take_focus);
+	//One move in ten goes into the island, so that only shows above p90.
+	EXPECT_LT(take_focus.p90, 1ms);
+	EXPECT_GE(take_focus.p99, 28ms);
+	EXPECT_EQ(probe.get_counters().interactions, 1100u);
+}
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "counter_report.h"
+#include "live_counters.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	//A named POSIX shared memory object standing in for the named file mapping.
+	//Each view maps it again at its own address, as a reader in another process would.
+	class shared_region
+	{
+	public:
+		explicit shared_region(std::string name) : m_name(std::move(name))
+		{
+			shm_unlink(m_name.c_str());
+			m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+			if (m_fd >= 0 && ftruncate(m_fd, static_cast<off_t>(live_counters_region_size)) != 0)
+			{
+				close(m_fd);
+				m_fd = -1;
+			}
+		}
+		~shared_region()
+		{
+			for (auto view : m_views)
+			{
+				munmap(view, live_counters_region_size);
+			}
+			if (m_fd >= 0)
+			{
+				close(m_fd);
+			}
+			shm_unlink(m_name.c_str());
+		}
+		shared_region(shared_region const &) = delete;
+		shared_region &operator=(shared_region const &) = delete;
+
+		bool is_open() const
+		{
+			return m_fd >= 0;
+		}
+		std::string const &get_name() const
+		{
+			return m_name;
+		}
+		void *map_view()
+		{
+			auto view = mmap(nullptr, live_counters_region_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+			if (view == MAP_FAILED)
+			{
+				return nullptr;
+			}
+			m_views.push_back(view);
+			return view;
+		}
+
+	private:
+		std::string m_name;
+		int m_fd = -1;
+		std::vector<void *> m_views;
+	};
+
+	std::string make_region_name(std::string_view test)
+	{
+		return "/xaml_island_tests." + std::string(test) + "." + std::to_string(getpid());
+	}
+
+	//Zeroed and aligned like a new mapping.
+	struct local_region
+	{
+		std::unique_ptr<std::byte[]> memory{ new (std::align_val_t{ live_counters_cache_line }) std::byte[live_counters_region_size]() };
+
+		local_region()
+		{
+			initialise_live_counters(memory.get(), 1234);
+		}
+		~local_region()
+		{
+			::operator delete[](memory.release(), std::align_val_t{ live_counters_cache_line });
+		}
+		void *get()
+		{
+			return memory.get();
+		}
+		live_counters_header &header()
+		{
+			return *reinterpret_cast<live_counters_header *>(memory.get());
+		}
+		live_counters_snapshot read()
+		{
+			live_counters_snapshot snapshot{};
+			EXPECT_EQ(read_live_counters(memory.get(), live_counters_region_size, snapshot), live_counters_read_result::ok);
+			return snapshot;
+		}
+	};
+}
+
+TEST(live_counters, reads_a_new_region)
+{
+	local_region region;
+	const auto snapshot = region.read();
+	EXPECT_EQ(snapshot.version, live_counters_version);
+	EXPECT_EQ(snapshot.process_id, 1234u);
+	EXPECT_EQ(snapshot.slots_in_use, 0u);
+	for (auto value : snapshot.values)
+	{
+		EXPECT_EQ(value, 0u);
+	}
+}
+
+TEST(live_counters, rejects_regions_it_cannot_read)
+{
+	live_counters_snapshot snapshot{};
+	{
+		local_region region;
+		EXPECT_EQ(read_live_counters(region.get(), sizeof(live_counters_header) - 1, snapshot), live_counters_read_result::too_small);
+		EXPECT_EQ(read_live_counters(region.get(), live_counters_region_size - 1, snapshot), live_counters_read_result::too_small);
+		region.header().version = live_counters_version + 1;
+		EXPECT_EQ(read_live_counters(region.get(), live_counters_region_size, snapshot), live_counters_read_result::unsupported_version);
+	}
+	{
+		local_region region;
+		region.header().slot_size = sizeof(live_counters_slot) + 8;
+		EXPECT_EQ(read_live_counters(region.get(), live_counters_region_size, snapshot), live_counters_read_result::bad_layout);
+		region.header().slot_size = sizeof(live_counters_slot);
+		region.header().counter_count = live_counter_count - 1;
+		EXPECT_EQ(read_live_counters(region.get(), live_counters_region_size, snapshot), live_counters_read_result::bad_layout);
+	}
+	{
+		local_region region;
+		region.header().magic.store(0);
+		EXPECT_EQ(read_live_counters(region.get(), live_counters_region_size, snapshot), live_counters_read_result::bad_magic);
+	}
+}
+
+TEST(live_counters, threads_get_their_own_slots)
+{
+	local_region region;
+	std::vector<std::unique_ptr<live_counters_writer>> writers;
+	for (uint32_t i = 0; i < live_counters_slot_count; ++i)
+	{
+		writers.push_back(std::make_unique<live_counters_writer>(region.get(), 100 + i));
+		ASSERT_TRUE(writers.back()->has_slot());
+		writers.back()->add(live_counter::pump_iterations, 2);
+		writers.back()->set(live_counter::islands, 1);
+	}
+	live_counters_writer without_slot(region.get(), 999);
+	EXPECT_FALSE(without_slot.has_slot());
+	without_slot.add(live_counter::pump_iterations, 1000);
+
+	auto snapshot = region.read();
+	EXPECT_EQ(snapshot.slots_in_use, live_counters_slot_count);
+	EXPECT_EQ(snapshot.slots_exhausted, 1u);
+	EXPECT_EQ(snapshot.get_total(live_counter::pump_iterations), 2u * live_counters_slot_count);
+	EXPECT_EQ(snapshot.get_gauge(live_counter::islands), static_cast<int64_t>(live_counters_slot_count));
+
+	//A released slot keeps its totals for the next thread to carry on from.
+	writers.pop_back();
+	live_counters_writer next(region.get(), 500);
+	ASSERT_TRUE(next.has_slot());
+	next.add(live_counter::pump_iterations);
+	snapshot = region.read();
+	EXPECT_EQ(snapshot.get_total(live_counter::pump_iterations), 2u * live_counters_slot_count + 1);
+}
+
+TEST(live_counters, gauges_can_go_down_across_threads)
+{
+	local_region region;
+	live_counters_writer ui_thread(region.get(), 1);
+	live_counters_writer pool_thread(region.get(), 2);
+	//Tasks queued on one thread and taken on another.
+	ui_thread.add(live_counter::executor_queue_depth, 5);
+	pool_thread.add(live_counter::executor_queue_depth, -3);
+	EXPECT_EQ(region.read().get_gauge(live_counter::executor_queue_depth), 2);
+	pool_thread.add(live_counter::executor_queue_depth, -4);
+	EXPECT_EQ(region.read().get_gauge(live_counter::executor_queue_depth), -2);
+}
+
+TEST(live_counters, snapshots_are_consistent_through_shared_memory)
+{
+	shared_region shared(make_region_name("consistent"));
+	ASSERT_TRUE(shared.is_open());
+	auto writer_view = shared.map_view();
+	auto reader_view = shared.map_view();
+	ASSERT_TRUE(writer_view && reader_view);
+	ASSERT_NE(writer_view, reader_view);
+	initialise_live_counters(writer_view, static_cast<uint32_t>(getpid()));
+
+	constexpr int writer_count = 4;
+	constexpr int writes = 20000;
+	std::atomic<int> finished = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < writer_count; ++t)
+	{
+		threads.emplace_back([&, t]()
+			{
+				live_counters_writer writer(writer_view, static_cast<uint32_t>(t + 1));
+				for (int i = 0; i < writes; ++i)
+				{
+					//Every iteration dispatches three messages, a reader must never see one without the other.
+					writer.add({ { live_counter::pump_iterations, 1 }, { live_counter::messages_dispatched, 3 }, { live_counter::pump_depth, 1 } });
+					writer.add(live_counter::pump_depth, -1);
+				}
+				finished.fetch_add(1);
+			});
+	}
+
+	uint64_t last_iterations = 0;
+	uint32_t reads = 0;
+	while (finished.load() < writer_count || reads == 0)
+	{
+		live_counters_snapshot snapshot{};
+		ASSERT_EQ(read_live_counters(reader_view, live_counters_region_size, snapshot), live_counters_read_result::ok);
+		++reads;
+		if (snapshot.slots_skipped != 0)
+		{
+			continue;
+		}
+		const auto iterations = snapshot.get_total(live_counter::pump_iterations);
+		EXPECT_EQ(snapshot.get_total(live_counter::messages_dispatched), iterations * 3);
+		EXPECT_GE(snapshot.get_gauge(live_counter::pump_depth), 0);
+		EXPECT_LE(snapshot.get_gauge(live_counter::pump_depth), writer_count);
+		EXPECT_GE(iterations, last_iterations);
+		last_iterations = iterations;
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	live_counters_snapshot snapshot{};
+	ASSERT_EQ(read_live_counters(reader_view, live_counters_region_size, snapshot), live_counters_read_result::ok);
+	EXPECT_EQ(snapshot.get_total(live_counter::pump_iterations), static_cast<uint64_t>(writer_count) * writes);
+	EXPECT_EQ(snapshot.get_gauge(live_counter::pump_depth), 0);
+	EXPECT_EQ(snapshot.slots_in_use, 0u);
+}
+
+TEST(live_counters, another_process_reads_what_was_published)
+{
+	shared_region shared(make_region_name("process"));
+	ASSERT_TRUE(shared.is_open());
+
+	//The child is the application, it opens the region by name and publishes.
+	const auto child = fork();
+	ASSERT_GE(child, 0);
+	if (child == 0)
+	{
+		const auto fd = shm_open(shared.get_name().c_str(), O_RDWR, 0);
+		auto view = fd < 0 ? MAP_FAILED : mmap(nullptr, live_counters_region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			_exit(1);
+		}
+		initialise_live_counters(view, static_cast<uint32_t>(getpid()));
+		{
+			live_counters_writer writer(view, 1);
+			writer.add(live_counter::islands, 3);
+			writer.add(live_counter::focus_navigations, 10);
+		}
+		live_counters_writer still_running(view, 2);
+		still_running.add(live_counter::filter_calls, 7);
+		_exit(0);
+	}
+
+	int status = 0;
+	ASSERT_EQ(waitpid(child, &status, 0), child);
+	ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	auto view = shared.map_view();
+	ASSERT_NE(view, nullptr);
+	live_counters_snapshot snapshot{};
+	ASSERT_EQ(read_live_counters(view, live_counters_region_size, snapshot), live_counters_read_result::ok);
+	EXPECT_EQ(snapshot.process_id, static_cast<uint32_t>(child));
+	EXPECT_EQ(snapshot.get_gauge(live_counter::islands), 3);
+	EXPECT_EQ(snapshot.get_total(live_counter::focus_navigations), 10u);
+	EXPECT_EQ(snapshot.get_total(live_counter::filter_calls), 7u);
+	//The child exited without releasing its second slot.
+	EXPECT_EQ(snapshot.slots_in_use, 1u);
+}
+
+TEST(live_counters, report_shows_rates_for_totals)
+{
+	local_region region;
+	live_counters_writer writer(region.get(), 1);
+	writer.add(live_counter::pump_iterations, 100);
+	const auto previous = region.read();
+	writer.add(live_counter::pump_iterations, 50);
+	writer.set(live_counter::islands, 4);
+
+	const auto report = format_counter_report(region.read(), &previous, std::chrono::milliseconds(500));
+	EXPECT_NE(report.find("process 1234, 1 threads publishing"), std::string::npos);
+	EXPECT_NE(report.find("pump_iterations"), std::string::npos);
+	EXPECT_NE(report.find("100.0/s"), std::string::npos);
+	EXPECT_EQ(std::count(report.begin(), report.end(), '\n'), static_cast<std::ptrdiff_t>(live_counter_count + 1));
+	EXPECT_EQ(get_read_result_name(live_counters_read_result::bad_magic), "the region isn't a counters region");
+}
\ No newline at end of file
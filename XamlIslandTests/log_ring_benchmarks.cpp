@@ -0,0 +1,107 @@
+#include "benchmark_support.h"
+#include "log_file.h"
+#include "log_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+//What logging costs the thread that logs, from the arguments to the record being in the ring.
+XAML_BENCHMARK(log_ring, encode)
+{
+	const int count = context.pick(1000000, 10000);
+	const std::wstring window_name = L"main_window";
+	context.measure("encode_ns", static_cast<uint64_t>(count), [&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				log_record_builder builder(log_level::info, 12, i);
+				builder.add(window_name);
+				builder.add(i);
+				builder.add(static_cast<uint64_t>(i) * 3);
+				keep_value(builder.get_record().size());
+			}
+		});
+}
+
+//The producer's latency for each write, with a consumer draining the ring on another thread.
+//Each write is timed on its own, so the figures include the cost of reading the clock.
+//The producer logs in bursts, the way the UI thread does while handling a message, so the
+//consumer gets to run even when both threads share a core.
+XAML_BENCHMARK(log_ring, producer_latency)
+{
+	const size_t count = context.pick<size_t>(1000000, 10000);
+	log_ring ring(64 * 1024);
+	std::atomic<bool> producing{ true };
+	std::thread consumer([&]()
+		{
+			while (producing.load(std::memory_order_relaxed))
+			{
+				ring.read_all([](std::span<const std::byte> record) { keep_value(record.size()); });
+			}
+		});
+
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(count);
+	const std::wstring window_name = L"main_window";
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		log_record_builder builder(log_level::info, 12, static_cast<int64_t>(i));
+		builder.add(window_name);
+		builder.add(i);
+		ring.try_write(builder.get_record());
+		latencies.push_back(std::chrono::steady_clock::now() - start);
+		if (i % 64 == 63)
+		{
+			std::this_thread::yield();
+		}
+	}
+	producing = false;
+	consumer.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	const auto percentile = [&latencies](double fraction) { return static_cast<double>(latencies[static_cast<size_t>(fraction * static_cast<double>(latencies.size() - 1))].count()); };
+	context.report("producer_p50_ns", percentile(0.5), "ns");
+	context.report("producer_p99_ns", percentile(0.99), "ns");
+	context.report("producer_p999_ns", percentile(0.999), "ns");
+	context.report("dropped", static_cast<double>(ring.get_dropped_count()), "count");
+}
+
+//The writer's side: decoding, formatting and writing each record to the file.
+XAML_BENCHMARK(log_ring, writer)
+{
+	const size_t count = context.pick<size_t>(200000, 5000);
+	log_ring ring(1 << 20);
+	const auto path = std::filesystem::temp_directory_path() / "log_ring_benchmark" / "island.log";
+	rotating_log_file file(path, 64 * 1024 * 1024, 1);
+	decoded_log_record decoded;
+	format_buffer buffer;
+
+	context.measure("decode_format_write_ns", count, [&]()
+		{
+			size_t remaining = count;
+			while (remaining != 0)
+			{
+				for (; remaining != 0; --remaining)
+				{
+					log_record_builder builder(log_level::info, 3, static_cast<int64_t>(remaining));
+					builder.add(L"main_window");
+					builder.add(remaining);
+					if (!ring.try_write(builder.get_record()))
+					{
+						break;
+					}
+				}
+				ring.read_all([&](std::span<const std::byte> record)
+					{
+						decode_log_record(record, decoded);
+						file.write_line(buffer.format_arguments(L"Window {} has {} children", decoded.arguments));
+					});
+			}
+			file.flush();
+		});
+	file.close();
+	std::filesystem::remove_all(path.parent_path());
+}
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "log_file.h"
+#include "log_ring.h"
+#include "logging.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+namespace
+{
+	std::vector<std::byte> make_record(uint64_t sequence, size_t text_length)
+	{
+		log_record_builder builder(log_level::info, 7, static_cast<int64_t>(sequence));
+		builder.add(sequence);
+		builder.add(std::string(text_length, 'x'));
+		const auto record = builder.get_record();
+		return std::vector<std::byte>(record.begin(), record.end());
+	}
+
+	std::wstring format_record(std::span<const std::byte> record, std::wstring_view pattern)
+	{
+		decoded_log_record decoded;
+		if (!decode_log_record(record, decoded))
+		{
+			return L"<malformed>";
+		}
+		format_buffer buffer;
+		return std::wstring(buffer.format_arguments(pattern, decoded.arguments));
+	}
+
+	std::string read_text(std::filesystem::path const &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::ostringstream content;
+		content << file.rdbuf();
+		return content.str();
+	}
+
+	//A line from a log_system file, "2024-01-31 13:45:02.123456 [info] [1] The message."
+	struct log_line
+	{
+		std::string time;
+		uint32_t thread_number = 0;
+		std::string text;
+	};
+
+	std::vector<log_line> read_log_lines(std::filesystem::path const &path)
+	{
+		std::istringstream content(read_text(path));
+		std::vector<log_line> lines;
+		for (std::string line; std::getline(content, line);)
+		{
+			const auto thread_start = line.find("] [");
+			const auto thread_end = line.find("] ", thread_start + 3);
+			if (thread_start == std::string::npos || thread_end == std::string::npos)
+			{
+				lines.push_back(log_line{ {}, 0, line });
+				continue;
+			}
+			lines.push_back(log_line{ line.substr(0, 26), static_cast<uint32_t>(std::stoul(line.substr(thread_start + 3, thread_end - thread_start - 3))), line.substr(thread_end + 2) });
+		}
+		return lines;
+	}
+
+	//The count from a "Pump ran {} timers" line.
+	uint64_t get_timer_count(log_line const &line)
+	{
+		return std::stoull(line.text.substr("Pump ran "sv.size()));
+	}
+
+	std::filesystem::path make_log_directory(std::string_view name)
+	{
+		const auto directory = std::filesystem::temp_directory_path() / "log_system_tests" / name;
+		std::filesystem::remove_all(directory);
+		return directory;
+	}
+}
+
+TEST(log_record, round_trips_every_kind_of_argument)
+{
+	log_record_builder builder(log_level::warning, 42, 123456789);
+	builder.add(-5);
+	builder.add(uint64_t{ 18446744073709551615u });
+	builder.add(true);
+	builder.add(L"wide");
+	builder.add("narrow");
+	builder.add(log_level::error);
+
+	decoded_log_record decoded;
+	ASSERT_TRUE(decode_log_record(builder.get_record(), decoded));
+	EXPECT_EQ(decoded.header.format_id, 42);
+	EXPECT_EQ(decoded.header.level, log_level::warning);
+	EXPECT_EQ(decoded.header.timestamp, 123456789);
+	EXPECT_EQ(format_record(builder.get_record(), L"{} {} {} {} {} {}"), L"-5 18446744073709551615 1 wide narrow 4");
+}
+
+TEST(log_record, cuts_text_short_to_fit)
+{
+	log_record_builder builder(log_level::info, 1, 0);
+	builder.add(1);
+	builder.add(std::wstring(1000, L'a'));
+	//There is no room left for this one, so it is left out.
+	builder.add(std::wstring(10, L'b'));
+
+	const auto record = builder.get_record();
+	EXPECT_LE(record.size(), max_log_record_size);
+	decoded_log_record decoded;
+	ASSERT_TRUE(decode_log_record(record, decoded));
+	ASSERT_GE(decoded.arguments.size(), 2u);
+	//Everything but the header and the first argument is used, whatever the size of wchar_t.
+	EXPECT_GT(decoded.arguments[1].text.size(), (max_log_record_size - 48) / sizeof(wchar_t));
+	EXPECT_LT(decoded.arguments[1].text.size(), max_log_record_size / sizeof(wchar_t));
+}
+
+TEST(log_record, rejects_malformed_records)
+{
+	const auto record = make_record(1, 20);
+	decoded_log_record decoded;
+	for (size_t size = 0; size < record.size(); ++size)
+	{
+		EXPECT_FALSE(decode_log_record(std::span<const std::byte>(record.data(), size), decoded)) << size;
+	}
+
+	auto bad_kind = record;
+	bad_kind[sizeof(log_record_builder::header)] = std::byte{ 0x7F };
+	EXPECT_FALSE(decode_log_record(bad_kind, decoded));
+}
+
+TEST(log_ring, reads_records_in_order)
+{
+	log_ring ring(256);
+	for (uint64_t i = 0; i < 3; ++i)
+	{
+		ASSERT_TRUE(ring.try_write(make_record(i, 4)));
+	}
+
+	std::vector<std::wstring> lines;
+	EXPECT_EQ(ring.read_all([&lines](std::span<const std::byte> record) { lines.push_back(format_record(record, L"{} {}")); }), 3u);
+	EXPECT_EQ(lines, (std::vector<std::wstring>{ L"0 xxxx", L"1 xxxx", L"2 xxxx" }));
+	EXPECT_EQ(ring.read_all([](std::span<const std::byte>) {}), 0u);
+}
+
+TEST(log_ring, drops_records_when_full)
+{
+	log_ring ring(256);
+	size_t written = 0;
+	while (ring.try_write(make_record(written, 30)))
+	{
+		++written;
+	}
+	EXPECT_GT(written, 0u);
+	EXPECT_EQ(ring.get_dropped_count(), 1u);
+	EXPECT_EQ(ring.get_written_count(), written);
+
+	//Reading makes room again.
+	ring.read_all([](std::span<const std::byte>) {});
+	EXPECT_TRUE(ring.try_write(make_record(0, 30)));
+
+	//A record bigger than the whole ring can never be written.
+	log_ring tiny(64);
+	EXPECT_FALSE(tiny.try_write(make_record(0, 100)));
+}
+
+//Records of every size go round the ring many times, so they keep landing at the end of the
+//buffer and have to be moved to the start.
+TEST(log_ring, wraps_without_splitting_records)
+{
+	log_ring ring(1024);
+	uint64_t next_write = 0;
+	uint64_t next_read = 0;
+	for (int round = 0; round < 2000; ++round)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (ring.try_write(make_record(next_write, (next_write * 37) % 200)))
+			{
+				++next_write;
+			}
+		}
+		ring.read_all([&next_read](std::span<const std::byte> record)
+			{
+				decoded_log_record decoded;
+				ASSERT_TRUE(decode_log_record(record, decoded));
+				ASSERT_EQ(decoded.arguments[0].unsigned_value, next_read);
+				ASSERT_EQ(decoded.arguments[1].text.size(), (next_read * 37) % 200);
+				++next_read;
+			});
+	}
+	EXPECT_EQ(next_read, next_write);
+	EXPECT_EQ(ring.get_dropped_count(), 0u);
+}
+
+TEST(log_ring, one_producer_and_one_consumer)
+{
+	constexpr uint64_t record_count = 200000;
+	log_ring ring(4096);
+	std::atomic<bool> producing{ true };
+
+	std::thread producer([&]()
+		{
+			for (uint64_t i = 0; i < record_count; ++i)
+			{
+				while (!ring.try_write(make_record(i, i % 64)))
+				{
+					std::this_thread::yield();
+				}
+			}
+			producing = false;
+		});
+
+	uint64_t expected = 0;
+	bool in_order = true;
+	const auto check = [&](std::span<const std::byte> record)
+		{
+			decoded_log_record decoded;
+			in_order = in_order && decode_log_record(record, decoded) && decoded.arguments[0].unsigned_value == expected && decoded.arguments[1].text.size() == expected % 64;
+			++expected;
+		};
+	while (producing)
+	{
+		ring.read_all(check);
+	}
+	producer.join();
+	ring.read_all(check);
+
+	EXPECT_TRUE(in_order);
+	EXPECT_EQ(expected, record_count);
+	EXPECT_EQ(ring.get_written_count(), record_count);
+}
+
+TEST(log_file, writes_utf8)
+{
+	std::string text;
+	append_utf8(text, L"aé€");
+	EXPECT_EQ(text, "a\xC3\xA9\xE2\x82\xAC");
+
+	text.clear();
+	const wchar_t unpaired[] = { L'a', static_cast<wchar_t>(0xD800), L'b', 0 };
+	append_utf8(text, unpaired);
+	EXPECT_EQ(text, "a\xEF\xBF\xBD" "b");
+}
+
+TEST(log_file, rotates_and_keeps_a_limited_number_of_files)
+{
+	const auto directory = std::filesystem::temp_directory_path() / "log_ring_tests";
+	std::filesystem::remove_all(directory);
+	{
+		rotating_log_file file(directory / "island.log", 100, 2);
+		for (int i = 0; i < 20; ++i)
+		{
+			file.write_line(L"line " + std::to_wstring(i) + L" with some padding");
+		}
+		file.close();
+		EXPECT_GE(file.get_counters().rotations, 3u);
+		EXPECT_EQ(file.get_counters().failures, 0u);
+	}
+
+	EXPECT_TRUE(std::filesystem::exists(directory / "island.log"));
+	EXPECT_TRUE(std::filesystem::exists(directory / "island.1.log"));
+	EXPECT_TRUE(std::filesystem::exists(directory / "island.2.log"));
+	EXPECT_FALSE(std::filesystem::exists(directory / "island.3.log"));
+	EXPECT_NE(read_text(directory / "island.log").find("line 19"), std::string::npos);
+	EXPECT_LE(std::filesystem::file_size(directory / "island.1.log"), 100u);
+	std::filesystem::remove_all(directory);
+}
+
+//Nothing is written until stop, so every thread's records are sorted together in one pass.
+TEST(log_system, interleaves_threads_in_time_order)
+{
+	constexpr uint32_t thread_count = 4;
+	constexpr uint64_t record_count = 2000;
+	const auto directory = make_log_directory("ordering");
+
+	log_system system;
+	system.start(directory, { .file_name = L"ordering.log", .ring_capacity = 256 * 1024, .flush_interval = 1h });
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < thread_count; ++i)
+	{
+		threads.emplace_back([&system]()
+			{
+				for (uint64_t j = 0; j < record_count; ++j)
+				{
+					system.write(log_level::info, log_message::pump_timers_run, j);
+				}
+			});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	system.stop();
+
+	const auto lines = read_log_lines(directory / "ordering.log");
+	ASSERT_EQ(lines.size(), thread_count * record_count + 1);
+	std::map<uint32_t, uint64_t> next_count;
+	for (size_t i = 0; i + 1 < lines.size(); ++i)
+	{
+		if (i != 0)
+		{
+			ASSERT_LE(lines[i - 1].time, lines[i].time) << i;
+		}
+		ASSERT_EQ(get_timer_count(lines[i]), next_count[lines[i].thread_number]++) << i;
+	}
+	EXPECT_EQ(next_count.size(), thread_count);
+	EXPECT_EQ(system.get_statistics().records_dropped, 0u);
+	std::filesystem::remove_all(directory);
+}
+
+//The thread's ring is emptied after it exits, without waiting for stop.
+TEST(log_system, writes_records_left_by_a_thread_that_exited)
+{
+	const auto directory = make_log_directory("exited");
+
+	log_system system;
+	system.start(directory, { .file_name = L"exited.log", .flush_interval = 1ms });
+	std::thread([&system]()
+		{
+			for (uint64_t i = 0; i < 3; ++i)
+			{
+				system.write(log_level::info, log_message::pump_timers_run, i);
+			}
+		}).join();
+
+	const auto deadline = std::chrono::steady_clock::now() + 10s;
+	while (system.get_statistics().records_written < 3 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(1ms);
+	}
+	EXPECT_EQ(system.get_statistics().records_written, 3u);
+	const auto lines = read_log_lines(directory / "exited.log");
+	ASSERT_EQ(lines.size(), 3u);
+	for (uint64_t i = 0; i < 3; ++i)
+	{
+		EXPECT_EQ(get_timer_count(lines[i]), i);
+	}
+	system.stop();
+	std::filesystem::remove_all(directory);
+}
+
+TEST(log_system, counts_records_dropped_by_a_full_ring)
+{
+	constexpr uint64_t record_count = 200;
+	const auto directory = make_log_directory("dropped");
+
+	log_system system;
+	system.start(directory, { .file_name = L"dropped.log", .ring_capacity = 1024, .flush_interval = 1h });
+	for (uint64_t i = 0; i < record_count; ++i)
+	{
+		system.write(log_level::info, log_message::pump_timers_run, i);
+	}
+	system.stop();
+
+	//The summary line is written as well as the records that fitted.
+	const auto statistics = system.get_statistics();
+	EXPECT_GT(statistics.records_dropped, 0u);
+	EXPECT_EQ(statistics.records_written + statistics.records_dropped, record_count + 1);
+	const auto lines = read_log_lines(directory / "dropped.log");
+	ASSERT_EQ(lines.size(), statistics.records_written);
+	const auto expected = "Logging stopped: " + std::to_string(statistics.records_written - 1) + " records written, " + std::to_string(statistics.records_dropped) + " dropped";
+	EXPECT_EQ(lines.back().text.substr(0, expected.size()), expected);
+	std::filesystem::remove_all(directory);
+}
+
+//The summary is the last line and counts everything written before it.
+TEST(log_system, stop_writes_a_summary_of_everything_logged)
+{
+	const auto directory = make_log_directory("summary");
+
+	log_system system;
+	system.start(directory, { .file_name = L"summary.log", .flush_interval = 1h });
+	for (uint64_t i = 0; i < 5; ++i)
+	{
+		system.write(log_level::info, log_message::pump_timers_run, i);
+	}
+	system.stop();
+	EXPECT_FALSE(system.is_running());
+
+	const auto lines = read_log_lines(directory / "summary.log");
+	ASSERT_EQ(lines.size(), 6u);
+	//The bytes are counted up to the start of the summary line.
+	const auto text = read_text(directory / "summary.log");
+	const auto summary_start = text.rfind('\n', text.size() - 2) + 1;
+	EXPECT_EQ(lines.back().thread_number, 0u);
+	EXPECT_EQ(lines.back().text, "Logging stopped: 5 records written, 0 dropped, " + std::to_string(summary_start) + " bytes, 0 rotations");
+	EXPECT_EQ(system.get_statistics().records_written, 6u);
+	std::filesystem::remove_all(directory);
+}
\ No newline at end of file
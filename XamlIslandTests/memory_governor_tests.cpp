@@ -0,0 +1,270 @@
+#include "memory_governor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	//A cache that holds some bytes, and can't go below a floor, such as a pool's controls that are
+	//in use.
+	struct fake_cache
+	{
+		size_t usage = 0;
+		size_t floor = 0;
+		size_t trims = 0;
+
+		memory_consumer make_consumer(std::wstring name, uint32_t priority, size_t budget = 0)
+		{
+			return { std::move(name), priority, budget, [this]() { return usage; }, [this](size_t target)
+				{
+					++trims;
+					usage = std::max(floor, std::min(usage, target));
+				} };
+		}
+	};
+
+	const memory_governor::time_point start = memory_governor::time_point{} + 1h;
+}
+
+TEST(memory_governor, keeps_each_consumer_within_its_budget)
+{
+	memory_governor governor;
+	fake_cache cache{ 3000 };
+	fake_cache unbounded{ 5000 };
+	governor.add_consumer(cache.make_consumer(L"cache", 0, 1000));
+	governor.add_consumer(unbounded.make_consumer(L"unbounded", 0));
+	EXPECT_EQ(governor.get_usage(), 8000u);
+
+	const auto result = governor.update(start);
+	EXPECT_EQ(result.pressure, memory_pressure::none);
+	EXPECT_EQ(result.usage_before, 8000u);
+	EXPECT_EQ(result.usage_after, 6000u);
+	EXPECT_EQ(result.consumers_trimmed, 1u);
+	EXPECT_EQ(cache.usage, 1000u);
+	EXPECT_EQ(unbounded.usage, 5000u);
+	EXPECT_EQ(unbounded.trims, 0u);
+
+	//Nothing is trimmed while everything is within its budget.
+	EXPECT_EQ(governor.update(start).consumers_trimmed, 0u);
+	EXPECT_EQ(governor.get_statistics().budget_trims, 1u);
+}
+
+TEST(memory_governor, the_total_budget_trims_low_priorities_first)
+{
+	memory_governor governor({ .total_budget = 10000 });
+	fake_cache important{ 6000 };
+	fake_cache middle{ 3000 };
+	fake_cache expendable{ 4000 };
+	governor.add_consumer(important.make_consumer(L"important", 5));
+	governor.add_consumer(expendable.make_consumer(L"expendable", 0));
+	governor.add_consumer(middle.make_consumer(L"middle", 2));
+
+	const auto result = governor.update(start);
+	EXPECT_EQ(result.usage_after, 10000u);
+	//Only as much as was needed came from the lowest priority.
+	EXPECT_EQ(expendable.usage, 1000u);
+	EXPECT_EQ(middle.usage, 3000u);
+	EXPECT_EQ(important.usage, 6000u);
+
+	//If the lowest can't give enough, the next one up gives the rest.
+	expendable.floor = 1000;
+	important.usage = 8000;
+	governor.update(start);
+	EXPECT_EQ(expendable.usage, 1000u);
+	EXPECT_EQ(middle.usage, 1000u);
+	EXPECT_EQ(important.usage, 8000u);
+	EXPECT_EQ(governor.get_usage(), 10000u);
+}
+
+TEST(memory_governor, low_pressure_trims_to_a_fraction)
+{
+	memory_governor governor({ .low_pressure_fraction = 0.25 });
+	fake_cache first{ 4000 };
+	fake_cache second{ 4000 };
+	governor.add_consumer(first.make_consumer(L"first", 0));
+	governor.add_consumer(second.make_consumer(L"second", 1));
+
+	governor.signal_pressure(memory_pressure::low);
+	EXPECT_TRUE(governor.has_pending_pressure());
+	const auto result = governor.update(start);
+	EXPECT_FALSE(governor.has_pending_pressure());
+	EXPECT_EQ(result.pressure, memory_pressure::low);
+	EXPECT_EQ(result.usage_after, 2000u);
+	EXPECT_EQ(first.usage, 0u);
+	EXPECT_EQ(second.usage, 2000u);
+	EXPECT_EQ(governor.get_statistics().low_pressure_trims, 1u);
+}
+
+TEST(memory_governor, critical_pressure_frees_everything_it_can)
+{
+	memory_governor governor;
+	fake_cache pool{ 5000, 1500 };
+	fake_cache cache{ 7000 };
+	governor.add_consumer(pool.make_consumer(L"pool", 0));
+	governor.add_consumer(cache.make_consumer(L"cache", 1));
+
+	governor.signal_pressure(memory_pressure::critical);
+	const auto result = governor.update(start);
+	EXPECT_EQ(result.pressure, memory_pressure::critical);
+	EXPECT_EQ(result.consumers_trimmed, 2u);
+	EXPECT_EQ(pool.usage, 1500u);
+	EXPECT_EQ(cache.usage, 0u);
+	EXPECT_EQ(governor.get_statistics().bytes_trimmed, 10500u);
+}
+
+TEST(memory_governor, repeated_pressure_waits_for_the_cooldown)
+{
+	memory_governor governor({ .pressure_cooldown = 5s });
+	fake_cache cache{ 8000 };
+	governor.add_consumer(cache.make_consumer(L"cache", 0));
+
+	governor.signal_pressure(memory_pressure::low);
+	governor.update(start);
+	EXPECT_EQ(cache.usage, 4000u);
+
+	//The cache was rebuilt, but the same pressure so soon is ignored.
+	cache.usage = 8000;
+	governor.signal_pressure(memory_pressure::low);
+	EXPECT_EQ(governor.update(start + 1s).pressure, memory_pressure::none);
+	EXPECT_EQ(cache.usage, 8000u);
+	EXPECT_EQ(governor.get_statistics().pressure_ignored, 1u);
+
+	//Higher pressure isn't held back.
+	governor.signal_pressure(memory_pressure::critical);
+	EXPECT_EQ(governor.update(start + 2s).pressure, memory_pressure::critical);
+	EXPECT_EQ(cache.usage, 0u);
+
+	cache.usage = 8000;
+	governor.signal_pressure(memory_pressure::low);
+	EXPECT_EQ(governor.update(start + 3s).pressure, memory_pressure::none);
+	governor.signal_pressure(memory_pressure::low);
+	EXPECT_EQ(governor.update(start + 8s).pressure, memory_pressure::low);
+	EXPECT_EQ(cache.usage, 4000u);
+}
+
+TEST(memory_governor, pressure_from_other_threads_wakes_the_owner_once)
+{
+	std::atomic<int> wakes = 0;
+	memory_governor governor({}, [&wakes]() { wakes.fetch_add(1); });
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&governor]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					governor.signal_pressure(memory_pressure::low);
+				}
+			});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(wakes.load(), 1);
+
+	//Raising the pressure wakes again, lowering it doesn't.
+	governor.signal_pressure(memory_pressure::critical);
+	governor.signal_pressure(memory_pressure::low);
+	EXPECT_EQ(wakes.load(), 2);
+	EXPECT_EQ(governor.update(start).pressure, memory_pressure::critical);
+	EXPECT_FALSE(governor.has_pending_pressure());
+}
+
+TEST(memory_governor, reports_each_consumer_in_trim_order)
+{
+	memory_governor governor;
+	fake_cache pool{ 2000 };
+	fake_cache cache{ 3000 };
+	governor.add_consumer(cache.make_consumer(L"cache", 3, 1000));
+	const auto pool_id = governor.add_consumer(pool.make_consumer(L"pool", 1));
+	governor.update(start);
+
+	auto report = governor.get_report();
+	ASSERT_EQ(report.size(), 2u);
+	EXPECT_EQ(report[0].name, L"pool");
+	EXPECT_EQ(report[1].name, L"cache");
+	EXPECT_EQ(report[1].usage, 1000u);
+	EXPECT_EQ(report[1].peak_usage, 3000u);
+	EXPECT_EQ(report[1].trims, 1u);
+	EXPECT_EQ(report[1].bytes_trimmed, 2000u);
+
+	governor.remove_consumer(pool_id);
+	EXPECT_EQ(governor.get_usage(), 1000u);
+	EXPECT_EQ(governor.get_report().size(), 1u);
+}
+
+TEST(memory_governor, a_consumer_that_grows_when_trimmed_counts_as_unchanged)
+{
+	memory_governor governor({ .total_budget = 1000 });
+	size_t usage = 5000;
+	governor.add_consumer({ L"odd", 0, 0, [&usage]() { return usage; }, [&usage](size_t) { usage += 100; } });
+	governor.update(start);
+	EXPECT_EQ(governor.get_usage(), 5000u);
+	EXPECT_EQ(governor.get_statistics().bytes_trimmed, 0u);
+}
+
+//Caches that grow at random while the system signals pressure at random. After every update,
+//each consumer is within its budget as far as it can be, and the total is within the total budget.
+TEST(memory_governor, holds_the_budgets_under_simulated_pressure)
+{
+	std::mt19937 random(13);
+	memory_governor governor({ .total_budget = 64 * 1024, .pressure_cooldown = 100ms });
+	std::vector<std::unique_ptr<fake_cache>> caches;
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		auto cache = std::make_unique<fake_cache>();
+		cache->floor = i % 3 == 0 ? 1024 : 0;
+		governor.add_consumer(cache->make_consumer(L"cache" + std::to_wstring(i), i % 3, i % 2 == 0 ? 16 * 1024 : 0));
+		caches.push_back(std::move(cache));
+	}
+
+	auto now = start;
+	for (int step = 0; step < 5000; ++step)
+	{
+		for (auto &cache : caches)
+		{
+			cache->usage += random() % 4096;
+		}
+		const auto roll = random() % 50;
+		const auto pressure = roll == 0 ? memory_pressure::critical : roll < 5 ? memory_pressure::low : memory_pressure::none;
+		if (pressure != memory_pressure::none)
+		{
+			governor.signal_pressure(pressure);
+		}
+		now += 10ms;
+		const auto result = governor.update(now);
+
+		size_t total = 0;
+		for (auto &cache : caches)
+		{
+			total += cache->usage;
+		}
+		ASSERT_EQ(result.usage_after, total);
+		ASSERT_LE(total, 64u * 1024u);
+		for (auto &consumer : governor.get_report())
+		{
+			if (consumer.budget != 0)
+			{
+				ASSERT_LE(consumer.usage, consumer.budget);
+			}
+		}
+		if (result.pressure == memory_pressure::critical)
+		{
+			for (auto &cache : caches)
+			{
+				ASSERT_EQ(cache->usage, cache->floor);
+			}
+		}
+	}
+	const auto &statistics = governor.get_statistics();
+	EXPECT_GT(statistics.critical_pressure_trims, 0u);
+	EXPECT_GT(statistics.low_pressure_trims, 0u);
+	EXPECT_GT(statistics.pressure_ignored, 0u);
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "benchmark_support.h"
+#include "message_trace_writer.h"
+#include "trace_replay.h"
+
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t wm_keydown = 0x0100;
+	constexpr uint32_t wm_mousemove = 0x0200;
+
+	//Mostly mouse moves over a native button, with a tab press now and then.
+	std::vector<message_trace_message> make_messages(size_t count)
+	{
+		std::vector<message_trace_message> messages(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto &msg = messages[i];
+			const bool tab = i % 50 == 0;
+			msg.window = tab ? 0x10010 : 0x10000;
+			msg.message = tab ? wm_keydown : wm_mousemove;
+			msg.wparam = tab ? 0x09 : 0;
+			msg.time = 5000 + static_cast<uint32_t>(i) * 8;
+			msg.x = static_cast<int32_t>(i % 800);
+			msg.y = 300;
+			msg.focus = 0x10010;
+			msg.outcome = static_cast<uint8_t>(tab ? message_trace_outcome::navigated : message_trace_outcome::dispatched);
+			msg.dequeue_time = std::chrono::microseconds(8000 * i);
+			msg.filter_duration = std::chrono::nanoseconds(250 + i % 100);
+			msg.navigate_duration = std::chrono::nanoseconds(150);
+			msg.dispatch_duration = tab ? std::chrono::nanoseconds(0) : std::chrono::microseconds(4);
+		}
+		return messages;
+	}
+}
+
+//The cost that recording adds to each message on the pump's thread.
+XAML_BENCHMARK(message_trace, record)
+{
+	const auto messages = make_messages(context.pick<size_t>(1000000, 10000));
+	uint64_t bytes = 0;
+	context.measure("record_ns_per_message", messages.size(), [&]()
+		{
+			message_trace_writer writer([](std::span<const std::byte>) { return true; }, message_trace_header{});
+			writer.write(message_trace_topology{ 0x10000, { 0x10010, 0x10020 }, { 0x10020 } });
+			for (auto &msg : messages)
+			{
+				writer.write(msg);
+			}
+			writer.close();
+			bytes = writer.get_statistics().bytes_written;
+		});
+	context.report("bytes_per_message", static_cast<double>(bytes) / static_cast<double>(messages.size()), "bytes");
+}
+
+XAML_BENCHMARK(message_trace, replay)
+{
+	const auto messages = make_messages(context.pick<size_t>(100000, 1000));
+	std::vector<std::byte> trace;
+	{
+		message_trace_writer writer([&trace](std::span<const std::byte> bytes)
+			{
+				trace.insert(trace.end(), bytes.begin(), bytes.end());
+				return true;
+			}, message_trace_header{});
+		writer.write(message_trace_topology{ 0x10000, { 0x10010, 0x10020 }, { 0x10020 } });
+		for (auto &msg : messages)
+		{
+			writer.write(msg);
+		}
+	}
+
+	context.measure("replay_ns_per_message", messages.size(), [&]()
+		{
+			keep_value(replay_message_trace(trace).messages);
+		});
+}
\ No newline at end of file
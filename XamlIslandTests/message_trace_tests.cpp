@@ -0,0 +1,467 @@
+#include "message_trace_writer.h"
+#include "trace_replay.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	constexpr uint32_t wm_keydown = 0x0100;
+	constexpr uint32_t wm_char = 0x0102;
+	constexpr uint32_t wm_mousemove = 0x0200;
+	constexpr uint64_t vk_tab = 0x09;
+
+	constexpr uint64_t host = 0x10000;
+	constexpr uint64_t native_button = 0x10010;
+	constexpr uint64_t island = 0x10020;
+	constexpr uint64_t other_button = 0x10030;
+
+	uint8_t outcome(message_trace_outcome value)
+	{
+		return static_cast<uint8_t>(value);
+	}
+
+	message_trace_topology make_topology()
+	{
+		return { host, { native_button, island, other_button }, { island } };
+	}
+
+	message_trace_message make_message(uint32_t message, uint64_t window, uint64_t focus, uint8_t result, uint64_t wparam = 0)
+	{
+		message_trace_message msg{};
+		msg.window = window;
+		msg.message = message;
+		msg.wparam = wparam;
+		msg.focus = focus;
+		msg.outcome = result;
+		msg.filter_duration = 300ns;
+		msg.navigate_duration = result & outcome(message_trace_outcome::filtered) ? 0ns : 200ns;
+		msg.dispatch_duration = result & outcome(message_trace_outcome::dispatched) ? 5us : 0ns;
+		return msg;
+	}
+
+	//A user tabbing from a native button into the island, typing, and tabbing round the window.
+	std::vector<message_trace_message> make_session()
+	{
+		const auto dispatched = outcome(message_trace_outcome::dispatched);
+		std::vector<message_trace_message> session{
+			make_message(wm_mousemove, host, native_button, dispatched),
+			make_message(wm_keydown, native_button, native_button, outcome(message_trace_outcome::navigated), vk_tab),
+			make_message(wm_char, island, island, outcome(message_trace_outcome::filtered), 'a'),
+			//Tab in the island is left to the island.
+			make_message(wm_keydown, island, island, dispatched, vk_tab),
+			make_message(wm_keydown, other_button, other_button, outcome(message_trace_outcome::navigated), vk_tab),
+			make_message(wm_mousemove, native_button, native_button, dispatched),
+		};
+		std::chrono::nanoseconds dequeue{};
+		uint32_t time = 5000;
+		for (auto &msg : session)
+		{
+			dequeue += 1700us;
+			time += 16;
+			msg.dequeue_time = dequeue;
+			msg.time = time;
+			msg.x = 400 + static_cast<int32_t>(time % 7);
+			msg.y = 300 - static_cast<int32_t>(time % 5);
+		}
+		return session;
+	}
+
+	message_trace_message make_random_message(std::mt19937_64 &random, std::chrono::nanoseconds &dequeue)
+	{
+		const uint64_t windows[] = { host, native_button, island, other_button, 0, 0xFFFFFFFFFFFFFFF0 };
+		const uint32_t messages[] = { wm_keydown, wm_char, wm_mousemove, 0x0113, 0xC123 };
+		message_trace_message msg{};
+		msg.window = windows[random() % std::size(windows)];
+		msg.message = messages[random() % std::size(messages)];
+		msg.wparam = random() % 4 == 0 ? random() : random() % 256;
+		msg.lparam = static_cast<int64_t>(random() % 4 == 0 ? random() : random() % 1000) * (random() % 2 == 0 ? 1 : -1);
+		msg.time = static_cast<uint32_t>(random());
+		msg.x = static_cast<int32_t>(random() % 4000) - 2000;
+		msg.y = static_cast<int32_t>(random() % 4000) - 2000;
+		msg.focus = windows[random() % std::size(windows)];
+		msg.modifiers = static_cast<uint8_t>(random() % 8);
+		msg.outcome = static_cast<uint8_t>(random() % 8);
+		//Now and then the caller's clock steps back.
+		dequeue += std::chrono::nanoseconds(static_cast<int64_t>(random() % 100000) - 1000);
+		msg.dequeue_time = dequeue;
+		msg.filter_duration = std::chrono::nanoseconds(random() % 100000);
+		msg.navigate_duration = msg.has_outcome(message_trace_outcome::filtered) ? 0ns : std::chrono::nanoseconds(random() % 100000);
+		msg.dispatch_duration = msg.has_outcome(message_trace_outcome::dispatched) ? std::chrono::nanoseconds(random() % 10000000) : 0ns;
+		return msg;
+	}
+
+	void expect_same(message_trace_message const &a, message_trace_message const &b)
+	{
+		EXPECT_EQ(a.window, b.window);
+		EXPECT_EQ(a.message, b.message);
+		EXPECT_EQ(a.wparam, b.wparam);
+		EXPECT_EQ(a.lparam, b.lparam);
+		EXPECT_EQ(a.time, b.time);
+		EXPECT_EQ(a.x, b.x);
+		EXPECT_EQ(a.y, b.y);
+		EXPECT_EQ(a.focus, b.focus);
+		EXPECT_EQ(a.modifiers, b.modifiers);
+		EXPECT_EQ(a.outcome, b.outcome);
+		EXPECT_EQ(a.dequeue_time, b.dequeue_time);
+		EXPECT_EQ(a.filter_duration, b.filter_duration);
+		EXPECT_EQ(a.navigate_duration, b.navigate_duration);
+		EXPECT_EQ(a.dispatch_duration, b.dispatch_duration);
+	}
+
+	//Reads every message in the trace, returning how the reading stopped.
+	message_trace_read_result read_messages(std::span<const std::byte> data, std::vector<message_trace_message> &messages)
+	{
+		message_trace_reader reader(data);
+		message_trace_header header{};
+		auto result = reader.read_header(header);
+		while (result == message_trace_read_result::ok)
+		{
+			message_trace_entry entry;
+			result = reader.next(entry);
+			if (result == message_trace_read_result::ok && entry.kind == message_trace_record_kind::message)
+			{
+				messages.push_back(entry.message);
+			}
+		}
+		return result;
+	}
+
+	//Records the messages with the writer, into memory.
+	std::vector<std::byte> record_trace(std::span<const message_trace_message> messages, size_t chunk_bytes = 64 * 1024)
+	{
+		std::vector<std::byte> trace;
+		message_trace_header header{};
+		header.start_tick = 5000;
+		message_trace_writer_options options{};
+		options.chunk_bytes = chunk_bytes;
+		message_trace_writer writer([&trace](std::span<const std::byte> bytes)
+			{
+				trace.insert(trace.end(), bytes.begin(), bytes.end());
+				return true;
+			}, header, options);
+		writer.write(make_topology());
+		for (auto &msg : messages)
+		{
+			writer.write(msg);
+		}
+		writer.close();
+		return trace;
+	}
+}
+
+TEST(message_trace, round_trips_through_chunks)
+{
+	std::mt19937_64 random(17);
+	std::chrono::nanoseconds dequeue{};
+	std::vector<message_trace_message> messages;
+	for (int i = 0; i < 5000; ++i)
+	{
+		messages.push_back(make_random_message(random, dequeue));
+	}
+
+	message_trace_header header{};
+	header.start_tick = 0xFFFFFF00;
+	header.start_time = 133000000000000000;
+	message_trace_encoder encoder(header.start_tick);
+	std::vector<std::byte> trace;
+	append_message_trace_header(trace, header);
+	for (size_t i = 0; i < messages.size(); ++i)
+	{
+		if (i % 700 == 0)
+		{
+			if (i != 0)
+			{
+				encoder.end_chunk(trace);
+			}
+			encoder.begin_chunk(trace);
+			encoder.add(trace, make_topology());
+		}
+		encoder.add(trace, messages[i]);
+	}
+	encoder.end_chunk(trace);
+	//An empty chunk leaves nothing behind.
+	const auto size = trace.size();
+	encoder.begin_chunk(trace);
+	EXPECT_FALSE(encoder.end_chunk(trace));
+	EXPECT_EQ(trace.size(), size);
+
+	message_trace_reader reader(trace);
+	message_trace_header read_header{};
+	ASSERT_EQ(reader.read_header(read_header), message_trace_read_result::ok);
+	EXPECT_EQ(read_header.start_tick, header.start_tick);
+	EXPECT_EQ(read_header.start_time, header.start_time);
+
+	size_t index = 0;
+	message_trace_entry entry;
+	message_trace_read_result result;
+	while ((result = reader.next(entry)) == message_trace_read_result::ok)
+	{
+		if (entry.kind == message_trace_record_kind::topology)
+		{
+			EXPECT_EQ(entry.topology.tab_stops, make_topology().tab_stops);
+			EXPECT_EQ(entry.topology.sources, make_topology().sources);
+			continue;
+		}
+		ASSERT_LT(index, messages.size());
+		expect_same(entry.message, messages[index++]);
+	}
+	EXPECT_EQ(result, message_trace_read_result::end);
+	EXPECT_EQ(index, messages.size());
+	EXPECT_EQ(reader.get_chunks_read(), 8u);
+}
+
+TEST(message_trace, similar_messages_are_compact)
+{
+	std::vector<message_trace_message> moves;
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto msg = make_message(wm_mousemove, host, native_button, outcome(message_trace_outcome::dispatched));
+		msg.time = 5000 + static_cast<uint32_t>(i) * 8;
+		msg.x = 100 + i;
+		msg.y = 200;
+		msg.dequeue_time = std::chrono::microseconds(8000 * i);
+		moves.push_back(msg);
+	}
+	const auto trace = record_trace(moves);
+	//A full MSG is 48 bytes on x64, without any of the timings. Here most of the bytes are the
+	//dequeue time and the three durations.
+	EXPECT_LE((trace.size() - message_trace_header_size) / moves.size(), 18u);
+}
+
+TEST(message_trace, a_cut_short_trace_keeps_its_complete_chunks)
+{
+	const auto session = make_session();
+	std::vector<message_trace_message> messages;
+	for (int i = 0; i < 100; ++i)
+	{
+		messages.insert(messages.end(), session.begin(), session.end());
+	}
+	const auto trace = record_trace(messages, 256);
+
+	std::vector<message_trace_message> whole;
+	ASSERT_EQ(read_messages(trace, whole), message_trace_read_result::end);
+	ASSERT_EQ(whole.size(), messages.size());
+
+	for (size_t cut = message_trace_header_size; cut < trace.size(); cut += 37)
+	{
+		std::vector<message_trace_message> partial;
+		const auto result = read_messages(std::span(trace).first(cut), partial);
+		EXPECT_TRUE(result == message_trace_read_result::truncated || result == message_trace_read_result::end) << cut;
+		ASSERT_LE(partial.size(), messages.size());
+		for (size_t i = 0; i < partial.size(); ++i)
+		{
+			expect_same(partial[i], messages[i]);
+		}
+	}
+}
+
+TEST(message_trace, damaged_traces_are_never_read_past)
+{
+	const auto session = make_session();
+	std::vector<message_trace_message> messages;
+	for (int i = 0; i < 20; ++i)
+	{
+		messages.insert(messages.end(), session.begin(), session.end());
+	}
+	const auto valid = record_trace(messages, 200);
+
+	std::mt19937 random(99);
+	for (int iteration = 0; iteration < 5000; ++iteration)
+	{
+		auto trace = valid;
+		for (int i = 0; i < 4; ++i)
+		{
+			//The header is left alone so that the chunks are read.
+			const auto position = std::uniform_int_distribution<size_t>(message_trace_header_size, trace.size() - 1)(random);
+			trace[position] = static_cast<std::byte>(random());
+		}
+		std::vector<message_trace_message> read;
+		EXPECT_NE(read_messages(trace, read), message_trace_read_result::ok);
+		//The replay routes whatever could be read before the damage.
+		EXPECT_EQ(replay_message_trace(trace).messages, read.size());
+	}
+
+	auto bad_magic = valid;
+	bad_magic[0] = std::byte{ 0 };
+	EXPECT_EQ(replay_message_trace(bad_magic).read_result, message_trace_read_result::bad_magic);
+	auto newer = valid;
+	newer[4] = std::byte{ 2 };
+	EXPECT_EQ(replay_message_trace(newer).read_result, message_trace_read_result::unsupported_version);
+}
+
+TEST(message_trace, writer_hands_chunks_over_while_recording)
+{
+	std::mt19937_64 random(5);
+	std::chrono::nanoseconds dequeue{};
+	std::vector<message_trace_message> messages;
+	for (int i = 0; i < 20000; ++i)
+	{
+		messages.push_back(make_random_message(random, dequeue));
+	}
+
+	std::vector<std::byte> trace;
+	size_t writes = 0;
+	message_trace_writer_options options{};
+	options.chunk_bytes = 4096;
+	message_trace_writer writer([&](std::span<const std::byte> bytes)
+		{
+			//A slow disk, so the recording thread has to wait now and then.
+			if (++writes % 8 == 0)
+			{
+				std::this_thread::sleep_for(1ms);
+			}
+			trace.insert(trace.end(), bytes.begin(), bytes.end());
+			return true;
+		}, message_trace_header{}, options);
+	for (auto &msg : messages)
+	{
+		writer.write(msg);
+	}
+	writer.close();
+	writer.write(messages[0]);
+
+	const auto statistics = writer.get_statistics();
+	EXPECT_FALSE(statistics.failed);
+	EXPECT_EQ(statistics.messages, messages.size());
+	EXPECT_EQ(statistics.records_dropped, 1u);
+	EXPECT_EQ(statistics.bytes_written, trace.size());
+	EXPECT_EQ(statistics.chunks, writes);
+	EXPECT_GT(statistics.chunks, 10u);
+
+	std::vector<message_trace_message> read;
+	ASSERT_EQ(read_messages(trace, read), message_trace_read_result::end);
+	ASSERT_EQ(read.size(), messages.size());
+	for (size_t i = 0; i < read.size(); ++i)
+	{
+		expect_same(read[i], messages[i]);
+	}
+}
+
+TEST(message_trace, writer_stops_when_the_sink_fails)
+{
+	std::vector<std::byte> trace;
+	size_t writes = 0;
+	message_trace_writer_options options{};
+	options.chunk_bytes = 256;
+	message_trace_writer writer([&](std::span<const std::byte> bytes)
+		{
+			//The disk fills up after two writes.
+			if (++writes > 2)
+			{
+				return false;
+			}
+			trace.insert(trace.end(), bytes.begin(), bytes.end());
+			return true;
+		}, message_trace_header{}, options);
+
+	const auto session = make_session();
+	for (int i = 0; i < 200; ++i)
+	{
+		writer.write(session[static_cast<size_t>(i) % session.size()]);
+	}
+	writer.close();
+
+	const auto statistics = writer.get_statistics();
+	EXPECT_TRUE(statistics.failed);
+	EXPECT_GT(statistics.records_dropped, 0u);
+	EXPECT_EQ(statistics.chunks, 2u);
+	//What made it to the disk can still be read.
+	std::vector<message_trace_message> read;
+	EXPECT_EQ(read_messages(trace, read), message_trace_read_result::end);
+	EXPECT_FALSE(read.empty());
+}
+
+TEST(message_trace, stale_chunks_are_flushed_without_waiting)
+{
+	std::vector<std::byte> trace;
+	std::mutex trace_mutex;
+	message_trace_writer_options options{};
+	options.max_chunk_age = 100ms;
+	message_trace_writer writer([&](std::span<const std::byte> bytes)
+		{
+			std::lock_guard lock(trace_mutex);
+			trace.insert(trace.end(), bytes.begin(), bytes.end());
+			return true;
+		}, message_trace_header{}, options);
+
+	const auto now = message_trace_writer::clock::now();
+	writer.write(make_session()[0]);
+	writer.flush_stale(now);
+	writer.flush_stale(now + 1s);
+	//The writer thread gets to it on its own time.
+	for (int i = 0; i < 500; ++i)
+	{
+		{
+			std::lock_guard lock(trace_mutex);
+			if (!trace.empty())
+			{
+				break;
+			}
+		}
+		std::this_thread::sleep_for(1ms);
+	}
+
+	std::vector<std::byte> copy;
+	{
+		std::lock_guard lock(trace_mutex);
+		copy = trace;
+	}
+	std::vector<message_trace_message> read;
+	EXPECT_EQ(read_messages(copy, read), message_trace_read_result::end);
+	EXPECT_EQ(read.size(), 1u);
+	writer.close();
+}
+
+TEST(message_trace, replay_follows_the_recorded_routing)
+{
+	const auto session = make_session();
+	const auto trace = record_trace(session);
+
+	trace_replay_options options{};
+	options.repeat = 3;
+	const auto result = replay_message_trace(trace, options);
+	EXPECT_EQ(result.read_result, message_trace_read_result::ok);
+	EXPECT_EQ(result.header.start_tick, 5000u);
+	EXPECT_EQ(result.messages, session.size());
+	EXPECT_EQ(result.topologies, 1u);
+	EXPECT_EQ(result.passes, 3u);
+	EXPECT_EQ(result.filtered, 1u);
+	EXPECT_EQ(result.navigated, 2u);
+	EXPECT_EQ(result.dispatched, 3u);
+	EXPECT_EQ(result.filter_mismatches, 0u);
+	EXPECT_EQ(result.navigate_mismatches, 0u);
+	EXPECT_FALSE(result.first_mismatch.has_value());
+	EXPECT_EQ(result.unknown_hosts, 0u);
+	EXPECT_EQ(result.recorded_dispatch, 15us);
+	EXPECT_EQ(result.recorded_span, 1700us * (session.size() - 1));
+
+	//The same trace always replays the same way.
+	const auto again = replay_message_trace(trace, options);
+	EXPECT_EQ(again.messages, result.messages);
+	EXPECT_EQ(again.navigate_mismatches, result.navigate_mismatches);
+	EXPECT_NE(format_replay_report(result).find("6 messages, 1 topology records in 1 chunks"), std::string::npos);
+}
+
+TEST(message_trace, replay_finds_where_the_routing_differs)
+{
+	auto session = make_session();
+	//Recorded as navigated, but an island had the focus so the routing leaves it to the island.
+	session[3].outcome = outcome(message_trace_outcome::navigated);
+	session.push_back(make_message(wm_mousemove, 0x99999, 0x99999, outcome(message_trace_outcome::dispatched)));
+
+	const auto result = replay_message_trace(record_trace(session));
+	EXPECT_EQ(result.navigate_mismatches, 1u);
+	EXPECT_EQ(result.first_mismatch, 3u);
+	EXPECT_EQ(result.unknown_hosts, 1u);
+	const auto report = format_replay_report(result);
+	EXPECT_NE(report.find("first at message 3"), std::string::npos);
+	EXPECT_NE(report.find("1 messages for windows outside of the recorded topology"), std::string::npos);
+	EXPECT_EQ(get_trace_read_result_name(message_trace_read_result::truncated), "the trace was cut short");
+}
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+
+//Stands in for the application's precompiled header, which pulls in Windows and WinRT.
+//The sources built here only need what the application's header provides from the standard library.
+#include <filesystem>
+#include <memory>
+#include <string>
\ No newline at end of file
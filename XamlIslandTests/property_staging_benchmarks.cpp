@@ -0,0 +1,61 @@
+#include "benchmark_support.h"
+#include "property_staging.h"
+
+#include <vector>
+
+namespace
+{
+	//Counts the writes that reach it, the way a xaml element would take them.
+	struct counting_sink
+	{
+		size_t writes = 0;
+
+		void operator()(int, uint32_t, double value)
+		{
+			++writes;
+			keep_value(value);
+		}
+	};
+}
+
+//A window laying out its elements on every resize step, where most of the sizes don't change.
+XAML_BENCHMARK(property_staging, resize)
+{
+	const int elements = context.pick(1000, 100);
+	const int steps = context.pick(1000, 20);
+	//One element in this many changes width on each step.
+	constexpr int changing_every = 10;
+
+	property_staging<int, double> staging;
+	counting_sink sink;
+	const auto operations = static_cast<uint64_t>(elements) * static_cast<uint64_t>(steps) * 2;
+	context.measure("staged_ns_per_write", operations, [&]()
+		{
+			for (int step = 0; step < steps; ++step)
+			{
+				for (int element = 0; element < elements; ++element)
+				{
+					staging.stage(element, 0, element % changing_every == 0 ? 100.0 + step : 150.0);
+					staging.stage(element, 1, 50.0);
+				}
+				staging.flush(sink);
+			}
+		});
+	//The counters add up over every repetition, so only their ratio is reported.
+	const auto &counters = staging.get_counters();
+	context.report("applied_per_requested", static_cast<double>(counters.writes_applied) / static_cast<double>(counters.writes_requested), "ratio");
+
+	//Each write going straight to the sink.
+	counting_sink direct_sink;
+	context.measure("direct_ns_per_write", operations, [&]()
+		{
+			for (int step = 0; step < steps; ++step)
+			{
+				for (int element = 0; element < elements; ++element)
+				{
+					direct_sink(element, 0, element % changing_every == 0 ? 100.0 + step : 150.0);
+					direct_sink(element, 1, 50.0);
+				}
+			}
+		});
+}
\ No newline at end of file
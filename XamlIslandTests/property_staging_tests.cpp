@@ -0,0 +1,145 @@
+#include "property_staging.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum property : uint32_t
+	{
+		width,
+		height,
+		content
+	};
+
+	struct applied_write
+	{
+		int element = 0;
+		uint32_t property = 0;
+		std::string value;
+
+		bool operator==(applied_write const &) const = default;
+	};
+
+	//Stands in for the xaml elements, it keeps every write that reaches it.
+	struct fake_property_sink
+	{
+		std::vector<applied_write> writes;
+
+		auto function()
+		{
+			return [this](int element, uint32_t property, std::string const &value) { writes.push_back({ element, property, value }); };
+		}
+	};
+}
+
+TEST(property_staging, resizing_to_the_same_size_applies_nothing)
+{
+	property_staging<int, std::string> staging;
+	fake_property_sink sink;
+
+	staging.stage(1, width, "150");
+	staging.stage(1, height, "50");
+	EXPECT_EQ(staging.flush(sink.function()), 2u);
+
+	//Every WM_SIZE sets the same values again.
+	for (int i = 0; i < 100; ++i)
+	{
+		staging.stage(1, width, "150");
+		staging.stage(1, height, "50");
+		EXPECT_EQ(staging.flush(sink.function()), 0u);
+	}
+	EXPECT_EQ(sink.writes.size(), 2u);
+	EXPECT_EQ(staging.get_counters().writes_requested, 202u);
+	EXPECT_EQ(staging.get_counters().writes_applied, 2u);
+	EXPECT_EQ(staging.get_counters().writes_unchanged, 200u);
+	EXPECT_EQ(staging.get_counters().flushes, 1u);
+}
+
+TEST(property_staging, applies_the_last_value_in_first_write_order)
+{
+	property_staging<int, std::string> staging;
+	fake_property_sink sink;
+
+	staging.stage(2, content, "a");
+	staging.stage(1, width, "10");
+	staging.stage(2, content, "b");
+	staging.stage(2, content, "c");
+	EXPECT_EQ(staging.pending_count(), 2u);
+	staging.flush(sink.function());
+
+	const std::vector<applied_write> expected{ { 2, content, "c" }, { 1, width, "10" } };
+	EXPECT_EQ(sink.writes, expected);
+	EXPECT_EQ(staging.get_counters().writes_superseded, 2u);
+	EXPECT_FALSE(staging.has_pending());
+}
+
+TEST(property_staging, a_write_that_is_undone_before_the_flush_is_dropped)
+{
+	property_staging<int, std::string> staging;
+	fake_property_sink sink;
+	staging.stage(1, width, "150");
+	staging.flush(sink.function());
+
+	staging.stage(1, width, "300");
+	staging.stage(1, width, "150");
+	EXPECT_EQ(staging.flush(sink.function()), 0u);
+	EXPECT_EQ(sink.writes.size(), 1u);
+}
+
+TEST(property_staging, writes_staged_by_the_sink_go_into_the_next_flush)
+{
+	property_staging<int, std::string> staging;
+	std::vector<applied_write> writes;
+	staging.stage(1, width, "150");
+	staging.flush([&](int element, uint32_t property, std::string const &value)
+		{
+			writes.push_back({ element, property, value });
+			//Changing the width changes the layout of the content.
+			staging.stage(element, content, "relaid");
+		});
+	EXPECT_EQ(writes.size(), 1u);
+	EXPECT_TRUE(staging.has_pending());
+
+	staging.flush([&](int element, uint32_t property, std::string const &value) { writes.push_back({ element, property, value }); });
+	ASSERT_EQ(writes.size(), 2u);
+	EXPECT_EQ(writes[1].property, content);
+}
+
+TEST(property_staging, a_throwing_sink_leaves_nothing_behind)
+{
+	property_staging<int, std::string> staging;
+	staging.stage(1, width, "150");
+	staging.stage(1, height, "50");
+	EXPECT_THROW(staging.flush([](int, uint32_t, std::string const &) { throw std::runtime_error("gone"); }), std::runtime_error);
+
+	//Nothing was applied, so the same values are written again.
+	fake_property_sink sink;
+	staging.stage(1, width, "150");
+	EXPECT_EQ(staging.flush(sink.function()), 1u);
+}
+
+TEST(property_staging, forgetting_an_element_drops_its_writes)
+{
+	property_staging<int, std::string> staging;
+	fake_property_sink sink;
+	staging.stage(1, width, "150");
+	staging.flush(sink.function());
+
+	staging.stage(1, height, "50");
+	staging.stage(2, width, "20");
+	staging.forget(1);
+	EXPECT_EQ(staging.pending_count(), 1u);
+	staging.flush(sink.function());
+	EXPECT_EQ(sink.writes.back(), (applied_write{ 2, width, "20" }));
+
+	//A new element that reuses the handle starts with nothing applied.
+	staging.stage(1, width, "150");
+	EXPECT_EQ(staging.flush(sink.function()), 1u);
+
+	staging.clear();
+	staging.stage(2, width, "20");
+	EXPECT_EQ(staging.flush(sink.function()), 1u);
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "teardown_coordinator.h"
+#include "virtual_clock.h"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <stdexcept>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	//Something that shuts down, with a queue it can post work to while it is running.
+	struct simulated_component
+	{
+		bool running = true;
+		size_t posts_per_step = 0;
+	};
+
+	//The application's components, wired up with the same ordering as main_application.
+	//The executor keeps posting completions to the message queue until it is stopped, and the
+	//pooled controls can only go once nothing can be delivered to them.
+	struct simulated_application
+	{
+		simulated_component timers;
+		simulated_component executor{ true, 3 };
+		simulated_component pooled_controls;
+		simulated_component xaml_host;
+		std::deque<int> message_queue;
+		std::vector<std::string> problems;
+
+		void post_from_running_components()
+		{
+			for (auto component : { &timers, &executor })
+			{
+				if (component->running)
+				{
+					message_queue.insert(message_queue.end(), component->posts_per_step, 0);
+				}
+			}
+		}
+		void check(bool condition, std::string const &problem)
+		{
+			if (!condition)
+			{
+				problems.push_back(problem);
+			}
+		}
+
+		void add_steps(teardown_coordinator &teardown)
+		{
+			teardown.add_step("cancel_pending_work", [this]() { timers.running = false; });
+			teardown.add_step("stop_background_executor", [this]()
+				{
+					check(!timers.running, "executor stopped while timers could still queue work");
+					executor.running = false;
+				}, { "cancel_pending_work" });
+			teardown.add_step("drain_message_queue", [this]()
+				{
+					check(!executor.running, "drained while the executor could still post");
+					bounded_drain([this]()
+						{
+							if (message_queue.empty())
+							{
+								return false;
+							}
+							message_queue.pop_front();
+							return true;
+						}, {});
+				}, { "cancel_pending_work", "stop_background_executor" });
+			teardown.add_step("destroy_pooled_controls", [this]()
+				{
+					check(message_queue.empty(), "controls destroyed with messages still queued for them");
+					pooled_controls.running = false;
+				}, { "drain_message_queue" });
+			teardown.add_step("release_cached_values", [this]() { check(xaml_host.running, "values released after the xaml host closed"); }, { "drain_message_queue" });
+			teardown.add_step("close_island_application", [this]() { xaml_host.running = false; }, { "release_cached_values" });
+		}
+	};
+
+	teardown_coordinator::step_function record(std::vector<std::string> &log, std::string name)
+	{
+		return [&log, name]() { log.push_back(name); };
+	}
+}
+
+TEST(teardown_coordinator, independent_steps_run_in_the_order_they_were_added)
+{
+	std::vector<std::string> log;
+	teardown_coordinator teardown;
+	teardown.add_step("c", record(log, "c"));
+	teardown.add_step("a", record(log, "a"));
+	teardown.add_step("b", record(log, "b"));
+	teardown.run();
+	EXPECT_EQ(log, (std::vector<std::string>{ "c", "a", "b" }));
+}
+
+TEST(teardown_coordinator, dependencies_come_first)
+{
+	teardown_coordinator teardown;
+	teardown.add_step("close", [] {}, { "release" });
+	teardown.add_step("release", [] {}, { "drain" });
+	teardown.add_step("log", [] {});
+	teardown.add_step("drain", [] {}, { "stop" });
+	teardown.add_step("stop", [] {});
+	EXPECT_EQ(teardown.plan(), (std::vector<std::string>{ "log", "stop", "drain", "release", "close" }));
+}
+
+TEST(teardown_coordinator, rejects_unknown_dependencies_and_cycles)
+{
+	teardown_coordinator unknown;
+	unknown.add_step("a", [] {}, { "missing" });
+	EXPECT_THROW(unknown.plan(), std::logic_error);
+
+	teardown_coordinator cycle;
+	bool ran = false;
+	cycle.add_step("a", [&ran] { ran = true; }, { "c" });
+	cycle.add_step("b", [] {}, { "a" });
+	cycle.add_step("c", [] {}, { "b" });
+	EXPECT_THROW(cycle.run(), std::logic_error);
+	//Nothing runs if the plan can't be made.
+	EXPECT_FALSE(ran);
+}
+
+TEST(teardown_coordinator, a_failing_step_does_not_stop_the_rest)
+{
+	std::vector<std::string> log;
+	teardown_coordinator teardown;
+	teardown.add_step("first", [] { throw std::runtime_error("failed"); });
+	teardown.add_step("second", record(log, "second"), { "first" });
+	const auto timings = teardown.run();
+
+	ASSERT_EQ(timings.size(), 2u);
+	EXPECT_FALSE(timings[0].succeeded);
+	EXPECT_TRUE(timings[1].succeeded);
+	EXPECT_EQ(log, (std::vector<std::string>{ "second" }));
+}
+
+TEST(teardown_coordinator, times_each_step)
+{
+	virtual_clock clock;
+	teardown_coordinator teardown(clock.function());
+	teardown.add_step("quick", [&clock] { clock.advance(2ms); });
+	teardown.add_step("slow", [&clock] { clock.advance(40ms); });
+	const auto timings = teardown.run();
+
+	ASSERT_EQ(timings.size(), 2u);
+	EXPECT_EQ(timings[0].name, "quick");
+	EXPECT_EQ(timings[0].duration, 2ms);
+	EXPECT_EQ(timings[1].duration, 40ms);
+}
+
+TEST(teardown_coordinator, shuts_the_application_down_in_a_safe_order)
+{
+	simulated_application application;
+	teardown_coordinator teardown;
+	application.add_steps(teardown);
+	//Work that is still being posted when shutdown starts.
+	application.post_from_running_components();
+
+	const auto timings = teardown.run();
+	EXPECT_EQ(timings.size(), 6u);
+	EXPECT_TRUE(application.problems.empty()) << application.problems.front();
+	EXPECT_TRUE(application.message_queue.empty());
+	EXPECT_FALSE(application.xaml_host.running);
+}
+
+TEST(bounded_drain, stops_when_the_queue_is_empty)
+{
+	std::deque<int> queue(10);
+	const auto result = bounded_drain([&queue]()
+		{
+			if (queue.empty())
+			{
+				return false;
+			}
+			queue.pop_front();
+			return true;
+		}, {});
+	EXPECT_EQ(result.messages, 10u);
+	EXPECT_FALSE(result.hit_message_limit);
+	EXPECT_FALSE(result.hit_time_limit);
+}
+
+//A message whose handler posts another one never empties the queue, the drain has to give up.
+TEST(bounded_drain, gives_up_on_a_queue_that_refills)
+{
+	bounded_drain_limits limits{};
+	limits.max_messages = 100;
+	const auto result = bounded_drain([] { return true; }, limits);
+	EXPECT_EQ(result.messages, 100u);
+	EXPECT_TRUE(result.hit_message_limit);
+	EXPECT_FALSE(result.hit_time_limit);
+}
+
+TEST(bounded_drain, gives_up_when_messages_are_slow)
+{
+	virtual_clock clock;
+	bounded_drain_limits limits{};
+	limits.max_time = 50ms;
+	const auto result = bounded_drain([&clock]()
+		{
+			clock.advance(20ms);
+			return true;
+		}, limits, clock.function());
+	//Two messages fit in the time, the third starts before the limit and finishes after it.
+	EXPECT_EQ(result.messages, 3u);
+	EXPECT_TRUE(result.hit_time_limit);
+	EXPECT_EQ(result.duration, 60ms);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "benchmark_support.h"
+#include "timer_wheel.h"
+
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+//A million timers spread over an hour, the way a busy host with many islands could have them:
+//scheduling them, cancelling half, and running the pump through the hour in 1ms steps.
+XAML_BENCHMARK(timer_wheel, million_timers)
+{
+	const size_t count = context.pick<size_t>(1000000, 10000);
+	const auto span = context.is_quick() ? std::chrono::milliseconds(10s) : std::chrono::milliseconds(1h);
+	const auto start = timer_wheel::clock::now();
+
+	std::mt19937_64 random(1);
+	std::vector<std::chrono::nanoseconds> offsets(count);
+	for (auto &offset : offsets)
+	{
+		offset = std::chrono::nanoseconds(random() % static_cast<uint64_t>(std::chrono::nanoseconds(span).count()));
+	}
+
+	//Measured once each, a second run would start from a wheel that already has its entries.
+	timer_wheel wheel(start);
+	std::vector<timer_id> ids(count);
+	uint64_t fired = 0;
+	context.report("schedule_ns", [&]()
+		{
+			const auto begin = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < count; ++i)
+			{
+				ids[i] = wheel.schedule(start + offsets[i], [&fired]() { ++fired; });
+			}
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / static_cast<double>(count);
+		}(), "ns");
+	context.report("cancel_ns", [&]()
+		{
+			const auto begin = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < count; i += 2)
+			{
+				wheel.cancel(ids[i]);
+			}
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / static_cast<double>(count / 2);
+		}(), "ns");
+
+	//Every tick, as a pump that is woken each millisecond would.
+	const auto ticks = static_cast<uint64_t>(span / timer_wheel::tick_length);
+	const auto begin = std::chrono::steady_clock::now();
+	for (uint64_t tick = 1; tick <= ticks + 1; ++tick)
+	{
+		wheel.run_due(start + tick * timer_wheel::tick_length);
+	}
+	const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	context.report("run_per_fired_timer_ns", elapsed / static_cast<double>(fired == 0 ? 1 : fired), "ns");
+	context.report("run_per_tick_ns", elapsed / static_cast<double>(ticks), "ns");
+	context.report("fired", static_cast<double>(fired), "count");
+	context.report("cascaded", static_cast<double>(wheel.get_statistics().cascaded), "count");
+}
+
+//Asking for the next deadline after each change, the way the pump sets its waitable timer.
+XAML_BENCHMARK(timer_wheel, next_deadline)
+{
+	const size_t count = context.pick<size_t>(100000, 2000);
+	const auto start = timer_wheel::clock::now();
+	timer_wheel wheel(start);
+	std::mt19937_64 random(2);
+	for (size_t i = 0; i < count; ++i)
+	{
+		wheel.schedule(start + std::chrono::milliseconds(random() % 60000 + 1), []() {});
+	}
+
+	context.measure("schedule_and_next_deadline_ns", count, [&]()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto id = wheel.schedule(start + std::chrono::milliseconds(random() % 60000 + 1), []() {});
+				keep_value(wheel.next_deadline());
+				wheel.cancel(id);
+				keep_value(wheel.next_deadline());
+			}
+		});
+}
\ No newline at end of file
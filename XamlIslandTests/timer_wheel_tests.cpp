@@ -0,0 +1,339 @@
+#include "timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	const timer_wheel::time_point start = timer_wheel::time_point{} + 1h;
+
+	//What a timer is expected to do, kept alongside the wheel.
+	struct expected_timer
+	{
+		uint64_t earliest_tick = 0;
+		uint64_t latest_tick = 0;
+		bool fired = false;
+	};
+
+	uint64_t ticks_after_start(timer_wheel::time_point time)
+	{
+		return static_cast<uint64_t>((time - start) / timer_wheel::tick_length);
+	}
+}
+
+TEST(timer_wheel, fires_once_the_deadline_has_passed)
+{
+	timer_wheel wheel(start);
+	int fired = 0;
+	wheel.schedule(start + 10ms, [&fired]() { ++fired; });
+	EXPECT_EQ(wheel.next_deadline(), start + 10ms);
+
+	EXPECT_EQ(wheel.run_due(start + 9ms), 0u);
+	EXPECT_EQ(fired, 0);
+	EXPECT_EQ(wheel.run_due(start + 10ms), 1u);
+	EXPECT_EQ(fired, 1);
+	EXPECT_TRUE(wheel.empty());
+	EXPECT_EQ(wheel.next_deadline(), timer_wheel::time_point::max());
+}
+
+TEST(timer_wheel, a_deadline_in_the_past_is_due_straight_away)
+{
+	timer_wheel wheel(start);
+	wheel.run_due(start + 50ms);
+	int fired = 0;
+	wheel.schedule(start + 1ms, [&fired]() { ++fired; });
+	EXPECT_EQ(wheel.next_deadline(), start + 50ms);
+	EXPECT_EQ(wheel.run_due(start + 50ms), 1u);
+	EXPECT_EQ(fired, 1);
+}
+
+TEST(timer_wheel, cancelled_timers_dont_fire)
+{
+	timer_wheel wheel(start);
+	int fired = 0;
+	const auto first = wheel.schedule(start + 5ms, [&fired]() { ++fired; });
+	wheel.schedule(start + 500ms, [&fired]() { fired += 10; });
+	EXPECT_TRUE(wheel.cancel(first));
+	EXPECT_FALSE(wheel.cancel(first));
+	EXPECT_FALSE(wheel.cancel(invalid_timer_id));
+	EXPECT_EQ(wheel.next_deadline(), start + 500ms);
+
+	wheel.run_due(start + 1s);
+	EXPECT_EQ(fired, 10);
+	//An id whose timer has fired stays stale when its entry is reused.
+	const auto reused = wheel.schedule(start + 2s, []() {});
+	EXPECT_NE(reused, first);
+	EXPECT_FALSE(wheel.cancel(first));
+	EXPECT_TRUE(wheel.cancel(reused));
+}
+
+TEST(timer_wheel, cancelling_an_owner_removes_all_of_its_timers)
+{
+	timer_wheel wheel(start);
+	int fired = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		wheel.schedule(start + std::chrono::milliseconds(i * 100), [&fired]() { ++fired; }, { .owner = 7 });
+		wheel.schedule(start + std::chrono::milliseconds(i * 100), [&fired]() { fired += 1000; }, { .owner = 8 });
+	}
+	EXPECT_EQ(wheel.cancel_owner(8), 10u);
+	EXPECT_EQ(wheel.cancel_owner(8), 0u);
+	EXPECT_EQ(wheel.cancel_owner(0), 0u);
+	wheel.run_due(start + 2s);
+	EXPECT_EQ(fired, 10);
+}
+
+TEST(timer_wheel, periodic_timers_keep_their_phase_and_skip_missed_periods)
+{
+	timer_wheel wheel(start);
+	std::vector<timer_wheel::time_point> runs;
+	auto now = start;
+	const auto id = wheel.schedule(start + 10ms, [&runs, &now]() { runs.push_back(now); }, { .period = 10ms });
+	for (int i = 1; i <= 5; ++i)
+	{
+		now = start + std::chrono::milliseconds(i * 10);
+		EXPECT_EQ(wheel.run_due(now), 1u);
+	}
+	EXPECT_EQ(runs.size(), 5u);
+
+	//The pump was away until 85ms. The timer fires once for 60ms, the runs for 70ms and 80ms are
+	//skipped and it stays on the 10ms grid.
+	now = start + 85ms;
+	EXPECT_EQ(wheel.run_due(now), 1u);
+	EXPECT_EQ(wheel.next_deadline(), start + 90ms);
+	EXPECT_EQ(wheel.get_statistics().periods_skipped, 2u);
+
+	EXPECT_TRUE(wheel.cancel(id));
+	EXPECT_EQ(wheel.run_due(start + 1s), 0u);
+}
+
+TEST(timer_wheel, callbacks_can_cancel_and_schedule)
+{
+	timer_wheel wheel(start);
+	int periodic_runs = 0;
+	timer_id periodic = invalid_timer_id;
+	periodic = wheel.schedule(start + 1ms, [&]()
+		{
+			//A periodic timer cancelling itself isn't put back.
+			if (++periodic_runs == 3)
+			{
+				EXPECT_TRUE(wheel.cancel(periodic));
+			}
+		}, { .period = 1ms });
+	bool chained = false;
+	wheel.schedule(start + 2ms, [&]() { wheel.schedule(start + 3ms, [&chained]() { chained = true; }); });
+
+	for (int i = 1; i <= 10; ++i)
+	{
+		wheel.run_due(start + std::chrono::milliseconds(i));
+	}
+	EXPECT_EQ(periodic_runs, 3);
+	EXPECT_TRUE(chained);
+	EXPECT_TRUE(wheel.empty());
+}
+
+//A callback that destroys a window cancels that window's timers, some of which can be later in
+//the same batch. They mustn't run.
+TEST(timer_wheel, cancelling_a_timer_later_in_the_batch_stops_it)
+{
+	timer_wheel wheel(start);
+	int a = 0;
+	int b = 0;
+	int c = 0;
+	timer_id second = invalid_timer_id;
+	wheel.schedule(start + 1ms, [&]()
+		{
+			++a;
+			EXPECT_TRUE(wheel.cancel(second));
+			EXPECT_EQ(wheel.cancel_owner(5), 1u);
+		});
+	second = wheel.schedule(start + 1ms, [&b]() { ++b; });
+	wheel.schedule(start + 1ms, [&c]() { ++c; }, { .period = 1ms, .owner = 5 });
+
+	EXPECT_EQ(wheel.run_due(start + 1ms), 1u);
+	EXPECT_EQ(a, 1);
+	EXPECT_EQ(b, 0);
+	EXPECT_EQ(c, 0);
+	//The periodic timer wasn't put back.
+	EXPECT_EQ(wheel.run_due(start + 10ms), 0u);
+	EXPECT_TRUE(wheel.empty());
+	const auto statistics = wheel.get_statistics();
+	EXPECT_EQ(statistics.fired, 1u);
+	EXPECT_EQ(statistics.cancelled, 2u);
+}
+
+TEST(timer_wheel, a_one_shot_timer_that_has_run_cant_be_cancelled)
+{
+	timer_wheel wheel(start);
+	timer_id first = invalid_timer_id;
+	bool cancelled_in_batch = true;
+	first = wheel.schedule(start + 1ms, []() {});
+	wheel.schedule(start + 1ms, [&]() { cancelled_in_batch = wheel.cancel(first); });
+	EXPECT_EQ(wheel.run_due(start + 1ms), 2u);
+	EXPECT_FALSE(cancelled_in_batch);
+	EXPECT_EQ(wheel.get_statistics().cancelled, 0u);
+}
+
+TEST(timer_wheel, a_throwing_callback_leaves_the_wheel_consistent)
+{
+	timer_wheel wheel(start);
+	int periodic_runs = 0;
+	wheel.schedule(start + 1ms, []() { throw std::runtime_error("bad timer"); });
+	wheel.schedule(start + 1ms, [&periodic_runs]() { ++periodic_runs; }, { .period = 5ms });
+	EXPECT_THROW(wheel.run_due(start + 1ms), std::runtime_error);
+
+	//The periodic timer in the same batch didn't run, but it is still scheduled.
+	EXPECT_EQ(wheel.get_statistics().active, 1u);
+	wheel.run_due(start + 6ms);
+	EXPECT_EQ(periodic_runs, 1);
+}
+
+TEST(timer_wheel, tolerances_coalesce_onto_shared_ticks)
+{
+	timer_wheel wheel(start);
+	std::mt19937 random(5);
+	std::map<int64_t, int> ticks_fired;
+	auto now = start;
+	for (int i = 0; i < 200; ++i)
+	{
+		const auto deadline = start + std::chrono::milliseconds(random() % 1000 + 1);
+		wheel.schedule(deadline, [&ticks_fired, &now, deadline]()
+			{
+				ASSERT_GE(now, deadline);
+				ASSERT_LE(now, deadline + 50ms);
+				++ticks_fired[(now - start) / 1ms];
+			}, { .tolerance = 50ms });
+	}
+	for (int i = 1; i <= 1100; ++i)
+	{
+		now = start + std::chrono::milliseconds(i);
+		wheel.run_due(now);
+	}
+
+	size_t fired = 0;
+	for (auto &[tick, count] : ticks_fired)
+	{
+		fired += static_cast<size_t>(count);
+	}
+	EXPECT_EQ(fired, 200u);
+	//Without tolerances the timers would wake the pump on about 180 different ticks.
+	EXPECT_LT(ticks_fired.size(), 40u);
+	EXPECT_GT(wheel.get_statistics().coalesced, 0u);
+}
+
+//Schedules, cancels and runs the wheel at random, over ranges that cover every level and the
+//overflow list, and checks each timer fires once, in its window, in tick order, and that the
+//next deadline is always the earliest timer.
+TEST(timer_wheel, matches_a_simple_model)
+{
+	std::mt19937_64 random(11);
+	timer_wheel wheel(start);
+	std::map<uint64_t, expected_timer> expected;
+	std::vector<timer_id> ids;
+	uint64_t fired = 0;
+	auto now = start;
+
+	const std::array<std::chrono::milliseconds, 6> ranges{ 10ms, 1s, 1min, 2h, 24h * 30, 24h * 365 * 3 };
+	for (int step = 0; step < 20000; ++step)
+	{
+		const auto action = random() % 10;
+		if (action < 6)
+		{
+			const auto range = ranges[random() % ranges.size()];
+			const auto deadline = now + std::chrono::nanoseconds(random() % static_cast<uint64_t>(std::chrono::nanoseconds(range).count()));
+			const auto tolerance = random() % 3 == 0 ? std::chrono::milliseconds(random() % 100) : 0ms;
+			const auto key = static_cast<uint64_t>(ids.size());
+			const auto earliest = ticks_after_start(deadline) + ((deadline - start) % timer_wheel::tick_length != 0ns ? 1 : 0);
+			expected[key] = { earliest, std::max(earliest, ticks_after_start(deadline + tolerance)), false };
+			ids.push_back(wheel.schedule(deadline, [&, key]()
+				{
+					auto &timer = expected.at(key);
+					ASSERT_FALSE(timer.fired);
+					ASSERT_GE(ticks_after_start(now), timer.earliest_tick);
+					timer.fired = true;
+					++fired;
+				}, { .tolerance = tolerance }));
+		}
+		else if (action < 8 && !ids.empty())
+		{
+			const auto key = random() % ids.size();
+			auto &timer = expected.at(key);
+			EXPECT_EQ(wheel.cancel(ids[key]), !timer.fired);
+			timer.fired = true;
+		}
+		else
+		{
+			//Mostly small steps, sometimes a long sleep.
+			const auto range = random() % 20 == 0 ? ranges[random() % ranges.size()] : 5ms;
+			now += std::chrono::nanoseconds(random() % static_cast<uint64_t>(std::chrono::nanoseconds(range).count()));
+			wheel.run_due(now);
+			const auto now_tick = ticks_after_start(now);
+			uint64_t earliest = UINT64_MAX;
+			uint64_t latest = UINT64_MAX;
+			for (auto &[key, timer] : expected)
+			{
+				if (!timer.fired)
+				{
+					ASSERT_GT(timer.latest_tick, now_tick) << "a timer in the past didn't fire";
+					earliest = std::min(earliest, timer.earliest_tick);
+					latest = std::min(latest, timer.latest_tick);
+				}
+			}
+			//The next deadline is the tick the first timer fires on, which is in its window.
+			if (earliest == UINT64_MAX)
+			{
+				ASSERT_EQ(wheel.next_deadline(), timer_wheel::time_point::max());
+			}
+			else
+			{
+				ASSERT_GE(wheel.next_deadline(), start + earliest * timer_wheel::tick_length);
+				ASSERT_LE(wheel.next_deadline(), start + latest * timer_wheel::tick_length);
+			}
+		}
+	}
+	EXPECT_GT(fired, 1000u);
+	EXPECT_GT(wheel.get_statistics().cascaded, 0u);
+}
+
+TEST(timer_wheel, can_be_scheduled_from_other_threads)
+{
+	timer_wheel wheel(start);
+	std::atomic<int> fired = 0;
+	std::atomic<int> cancelled = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&wheel, &fired, &cancelled, t]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					const auto id = wheel.schedule(start + std::chrono::milliseconds(i % 50 + 1), [&fired]() { fired.fetch_add(1); }, { .owner = static_cast<uint64_t>(t + 1) });
+					//The pump may have fired it already.
+					if (i % 4 == 0 && wheel.cancel(id))
+					{
+						cancelled.fetch_add(1);
+					}
+				}
+			});
+	}
+	for (int i = 1; i <= 60; ++i)
+	{
+		wheel.run_due(start + std::chrono::milliseconds(i));
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	wheel.run_due(start + 100ms);
+	EXPECT_EQ(fired.load() + cancelled.load(), 4000);
+	EXPECT_EQ(wheel.get_statistics().cancelled, static_cast<uint64_t>(cancelled.load()));
+	EXPECT_TRUE(wheel.empty());
+}
\ No newline at end of file
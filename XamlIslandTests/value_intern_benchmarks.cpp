@@ -0,0 +1,81 @@
+#include "benchmark_support.h"
+#include "value_intern.h"
+
+#include <memory>
+#include <string>
+
+//The formatter against building the same text with std::wstring, which allocates every time.
+XAML_BENCHMARK(value_intern, format)
+{
+	const int count = context.pick(1000000, 10000);
+	const std::wstring label = L"Progress";
+	format_buffer buffer;
+	context.measure("format_buffer_ns", static_cast<uint64_t>(count), [&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				keep_value(buffer.format(L"{}: {} of {}", label, i, count));
+			}
+		});
+	context.measure("wstring_concatenation_ns", static_cast<uint64_t>(count), [&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				keep_value(label + L": " + std::to_wstring(i) + L" of " + std::to_wstring(count));
+			}
+		});
+	context.report("format_buffer_growths", static_cast<double>(buffer.get_growth_count()), "count");
+}
+
+//Boxing stands in for making a xaml property value.
+XAML_BENCHMARK(value_intern, intern)
+{
+	const int count = context.pick(1000000, 10000);
+	for (const size_t distinct : { size_t{ 16 }, size_t{ 1024 } })
+	{
+		std::vector<std::wstring> keys;
+		for (size_t i = 0; i < distinct; ++i)
+		{
+			keys.push_back(L"Item text " + std::to_wstring(i));
+		}
+
+		intern_table<std::shared_ptr<std::wstring>> table(distinct, [](std::wstring_view text) { return std::make_shared<std::wstring>(text); });
+		context.measure("intern_hit_ns_" + std::to_string(distinct), static_cast<uint64_t>(count), [&]()
+			{
+				for (int i = 0; i < count; ++i)
+				{
+					keep_value(table.intern(keys[static_cast<size_t>(i) % distinct]).get());
+				}
+			});
+
+		//Half as many entries as keys, cycling through them, so every lookup evicts.
+		intern_table<std::shared_ptr<std::wstring>> small_table(distinct / 2, [](std::wstring_view text) { return std::make_shared<std::wstring>(text); });
+		context.measure("intern_evicting_ns_" + std::to_string(distinct), static_cast<uint64_t>(count), [&]()
+			{
+				for (int i = 0; i < count; ++i)
+				{
+					keep_value(small_table.intern(keys[static_cast<size_t>(i) % distinct]).get());
+				}
+			});
+	}
+}
+
+XAML_BENCHMARK(value_intern, small_integers)
+{
+	const int count = context.pick(1000000, 10000);
+	small_integer_cache<std::shared_ptr<int32_t>> cache(-128, 1023, [](int32_t value) { return std::make_shared<int32_t>(value); });
+	context.measure("cached_integer_ns", static_cast<uint64_t>(count), [&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				keep_value(cache.find_or_create(i % 1024)->get());
+			}
+		});
+	context.measure("boxed_integer_ns", static_cast<uint64_t>(count), [&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				keep_value(std::make_shared<int32_t>(i % 1024).get());
+			}
+		});
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "value_intern.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+using namespace std::string_view_literals;
+
+TEST(format_buffer, formats_each_kind_of_argument)
+{
+	format_buffer buffer;
+	const std::wstring name = L"island";
+	EXPECT_EQ(buffer.format(L"{} {} {} {} {}", name, -42, 7u, L'x', true), L"island -42 7 x true"sv);
+	EXPECT_EQ(buffer.format(L"{}", std::numeric_limits<int64_t>::min()), L"-9223372036854775808"sv);
+	EXPECT_EQ(buffer.format(L"{}", std::numeric_limits<uint64_t>::max()), L"18446744073709551615"sv);
+	EXPECT_EQ(buffer.format(L"{}", 0), L"0"sv);
+	EXPECT_EQ(buffer.format(L"{{{}}}", 5), L"{5}"sv);
+	EXPECT_EQ(buffer.format(L"no arguments"), L"no arguments"sv);
+}
+
+TEST(format_buffer, rejects_patterns_that_do_not_match)
+{
+	format_buffer buffer;
+	EXPECT_THROW(buffer.format(L"{} {}", 1), std::invalid_argument);
+	EXPECT_THROW(buffer.format(L"{}", 1, 2), std::invalid_argument);
+	EXPECT_THROW(buffer.format(L"{ }", 1), std::invalid_argument);
+	EXPECT_THROW(buffer.format(L"}"), std::invalid_argument);
+}
+
+TEST(format_buffer, stops_growing_once_warmed_up)
+{
+	format_buffer buffer(4);
+	const std::wstring long_text(300, L'a');
+	buffer.format(L"{}", long_text);
+	const auto growths = buffer.get_growth_count();
+	EXPECT_EQ(growths, 1u);
+
+	for (int i = 0; i < 100; ++i)
+	{
+		buffer.format(L"{} {}", i, long_text.substr(0, static_cast<size_t>(i)));
+	}
+	EXPECT_EQ(buffer.get_growth_count(), growths);
+	EXPECT_EQ(buffer.get_format_count(), 101u);
+}
+
+TEST(intern_table, makes_each_value_once)
+{
+	size_t made = 0;
+	intern_table<std::wstring> table(8, [&made](std::wstring_view text)
+		{
+			++made;
+			return L"<" + std::wstring(text) + L">";
+		});
+
+	EXPECT_EQ(table.intern(L"a"), L"<a>");
+	EXPECT_EQ(table.intern(L"b"), L"<b>");
+	EXPECT_EQ(table.intern(L"a"), L"<a>");
+	EXPECT_EQ(made, 2u);
+	EXPECT_EQ(table.get_counters().hits, 1u);
+	EXPECT_EQ(table.get_counters().misses, 2u);
+	EXPECT_EQ(table.get_text_bytes(), 2 * sizeof(wchar_t));
+}
+
+TEST(intern_table, evicts_the_least_recently_used)
+{
+	intern_table<int> table(3, [](std::wstring_view text) { return static_cast<int>(text.size()); });
+	table.intern(L"one");
+	table.intern(L"two");
+	table.intern(L"three");
+	//Using "one" again makes "two" the oldest.
+	table.intern(L"one");
+	table.intern(L"four");
+	EXPECT_EQ(table.size(), 3u);
+	EXPECT_EQ(table.get_counters().evictions, 1u);
+
+	const auto misses = table.get_counters().misses;
+	table.intern(L"one");
+	table.intern(L"three");
+	EXPECT_EQ(table.get_counters().misses, misses);
+	table.intern(L"two");
+	EXPECT_EQ(table.get_counters().misses, misses + 1);
+}
+
+//The evicted node is reused for the new key, which must not leave the index pointing at the old one.
+TEST(intern_table, reused_nodes_are_found_by_their_new_key)
+{
+	intern_table<std::wstring> table(1, [](std::wstring_view text) { return std::wstring(text); });
+	for (int round = 0; round < 3; ++round)
+	{
+		const std::wstring key = L"a key long enough to be allocated on the heap " + std::to_wstring(round);
+		EXPECT_EQ(table.intern(key), key);
+		EXPECT_EQ(table.intern(key), key);
+	}
+	EXPECT_EQ(table.size(), 1u);
+	EXPECT_EQ(table.get_counters().hits, 3u);
+	EXPECT_EQ(table.get_text_bytes(), table.intern(L"a key long enough to be allocated on the heap 2").size() * sizeof(wchar_t));
+}
+
+TEST(intern_table, trim_keeps_the_most_recent)
+{
+	intern_table<int> table(10, [](std::wstring_view) { return 0; });
+	for (auto key : { L"a", L"b", L"c", L"d" })
+	{
+		table.intern(key);
+	}
+	table.trim(2);
+	EXPECT_EQ(table.size(), 2u);
+	EXPECT_EQ(table.get_text_bytes(), 2 * sizeof(wchar_t));
+
+	const auto misses = table.get_counters().misses;
+	table.intern(L"d");
+	table.intern(L"c");
+	EXPECT_EQ(table.get_counters().misses, misses);
+
+	table.clear();
+	EXPECT_EQ(table.size(), 0u);
+	EXPECT_EQ(table.get_text_bytes(), 0u);
+}
+
+TEST(small_integer_cache, caches_values_in_range)
+{
+	size_t made = 0;
+	small_integer_cache<std::shared_ptr<int>> cache(-2, 2, [&made](int32_t value)
+		{
+			++made;
+			return std::make_shared<int>(value);
+		});
+
+	const auto first = cache.find_or_create(-2);
+	ASSERT_NE(first, nullptr);
+	EXPECT_EQ(**first, -2);
+	EXPECT_EQ(cache.find_or_create(-2)->get(), first->get());
+	EXPECT_EQ(cache.find_or_create(3), nullptr);
+	EXPECT_EQ(cache.find_or_create(-3), nullptr);
+	EXPECT_EQ(made, 1u);
+	EXPECT_EQ(cache.get_counters().hits, 1u);
+
+	cache.clear();
+	cache.find_or_create(-2);
+	EXPECT_EQ(made, 2u);
+}
+
+TEST(small_integer_cache, handles_the_extremes_of_the_range)
+{
+	small_integer_cache<int> cache(std::numeric_limits<int32_t>::max() - 1, std::numeric_limits<int32_t>::max(), [](int32_t value) { return value; });
+	EXPECT_NE(cache.find_or_create(std::numeric_limits<int32_t>::max()), nullptr);
+	EXPECT_EQ(cache.find_or_create(std::numeric_limits<int32_t>::min()), nullptr);
+
+	small_integer_cache<int> empty(1, 0, [](int32_t value) { return value; });
+	EXPECT_EQ(empty.find_or_create(0), nullptr);
+}
\ No newline at end of file
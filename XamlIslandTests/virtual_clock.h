@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+
+//A steady_clock that only moves when a test moves it.
+struct virtual_clock
+{
+	using time_point = std::chrono::steady_clock::time_point;
+
+	time_point now = time_point{} + std::chrono::hours(1);
+
+	void advance(std::chrono::nanoseconds duration)
+	{
+		now += duration;
+	}
+	auto function()
+	{
+		return [this]() { return now; };
+	}
+};
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "benchmark_support.h"
+#include "fake_window_manager.h"
+#include "virtual_list.h"
+
+#include <string>
+
+//Scrolling through a long list a few pixels at a time and a page at a time, against the
+//in-memory window manager, so the figures are the list's own cost and the calls it makes.
+XAML_BENCHMARK(virtual_list, scroll)
+{
+	const size_t items = context.pick<size_t>(1000000, 10000);
+	constexpr child_control_class row_class{ L"Static", 0, 0 };
+	fake_window_manager window_manager;
+	child_control_recycler<fake_window_manager, uint32_t> recycler(window_manager);
+	const auto parent = window_manager.add_window();
+	size_t bound = 0;
+	virtual_list_host<fake_window_manager, uint32_t> list(window_manager, recycler, parent, row_class, {}, [&bound](uint32_t handle, size_t index) { bound += handle + index; });
+	list.set_item_count(items);
+	list.set_viewport(400, 720);
+	list.update();
+
+	const auto limit = get_virtual_list_scroll_limit(items, 720, {});
+	for (const auto step : { int64_t{ 7 }, int64_t{ 720 } })
+	{
+		const auto updates = static_cast<uint64_t>(limit / step);
+		const auto calls_before = window_manager.calls.create_control + window_manager.calls.reuse_control;
+		context.measure("update_ns_step_" + std::to_string(step), updates, [&]()
+			{
+				for (uint64_t i = 0; i <= updates; ++i)
+				{
+					list.set_scroll_offset(static_cast<int64_t>(i) * step);
+					keep_value(list.update());
+				}
+			});
+		context.report("acquires_per_update_step_" + std::to_string(step), static_cast<double>(window_manager.calls.create_control + window_manager.calls.reuse_control - calls_before) / static_cast<double>(updates * (context.is_quick() ? 1 : 5)), "count");
+	}
+	keep_value(bound);
+	context.report("controls_created", static_cast<double>(window_manager.calls.create_control), "count");
+}
\ No newline at end of file
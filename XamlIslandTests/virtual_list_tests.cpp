@@ -0,0 +1,217 @@
+#include "fake_window_manager.h"
+#include "virtual_list.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+
+namespace
+{
+	constexpr child_control_class row_class{ L"Static", 0x100, 0 };
+
+	//A list under a parent window, with every bind recorded.
+	//The fixture keeps its own copy of the list's settings, so that tests can work out where the
+	//rows should be.
+	struct list_fixture
+	{
+		fake_window_manager window_manager;
+		child_control_recycler<fake_window_manager, uint32_t> recycler;
+		uint32_t parent = window_manager.add_window();
+		std::unordered_map<uint32_t, size_t> bound;
+		size_t item_count = 0;
+		int height = 0;
+		int64_t scroll_offset = 0;
+		virtual_list_host<fake_window_manager, uint32_t> list{ window_manager, recycler, parent, row_class, {}, [this](uint32_t handle, size_t index) { bound[handle] = index; } };
+
+		list_fixture(size_t items, int width, int viewport_height, size_t max_pooled = 16) : recycler(window_manager, { .max_pooled_per_class = max_pooled })
+		{
+			set_item_count(items);
+			set_viewport(width, viewport_height);
+		}
+		void set_item_count(size_t items)
+		{
+			item_count = items;
+			list.set_item_count(items);
+			scroll_to(scroll_offset);
+		}
+		void set_viewport(int width, int viewport_height)
+		{
+			height = viewport_height;
+			list.set_viewport(width, viewport_height);
+			scroll_to(scroll_offset);
+		}
+		void scroll_to(int64_t offset)
+		{
+			list.set_scroll_offset(offset);
+			scroll_offset = std::clamp<int64_t>(offset, 0, get_virtual_list_scroll_limit(item_count, height, {}));
+		}
+	};
+
+	//Every row in the range has a visible control in the right place, bound to its item, and
+	//every other control is parked in the recycler.
+	void check_consistent(list_fixture &fixture)
+	{
+		const auto range = fixture.list.get_range();
+		for (size_t index = range.first; index < range.last; ++index)
+		{
+			const auto handle = fixture.list.get_row(index);
+			ASSERT_NE(handle, 0u);
+			auto &control = fixture.window_manager.windows.at(handle);
+			ASSERT_TRUE(control.visible);
+			ASSERT_EQ(control.parent, fixture.parent);
+			ASSERT_EQ(fixture.bound.at(handle), index);
+			ASSERT_EQ(fixture.list.find_item(handle), index);
+			ASSERT_EQ(control.rect.y, static_cast<int64_t>(index) * 24 - fixture.scroll_offset);
+		}
+
+		size_t visible = 0;
+		size_t controls = 0;
+		for (auto &[handle, control] : fixture.window_manager.windows)
+		{
+			if (handle == fixture.parent)
+			{
+				continue;
+			}
+			++controls;
+			visible += control.visible ? 1 : 0;
+		}
+		ASSERT_EQ(visible, range.size()) << "a control is in view without a row";
+		ASSERT_EQ(controls, range.size() + fixture.recycler.get_pooled_count()) << "a control was lost";
+	}
+}
+
+TEST(virtual_list, range_covers_the_viewport_and_the_overscan)
+{
+	const virtual_list_layout layout{ 20, 2 };
+	EXPECT_EQ(get_virtual_list_range(1000, 0, 100, layout).first, 0u);
+	EXPECT_EQ(get_virtual_list_range(1000, 0, 100, layout).last, 7u);
+	EXPECT_EQ(get_virtual_list_range(1000, 210, 100, layout).first, 8u);
+	EXPECT_EQ(get_virtual_list_range(1000, 210, 100, layout).last, 18u);
+	EXPECT_EQ(get_virtual_list_range(10, 1000, 100, layout).last, 10u);
+	EXPECT_EQ(get_virtual_list_range(0, 0, 100, layout).size(), 0u);
+	EXPECT_EQ(get_virtual_list_range(10, 0, 0, layout).size(), 0u);
+	EXPECT_EQ(get_virtual_list_scroll_limit(10, 100, layout), 100);
+	EXPECT_EQ(get_virtual_list_scroll_limit(2, 100, layout), 0);
+}
+
+TEST(virtual_list, scrolling_reuses_the_controls)
+{
+	list_fixture fixture(10000, 200, 240);
+	fixture.list.update();
+	check_consistent(fixture);
+	const auto rows = fixture.list.get_range().size();
+	EXPECT_EQ(rows, 12u);
+
+	for (int64_t offset = 0; offset < 10000 * 24; offset += 37)
+	{
+		fixture.scroll_to(offset);
+		fixture.list.update();
+	}
+	check_consistent(fixture);
+	//Only a scroll step's worth of extra controls were ever needed.
+	EXPECT_LE(fixture.window_manager.calls.create_control, rows + 4);
+	EXPECT_GT(fixture.window_manager.calls.reuse_control, 1000u);
+	EXPECT_EQ(fixture.list.get_range().last, 10000u);
+	EXPECT_EQ(fixture.window_manager.windows.at(fixture.list.get_row(9999)).rect.width, 200);
+}
+
+TEST(virtual_list, rows_that_stay_are_only_moved_when_the_list_scrolls)
+{
+	list_fixture fixture(100, 200, 240);
+	fixture.list.update();
+	const auto moves = fixture.window_manager.calls.defer_position + fixture.window_manager.calls.set_position;
+	fixture.list.update();
+	EXPECT_EQ(fixture.window_manager.calls.defer_position + fixture.window_manager.calls.set_position, moves);
+
+	fixture.list.invalidate();
+	fixture.list.update();
+	EXPECT_EQ(fixture.list.get_statistics().rows_rebound, 12u);
+
+	fixture.scroll_to(5);
+	fixture.list.update();
+	EXPECT_GT(fixture.list.get_statistics().rows_moved, 0u);
+	check_consistent(fixture);
+}
+
+//Scrolling up, the first row to come into view can't be created. The rows further down that were
+//in view before are still in the range, but have to go back to the recycler since the range is
+//cut off before them.
+TEST(virtual_list, a_failed_acquire_gives_back_the_rows_it_cuts_off)
+{
+	list_fixture fixture(1000, 200, 240, 0);
+	fixture.scroll_to(24 * 500);
+	fixture.list.update();
+	check_consistent(fixture);
+	EXPECT_EQ(fixture.list.get_range().first, 498u);
+
+	fixture.window_manager.fail_create_control = true;
+	fixture.scroll_to(24 * 490);
+	fixture.list.update();
+	check_consistent(fixture);
+	EXPECT_EQ(fixture.list.get_range().size(), 0u);
+	EXPECT_GT(fixture.recycler.get_statistics().failed, 0u);
+
+	//Once controls can be created again, the whole range comes back.
+	fixture.window_manager.fail_create_control = false;
+	fixture.list.update();
+	check_consistent(fixture);
+	EXPECT_EQ(fixture.list.get_range().first, 488u);
+	EXPECT_EQ(fixture.list.get_range().size(), 14u);
+}
+
+//Scrolling up by five rows releases five, but only three fit in the pool. The first three rows
+//coming into view reuse them, the fourth fails, and everything after it is given back.
+TEST(virtual_list, a_failed_acquire_part_way_keeps_the_rows_before_it)
+{
+	list_fixture fixture(1000, 200, 240, 3);
+	fixture.scroll_to(24 * 500);
+	fixture.list.update();
+
+	fixture.window_manager.fail_create_control = true;
+	fixture.scroll_to(24 * 495);
+	fixture.list.update();
+	check_consistent(fixture);
+	EXPECT_EQ(fixture.list.get_range().first, 493u);
+	EXPECT_EQ(fixture.list.get_range().last, 496u);
+
+	fixture.window_manager.fail_create_control = false;
+	fixture.list.update();
+	check_consistent(fixture);
+	EXPECT_EQ(fixture.list.get_range().last, 507u);
+}
+
+//Scrolls, resizes and changes the item count at random, with creation failing now and then,
+//and checks that no control is ever left in view without a row or lost.
+TEST(virtual_list, stays_consistent_when_creation_fails_at_random)
+{
+	std::mt19937 random(21);
+	list_fixture fixture(5000, 200, 240);
+	for (int step = 0; step < 3000; ++step)
+	{
+		fixture.window_manager.fail_create_control = random() % 4 == 0;
+		switch (random() % 6)
+		{
+		case 0:
+			fixture.set_viewport(200, static_cast<int>(random() % 600));
+			break;
+		case 1:
+			fixture.set_item_count(random() % 5000);
+			break;
+		case 2:
+			fixture.list.invalidate();
+			break;
+		case 3:
+			fixture.scroll_to(static_cast<int64_t>(random() % (5000 * 24)));
+			break;
+		default:
+			fixture.scroll_to(fixture.scroll_offset + static_cast<int64_t>(random() % 200) - 100);
+			break;
+		}
+		fixture.list.update();
+		check_consistent(fixture);
+	}
+	fixture.list.clear();
+	EXPECT_EQ(fixture.list.get_range().size(), 0u);
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "window_state.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+	window_state_snapshot make_snapshot(uint32_t control_count)
+	{
+		window_state_snapshot snapshot{};
+		snapshot.window_rect = { -1200, 40, 800, 600 };
+		snapshot.maximized = true;
+		snapshot.dpi = 144;
+		snapshot.focused_control = control_count / 2;
+		for (uint32_t i = 0; i < control_count; ++i)
+		{
+			snapshot.controls.push_back({ i, { 10, static_cast<int>(i) * 30, 150, 25 }, i % 3 != 0 });
+		}
+		return snapshot;
+	}
+
+	void expect_equal(island_rect const &a, island_rect const &b)
+	{
+		EXPECT_EQ(a.x, b.x);
+		EXPECT_EQ(a.y, b.y);
+		EXPECT_EQ(a.width, b.width);
+		EXPECT_EQ(a.height, b.height);
+	}
+
+	void expect_equal(window_state_snapshot const &a, window_state_snapshot const &b)
+	{
+		expect_equal(a.window_rect, b.window_rect);
+		EXPECT_EQ(a.maximized, b.maximized);
+		EXPECT_EQ(a.dpi, b.dpi);
+		EXPECT_EQ(a.focused_control, b.focused_control);
+		ASSERT_EQ(a.controls.size(), b.controls.size());
+		for (size_t i = 0; i < a.controls.size(); ++i)
+		{
+			EXPECT_EQ(a.controls[i].control_id, b.controls[i].control_id);
+			expect_equal(a.controls[i].rect, b.controls[i].rect);
+			EXPECT_EQ(a.controls[i].visible, b.controls[i].visible);
+		}
+	}
+
+	uint32_t read_u32(std::vector<std::byte> const &data, size_t offset)
+	{
+		uint32_t value = 0;
+		for (size_t i = 0; i < 4; ++i)
+		{
+			value |= static_cast<uint32_t>(data[offset + i]) << (i * 8);
+		}
+		return value;
+	}
+	void write_u32(std::vector<std::byte> &data, size_t offset, uint32_t value)
+	{
+		for (size_t i = 0; i < 4; ++i)
+		{
+			data[offset + i] = static_cast<std::byte>((value >> (i * 8)) & 0xFF);
+		}
+	}
+
+	//Puts the right checksum back after a change, so that the parser looks past it.
+	//The header size is at offset 6 and the checksum at offset 16.
+	void fix_checksum(std::vector<std::byte> &data)
+	{
+		if (data.size() < 20)
+		{
+			return;
+		}
+		const size_t header_size = static_cast<size_t>(data[6]) | (static_cast<size_t>(data[7]) << 8);
+		if (header_size < 20 || header_size > data.size())
+		{
+			return;
+		}
+		uint32_t hash = 0x811C9DC5u;
+		for (size_t i = header_size; i < data.size(); ++i)
+		{
+			hash ^= static_cast<uint32_t>(data[i]);
+			hash *= 0x01000193u;
+		}
+		write_u32(data, 16, hash);
+	}
+
+	//Whatever the input, the parser either fails and leaves the snapshot alone, or gives back a
+	//snapshot that survives another round trip.
+	void check_decode(std::span<const std::byte> data)
+	{
+		const auto untouched = make_snapshot(1);
+		auto snapshot = untouched;
+		if (decode_window_state(data, snapshot) != window_state_result::ok)
+		{
+			expect_equal(snapshot, untouched);
+			return;
+		}
+
+		EXPECT_LE(snapshot.controls.size(), window_state_max_controls);
+		window_state_snapshot again{};
+		ASSERT_EQ(decode_window_state(encode_window_state(snapshot), again), window_state_result::ok);
+		expect_equal(snapshot, again);
+	}
+}
+
+TEST(window_state, round_trips)
+{
+	for (const uint32_t count : { 0u, 1u, 7u, window_state_max_controls })
+	{
+		const auto snapshot = make_snapshot(count);
+		window_state_snapshot decoded{};
+		ASSERT_EQ(decode_window_state(encode_window_state(snapshot), decoded), window_state_result::ok);
+		expect_equal(snapshot, decoded);
+	}
+}
+
+TEST(window_state, rejects_broken_files)
+{
+	const auto data = encode_window_state(make_snapshot(3));
+	window_state_snapshot snapshot{};
+
+	EXPECT_EQ(decode_window_state(std::span(data).first(10), snapshot), window_state_result::too_small);
+	EXPECT_EQ(decode_window_state(std::span(data).first(data.size() - 1), snapshot), window_state_result::bad_size);
+
+	auto bad_magic = data;
+	bad_magic[0] ^= std::byte{ 1 };
+	EXPECT_EQ(decode_window_state(bad_magic, snapshot), window_state_result::bad_magic);
+
+	auto newer = data;
+	newer[4] = std::byte{ 2 };
+	EXPECT_EQ(decode_window_state(newer, snapshot), window_state_result::unsupported_version);
+
+	auto corrupt = data;
+	corrupt.back() ^= std::byte{ 0x80 };
+	EXPECT_EQ(decode_window_state(corrupt, snapshot), window_state_result::bad_checksum);
+
+	auto too_many = data;
+	write_u32(too_many, 12, window_state_max_controls + 1);
+	EXPECT_EQ(decode_window_state(too_many, snapshot), window_state_result::too_many_controls);
+
+	//A huge count must not be trusted to size anything.
+	auto huge = data;
+	write_u32(huge, 12, 0xFFFFFFFF);
+	EXPECT_EQ(decode_window_state(huge, snapshot), window_state_result::too_many_controls);
+}
+
+TEST(window_state, reads_bigger_records_from_a_later_version)
+{
+	const auto snapshot = make_snapshot(2);
+	const auto data = encode_window_state(snapshot);
+	constexpr size_t header_size = 20;
+	constexpr size_t window_size = 28;
+	constexpr size_t control_size = 24;
+	constexpr size_t extra = 8;
+
+	//Every record gets some bytes on the end that this version doesn't know about.
+	std::vector<std::byte> bigger(data.begin(), data.begin() + header_size);
+	bigger.resize(header_size + extra, std::byte{ 0xAB });
+	bigger[6] = static_cast<std::byte>(header_size + extra);
+	bigger[8] = static_cast<std::byte>(window_size + extra);
+	bigger[10] = static_cast<std::byte>(control_size + extra);
+	auto record = data.begin() + header_size;
+	bigger.insert(bigger.end(), record, record + window_size);
+	bigger.resize(bigger.size() + extra, std::byte{ 0xCD });
+	record += window_size;
+	for (size_t i = 0; i < snapshot.controls.size(); ++i, record += control_size)
+	{
+		bigger.insert(bigger.end(), record, record + control_size);
+		bigger.resize(bigger.size() + extra, std::byte{ 0xEF });
+	}
+	fix_checksum(bigger);
+
+	window_state_snapshot decoded{};
+	ASSERT_EQ(decode_window_state(bigger, decoded), window_state_result::ok);
+	expect_equal(snapshot, decoded);
+}
+
+TEST(window_state, survives_every_truncation)
+{
+	const auto data = encode_window_state(make_snapshot(5));
+	for (size_t size = 0; size < data.size(); ++size)
+	{
+		check_decode(std::span(data).first(size));
+	}
+}
+
+TEST(window_state, fuzz_mutated_files)
+{
+	std::mt19937 random(1234);
+	const auto valid = encode_window_state(make_snapshot(6));
+	for (int iteration = 0; iteration < 20000; ++iteration)
+	{
+		auto data = valid;
+		const int mutations = std::uniform_int_distribution<int>(1, 8)(random);
+		for (int i = 0; i < mutations; ++i)
+		{
+			//Earlier mutations may have cut the file down to nothing.
+			if (data.size() < 16)
+			{
+				data.resize(16, static_cast<std::byte>(random()));
+			}
+			switch (std::uniform_int_distribution<int>(0, 4)(random))
+			{
+			case 0:
+				//Flip a bit anywhere.
+				data[std::uniform_int_distribution<size_t>(0, data.size() - 1)(random)] ^= static_cast<std::byte>(1u << std::uniform_int_distribution<int>(0, 7)(random));
+				break;
+			case 1:
+				//Set a byte in the header, where the sizes and the count are.
+				data[std::uniform_int_distribution<size_t>(4, 15)(random)] = static_cast<std::byte>(random());
+				break;
+			case 2:
+				data.resize(std::uniform_int_distribution<size_t>(0, data.size())(random));
+				break;
+			case 3:
+				data.resize(data.size() + std::uniform_int_distribution<size_t>(1, 64)(random), static_cast<std::byte>(random()));
+				break;
+			default:
+				write_u32(data, 12, static_cast<uint32_t>(random()) % (window_state_max_controls + 2));
+				break;
+			}
+		}
+		//Most of the time the checksum is fixed, otherwise nearly everything stops there.
+		if (iteration % 4 != 0)
+		{
+			fix_checksum(data);
+		}
+		check_decode(data);
+		if (::testing::Test::HasFailure())
+		{
+			FAIL() << "iteration " << iteration << ", control count " << (data.size() >= 16 ? read_u32(data, 12) : 0);
+		}
+	}
+}
+
+TEST(window_state, fuzz_random_bytes)
+{
+	std::mt19937 random(5678);
+	for (int iteration = 0; iteration < 5000; ++iteration)
+	{
+		std::vector<std::byte> data(std::uniform_int_distribution<size_t>(0, 256)(random));
+		for (auto &b : data)
+		{
+			b = static_cast<std::byte>(random());
+		}
+		//Random bytes with a real magic and version get further.
+		if (data.size() >= 6 && iteration % 2 == 0)
+		{
+			write_u32(data, 0, window_state_magic);
+			data[4] = static_cast<std::byte>(window_state_version);
+			data[5] = std::byte{ 0 };
+			fix_checksum(data);
+		}
+		check_decode(data);
+	}
+}
\ No newline at end of file
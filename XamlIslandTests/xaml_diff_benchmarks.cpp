@@ -0,0 +1,69 @@
+#include "benchmark_support.h"
+#include "xaml_diff.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+namespace
+{
+	//A panel of rows, each a grid with a few text blocks, about ten thousand elements in all.
+	xaml_element make_panel(size_t rows)
+	{
+		xaml_element panel{ L"StackPanel", {}, { { L"Orientation", L"Vertical" } }, {} };
+		for (size_t i = 0; i < rows; ++i)
+		{
+			xaml_element row{ L"Grid", L"row" + std::to_wstring(i), { { L"Height", L"24" } }, {} };
+			row.children.push_back({ L"TextBlock", {}, { { L"Text", L"Name " + std::to_wstring(i) } }, {} });
+			row.children.push_back({ L"TextBlock", {}, { { L"Text", std::to_wstring(i * 7) } }, {} });
+			row.children.push_back({ L"Button", {}, { { L"Content", L"Open" } }, {} });
+			panel.children.push_back(std::move(row));
+		}
+		return panel;
+	}
+}
+
+XAML_BENCHMARK(xaml_diff, ten_thousand_nodes)
+{
+	const size_t rows = context.pick<size_t>(2500, 100);
+	const auto old_tree = make_panel(rows);
+	context.report("nodes", static_cast<double>(count_xaml_elements(old_tree)), "count");
+
+	context.measure("unchanged_ns", 1, [&]()
+		{
+			keep_value(diff_xaml_trees(old_tree, old_tree).patches.size());
+		});
+
+	//A regenerated panel where one value in a hundred changed.
+	auto updated = old_tree;
+	for (size_t i = 0; i < rows; i += 100)
+	{
+		updated.children[i].children[1].properties[0].value += L"!";
+	}
+	context.measure("one_percent_changed_ns", 1, [&]()
+		{
+			keep_value(diff_xaml_trees(old_tree, updated).patches.size());
+		});
+
+	//Sorted differently, with some rows gone and some new.
+	auto reordered = old_tree;
+	std::shuffle(reordered.children.begin(), reordered.children.end(), std::mt19937(7));
+	reordered.children.resize(rows - rows / 10);
+	for (size_t i = 0; i < rows / 20; ++i)
+	{
+		auto row = reordered.children[i];
+		row.key = L"added" + std::to_wstring(i);
+		reordered.children.push_back(std::move(row));
+	}
+	context.measure("reordered_ns", 1, [&]()
+		{
+			keep_value(diff_xaml_trees(old_tree, reordered).patches.size());
+		});
+	context.report("reordered_moves", static_cast<double>(diff_xaml_trees(old_tree, reordered).statistics.moves), "count");
+
+	//What a full rebuild has to produce before xaml even starts parsing it.
+	context.measure("write_markup_ns", 1, [&]()
+		{
+			keep_value(write_xaml_markup(updated).size());
+		});
+}
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include "xaml_diff.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	//Stands in for the live visual tree that the patches are applied to.
+	struct live_element
+	{
+		std::wstring type;
+		std::wstring key;
+		std::vector<xaml_element_property> properties;
+		std::vector<std::unique_ptr<live_element>> children;
+	};
+
+	std::unique_ptr<live_element> make_live(xaml_element const &element)
+	{
+		auto live = std::make_unique<live_element>();
+		live->type = element.type;
+		live->key = element.key;
+		live->properties = element.properties;
+		for (auto &child : element.children)
+		{
+			live->children.push_back(make_live(child));
+		}
+		return live;
+	}
+
+	void number_nodes(live_element *element, std::vector<live_element *> &nodes)
+	{
+		nodes.push_back(element);
+		for (auto &child : element->children)
+		{
+			number_nodes(child.get(), nodes);
+		}
+	}
+
+	//Applies the patches the way xaml_patch does, to elements found by their position in the old tree.
+	void apply_patches(std::unique_ptr<live_element> &root, std::span<const xaml_patch> patches)
+	{
+		std::vector<live_element *> nodes;
+		number_nodes(root.get(), nodes);
+		for (auto &patch : patches)
+		{
+			if (patch.operation == xaml_patch_operation::replace_root)
+			{
+				root = make_live(*patch.element);
+				return;
+			}
+
+			ASSERT_LT(patch.node, nodes.size());
+			auto &element = *nodes[patch.node];
+			auto &children = element.children;
+			auto property = std::find_if(element.properties.begin(), element.properties.end(), [&patch](xaml_element_property const &p) { return p.name == patch.name; });
+			switch (patch.operation)
+			{
+			case xaml_patch_operation::set_property:
+				if (property == element.properties.end())
+				{
+					element.properties.push_back({ std::wstring(patch.name), std::wstring(patch.value) });
+				}
+				else
+				{
+					property->value = patch.value;
+				}
+				break;
+			case xaml_patch_operation::clear_property:
+				ASSERT_NE(property, element.properties.end());
+				element.properties.erase(property);
+				break;
+			case xaml_patch_operation::insert_child:
+				ASSERT_LE(patch.index, children.size());
+				children.insert(children.begin() + patch.index, make_live(*patch.element));
+				break;
+			case xaml_patch_operation::remove_child:
+				ASSERT_LT(patch.index, children.size());
+				children.erase(children.begin() + patch.index);
+				break;
+			case xaml_patch_operation::move_child:
+			{
+				ASSERT_LT(patch.from, children.size());
+				auto child = std::move(children[patch.from]);
+				children.erase(children.begin() + patch.from);
+				ASSERT_LE(patch.index, children.size());
+				children.insert(children.begin() + patch.index, std::move(child));
+				break;
+			}
+			default:
+				FAIL();
+			}
+		}
+	}
+
+	//Properties are compared without regard to order, the live tree appends new ones.
+	bool same_tree(live_element const &live, xaml_element const &expected)
+	{
+		if (live.type != expected.type || live.properties.size() != expected.properties.size() || live.children.size() != expected.children.size())
+		{
+			return false;
+		}
+		for (auto &property : expected.properties)
+		{
+			auto found = std::find_if(live.properties.begin(), live.properties.end(), [&property](xaml_element_property const &p) { return p.name == property.name; });
+			if (found == live.properties.end() || found->value != property.value)
+			{
+				return false;
+			}
+		}
+		for (size_t i = 0; i < expected.children.size(); ++i)
+		{
+			if (!same_tree(*live.children[i], expected.children[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	xaml_diff_result diff_and_check(xaml_element const &old_tree, xaml_element const &new_tree)
+	{
+		auto result = diff_xaml_trees(old_tree, new_tree);
+		auto live = make_live(old_tree);
+		apply_patches(live, result.patches);
+		EXPECT_TRUE(same_tree(*live, new_tree));
+		return result;
+	}
+
+	xaml_element make_text(std::wstring key, std::wstring text)
+	{
+		return xaml_element{ L"TextBlock", std::move(key), { { L"Text", std::move(text) } }, {} };
+	}
+
+	xaml_element make_list(size_t count)
+	{
+		xaml_element list{ L"StackPanel", {}, { { L"Orientation", L"Vertical" } }, {} };
+		for (size_t i = 0; i < count; ++i)
+		{
+			list.children.push_back(make_text(L"row" + std::to_wstring(i), L"Row " + std::to_wstring(i)));
+		}
+		return list;
+	}
+
+	const std::wstring element_types[] = { L"StackPanel", L"Grid", L"TextBlock", L"Button" };
+
+	xaml_element make_random_tree(std::mt19937 &random, int depth, int &next_key)
+	{
+		xaml_element element{};
+		element.type = element_types[random() % std::size(element_types)];
+		//Some children are keyed and some are matched by type.
+		if (random() % 2 == 0)
+		{
+			element.key = L"k" + std::to_wstring(next_key++);
+		}
+		const auto property_count = random() % 3;
+		for (size_t i = 0; i < property_count; ++i)
+		{
+			element.properties.push_back({ L"P" + std::to_wstring(i), std::to_wstring(random() % 4) });
+		}
+		if (depth > 0)
+		{
+			const auto child_count = random() % 6;
+			for (size_t i = 0; i < child_count; ++i)
+			{
+				element.children.push_back(make_random_tree(random, depth - 1, next_key));
+			}
+		}
+		return element;
+	}
+
+	void mutate_tree(std::mt19937 &random, xaml_element &element, int &next_key)
+	{
+		switch (random() % 8)
+		{
+		case 0:
+			element.properties.push_back({ L"Added", L"1" });
+			break;
+		case 1:
+			if (!element.properties.empty())
+			{
+				element.properties.erase(element.properties.begin());
+			}
+			break;
+		case 2:
+			if (!element.properties.empty())
+			{
+				element.properties.back().value += L"x";
+			}
+			break;
+		case 3:
+			if (!element.children.empty())
+			{
+				element.children.erase(element.children.begin() + static_cast<std::ptrdiff_t>(random() % element.children.size()));
+			}
+			break;
+		case 4:
+			element.children.insert(element.children.begin() + static_cast<std::ptrdiff_t>(random() % (element.children.size() + 1)), make_random_tree(random, 1, next_key));
+			break;
+		case 5:
+			std::shuffle(element.children.begin(), element.children.end(), random);
+			break;
+		case 6:
+			//A keyed child that changes type can't be kept.
+			if (!element.children.empty())
+			{
+				element.children[random() % element.children.size()].type = L"Border";
+			}
+			break;
+		default:
+			break;
+		}
+		for (auto &child : element.children)
+		{
+			if (random() % 3 == 0)
+			{
+				mutate_tree(random, child, next_key);
+			}
+		}
+	}
+}
+
+TEST(xaml_diff, identical_trees_need_no_patches)
+{
+	const auto tree = make_list(50);
+	const auto result = diff_and_check(tree, tree);
+	EXPECT_TRUE(result.patches.empty());
+	EXPECT_EQ(result.statistics.old_nodes, 51u);
+	EXPECT_EQ(result.statistics.matched_nodes, 51u);
+}
+
+TEST(xaml_diff, sets_and_clears_properties)
+{
+	const auto old_tree = make_list(3);
+	auto new_tree = old_tree;
+	new_tree.children[1].properties[0].value = L"Changed";
+	new_tree.children[2].properties.clear();
+	new_tree.properties.push_back({ L"Spacing", L"4" });
+
+	const auto result = diff_and_check(old_tree, new_tree);
+	EXPECT_EQ(result.statistics.property_sets, 2u);
+	EXPECT_EQ(result.statistics.property_clears, 1u);
+	ASSERT_EQ(result.patches.size(), 3u);
+	//The second row is node 2, after the panel and the first row.
+	EXPECT_EQ(result.patches[1].node, 2u);
+}
+
+TEST(xaml_diff, moves_as_few_children_as_it_can)
+{
+	const auto old_tree = make_list(100);
+
+	//One row taken from the end and put at the front is a single move.
+	auto rotated = old_tree;
+	std::rotate(rotated.children.rbegin(), rotated.children.rbegin() + 1, rotated.children.rend());
+	auto result = diff_and_check(old_tree, rotated);
+	EXPECT_EQ(result.statistics.moves, 1u);
+	EXPECT_EQ(result.statistics.inserts + result.statistics.removes, 0u);
+
+	//Reversing keeps one row where it is.
+	auto reversed = old_tree;
+	std::reverse(reversed.children.begin(), reversed.children.end());
+	result = diff_and_check(old_tree, reversed);
+	EXPECT_EQ(result.statistics.moves, 99u);
+}
+
+TEST(xaml_diff, inserts_and_removes_children)
+{
+	const auto old_tree = make_list(10);
+	auto new_tree = old_tree;
+	new_tree.children.erase(new_tree.children.begin() + 3);
+	new_tree.children.insert(new_tree.children.begin() + 7, make_text(L"new", L"New row"));
+	new_tree.children.push_back(xaml_element{ L"Button", {}, {}, { make_text({}, L"Inside") } });
+
+	const auto result = diff_and_check(old_tree, new_tree);
+	EXPECT_EQ(result.statistics.removes, 1u);
+	EXPECT_EQ(result.statistics.inserts, 2u);
+	EXPECT_EQ(result.statistics.moves, 0u);
+}
+
+TEST(xaml_diff, a_different_type_is_replaced)
+{
+	const auto old_tree = make_list(4);
+	auto new_tree = old_tree;
+	new_tree.children[2].type = L"Button";
+	auto result = diff_and_check(old_tree, new_tree);
+	EXPECT_EQ(result.statistics.removes, 1u);
+	EXPECT_EQ(result.statistics.inserts, 1u);
+
+	auto new_root = old_tree;
+	new_root.type = L"Grid";
+	result = diff_and_check(old_tree, new_root);
+	ASSERT_EQ(result.patches.size(), 1u);
+	EXPECT_EQ(result.patches[0].operation, xaml_patch_operation::replace_root);
+}
+
+TEST(xaml_diff, unkeyed_children_are_matched_by_type_in_order)
+{
+	xaml_element old_tree{ L"Grid", {}, {}, { make_text({}, L"a"), xaml_element{ L"Button" }, make_text({}, L"b") } };
+	xaml_element new_tree{ L"Grid", {}, {}, { make_text({}, L"a"), make_text({}, L"c"), xaml_element{ L"Button" } } };
+
+	const auto result = diff_and_check(old_tree, new_tree);
+	//The second text block is kept and given new text, and the button moves after it.
+	EXPECT_EQ(result.statistics.inserts, 0u);
+	EXPECT_EQ(result.statistics.removes, 0u);
+	EXPECT_EQ(result.statistics.moves, 1u);
+	EXPECT_EQ(result.statistics.property_sets, 1u);
+}
+
+TEST(xaml_diff, random_edits_apply_cleanly)
+{
+	std::mt19937 random(42);
+	for (int iteration = 0; iteration < 500; ++iteration)
+	{
+		int next_key = 0;
+		auto old_tree = make_random_tree(random, 4, next_key);
+		old_tree.key.clear();
+		auto new_tree = old_tree;
+		mutate_tree(random, new_tree, next_key);
+		new_tree.type = old_tree.type;
+
+		const auto result = diff_and_check(old_tree, new_tree);
+		EXPECT_EQ(result.statistics.new_nodes, count_xaml_elements(new_tree));
+		if (::testing::Test::HasFailure())
+		{
+			FAIL() << "iteration " << iteration;
+		}
+	}
+}
+
+TEST(xaml_diff, writes_escaped_markup)
+{
+	xaml_element tree{ L"StackPanel", {}, { { L"Tag", L"a<b & \"c\">" } }, { make_text(L"ignored", L"Hello") } };
+	EXPECT_EQ(write_xaml_markup(tree),
+		L"<StackPanel xmlns=\"http://schemas.microsoft.com/winfx/2006/xaml/presentation\" Tag=\"a&lt;b &amp; &quot;c&quot;&gt;\">"
+		L"<TextBlock Text=\"Hello\"/></StackPanel>");
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "coroutine_support.h"
+#include "xaml_text.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//The load pipeline from window_base, with the thread pool and the window's message queue
+//replaced by plain threads and queues.
+
+//A single worker thread standing in for the thread pool.
+class test_thread_pool
+{
+public:
+	test_thread_pool() : m_thread([this]() { run(); })
+	{
+	}
+	~test_thread_pool()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+	void submit(std::function<void()> work)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_work.push_back(std::move(work));
+		}
+		m_wake.notify_all();
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stopping || !m_work.empty(); });
+			if (m_work.empty())
+			{
+				return;
+			}
+			auto work = std::move(m_work.front());
+			m_work.pop_front();
+			lock.unlock();
+			work();
+			lock.lock();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()>> m_work;
+	bool m_stopping = false;
+	std::thread m_thread;
+};
+
+//Like background_awaitable, this throws operation_cancelled if the context was cancelled while
+//the coroutine was waiting for the pool.
+class test_background_awaitable
+{
+public:
+	test_background_awaitable(test_thread_pool &pool, std::shared_ptr<coroutine_context> context) : m_pool(pool), m_context(std::move(context))
+	{
+	}
+
+	bool await_ready() const
+	{
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle) const
+	{
+		m_pool.submit([handle]() { handle.resume(); });
+	}
+	void await_resume() const
+	{
+		if (m_context->is_cancelled())
+		{
+			throw operation_cancelled();
+		}
+	}
+
+private:
+	test_thread_pool &m_pool;
+	std::shared_ptr<coroutine_context> m_context;
+};
+
+//The window, with a message queue that the owning thread empties.
+class test_window
+{
+public:
+	test_window() : m_context(std::make_shared<coroutine_context>(std::this_thread::get_id(), [this](resumption_id id) { return post(id); }, [this](resumption_id id, std::chrono::nanoseconds) { return post(id); }))
+	{
+	}
+	//The same as window_base, destroying the window cancels its coroutines.
+	~test_window()
+	{
+		m_context->cancel();
+	}
+
+	std::shared_ptr<coroutine_context> const &get_coroutine_context() const
+	{
+		return m_context;
+	}
+
+	//Waits for a resumption and runs it. Returns false if nothing arrived in time.
+	bool pump_one(std::chrono::milliseconds timeout = std::chrono::seconds(5))
+	{
+		std::unique_lock lock(m_mutex);
+		if (!m_posted_event.wait_for(lock, timeout, [this]() { return !m_posted.empty(); }))
+		{
+			return false;
+		}
+		const auto id = m_posted.front();
+		m_posted.pop_front();
+		lock.unlock();
+		m_context->resume(id);
+		return true;
+	}
+
+private:
+	bool post(resumption_id id)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_posted.push_back(id);
+		}
+		m_posted_event.notify_all();
+		return true;
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_posted_event;
+	std::deque<resumption_id> m_posted;
+	std::shared_ptr<coroutine_context> m_context;
+};
+
+//Decodes on the pool and hands the text back on the window's thread.
+//As in load_control_async, only the context is used after the first await, since the window can
+//be destroyed while the coroutine is on the pool.
+inline window_task load_xaml_async(test_window &window, test_thread_pool &pool, std::string bytes, std::function<void(std::wstring &&)> on_loaded, std::function<void()> on_background = {})
+{
+	const auto context = window.get_coroutine_context();
+	co_await test_background_awaitable(pool, context);
+	if (on_background)
+	{
+		on_background();
+	}
+	auto text = decode_xaml_text(bytes);
+
+	co_await context_awaitable(context);
+	on_loaded(std::move(text));
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "virtual_clock.h"
+#include "xaml_prewarm.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	//Three runs recorded by the application: the main window's button on every run, a settings
+	//page on two of them and a help file once.
+	constexpr std::string_view recorded_history =
+		"xaml-usage 1\n"
+		"run\n"
+		"120\t4096\tresource\t101\n"
+		"900\t20000\tfile\tC:\\Program Files\\Island\\settings.xaml\n"
+		"run\n"
+		"140\t4096\tresource\t101\n"
+		"2500\t8000\tfile\tC:\\Program Files\\Island\\help.xaml\n"
+		"run\n"
+		"100\t4096\tresource\t101\n"
+		"700\t20000\tfile\tC:\\Program Files\\Island\\settings.xaml\n";
+
+	std::vector<xaml_usage_record> make_run(std::initializer_list<std::pair<uint16_t, int>> loads, size_t text_bytes = 1000)
+	{
+		std::vector<xaml_usage_record> run;
+		for (auto &[id, milliseconds] : loads)
+		{
+			run.push_back({ make_resource_source(id), std::chrono::milliseconds(milliseconds), text_bytes });
+		}
+		return run;
+	}
+}
+
+TEST(xaml_prewarm, records_the_first_load_during_startup)
+{
+	virtual_clock clock;
+	xaml_usage_recorder recorder(10s, clock.function());
+
+	clock.advance(150ms);
+	recorder.record(make_resource_source(101), 4096);
+	clock.advance(50ms);
+	recorder.record(make_resource_source(101), 4096);
+	recorder.record(make_file_source(L"page.xaml"), 300);
+	//A path that would break the history's lines.
+	recorder.record(make_file_source(L"bad\tpath.xaml"), 300);
+	clock.advance(20s);
+	recorder.record(make_resource_source(102), 100);
+
+	const auto records = recorder.get_records();
+	ASSERT_EQ(records.size(), 2u);
+	EXPECT_EQ(records[0].source, make_resource_source(101));
+	EXPECT_EQ(records[0].since_start, 150ms);
+	EXPECT_EQ(records[1].source, make_file_source(L"page.xaml"));
+	EXPECT_EQ(records[1].since_start, 200ms);
+}
+
+TEST(xaml_prewarm, history_round_trips)
+{
+	xaml_usage_history history;
+	append_usage_run(history, make_run({ { 101, 10 }, { 102, 20 } }));
+	history.push_back({ { make_file_source(L"C:\\Users\\J\u00f6rg\\\u30da\u30fc\u30b8.xaml"), 35ms, 77 } });
+
+	xaml_usage_history decoded;
+	ASSERT_TRUE(decode_usage_history(encode_usage_history(history), decoded));
+	ASSERT_EQ(decoded.size(), 2u);
+	ASSERT_EQ(decoded[0].size(), 2u);
+	EXPECT_EQ(decoded[0][1].source, make_resource_source(102));
+	EXPECT_EQ(decoded[0][1].since_start, 20ms);
+	ASSERT_EQ(decoded[1].size(), 1u);
+	EXPECT_EQ(decoded[1][0].source, history[1][0].source);
+	EXPECT_EQ(decoded[1][0].text_bytes, 77u);
+}
+
+TEST(xaml_prewarm, only_the_newest_runs_are_kept)
+{
+	xaml_usage_history history;
+	for (uint16_t i = 0; i < max_usage_history_runs + 3; ++i)
+	{
+		append_usage_run(history, make_run({ { i, 10 } }));
+	}
+	ASSERT_EQ(history.size(), max_usage_history_runs);
+	EXPECT_EQ(history.front()[0].source, make_resource_source(3));
+
+	//A history that was put together by hand is cut down when it is written.
+	history.push_back(make_run({ { 500, 10 } }));
+	xaml_usage_history decoded;
+	ASSERT_TRUE(decode_usage_history(encode_usage_history(history), decoded));
+	ASSERT_EQ(decoded.size(), max_usage_history_runs);
+	EXPECT_EQ(decoded.back()[0].source, make_resource_source(500));
+}
+
+TEST(xaml_prewarm, bad_lines_are_skipped)
+{
+	xaml_usage_history history;
+	EXPECT_FALSE(decode_usage_history("not a history\nrun\n", history));
+	EXPECT_FALSE(decode_usage_history("", history));
+
+	const std::string_view text =
+		"xaml-usage 1\r\n"
+		"10\t5\tresource\t1\r\n"
+		"run\r\n"
+		"10\t5\tresource\t1\r\n"
+		"-5\t5\tresource\t2\n"
+		"10\t5\tresource\t70000\n"
+		"10\t5\twidget\t3\n"
+		"10\t5\tfile\t\n"
+		"10x\t5\tresource\t4\n"
+		"\n"
+		"20\t6\tresource\t5";
+	ASSERT_TRUE(decode_usage_history(text, history));
+	ASSERT_EQ(history.size(), 1u);
+	ASSERT_EQ(history[0].size(), 2u);
+	EXPECT_EQ(history[0][0].source, make_resource_source(1));
+	EXPECT_EQ(history[0][1].source, make_resource_source(5));
+}
+
+TEST(xaml_prewarm, plans_a_recorded_history)
+{
+	xaml_usage_history history;
+	ASSERT_TRUE(decode_usage_history(recorded_history, history));
+	ASSERT_EQ(history.size(), 3u);
+
+	const auto plan = plan_xaml_prewarm(history);
+	ASSERT_EQ(plan.size(), 2u);
+	EXPECT_EQ(plan[0].source, make_resource_source(101));
+	EXPECT_EQ(plan[0].expected_use, 120ms);
+	EXPECT_DOUBLE_EQ(plan[0].frequency, 1.0);
+	EXPECT_EQ(plan[1].source, make_file_source(L"C:\\Program Files\\Island\\settings.xaml"));
+	EXPECT_EQ(plan[1].text_bytes, 20000u);
+
+	//The help file was only opened once.
+	prewarm_planner_options everything{};
+	everything.minimum_frequency = 0.0;
+	EXPECT_EQ(plan_xaml_prewarm(history, everything).size(), 3u);
+
+	//Over the budget, the settings page is left out but the smaller help file still fits.
+	prewarm_planner_options small{};
+	small.minimum_frequency = 0.0;
+	small.memory_budget = 15000;
+	const auto small_plan = plan_xaml_prewarm(history, small);
+	ASSERT_EQ(small_plan.size(), 2u);
+	EXPECT_EQ(small_plan[1].source, make_file_source(L"C:\\Program Files\\Island\\help.xaml"));
+}
+
+TEST(xaml_prewarm, orders_by_expected_use_then_frequency)
+{
+	xaml_usage_history history;
+	append_usage_run(history, make_run({ { 1, 500 }, { 2, 100 }, { 3, 300 } }));
+	append_usage_run(history, make_run({ { 1, 500 }, { 2, 100 }, { 4, 300 } }));
+	append_usage_run(history, make_run({ { 1, 500 }, { 3, 300 }, { 3, 50 } }));
+	append_usage_run(history, make_run({ { 2, 5000 } }));
+
+	prewarm_planner_options options{};
+	options.minimum_frequency = 0.0;
+	const auto plan = plan_xaml_prewarm(history, options);
+	ASSERT_EQ(plan.size(), 4u);
+	//2 has a median of 100ms even with one slow run.
+	EXPECT_EQ(plan[0].source, make_resource_source(2));
+	//3 and 4 are both at 300ms, 3 was used in more runs, and only counts once in the last one.
+	EXPECT_EQ(plan[1].source, make_resource_source(3));
+	EXPECT_DOUBLE_EQ(plan[1].frequency, 0.5);
+	EXPECT_EQ(plan[2].source, make_resource_source(4));
+	EXPECT_EQ(plan[3].source, make_resource_source(1));
+
+	options.max_items = 2;
+	EXPECT_EQ(plan_xaml_prewarm(history, options).size(), 2u);
+	EXPECT_TRUE(plan_xaml_prewarm({}, options).empty());
+}
+
+TEST(xaml_prewarm, cache_hands_each_fragment_out_once)
+{
+	xaml_text_cache cache(100 * sizeof(wchar_t));
+	const auto button = make_resource_source(101);
+
+	EXPECT_TRUE(cache.is_wanted(button));
+	EXPECT_TRUE(cache.insert(button, std::wstring(60, L'x')));
+	EXPECT_FALSE(cache.is_wanted(button));
+	//Over the budget.
+	EXPECT_FALSE(cache.insert(make_resource_source(102), std::wstring(60, L'y')));
+	EXPECT_EQ(cache.get_bytes(), 60 * sizeof(wchar_t));
+
+	EXPECT_EQ(cache.take(button).value_or(L"").size(), 60u);
+	EXPECT_EQ(cache.get_bytes(), 0u);
+	EXPECT_FALSE(cache.take(button).has_value());
+	//Once it has been loaded, prewarming it again is pointless.
+	EXPECT_FALSE(cache.is_wanted(button));
+	EXPECT_FALSE(cache.insert(button, L"again"));
+
+	EXPECT_TRUE(cache.insert(make_resource_source(103), std::wstring(30, L'a')));
+	EXPECT_TRUE(cache.insert(make_resource_source(104), std::wstring(30, L'b')));
+	cache.trim(40 * sizeof(wchar_t));
+	EXPECT_LE(cache.get_bytes(), 40 * sizeof(wchar_t));
+
+	const auto counters = cache.get_counters();
+	EXPECT_EQ(counters.hits, 1u);
+	EXPECT_EQ(counters.misses, 1u);
+	EXPECT_EQ(counters.rejected, 2u);
+	EXPECT_EQ(counters.trimmed, 1u);
+}
+
+TEST(xaml_prewarm, prewarms_in_plan_order_until_cancelled)
+{
+	xaml_usage_history history;
+	append_usage_run(history, make_run({ { 1, 10 }, { 2, 20 }, { 3, 30 }, { 4, 40 }, { 5, 50 } }));
+	const auto plan = plan_xaml_prewarm(history);
+
+	xaml_text_cache cache;
+	std::vector<uint16_t> reads;
+	xaml_prewarmer prewarmer(cache, [&reads](xaml_source_key const &source)
+		{
+			reads.push_back(source.resource_id);
+			if (source.resource_id == 2)
+			{
+				throw std::runtime_error("the file has gone");
+			}
+			return std::wstring(L"<Button/>");
+		});
+	prewarmer.start(plan);
+	EXPECT_TRUE(prewarmer.is_active());
+
+	//The user got to fragment 3 before the prewarm did.
+	EXPECT_FALSE(cache.take(make_resource_source(3)).has_value());
+	EXPECT_TRUE(prewarmer.prewarm_next());
+	EXPECT_TRUE(prewarmer.prewarm_next());
+	EXPECT_TRUE(prewarmer.prewarm_next());
+	//The user acts, the rest of the plan is dropped.
+	prewarmer.cancel();
+	EXPECT_FALSE(prewarmer.is_active());
+	EXPECT_FALSE(prewarmer.prewarm_next());
+
+	EXPECT_EQ(reads, (std::vector<uint16_t>{ 1, 2, 4 }));
+	const auto &statistics = prewarmer.get_statistics();
+	EXPECT_EQ(statistics.planned, 5u);
+	EXPECT_EQ(statistics.prewarmed, 2u);
+	EXPECT_EQ(statistics.failed, 1u);
+	EXPECT_EQ(statistics.skipped, 1u);
+	EXPECT_EQ(statistics.cancelled, 1u);
+	EXPECT_EQ(cache.take(make_resource_source(4)).value_or(L""), L"<Button/>");
+}
\ No newline at end of file
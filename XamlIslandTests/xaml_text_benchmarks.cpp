@@ -0,0 +1,78 @@
+#include "benchmark_support.h"
+#include "xaml_load_pipeline.h"
+#include "xaml_text.h"
+
+#include <filesystem>
+#include <fstream>
+
+//Markup of about the given size, made of nested elements with attributes.
+std::string make_markup(size_t size, bool non_ascii)
+{
+	std::string markup = "\xEF\xBB\xBF<Grid xmlns=\"http://schemas.microsoft.com/winfx/2006/xaml/presentation\">\r\n";
+	int index = 0;
+	while (markup.size() < size)
+	{
+		markup += "  <StackPanel Orientation=\"Horizontal\">\r\n    <TextBlock Text=\"";
+		markup += non_ascii ? "\xC3\xA9l\xC3\xA9ment \xE2\x82\xAC" : "element";
+		markup += std::to_string(index++);
+		markup += "\" Margin=\"4,2,4,2\"/>\r\n  </StackPanel>\r\n";
+	}
+	markup += "</Grid>";
+	return markup;
+}
+
+XAML_BENCHMARK(xaml_text, decode)
+{
+	const size_t size = context.pick<size_t>(1 << 20, 1 << 14);
+	for (const bool non_ascii : { false, true })
+	{
+		const auto markup = make_markup(size, non_ascii);
+		const int rounds = context.pick(20, 2);
+		const auto ns_per_byte = context.measure(non_ascii ? "utf8_mixed_ns_per_byte" : "utf8_ascii_ns_per_byte", markup.size() * rounds, [&]()
+			{
+				for (int i = 0; i < rounds; ++i)
+				{
+					keep_value(decode_xaml_text(markup));
+				}
+			});
+		context.report(non_ascii ? "utf8_mixed_mb_per_s" : "utf8_ascii_mb_per_s", 1000.0 / ns_per_byte, "MB/s");
+	}
+}
+
+XAML_BENCHMARK(xaml_text, read_file)
+{
+	const auto path = std::filesystem::temp_directory_path() / "xaml_text_benchmark.xaml";
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << make_markup(context.pick<size_t>(1 << 20, 1 << 14), false);
+	}
+	const auto size = std::filesystem::file_size(path);
+	const int rounds = context.pick(20, 2);
+	context.measure("read_and_decode_ns_per_byte", size * rounds, [&]()
+		{
+			for (int i = 0; i < rounds; ++i)
+			{
+				keep_value(decode_xaml_text(read_xaml_file(path)));
+			}
+		});
+	std::filesystem::remove(path);
+}
+
+//A load that goes from the window to the pool and back, with a small document so the time is
+//mostly the two handoffs.
+XAML_BENCHMARK(xaml_text, pipeline_round_trip)
+{
+	test_thread_pool pool;
+	test_window window;
+	const auto markup = make_markup(256, false);
+	const int loads = context.pick(20000, 200);
+	context.measure("round_trip_ns", loads, [&]()
+		{
+			for (int i = 0; i < loads; ++i)
+			{
+				load_xaml_async(window, pool, markup, [](std::wstring &&text) { keep_value(text); });
+				window.pump_one();
+			}
+		});
+	context.report("frame_pool_hits", static_cast<double>(window.get_coroutine_context()->get_frame_pool().get_statistics().pool_hits), "count");
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "xaml_load_pipeline.h"
+#include "xaml_text.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+using namespace std::string_literals;
+
+namespace
+{
+	//A flag that one thread sets and another waits for.
+	struct handoff_signal
+	{
+		std::mutex mutex;
+		std::condition_variable changed;
+		bool is_set = false;
+
+		void set()
+		{
+			{
+				std::lock_guard lock(mutex);
+				is_set = true;
+			}
+			changed.notify_all();
+		}
+		void wait()
+		{
+			std::unique_lock lock(mutex);
+			changed.wait(lock, [this]() { return is_set; });
+		}
+	};
+}
+
+TEST(xaml_text, decodes_utf8_without_a_byte_order_mark)
+{
+	EXPECT_EQ(decode_xaml_text("<Button Content=\"caf\xC3\xA9\"/>"), L"<Button Content=\"caf\u00e9\"/>");
+}
+
+TEST(xaml_text, removes_the_utf8_byte_order_mark)
+{
+	EXPECT_EQ(decode_xaml_text("\xEF\xBB\xBF<Grid/>"), L"<Grid/>");
+}
+
+TEST(xaml_text, decodes_utf16_in_both_byte_orders)
+{
+	EXPECT_EQ(decode_xaml_text("\xFF\xFE<\0G\0/\0>\0"s), L"<G/>");
+	EXPECT_EQ(decode_xaml_text("\xFE\xFF\0<\0G\0/\0>"s), L"<G/>");
+	//An odd trailing byte is replaced.
+	EXPECT_EQ(decode_xaml_text("\xFF\xFE<\0>"s), L"<\uFFFD");
+}
+
+TEST(xaml_text, encodes_supplementary_characters_as_surrogate_pairs)
+{
+	const auto text = decode_xaml_text("\xF0\x9F\x98\x80");
+	ASSERT_EQ(text.size(), 2u);
+	EXPECT_EQ(static_cast<uint32_t>(text[0]), 0xD83Du);
+	EXPECT_EQ(static_cast<uint32_t>(text[1]), 0xDE00u);
+}
+
+TEST(xaml_text, replaces_invalid_utf8)
+{
+	//A stray continuation byte, an overlong encoding, an encoded surrogate and a truncated sequence.
+	const auto text = decode_xaml_text("a\x80" "b\xC0\xAF" "c\xED\xA0\x80" "d\xE2\x82");
+	EXPECT_EQ(text, L"a\uFFFDb\uFFFDc\uFFFDd\uFFFD");
+}
+
+TEST(xaml_text, normalises_line_endings_and_stops_at_a_null)
+{
+	EXPECT_EQ(decode_xaml_text("a\r\nb\rc\nd\0ignored"s), L"a\nb\nc\nd");
+}
+
+TEST(xaml_text, reads_whole_files)
+{
+	const auto path = std::filesystem::temp_directory_path() / "xaml_text_tests.xaml";
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "\xEF\xBB\xBF<Grid>\r\n</Grid>";
+	}
+	EXPECT_EQ(decode_xaml_text(read_xaml_file(path)), L"<Grid>\n</Grid>");
+	std::filesystem::remove(path);
+
+	EXPECT_THROW(read_xaml_file(path), std::filesystem::filesystem_error);
+}
+
+TEST(xaml_load_pipeline, decodes_on_the_pool_and_finishes_on_the_window)
+{
+	test_thread_pool pool;
+	test_window window;
+	std::thread::id decode_thread;
+	std::thread::id loaded_thread;
+	std::wstring loaded;
+
+	load_xaml_async(window, pool, "<Grid/>", [&](std::wstring &&text)
+		{
+			loaded_thread = std::this_thread::get_id();
+			loaded = std::move(text);
+		}, [&]() { decode_thread = std::this_thread::get_id(); });
+
+	ASSERT_TRUE(window.pump_one());
+	EXPECT_EQ(loaded, L"<Grid/>");
+	EXPECT_EQ(loaded_thread, std::this_thread::get_id());
+	EXPECT_NE(decode_thread, std::this_thread::get_id());
+	EXPECT_EQ(window.get_coroutine_context()->get_frame_pool().get_statistics().live_frames, 0u);
+}
+
+//The window goes away while the coroutine is on the pool. The coroutine only holds the context,
+//so it sees the cancellation and unwinds without touching the window.
+TEST(xaml_load_pipeline, window_destroyed_while_decoding)
+{
+	test_thread_pool pool;
+	auto window = std::make_unique<test_window>();
+	std::weak_ptr<coroutine_context> context = window->get_coroutine_context();
+	handoff_signal on_pool;
+	handoff_signal window_gone;
+	std::atomic<bool> loaded{ false };
+
+	load_xaml_async(*window, pool, "<Grid/>", [&](std::wstring &&) { loaded = true; }, [&]()
+		{
+			on_pool.set();
+			window_gone.wait();
+		});
+
+	on_pool.wait();
+	window.reset();
+	window_gone.set();
+
+	//Once the pool has finished with the coroutine, its frame has released the context.
+	for (int i = 0; i < 500 && !context.expired(); ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_TRUE(context.expired());
+	EXPECT_FALSE(loaded);
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "perfect_hash_builder.h"
+#include "type_scanner.h"
+#include "xaml_type_table.g.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+namespace
+{
+	//Names shaped like real type names, so they share long prefixes the way they do in practice.
+	std::vector<std::string> make_type_names(size_t count)
+	{
+		static constexpr std::string_view namespaces[] = { "Microsoft.UI.Xaml.Controls.", "Microsoft.UI.Xaml.Media.", "Contoso.Views.", "Contoso.Controls.Primitives." };
+		std::vector<std::string> names;
+		for (size_t i = 0; i < count; ++i)
+		{
+			names.push_back(std::string(namespaces[i % std::size(namespaces)]) + "Type" + std::to_string(i));
+		}
+		return names;
+	}
+
+	std::wstring widen(std::string const &name)
+	{
+		return std::wstring(name.begin(), name.end());
+	}
+}
+
+TEST(xaml_type_hash, narrow_and_wide_names_hash_the_same)
+{
+	for (auto &name : make_type_names(50))
+	{
+		EXPECT_EQ(xaml_type_hash(std::string_view(name), 1234u), xaml_type_hash(std::wstring_view(widen(name)), 1234u));
+	}
+}
+
+//With thousands of names there are bound to be names that share a bucket and a first choice of
+//slot, the layout has to separate all of them.
+TEST(perfect_hash_builder, separates_every_name)
+{
+	const auto names = make_type_names(5000);
+	std::set<size_t> first_choice_slots;
+	for (auto &name : names)
+	{
+		first_choice_slots.insert(static_cast<size_t>(xaml_type_hash(std::string_view(name), 0u)) & 8191u);
+	}
+	ASSERT_LT(first_choice_slots.size(), names.size());
+
+	const auto layout = build_perfect_hash(names);
+	ASSERT_TRUE(layout);
+	EXPECT_TRUE(is_collision_free(names, *layout));
+	EXPECT_GE(layout->slots.size(), names.size() * 2);
+
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		const auto slot = xaml_type_slot(std::string_view(names[i]), std::span<const uint32_t>(layout->displacements), layout->slots.size());
+		ASSERT_EQ(layout->slots[slot], static_cast<int>(i)) << names[i];
+	}
+}
+
+TEST(perfect_hash_builder, rejects_duplicates)
+{
+	EXPECT_FALSE(build_perfect_hash({ "Contoso.A", "Contoso.B", "Contoso.A" }));
+}
+
+TEST(perfect_hash_builder, handles_empty_and_single_name_sets)
+{
+	const auto empty = build_perfect_hash({});
+	ASSERT_TRUE(empty);
+	EXPECT_TRUE(is_collision_free({}, *empty));
+
+	const auto single = build_perfect_hash({ "Contoso.A" });
+	ASSERT_TRUE(single);
+	EXPECT_TRUE(is_collision_free({ "Contoso.A" }, *single));
+}
+
+TEST(perfect_hash_builder, check_catches_a_broken_layout)
+{
+	const auto names = make_type_names(64);
+	auto layout = build_perfect_hash(names);
+	ASSERT_TRUE(layout);
+
+	//Moving a name out of its slot, which is what a collision would force.
+	const auto occupied = std::find_if(layout->slots.begin(), layout->slots.end(), [](int index) { return index != -1; });
+	const auto empty = std::find(layout->slots.begin(), layout->slots.end(), -1);
+	ASSERT_NE(occupied, layout->slots.end());
+	ASSERT_NE(empty, layout->slots.end());
+	std::iter_swap(occupied, empty);
+	EXPECT_FALSE(is_collision_free(names, *layout));
+}
+
+TEST(type_scanner, assigns_factories_by_namespace)
+{
+	EXPECT_EQ(get_xaml_type_factory("Microsoft.UI.Xaml.Controls.Button", false), xaml_type_factory::controls_provider);
+	EXPECT_EQ(get_xaml_type_factory("Contoso.Views.Card", false), xaml_type_factory::application_provider);
+	//A project type is the application's even if it is in the framework's namespace.
+	EXPECT_EQ(get_xaml_type_factory("Microsoft.UI.Xaml.Custom", true), xaml_type_factory::application_provider);
+}
+
+TEST(type_scanner, finds_element_types)
+{
+	const auto types = scan_xaml_types(
+		"<Grid xmlns=\"http://schemas.microsoft.com/winfx/2006/xaml/presentation\" xmlns:x=\"http://schemas.microsoft.com/winfx/2006/xaml\" xmlns:local=\"using:Contoso.Views\">"
+		"<Grid.Resources><Style x:Key=\"a\"/></Grid.Resources>"
+		"<!-- <Ignored/> --><local:Card/><x:String>text</x:String>"
+		"</Grid>");
+	EXPECT_EQ(types, (std::vector<std::string>{ "Contoso.Views.Card", "Microsoft.UI.Xaml.Controls.Grid", "Microsoft.UI.Xaml.Style" }));
+}
+
+//The table generated from the application's own sources.
+TEST(xaml_type_table, finds_every_generated_type)
+{
+	size_t known = 0;
+	for (size_t slot = 0; slot < xaml_type_table.size(); ++slot)
+	{
+		auto &entry = xaml_type_table[slot];
+		if (entry.origin == xaml_type_origin::none)
+		{
+			continue;
+		}
+		++known;
+		EXPECT_EQ(find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, entry.name), slot);
+		EXPECT_NE(entry.factory, xaml_type_factory::none);
+	}
+	EXPECT_GE(known, 2u);
+}
+
+TEST(xaml_type_table, has_the_application_types_with_their_factories)
+{
+	const auto button = find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, L"Microsoft.UI.Xaml.Controls.Button");
+	ASSERT_NE(button, xaml_type_not_found);
+	EXPECT_EQ(xaml_type_table[button].origin, xaml_type_origin::markup);
+	EXPECT_EQ(xaml_type_table[button].factory, xaml_type_factory::controls_provider);
+
+	const auto application = find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, L"XamlIslandTest3.IslandApplication");
+	ASSERT_NE(application, xaml_type_not_found);
+	EXPECT_EQ(xaml_type_table[application].origin, xaml_type_origin::idl);
+	EXPECT_EQ(xaml_type_table[application].factory, xaml_type_factory::application_provider);
+}
+
+TEST(xaml_type_table, misses_unknown_types)
+{
+	EXPECT_EQ(find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, L"Microsoft.UI.Xaml.Controls.Buttons"), xaml_type_not_found);
+	EXPECT_EQ(find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, L""), xaml_type_not_found);
+	EXPECT_EQ(find_xaml_type_slot(xaml_type_table, xaml_type_table_displacements, L"Contoso.Views.Card"), xaml_type_not_found);
+}
\ No newline at end of file
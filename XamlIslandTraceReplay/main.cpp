@@ -0,0 +1,53 @@
+#include "trace_replay.h"
+
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+//Replays a message trace recorded by XamlIslandTest3 and reports how the routing compares.
+//Usage: XamlIslandTraceReplay <trace file> [passes]
+//A trace is recorded by starting XamlIslandTest3 with XAMLISLANDTEST3_MESSAGE_TRACE set to the
+//path of the file to write.
+
+int wmain(int argc, wchar_t *argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: XamlIslandTraceReplay <trace file> [passes]\n";
+		return 2;
+	}
+
+	const std::filesystem::path path(argv[1]);
+	trace_replay_options options{};
+	if (argc > 2)
+	{
+		options.repeat = static_cast<uint32_t>(std::wcstoul(argv[2], nullptr, 10));
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "XamlIslandTraceReplay: error: unable to open " << path.string() << "\n";
+		return 1;
+	}
+	std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const auto data = std::span<const std::byte>(reinterpret_cast<std::byte const *>(contents.data()), contents.size());
+
+	const auto result = replay_message_trace(data, options);
+	if (result.read_result == message_trace_read_result::bad_magic || result.read_result == message_trace_read_result::unsupported_version)
+	{
+		std::cerr << "XamlIslandTraceReplay: error: " << get_trace_read_result_name(result.read_result) << "\n";
+		return 1;
+	}
+
+	std::cout << format_replay_report(result);
+	if (result.read_result != message_trace_read_result::ok)
+	{
+		//The records before the damage have still been replayed.
+		std::cerr << "XamlIslandTraceReplay: warning: " << get_trace_read_result_name(result.read_result) << "\n";
+	}
+	return result.filter_mismatches + result.navigate_mismatches == 0 ? 0 : 3;
+}
\ No newline at end of file
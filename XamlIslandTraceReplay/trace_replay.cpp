@@ -0,0 +1,374 @@
+#include "trace_replay.h"
+#include "island_focus.h"
+
+#include <algorithm>
+#include <cstdio>
+
+//The Windows API values that the replay needs, so that it doesn't depend on Windows.h.
+constexpr uint32_t trace_wm_keydown = 0x0100;
+constexpr uint64_t trace_vk_tab = 0x09;
+constexpr uint64_t trace_vk_left = 0x25;
+constexpr uint64_t trace_vk_up = 0x26;
+constexpr uint64_t trace_vk_right = 0x27;
+constexpr uint64_t trace_vk_down = 0x28;
+
+//A window belongs to a host if it is the host, one of its tab stops or one of its islands.
+bool is_host_window(message_trace_topology const &topology, uint64_t window)
+{
+	return window == topology.host
+		|| std::find(topology.tab_stops.begin(), topology.tab_stops.end(), window) != topology.tab_stops.end()
+		|| std::find(topology.sources.begin(), topology.sources.end(), window) != topology.sources.end();
+}
+
+uint64_t trace_replay_platform::get_focus()
+{
+	return desktop->focus;
+}
+
+void trace_replay_platform::set_focus(uint64_t window)
+{
+	if (window != desktop->focus)
+	{
+		desktop->focus = window;
+		++desktop->focus_changes;
+	}
+}
+
+uint64_t trace_replay_platform::get_next_tab_item(uint64_t host, uint64_t from, bool previous)
+{
+	auto found = desktop->hosts.find(host);
+	if (found == desktop->hosts.end() || found->second.tab_stops.empty())
+	{
+		return 0;
+	}
+
+	auto &tab_stops = found->second.tab_stops;
+	const auto count = tab_stops.size();
+	auto position = std::find(tab_stops.begin(), tab_stops.end(), from);
+	//Like GetNextDlgTabItem, starting from a window that isn't a tab stop goes to either end.
+	if (position == tab_stops.end())
+	{
+		return previous ? tab_stops.back() : tab_stops.front();
+	}
+	const auto index = static_cast<size_t>(position - tab_stops.begin());
+	return tab_stops[previous ? (index + count - 1) % count : (index + 1) % count];
+}
+
+bool trace_replay_platform::is_menu_modifier_down()
+{
+	return desktop->current && desktop->current->has_modifier(message_trace_modifier::alt);
+}
+
+bool trace_replay_platform::is_dialog_message(uint64_t host, message_trace_message &msg)
+{
+	auto found = desktop->hosts.find(host);
+	if (found == desktop->hosts.end() || !is_host_window(found->second, msg.window))
+	{
+		return false;
+	}
+	if (!msg.has_outcome(message_trace_outcome::navigated))
+	{
+		return false;
+	}
+
+	if (const auto reason = get_navigation_reason(msg))
+	{
+		set_focus(get_next_tab_item(host, desktop->focus, is_previous(*reason)));
+	}
+	return true;
+}
+
+std::optional<trace_navigation_reason> trace_replay_platform::get_navigation_reason(message_trace_message const &msg)
+{
+	if (msg.message != trace_wm_keydown)
+	{
+		return std::nullopt;
+	}
+
+	switch (msg.wparam)
+	{
+	case trace_vk_tab:
+		return msg.has_modifier(message_trace_modifier::shift) ? trace_navigation_reason::last : trace_navigation_reason::first;
+	case trace_vk_left:
+		return trace_navigation_reason::left;
+	case trace_vk_right:
+		return trace_navigation_reason::right;
+	case trace_vk_up:
+		return trace_navigation_reason::up;
+	case trace_vk_down:
+		return trace_navigation_reason::down;
+	}
+	return std::nullopt;
+}
+
+bool trace_replay_platform::is_previous(trace_navigation_reason reason)
+{
+	return reason == trace_navigation_reason::last || reason == trace_navigation_reason::left || reason == trace_navigation_reason::up;
+}
+
+message_trace_message trace_replay_platform::make_navigation_message(uint64_t window, trace_navigation_reason reason)
+{
+	message_trace_message msg{};
+	msg.window = window;
+	msg.message = trace_wm_keydown;
+	switch (reason)
+	{
+	case trace_navigation_reason::first:
+		msg.wparam = trace_vk_tab;
+		break;
+	case trace_navigation_reason::last:
+		msg.wparam = trace_vk_tab;
+		msg.modifiers = static_cast<uint8_t>(message_trace_modifier::shift);
+		break;
+	case trace_navigation_reason::left:
+		msg.wparam = trace_vk_left;
+		break;
+	case trace_navigation_reason::right:
+		msg.wparam = trace_vk_right;
+		break;
+	case trace_navigation_reason::up:
+		msg.wparam = trace_vk_up;
+		break;
+	case trace_navigation_reason::down:
+		msg.wparam = trace_vk_down;
+		break;
+	}
+	return msg;
+}
+
+uint64_t trace_replay_platform::get_source_window(uint64_t const &source)
+{
+	return source;
+}
+
+bool trace_replay_platform::source_has_focus(uint64_t const &source)
+{
+	return desktop->focus == source;
+}
+
+//The routing stops at the first source that handles the message, so answering with the
+//recorded outcome gives the same result however many islands there are.
+bool trace_replay_platform::pre_translate_message(uint64_t const &, message_trace_message const &msg)
+{
+	return msg.has_outcome(message_trace_outcome::filtered);
+}
+
+bool trace_replay_platform::navigate_source(uint64_t const &, trace_navigation_reason, uint64_t, uint64_t &last_request_id)
+{
+	last_request_id = desktop->next_request_id++;
+	return desktop->current && desktop->current->has_outcome(message_trace_outcome::navigated);
+}
+
+void trace_replay_platform::restore_source(uint64_t const &, uint64_t &last_request_id)
+{
+	last_request_id = desktop->next_request_id++;
+}
+
+//The routing state for one pass, a navigator for each host as each window has its own.
+class trace_router
+{
+public:
+	void apply(message_trace_topology const &topology)
+	{
+		if (m_desktop.hosts.find(topology.host) == m_desktop.hosts.end())
+		{
+			m_desktop.host_order.push_back(topology.host);
+			m_navigators.emplace(topology.host, island_focus_navigator<trace_replay_platform>(trace_replay_platform{ &m_desktop }));
+		}
+		m_desktop.hosts[topology.host] = topology;
+	}
+
+	bool has_host_for(uint64_t window) const
+	{
+		for (auto &[host, topology] : m_desktop.hosts)
+		{
+			if (is_host_window(topology, window))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//The same steps as main_application::process_message, without the dispatch.
+	void route(message_trace_message const &recorded, bool &filtered, bool &navigated)
+	{
+		m_desktop.current = &recorded;
+		m_desktop.focus = recorded.focus;
+		filtered = false;
+		navigated = false;
+
+		for (auto host : m_desktop.host_order)
+		{
+			auto &sources = m_desktop.hosts[host].sources;
+			if (m_navigators.at(host).pre_translate_message(sources, recorded))
+			{
+				filtered = true;
+				break;
+			}
+		}
+		if (!filtered)
+		{
+			auto msg = recorded;
+			for (auto host : m_desktop.host_order)
+			{
+				auto &sources = m_desktop.hosts[host].sources;
+				if (m_navigators.at(host).navigate_focus(host, sources, msg))
+				{
+					navigated = true;
+					break;
+				}
+			}
+		}
+		m_desktop.current = nullptr;
+	}
+
+private:
+	trace_replay_desktop m_desktop;
+	std::map<uint64_t, island_focus_navigator<trace_replay_platform>> m_navigators;
+};
+
+trace_replay_result replay_message_trace(std::span<const std::byte> data, trace_replay_options const &options)
+{
+	trace_replay_result result{};
+
+	//Everything is decoded first, so the replay time is only the routing.
+	std::vector<message_trace_entry> entries;
+	message_trace_reader reader(data);
+	result.read_result = reader.read_header(result.header);
+	if (result.read_result != message_trace_read_result::ok)
+	{
+		return result;
+	}
+	for (;;)
+	{
+		message_trace_entry entry;
+		const auto read_result = reader.next(entry);
+		if (read_result != message_trace_read_result::ok)
+		{
+			result.read_result = read_result == message_trace_read_result::end ? message_trace_read_result::ok : read_result;
+			break;
+		}
+		entries.push_back(std::move(entry));
+	}
+	result.chunks = reader.get_chunks_read();
+
+	std::optional<std::chrono::nanoseconds> first_dequeue;
+	std::chrono::nanoseconds last_dequeue{};
+	for (uint32_t pass = 0; pass < std::max<uint32_t>(options.repeat, 1); ++pass)
+	{
+		const bool counting = pass == 0;
+		trace_router router;
+		uint64_t index = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (auto &entry : entries)
+		{
+			if (entry.kind == message_trace_record_kind::topology)
+			{
+				router.apply(entry.topology);
+				result.topologies += counting ? 1 : 0;
+				continue;
+			}
+
+			auto &message = entry.message;
+			bool filtered = false;
+			bool navigated = false;
+			router.route(message, filtered, navigated);
+			if (!counting)
+			{
+				continue;
+			}
+
+			++result.messages;
+			const bool recorded_filtered = message.has_outcome(message_trace_outcome::filtered);
+			const bool recorded_navigated = message.has_outcome(message_trace_outcome::navigated);
+			result.filtered += recorded_filtered ? 1 : 0;
+			result.navigated += recorded_navigated ? 1 : 0;
+			result.dispatched += message.has_outcome(message_trace_outcome::dispatched) ? 1 : 0;
+			const bool filter_mismatch = filtered != recorded_filtered;
+			const bool navigate_mismatch = !filter_mismatch && !filtered && navigated != recorded_navigated;
+			result.filter_mismatches += filter_mismatch ? 1 : 0;
+			result.navigate_mismatches += navigate_mismatch ? 1 : 0;
+			if ((filter_mismatch || navigate_mismatch) && !result.first_mismatch)
+			{
+				result.first_mismatch = index;
+			}
+			if (message.window != 0 && !router.has_host_for(message.window))
+			{
+				++result.unknown_hosts;
+			}
+
+			result.recorded_filter += message.filter_duration;
+			result.recorded_navigate += message.navigate_duration;
+			result.recorded_dispatch += message.dispatch_duration;
+			if (!first_dequeue)
+			{
+				first_dequeue = message.dequeue_time;
+			}
+			last_dequeue = message.dequeue_time;
+			++index;
+		}
+		result.replay_time += std::chrono::steady_clock::now() - start;
+		++result.passes;
+	}
+	if (first_dequeue)
+	{
+		result.recorded_span = last_dequeue - *first_dequeue;
+	}
+
+	return result;
+}
+
+std::string format_replay_report(trace_replay_result const &result)
+{
+	std::string report;
+	char line[160];
+	const auto microseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<double, std::micro>(time).count(); };
+
+	std::snprintf(line, sizeof(line), "%llu messages, %llu topology records in %llu chunks, %.1fms recorded\n", static_cast<unsigned long long>(result.messages), static_cast<unsigned long long>(result.topologies), static_cast<unsigned long long>(result.chunks), microseconds(result.recorded_span) / 1000.0);
+	report.append(line);
+	std::snprintf(line, sizeof(line), "  recorded   %llu filtered, %llu navigated, %llu dispatched\n", static_cast<unsigned long long>(result.filtered), static_cast<unsigned long long>(result.navigated), static_cast<unsigned long long>(result.dispatched));
+	report.append(line);
+	std::snprintf(line, sizeof(line), "  recorded   filter %.1fus, navigate %.1fus, dispatch %.1fus\n", microseconds(result.recorded_filter), microseconds(result.recorded_navigate), microseconds(result.recorded_dispatch));
+	report.append(line);
+	if (result.passes != 0 && result.messages != 0)
+	{
+		const auto per_message = static_cast<double>(result.replay_time.count()) / (static_cast<double>(result.passes) * static_cast<double>(result.messages));
+		std::snprintf(line, sizeof(line), "  replayed   %u passes, %.1fus per pass, %.1fns per message\n", result.passes, microseconds(result.replay_time) / result.passes, per_message);
+		report.append(line);
+	}
+	std::snprintf(line, sizeof(line), "  mismatches %llu filter, %llu navigation", static_cast<unsigned long long>(result.filter_mismatches), static_cast<unsigned long long>(result.navigate_mismatches));
+	report.append(line);
+	if (result.first_mismatch)
+	{
+		std::snprintf(line, sizeof(line), ", first at message %llu", static_cast<unsigned long long>(*result.first_mismatch));
+		report.append(line);
+	}
+	report.push_back('\n');
+	if (result.unknown_hosts != 0)
+	{
+		std::snprintf(line, sizeof(line), "  %llu messages for windows outside of the recorded topology\n", static_cast<unsigned long long>(result.unknown_hosts));
+		report.append(line);
+	}
+	return report;
+}
+
+std::string_view get_trace_read_result_name(message_trace_read_result result)
+{
+	switch (result)
+	{
+	case message_trace_read_result::ok:
+	case message_trace_read_result::end:
+		return "ok";
+	case message_trace_read_result::truncated:
+		return "the trace was cut short";
+	case message_trace_read_result::bad_magic:
+		return "the file isn't a message trace";
+	case message_trace_read_result::unsupported_version:
+		return "the trace is from an unsupported version";
+	case message_trace_read_result::corrupt:
+		return "the trace is damaged";
+	}
+	return "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "message_trace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Feeds a recorded message trace back through the message routing and focus navigation.
+//The routing is the same island_focus_navigator that the application uses, driven by a platform
+//that plays the part of the desktop. The windows come from the topology records, the keyboard
+//focus is set to what it was when each message was recorded, and the answers that only xaml could
+//give, such as whether PreTranslateMessage handled the message, come from the recorded outcome.
+//With nothing live involved, every replay of a trace does exactly the same thing.
+
+enum class trace_navigation_reason : uint8_t
+{
+	first,
+	last,
+	left,
+	right,
+	up,
+	down
+};
+
+//The state shared by the platforms of every host window.
+struct trace_replay_desktop
+{
+	std::map<uint64_t, message_trace_topology> hosts;
+	//The order that the hosts were first seen in, which is the order the pump asks them in.
+	std::vector<uint64_t> host_order;
+	message_trace_message const *current = nullptr;
+	uint64_t focus = 0;
+	uint64_t next_request_id = 1;
+	uint64_t focus_changes = 0;
+};
+
+//The island_focus_navigator platform for a replay.
+struct trace_replay_platform
+{
+	using window_type = uint64_t;
+	using message_type = message_trace_message;
+	using source_type = uint64_t;
+	using reason_type = trace_navigation_reason;
+	using request_id_type = uint64_t;
+
+	trace_replay_desktop *desktop = nullptr;
+
+	uint64_t get_focus();
+	void set_focus(uint64_t);
+	//Steps through the host's tab stops, wrapping around at the ends.
+	uint64_t get_next_tab_item(uint64_t host, uint64_t from, bool previous);
+	bool is_menu_modifier_down();
+	//Dialog navigation handled the message if the trace says it was navigated.
+	bool is_dialog_message(uint64_t host, message_trace_message &);
+	std::optional<trace_navigation_reason> get_navigation_reason(message_trace_message const &);
+	bool is_previous(trace_navigation_reason);
+	message_trace_message make_navigation_message(uint64_t, trace_navigation_reason);
+	uint64_t get_source_window(uint64_t const &);
+	bool source_has_focus(uint64_t const &);
+	bool pre_translate_message(uint64_t const &, message_trace_message const &);
+	bool navigate_source(uint64_t const &, trace_navigation_reason, uint64_t previous_focus, uint64_t &last_request_id);
+	void restore_source(uint64_t const &, uint64_t &last_request_id);
+};
+
+struct trace_replay_options
+{
+	//The trace is replayed this many times, which gives steadier timings for short traces.
+	uint32_t repeat = 1;
+};
+
+struct trace_replay_result
+{
+	message_trace_read_result read_result = message_trace_read_result::ok;
+	message_trace_header header{};
+	uint64_t messages = 0;
+	uint64_t topologies = 0;
+	uint64_t chunks = 0;
+	uint64_t filtered = 0;
+	uint64_t navigated = 0;
+	uint64_t dispatched = 0;
+	//Messages where the replayed routing came to a different outcome to the recorded one.
+	uint64_t filter_mismatches = 0;
+	uint64_t navigate_mismatches = 0;
+	//Messages for windows that no topology record has described.
+	uint64_t unknown_hosts = 0;
+	//The recorded times, summed over the messages in one pass.
+	std::chrono::nanoseconds recorded_filter{};
+	std::chrono::nanoseconds recorded_navigate{};
+	std::chrono::nanoseconds recorded_dispatch{};
+	//The time from the first to the last message in the trace.
+	std::chrono::nanoseconds recorded_span{};
+	//The time the replayed routing took, summed over every pass.
+	std::chrono::nanoseconds replay_time{};
+	uint32_t passes = 0;
+	//The first message that didn't match, counting from 0.
+	std::optional<uint64_t> first_mismatch;
+};
+
+//Replays a whole trace that is in memory.
+//If the trace is damaged the records before the damage are still replayed, and the read result
+//says what was wrong.
+trace_replay_result replay_message_trace(std::span<const std::byte>, trace_replay_options const & = {});
+
+std::string format_replay_report(trace_replay_result const &);
+std::string_view get_trace_read_result_name(message_trace_read_result);
\ No newline at end of file
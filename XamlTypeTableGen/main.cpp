@@ -0,0 +1,159 @@
+#include "perfect_hash_builder.h"
+#include "type_scanner.h"
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+//Generates the constexpr xaml type table for XamlIslandTest3.
+//Usage: XamlTypeTableGen <output header> <input>...
+//Inputs ending in .idl are scanned for runtime classes, everything else is treated as xaml.
+//The header is only rewritten if its contents change, so an unchanged table doesn't force
+//everything that includes it to be rebuilt.
+
+std::string read_file(std::filesystem::path const &file_path)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("unable to open " + file_path.string());
+	}
+
+	std::ostringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+char const *get_xaml_type_factory_name(xaml_type_factory factory)
+{
+	switch (factory)
+	{
+	case xaml_type_factory::controls_provider:
+		return "controls_provider";
+	case xaml_type_factory::application_provider:
+		return "application_provider";
+	case xaml_type_factory::none:
+	case xaml_type_factory::factory_count:
+		break;
+	}
+
+	return "none";
+}
+
+//A known type and where it came from.
+struct known_type
+{
+	std::string origin;
+	xaml_type_factory factory = xaml_type_factory::none;
+};
+
+std::string generate_header(std::vector<std::string> const &names, std::vector<known_type> const &types, perfect_hash_layout const &layout, std::vector<std::filesystem::path> const &inputs)
+{
+	std::ostringstream header;
+
+	header << "#pragma once\n";
+	header << "//Generated by XamlTypeTableGen from:\n";
+	for (auto &input : inputs)
+	{
+		header << "//  " << input.filename().string() << "\n";
+	}
+	header << "//Do not edit, this is regenerated whenever the inputs change.\n\n";
+	header << "#include \"xaml_type_hash.h\"\n\n";
+	header << "constexpr std::array<uint32_t, " << layout.displacements.size() << "> xaml_type_table_displacements{ {";
+	for (size_t i = 0; i < layout.displacements.size(); ++i)
+	{
+		header << (i % 8 == 0 ? "\n\t" : " ") << layout.displacements[i] << "u,";
+	}
+	header << "\n} };\n";
+	header << "constexpr std::array<xaml_type_table_entry, " << layout.slots.size() << "> xaml_type_table{ {\n";
+	for (auto index : layout.slots)
+	{
+		if (index == -1)
+		{
+			header << "\t{},\n";
+		}
+		else
+		{
+			header << "\t{ L\"" << names[index] << "\", xaml_type_origin::" << types[index].origin << ", xaml_type_factory::" << get_xaml_type_factory_name(types[index].factory) << " },\n";
+		}
+	}
+	header << "} };\n\n";
+	header << "static_assert(xaml_type_table_is_perfect(xaml_type_table, xaml_type_table_displacements), \"xaml type table has a collision\");";
+
+	return header.str();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: XamlTypeTableGen <output header> <input>...\n";
+		return 2;
+	}
+
+	try
+	{
+		const std::filesystem::path output_path = argv[1];
+		std::vector<std::filesystem::path> inputs(argv + 2, argv + argc);
+
+		//Sorted by name so that the output only depends on the set of types.
+		std::map<std::string, known_type> types;
+		for (auto &input : inputs)
+		{
+			const auto content = read_file(input);
+			const bool is_idl = input.extension() == ".idl";
+			const auto found = is_idl ? scan_idl_types(content) : scan_xaml_types(content);
+			for (auto &name : found)
+			{
+				if (!is_valid_type_name(name))
+				{
+					throw std::runtime_error("unsupported type name " + name + " in " + input.string());
+				}
+				types.emplace(name, known_type{ is_idl ? "idl" : "markup", get_xaml_type_factory(name, is_idl) });
+			}
+		}
+
+		std::vector<std::string> names;
+		std::vector<known_type> known_types;
+		for (auto &[name, type] : types)
+		{
+			names.push_back(name);
+			known_types.push_back(type);
+		}
+
+		const auto layout = build_perfect_hash(names);
+		if (!layout || !is_collision_free(names, *layout))
+		{
+			throw std::runtime_error("unable to find a collision free layout for the xaml type table");
+		}
+
+		const auto header = generate_header(names, known_types, *layout, inputs);
+		if (std::filesystem::exists(output_path) && read_file(output_path) == header)
+		{
+			return 0;
+		}
+
+		if (output_path.has_parent_path())
+		{
+			std::filesystem::create_directories(output_path.parent_path());
+		}
+		std::ofstream output(output_path, std::ios::binary | std::ios::trunc);
+		output << header;
+		if (!output)
+		{
+			throw std::runtime_error("unable to write " + output_path.string());
+		}
+
+		std::cout << "XamlTypeTableGen: " << names.size() << " types in " << layout->slots.size() << " slots, " << layout->displacements.size() << " buckets\n";
+	}
+	catch (std::exception const &e)
+	{
+		std::cerr << "XamlTypeTableGen: error: " << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
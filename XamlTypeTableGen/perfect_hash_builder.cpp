@@ -0,0 +1,132 @@
+#include "perfect_hash_builder.h"
+#include "xaml_type_hash.h"
+
+#include <algorithm>
+
+constexpr size_t maximum_table_size = 1u << 20;
+
+size_t next_power_of_two(size_t value)
+{
+	size_t result = 1;
+	while (result < value)
+	{
+		result *= 2;
+	}
+	return result;
+}
+
+//Tries to place every bucket in a table of the given size.
+bool place_buckets(std::vector<std::string> const &names, std::vector<std::vector<size_t>> const &buckets, size_t table_size, uint32_t seeds_per_bucket, perfect_hash_layout &layout)
+{
+	layout.displacements.assign(buckets.size(), 0);
+	layout.slots.assign(table_size, -1);
+
+	std::vector<size_t> order(buckets.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	//The biggest buckets are the hardest to place, so they go while the table is emptiest.
+	std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+	std::vector<size_t> candidate;
+	for (auto bucket : order)
+	{
+		if (buckets[bucket].empty())
+		{
+			break;
+		}
+
+		bool placed = false;
+		for (uint32_t seed = 0; seed < seeds_per_bucket && !placed; ++seed)
+		{
+			candidate.clear();
+			placed = true;
+			for (auto index : buckets[bucket])
+			{
+				const auto slot = static_cast<size_t>(xaml_type_hash(std::string_view(names[index]), seed)) & (table_size - 1);
+				if (layout.slots[slot] != -1 || std::find(candidate.begin(), candidate.end(), slot) != candidate.end())
+				{
+					placed = false;
+					break;
+				}
+				candidate.push_back(slot);
+			}
+
+			if (placed)
+			{
+				layout.displacements[bucket] = seed;
+				for (size_t i = 0; i < candidate.size(); ++i)
+				{
+					layout.slots[candidate[i]] = static_cast<int>(buckets[bucket][i]);
+				}
+			}
+		}
+
+		if (!placed)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::optional<perfect_hash_layout> build_perfect_hash(std::vector<std::string> const &names, uint32_t seeds_per_bucket)
+{
+	auto sorted = names;
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+	{
+		return std::nullopt;
+	}
+
+	const auto bucket_count = next_power_of_two((names.size() + 3) / 4);
+	std::vector<std::vector<size_t>> buckets(bucket_count);
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		buckets[xaml_type_bucket(std::string_view(names[i]), bucket_count)].push_back(i);
+	}
+
+	perfect_hash_layout layout;
+	for (auto table_size = next_power_of_two(names.size() * 2); table_size <= maximum_table_size; table_size *= 2)
+	{
+		if (place_buckets(names, buckets, table_size, seeds_per_bucket, layout))
+		{
+			return layout;
+		}
+	}
+
+	return std::nullopt;
+}
+
+bool is_collision_free(std::vector<std::string> const &names, perfect_hash_layout const &layout)
+{
+	const auto table_size = layout.slots.size();
+	const auto bucket_count = layout.displacements.size();
+	if (table_size == 0 || (table_size & (table_size - 1)) != 0 || bucket_count == 0 || (bucket_count & (bucket_count - 1)) != 0)
+	{
+		return false;
+	}
+
+	std::vector<bool> placed(names.size(), false);
+	for (size_t slot = 0; slot < table_size; ++slot)
+	{
+		const auto index = layout.slots[slot];
+		if (index == -1)
+		{
+			continue;
+		}
+		if (index < 0 || static_cast<size_t>(index) >= names.size() || placed[index])
+		{
+			return false;
+		}
+		if (xaml_type_slot(std::string_view(names[index]), std::span<const uint32_t>(layout.displacements), table_size) != slot)
+		{
+			return false;
+		}
+		placed[index] = true;
+	}
+
+	return std::all_of(placed.begin(), placed.end(), [](bool p) { return p; });
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+//Per bucket seeds and a table layout that place every name in its own slot.
+struct perfect_hash_layout
+{
+	std::vector<uint32_t> displacements;
+	//Index into the names for each slot, or -1 for an empty slot.
+	std::vector<int> slots;
+};
+
+//Searches for a collision free layout using the hash and displace scheme in xaml_type_hash.h.
+//There is a bucket for roughly every four names and the table is the smallest power of two that
+//is at least twice the number of names. Buckets are placed largest first, trying seeds in order
+//until every name in the bucket lands in a free slot. If a bucket runs out of seeds the table
+//size is doubled and the search starts again.
+//Returns nothing if the names contain duplicates, since they can never be separated.
+std::optional<perfect_hash_layout> build_perfect_hash(std::vector<std::string> const &names, uint32_t seeds_per_bucket = 1u << 16);
+
+//Checks a layout independently of how it was built.
+bool is_collision_free(std::vector<std::string> const &names, perfect_hash_layout const &);
\ No newline at end of file
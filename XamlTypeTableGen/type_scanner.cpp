@@ -0,0 +1,376 @@
+#include "type_scanner.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+constexpr std::string_view presentation_namespace = "http://schemas.microsoft.com/winfx/2006/xaml/presentation";
+constexpr std::string_view using_prefix = "using:";
+constexpr std::string_view framework_namespace = "Microsoft.UI.Xaml.";
+
+//Most of the presentation namespace is controls, these are the exceptions.
+struct presentation_type
+{
+	std::string_view name;
+	std::string_view type_namespace;
+};
+constexpr presentation_type presentation_exceptions[] = {
+	{ "DataTemplate", "Microsoft.UI.Xaml" },
+	{ "ResourceDictionary", "Microsoft.UI.Xaml" },
+	{ "Setter", "Microsoft.UI.Xaml" },
+	{ "Style", "Microsoft.UI.Xaml" },
+	{ "VisualState", "Microsoft.UI.Xaml" },
+	{ "VisualStateGroup", "Microsoft.UI.Xaml" },
+	{ "VisualTransition", "Microsoft.UI.Xaml" },
+	{ "AcrylicBrush", "Microsoft.UI.Xaml.Media" },
+	{ "FontFamily", "Microsoft.UI.Xaml.Media" },
+	{ "GradientStop", "Microsoft.UI.Xaml.Media" },
+	{ "ImageBrush", "Microsoft.UI.Xaml.Media" },
+	{ "LinearGradientBrush", "Microsoft.UI.Xaml.Media" },
+	{ "RotateTransform", "Microsoft.UI.Xaml.Media" },
+	{ "ScaleTransform", "Microsoft.UI.Xaml.Media" },
+	{ "SolidColorBrush", "Microsoft.UI.Xaml.Media" },
+	{ "TranslateTransform", "Microsoft.UI.Xaml.Media" },
+	{ "ColorAnimation", "Microsoft.UI.Xaml.Media.Animation" },
+	{ "DoubleAnimation", "Microsoft.UI.Xaml.Media.Animation" },
+	{ "Storyboard", "Microsoft.UI.Xaml.Media.Animation" },
+	{ "Bold", "Microsoft.UI.Xaml.Documents" },
+	{ "Hyperlink", "Microsoft.UI.Xaml.Documents" },
+	{ "Italic", "Microsoft.UI.Xaml.Documents" },
+	{ "LineBreak", "Microsoft.UI.Xaml.Documents" },
+	{ "Paragraph", "Microsoft.UI.Xaml.Documents" },
+	{ "Run", "Microsoft.UI.Xaml.Documents" },
+	{ "Span", "Microsoft.UI.Xaml.Documents" },
+	{ "Ellipse", "Microsoft.UI.Xaml.Shapes" },
+	{ "Line", "Microsoft.UI.Xaml.Shapes" },
+	{ "Path", "Microsoft.UI.Xaml.Shapes" },
+	{ "Rectangle", "Microsoft.UI.Xaml.Shapes" },
+};
+
+bool is_name_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == ':' || c == '-';
+}
+
+bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_valid_type_name(std::string_view name)
+{
+	if (name.empty() || name.front() == '.' || name.back() == '.')
+	{
+		return false;
+	}
+
+	char previous = '\0';
+	for (auto c : name)
+	{
+		const bool identifier = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+		if (!identifier && c != '.')
+		{
+			return false;
+		}
+		if (c == '.' && previous == '.')
+		{
+			return false;
+		}
+		previous = c;
+	}
+
+	return true;
+}
+
+xaml_type_factory get_xaml_type_factory(std::string_view name, bool is_idl)
+{
+	if (!is_idl && name.starts_with(framework_namespace))
+	{
+		return xaml_type_factory::controls_provider;
+	}
+
+	return xaml_type_factory::application_provider;
+}
+
+//Maps an xml namespace and local name to a type name.
+//Returns an empty string for namespaces that don't hold types.
+std::string resolve_xaml_type(std::string_view xml_namespace, std::string_view local_name)
+{
+	if (xml_namespace == presentation_namespace)
+	{
+		auto it = std::find_if(std::begin(presentation_exceptions), std::end(presentation_exceptions), [local_name](presentation_type const &t) { return t.name == local_name; });
+		const std::string_view type_namespace = it != std::end(presentation_exceptions) ? it->type_namespace : "Microsoft.UI.Xaml.Controls";
+		return std::string(type_namespace) + "." + std::string(local_name);
+	}
+	if (xml_namespace.starts_with(using_prefix))
+	{
+		return std::string(xml_namespace.substr(using_prefix.size())) + "." + std::string(local_name);
+	}
+
+	//The xaml language namespace, markup compatibility, designer namespaces and so on.
+	return {};
+}
+
+void sort_unique(std::vector<std::string> &names)
+{
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+std::vector<std::string> scan_xaml_types(std::string_view markup)
+{
+	if (markup.starts_with("\xEF\xBB\xBF"))
+	{
+		markup.remove_prefix(3);
+	}
+	if (markup.starts_with("\xFF\xFE") || markup.starts_with("\xFE\xFF"))
+	{
+		throw std::runtime_error("UTF-16 xaml isn't supported, save the file as UTF-8");
+	}
+
+	using namespace_scope = std::map<std::string, std::string, std::less<>>;
+	std::vector<namespace_scope> scopes;
+	std::vector<std::string> types;
+
+	size_t i = 0;
+	while ((i = markup.find('<', i)) != std::string_view::npos)
+	{
+		const auto rest = markup.substr(i);
+		if (rest.starts_with("<!--"))
+		{
+			const auto end = markup.find("-->", i + 4);
+			i = end == std::string_view::npos ? markup.size() : end + 3;
+			continue;
+		}
+		if (rest.starts_with("<![CDATA["))
+		{
+			const auto end = markup.find("]]>", i + 9);
+			i = end == std::string_view::npos ? markup.size() : end + 3;
+			continue;
+		}
+		if (rest.starts_with("<?") || rest.starts_with("<!"))
+		{
+			const auto end = markup.find('>', i);
+			i = end == std::string_view::npos ? markup.size() : end + 1;
+			continue;
+		}
+		if (rest.starts_with("</"))
+		{
+			if (!scopes.empty())
+			{
+				scopes.pop_back();
+			}
+			const auto end = markup.find('>', i);
+			i = end == std::string_view::npos ? markup.size() : end + 1;
+			continue;
+		}
+
+		//A start tag, read the name and then the attributes.
+		++i;
+		const auto name_start = i;
+		while (i < markup.size() && is_name_char(markup[i]))
+		{
+			++i;
+		}
+		const auto qualified_name = markup.substr(name_start, i - name_start);
+
+		namespace_scope scope = scopes.empty() ? namespace_scope{} : scopes.back();
+		bool self_closing = false;
+		while (i < markup.size())
+		{
+			if (is_space(markup[i]))
+			{
+				++i;
+				continue;
+			}
+			if (markup[i] == '>')
+			{
+				++i;
+				break;
+			}
+			if (markup[i] == '/')
+			{
+				self_closing = true;
+				++i;
+				continue;
+			}
+
+			const auto attribute_start = i;
+			while (i < markup.size() && is_name_char(markup[i]))
+			{
+				++i;
+			}
+			const auto attribute = markup.substr(attribute_start, i - attribute_start);
+			if (attribute.empty())
+			{
+				throw std::runtime_error("malformed attribute in xaml tag");
+			}
+			while (i < markup.size() && is_space(markup[i]))
+			{
+				++i;
+			}
+			if (i >= markup.size() || markup[i] != '=')
+			{
+				continue;
+			}
+			++i;
+			while (i < markup.size() && is_space(markup[i]))
+			{
+				++i;
+			}
+			if (i >= markup.size() || (markup[i] != '"' && markup[i] != '\''))
+			{
+				throw std::runtime_error("unquoted attribute value in xaml tag");
+			}
+			const auto quote = markup[i++];
+			const auto value_end = markup.find(quote, i);
+			if (value_end == std::string_view::npos)
+			{
+				throw std::runtime_error("unterminated attribute value in xaml tag");
+			}
+			const auto value = markup.substr(i, value_end - i);
+			i = value_end + 1;
+
+			if (attribute == "xmlns")
+			{
+				scope[""] = std::string(value);
+			}
+			else if (attribute.starts_with("xmlns:"))
+			{
+				scope[std::string(attribute.substr(6))] = std::string(value);
+			}
+		}
+
+		//Property elements such as Button.Flyout name a property, not a type.
+		const auto colon = qualified_name.find(':');
+		const auto prefix = colon == std::string_view::npos ? std::string_view{} : qualified_name.substr(0, colon);
+		const auto local_name = colon == std::string_view::npos ? qualified_name : qualified_name.substr(colon + 1);
+		if (!local_name.empty() && local_name.find('.') == std::string_view::npos)
+		{
+			auto it = scope.find(prefix);
+			if (it == scope.end())
+			{
+				throw std::runtime_error("xaml element uses an undeclared namespace prefix: " + std::string(qualified_name));
+			}
+			auto type = resolve_xaml_type(it->second, local_name);
+			if (!type.empty())
+			{
+				types.push_back(std::move(type));
+			}
+		}
+
+		if (!self_closing)
+		{
+			scopes.push_back(std::move(scope));
+		}
+	}
+
+	sort_unique(types);
+	return types;
+}
+
+//Removes both styles of comment, keeping line breaks so that nothing gets joined together.
+std::string strip_idl_comments(std::string_view idl)
+{
+	std::string result;
+	result.reserve(idl.size());
+
+	size_t i = 0;
+	while (i < idl.size())
+	{
+		if (idl.substr(i).starts_with("//"))
+		{
+			const auto end = idl.find('\n', i);
+			i = end == std::string_view::npos ? idl.size() : end;
+			continue;
+		}
+		if (idl.substr(i).starts_with("/*"))
+		{
+			const auto end = idl.find("*/", i + 2);
+			i = end == std::string_view::npos ? idl.size() : end + 2;
+			result.push_back(' ');
+			continue;
+		}
+		result.push_back(idl[i++]);
+	}
+
+	return result;
+}
+
+std::vector<std::string> scan_idl_types(std::string_view idl)
+{
+	const auto text = strip_idl_comments(idl);
+
+	//Split into identifiers, which include dots so that qualified names stay together, and
+	//single punctuation characters. Only braces matter beyond the identifiers themselves.
+	std::vector<std::string> tokens;
+	size_t i = 0;
+	while (i < text.size())
+	{
+		const auto c = text[i];
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.')
+		{
+			const auto start = i;
+			while (i < text.size() && ((text[i] >= 'a' && text[i] <= 'z') || (text[i] >= 'A' && text[i] <= 'Z') || (text[i] >= '0' && text[i] <= '9') || text[i] == '_' || text[i] == '.'))
+			{
+				++i;
+			}
+			tokens.push_back(text.substr(start, i - start));
+			continue;
+		}
+		if (c == '"')
+		{
+			//Attribute arguments can contain anything, skip them.
+			const auto end = text.find('"', i + 1);
+			i = end == std::string::npos ? text.size() : end + 1;
+			continue;
+		}
+		if (!is_space(c))
+		{
+			tokens.push_back(std::string(1, c));
+		}
+		++i;
+	}
+
+	//Each open brace pushes either the namespace it opens or an empty string for any other block.
+	std::vector<std::string> blocks;
+	std::string pending_namespace;
+	std::vector<std::string> types;
+
+	for (size_t t = 0; t < tokens.size(); ++t)
+	{
+		const auto &token = tokens[t];
+		if (token == "namespace" && t + 1 < tokens.size())
+		{
+			pending_namespace = tokens[++t];
+		}
+		else if (token == "{")
+		{
+			blocks.push_back(std::move(pending_namespace));
+			pending_namespace.clear();
+		}
+		else if (token == "}")
+		{
+			if (!blocks.empty())
+			{
+				blocks.pop_back();
+			}
+		}
+		else if (token == "runtimeclass" && t + 1 < tokens.size())
+		{
+			std::string name;
+			for (auto &block : blocks)
+			{
+				if (!block.empty())
+				{
+					name += block + ".";
+				}
+			}
+			name += tokens[++t];
+			types.push_back(std::move(name));
+		}
+	}
+
+	sort_unique(types);
+	return types;
+}
\ No newline at end of file
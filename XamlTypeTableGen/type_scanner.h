@@ -0,0 +1,29 @@
+#pragma once
+
+#include "xaml_type_hash.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Finds the fully qualified names of the types used by the project's sources.
+//These are deliberately simple scanners rather than full parsers, they only need to understand
+//as much of each format as the project uses.
+
+//Returns the types of the elements in a piece of xaml markup.
+//Property elements, directives in the xaml language namespace and elements in namespaces that
+//don't map to types are skipped.
+//The markup must be UTF-8, with or without a byte order mark.
+std::vector<std::string> scan_xaml_types(std::string_view markup);
+
+//Returns the runtime classes declared in a piece of MIDL 3.0.
+std::vector<std::string> scan_idl_types(std::string_view idl);
+
+//Works out which provider creates a type's metadata from its namespace.
+//Types declared in the project's IDL, and markup types from any namespace other than the
+//framework's, belong to the application.
+xaml_type_factory get_xaml_type_factory(std::string_view name, bool is_idl);
+
+//Type names end up as wide string literals and are hashed as both narrow and wide strings,
+//so they are restricted to ASCII identifiers separated by dots.
+bool is_valid_type_name(std::string_view name);
\ No newline at end of file